@@ -39,6 +39,8 @@
 
 #include <KFL/Bound.hpp>
 
+#include <vector>
+
 namespace KlayGE
 {
 	template <typename T>
@@ -124,6 +126,52 @@ namespace KlayGE
 	private:
 		Vector_T<T, 3> min_, max_;
 	};
+
+	// AABBs stored as one array per component, so batch tests can load several boxes per SIMD register
+	template <typename T>
+	class AABBoxSoA_T final
+	{
+	public:
+		size_t Size() const noexcept
+		{
+			return min_x_.size();
+		}
+		void Resize(size_t size);
+		void Clear() noexcept;
+
+		void PushBack(AABBox_T<T> const & aabb);
+		void Set(size_t index, AABBox_T<T> const & aabb) noexcept;
+		AABBox_T<T> Get(size_t index) const noexcept;
+
+		T const * MinX() const noexcept
+		{
+			return min_x_.data();
+		}
+		T const * MinY() const noexcept
+		{
+			return min_y_.data();
+		}
+		T const * MinZ() const noexcept
+		{
+			return min_z_.data();
+		}
+		T const * MaxX() const noexcept
+		{
+			return max_x_.data();
+		}
+		T const * MaxY() const noexcept
+		{
+			return max_y_.data();
+		}
+		T const * MaxZ() const noexcept
+		{
+			return max_z_.data();
+		}
+
+	private:
+		std::vector<T> min_x_, min_y_, min_z_;
+		std::vector<T> max_x_, max_y_, max_z_;
+	};
 }
 
 #endif			// _KFL_AABBOX_HPP
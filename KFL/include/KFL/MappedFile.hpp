@@ -0,0 +1,88 @@
+/**
+ * @file MappedFile.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_MAPPEDFILE_HPP
+#define _KFL_MAPPEDFILE_HPP
+
+#pragma once
+
+#include <KFL/ArrayRef.hpp>
+#include <KFL/CXX17/string_view.hpp>
+
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// A read-only view of a whole file. It's memory mapped when the platform supports it, otherwise the file is read into memory.
+	class MappedFile : boost::noncopyable
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool Map(std::string_view file_name);
+		void Unmap();
+
+		bool Valid() const
+		{
+			return data_ != nullptr;
+		}
+
+		uint8_t const * Data() const
+		{
+			return data_;
+		}
+		uint64_t Size() const
+		{
+			return size_;
+		}
+		ArrayRef<uint8_t> View() const
+		{
+			return ArrayRef<uint8_t>(data_, static_cast<size_t>(size_));
+		}
+
+	private:
+		uint8_t const * data_;
+		uint64_t size_;
+
+#if defined(KLAYGE_PLATFORM_WINDOWS_DESKTOP)
+		void* file_;
+		void* mapping_;
+#elif !defined(KLAYGE_PLATFORM_WINDOWS)
+		bool mapped_;
+#endif
+		std::vector<uint8_t> file_data_;
+	};
+}
+
+#endif		// _KFL_MAPPEDFILE_HPP
@@ -678,6 +678,25 @@ namespace KlayGE
 		template <typename T>
 		BoundOverlap intersect_frustum_frustum(Frustum_T<T> const & lhs, Frustum_T<T> const & frustum) noexcept;
 
+		// Tests aabbs [first, first + count) against the frustum, results[i] is the overlap of aabb first + i.
+		// Gives the same results as calling intersect_aabb_frustum on each box.
+		template <typename T>
+		void intersect_aabb_frustum(AABBoxSoA_T<T> const & aabbs, size_t first, size_t count, Frustum_T<T> const & frustum,
+			BoundOverlap* results) noexcept;
+		// Same as above for spheres.
+		template <typename T>
+		void intersect_sphere_frustum(SphereSoA_T<T> const & spheres, size_t first, size_t count, Frustum_T<T> const & frustum,
+			BoundOverlap* results) noexcept;
+
+		// Bit i % 32 of visible_masks[i / 32] is set when the overlap of bound first + i is not BO_No.
+		// visible_masks needs (count + 31) / 32 words, the unused high bits of the last word are cleared.
+		template <typename T>
+		void intersect_aabb_frustum_mask(AABBoxSoA_T<T> const & aabbs, size_t first, size_t count, Frustum_T<T> const & frustum,
+			uint32_t* visible_masks) noexcept;
+		template <typename T>
+		void intersect_sphere_frustum_mask(SphereSoA_T<T> const & spheres, size_t first, size_t count, Frustum_T<T> const & frustum,
+			uint32_t* visible_masks) noexcept;
+
 
 		// 
 		///////////////////////////////////////////////////////////////////////////////
@@ -106,10 +106,16 @@ namespace KlayGE
 	typedef Sphere_T<float> Sphere;
 	typedef std::shared_ptr<Sphere> SpherePtr;
 	template <typename T>
+	class SphereSoA_T;
+	typedef SphereSoA_T<float> SphereSoA;
+	template <typename T>
 	class AABBox_T;
 	typedef AABBox_T<float> AABBox;
 	typedef std::shared_ptr<AABBox> AABBoxPtr;
 	template <typename T>
+	class AABBoxSoA_T;
+	typedef AABBoxSoA_T<float> AABBoxSoA;
+	template <typename T>
 	class Frustum_T;
 	typedef Frustum_T<float> Frustum;
 	typedef std::shared_ptr<Frustum> FrustumPtr;
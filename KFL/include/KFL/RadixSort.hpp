@@ -0,0 +1,196 @@
+/**
+ * @file RadixSort.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_RADIX_SORT_HPP
+#define _KFL_RADIX_SORT_HPP
+
+#pragma once
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace KlayGE
+{
+	// Maps a float to an unsigned int with the same ordering, so floats can be used as radix sort keys. -0 sorts before +0.
+	inline uint32_t RadixSortableFloat(float v)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		return (bits & 0x80000000U) ? ~bits : (bits | 0x80000000U);
+	}
+
+	// Stable LSD radix sort on unsigned keys, 8 bits per pass. values are moved along with their keys. tmp_keys and
+	// tmp_values are scratch of num elements each. Passes over bytes that are the same in all keys are skipped, so
+	// keys with few distinct high bits sort in few passes. The result is in keys and values.
+	template <typename KeyType, typename ValueType>
+	void RadixSort(KeyType* keys, ValueType* values, KeyType* tmp_keys, ValueType* tmp_values, size_t num)
+	{
+		static_assert(std::is_unsigned<KeyType>::value, "Radix sort keys must be unsigned.");
+
+		uint32_t constexpr NUM_PASSES = sizeof(KeyType);
+
+		size_t histograms[NUM_PASSES][256];
+		std::memset(histograms, 0, sizeof(histograms));
+		for (size_t i = 0; i < num; ++ i)
+		{
+			KeyType const key = keys[i];
+			for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+			{
+				++ histograms[pass][(key >> (pass * 8)) & 0xFF];
+			}
+		}
+
+		KeyType* src_keys = keys;
+		ValueType* src_values = values;
+		KeyType* dst_keys = tmp_keys;
+		ValueType* dst_values = tmp_values;
+		for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+		{
+			size_t* histogram = histograms[pass];
+			if ((num == 0) || (histogram[(src_keys[0] >> (pass * 8)) & 0xFF] == num))
+			{
+				continue;
+			}
+
+			size_t offset = 0;
+			for (uint32_t b = 0; b < 256; ++ b)
+			{
+				size_t const count = histogram[b];
+				histogram[b] = offset;
+				offset += count;
+			}
+
+			for (size_t i = 0; i < num; ++ i)
+			{
+				size_t const dst = histogram[(src_keys[i] >> (pass * 8)) & 0xFF] ++;
+				dst_keys[dst] = src_keys[i];
+				dst_values[dst] = std::move(src_values[i]);
+			}
+
+			std::swap(src_keys, dst_keys);
+			std::swap(src_values, dst_values);
+		}
+
+		if (src_keys != keys)
+		{
+			std::copy(src_keys, src_keys + num, keys);
+			std::move(src_values, src_values + num, values);
+		}
+	}
+
+	// RadixSort with the histograms and the scatter of each pass split across num_workers workers on tp. Worker w handles
+	// the same chunk in both steps, and its offsets in a bucket come after the ones of workers before it, so it's stable.
+	template <typename KeyType, typename ValueType>
+	void ParallelRadixSort(thread_pool& tp, KeyType* keys, ValueType* values, KeyType* tmp_keys, ValueType* tmp_values,
+		uint32_t num, uint32_t num_workers)
+	{
+		static_assert(std::is_unsigned<KeyType>::value, "Radix sort keys must be unsigned.");
+
+		if ((num_workers <= 1) || (num == 0))
+		{
+			RadixSort(keys, values, tmp_keys, tmp_values, num);
+			return;
+		}
+
+		uint32_t constexpr NUM_PASSES = sizeof(KeyType);
+
+		std::vector<std::array<uint32_t, 256>> histograms(num_workers);
+
+		KeyType* src_keys = keys;
+		ValueType* src_values = values;
+		KeyType* dst_keys = tmp_keys;
+		ValueType* dst_values = tmp_values;
+		for (uint32_t pass = 0; pass < NUM_PASSES; ++ pass)
+		{
+			uint32_t const shift = pass * 8;
+			parallel_for_chunks(tp, num, num_workers,
+				[src_keys, shift, &histograms](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					auto& histogram = histograms[worker];
+					histogram.fill(0);
+					for (uint32_t i = first; i < last; ++ i)
+					{
+						++ histogram[(src_keys[i] >> shift) & 0xFF];
+					}
+				});
+
+			uint32_t const first_bucket = (src_keys[0] >> shift) & 0xFF;
+			uint32_t first_bucket_count = 0;
+			for (auto const & histogram : histograms)
+			{
+				first_bucket_count += histogram[first_bucket];
+			}
+			if (first_bucket_count == num)
+			{
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t b = 0; b < 256; ++ b)
+			{
+				for (auto& histogram : histograms)
+				{
+					uint32_t const count = histogram[b];
+					histogram[b] = offset;
+					offset += count;
+				}
+			}
+
+			parallel_for_chunks(tp, num, num_workers,
+				[src_keys, src_values, dst_keys, dst_values, shift, &histograms](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					auto& histogram = histograms[worker];
+					for (uint32_t i = first; i < last; ++ i)
+					{
+						uint32_t const dst = histogram[(src_keys[i] >> shift) & 0xFF] ++;
+						dst_keys[dst] = src_keys[i];
+						dst_values[dst] = std::move(src_values[i]);
+					}
+				});
+
+			std::swap(src_keys, dst_keys);
+			std::swap(src_values, dst_values);
+		}
+
+		if (src_keys != keys)
+		{
+			std::copy(src_keys, src_keys + num, keys);
+			std::move(src_values, src_values + num, values);
+		}
+	}
+}
+
+#endif		// _KFL_RADIX_SORT_HPP
@@ -34,7 +34,10 @@
 #pragma once
 
 #include <KFL/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
+#include <KFL/CustomizedStreamBuf.hpp>
 #include <KFL/CXX17/string_view.hpp>
+#include <KFL/Util.hpp>
 #include <istream>
 #include <vector>
 #include <string>
@@ -54,6 +57,15 @@ namespace KlayGE
 			: res_name_(name), timestamp_(timestamp), istream_(is), streambuf_(streambuf)
 		{
 		}
+		// The resource is already in memory, such as a memory mapped file. data_holder keeps it alive.
+		ResIdentifier(std::string_view name, uint64_t timestamp,
+				ArrayRef<uint8_t> data, std::shared_ptr<void const> const & data_holder)
+			: res_name_(name), timestamp_(timestamp),
+				streambuf_(MakeSharedPtr<MemInputStreamBuf>(data.data(), static_cast<std::streamsize>(data.size()))),
+				data_holder_(data_holder), view_(data)
+		{
+			istream_ = MakeSharedPtr<std::istream>(streambuf_.get());
+		}
 
 		void ResName(std::string_view name)
 		{
@@ -113,11 +125,19 @@ namespace KlayGE
 			return *istream_;
 		}
 
+		// The whole resource in memory, regardless of the read position. Empty if the resource is only a stream.
+		ArrayRef<uint8_t> View() const
+		{
+			return view_;
+		}
+
 	private:
 		std::string res_name_;
 		uint64_t timestamp_;
 		std::shared_ptr<std::istream> istream_;
 		std::shared_ptr<std::streambuf> streambuf_;
+		std::shared_ptr<void const> data_holder_;
+		ArrayRef<uint8_t> view_;
 	};
 }
 
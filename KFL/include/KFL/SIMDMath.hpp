@@ -38,6 +38,18 @@
 #if defined(KLAYGE_SSE_SUPPORT)
 	#define SIMD_MATH_SSE
 	#include <xmmintrin.h>
+	#include <emmintrin.h>
+	#if defined(KLAYGE_SSE4_1_SUPPORT)
+		#define SIMD_MATH_SSE4_1
+		#include <smmintrin.h>
+	#endif
+	#if defined(KLAYGE_AVX2_SUPPORT) && (defined(KLAYGE_COMPILER_MSVC) || defined(__FMA__))
+		#define SIMD_MATH_FMA
+		#include <immintrin.h>
+	#endif
+#elif defined(KLAYGE_NEON_SUPPORT)
+	#define SIMD_MATH_NEON
+	#include <arm_neon.h>
 #else
 	#define SIMD_MATH_GENERAL
 #endif
@@ -256,10 +268,31 @@ namespace KlayGE
 		///////////////////////////////////////////////////////////////////////////////
 		SIMDVectorF4 NegativeColor(SIMDVectorF4 const & rhs);
 		SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs);
+
+
+		// Batch
+		// Out of line. The kernel (AVX2, SSE, NEON or general) is picked once at runtime.
+		// The outputs can alias the inputs.
+		///////////////////////////////////////////////////////////////////////////////
+		char const * BatchBackendName();
+
+		// Same as MathLib::transform_coord on each point
+		void TransformCoordVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat);
+		// Same as MathLib::transform_aabb on each box
+		void TransformAABBox(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat);
+		// Same as MathLib::mul_real and MathLib::mul_dual on each pair of unit dual quaternions
+		void MultiplyDualQuat(Quaternion* out_real, Quaternion* out_dual,
+			Quaternion const * lhs_real, Quaternion const * lhs_dual,
+			Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num);
+		// Dual quaternion linear blending along the shortest path, normalized
+		void BlendDualQuat(Quaternion* out_real, Quaternion* out_dual,
+			Quaternion const * real0, Quaternion const * dual0,
+			Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num);
 	}
 }
 
 #include <KFL/SIMDVector.hpp>
 #include <KFL/SIMDMatrix.hpp>
+#include <KFL/Detail/SIMDMathImpl.hpp>
 
 #endif		// _KFL_SIMDMATH_HPP
@@ -39,6 +39,8 @@
 
 #include <KFL/Bound.hpp>
 
+#include <vector>
+
 namespace KlayGE
 {
 	template <typename T>
@@ -107,6 +109,44 @@ namespace KlayGE
 		Vector_T<T, 3> center_;
 		T radius_;
 	};
+
+	// Spheres stored as one array per component, so batch tests can load several spheres per SIMD register
+	template <typename T>
+	class SphereSoA_T final
+	{
+	public:
+		size_t Size() const noexcept
+		{
+			return center_x_.size();
+		}
+		void Resize(size_t size);
+		void Clear() noexcept;
+
+		void PushBack(Sphere_T<T> const & sphere);
+		void Set(size_t index, Sphere_T<T> const & sphere) noexcept;
+		Sphere_T<T> Get(size_t index) const noexcept;
+
+		T const * CenterX() const noexcept
+		{
+			return center_x_.data();
+		}
+		T const * CenterY() const noexcept
+		{
+			return center_y_.data();
+		}
+		T const * CenterZ() const noexcept
+		{
+			return center_z_.data();
+		}
+		T const * Radius() const noexcept
+		{
+			return radius_.data();
+		}
+
+	private:
+		std::vector<T> center_x_, center_y_, center_z_;
+		std::vector<T> radius_;
+	};
 }
 
 #endif			// _KFL_SPHERE_HPP
@@ -34,6 +34,7 @@
 #pragma once
 
 #include <boost/assert.hpp>
+#include <algorithm>
 #include <thread>
 #include <condition_variable>
 #include <mutex>
@@ -612,6 +613,50 @@ namespace KlayGE
 	private:
 		std::shared_ptr<thread_pool_common_data_t> data_;
 	};
+
+	// Number of workers for num items, one per hardware thread at most, each with min_items_per_worker items at least
+	inline uint32_t num_parallel_workers(uint32_t num, uint32_t min_items_per_worker)
+	{
+		uint32_t const num_hw_threads = std::max(std::thread::hardware_concurrency(), 1U);
+		return std::max(1U, std::min(num_hw_threads, num / std::max(min_items_per_worker, 1U)));
+	}
+
+	// Calls func(worker, first, last) on num_workers even chunks of [0, num). The calling thread takes chunk 0, the
+	//  other chunks run on the pool. Returns when all of them are done.
+	template <typename F>
+	void parallel_for_chunks(thread_pool& tp, uint32_t num, uint32_t num_workers, F const & func)
+	{
+		if (num_workers <= 1)
+		{
+			func(0U, 0U, num);
+			return;
+		}
+
+		auto chunk_begin = [num, num_workers](uint32_t worker)
+		{
+			return static_cast<uint32_t>(static_cast<uint64_t>(num) * worker / num_workers);
+		};
+
+		std::vector<joiner<void>> joiners;
+		joiners.reserve(num_workers - 1);
+		for (uint32_t i = 1; i < num_workers; ++ i)
+		{
+			uint32_t const first = chunk_begin(i);
+			uint32_t const last = chunk_begin(i + 1);
+			joiners.push_back(tp(
+				[&func, i, first, last]
+				{
+					func(i, first, last);
+				}));
+		}
+
+		func(0U, 0U, chunk_begin(1));
+
+		for (auto& joiner : joiners)
+		{
+			joiner();
+		}
+	}
 }
 
 #endif		// _KFL_THREAD_HPP
@@ -0,0 +1,168 @@
+/**
+ * @file MappedFile.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+
+#include <fstream>
+
+#if defined(KLAYGE_PLATFORM_WINDOWS_DESKTOP)
+#include <windows.h>
+#elif !defined(KLAYGE_PLATFORM_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <KFL/MappedFile.hpp>
+
+namespace KlayGE
+{
+	MappedFile::MappedFile()
+		: data_(nullptr), size_(0)
+#if defined(KLAYGE_PLATFORM_WINDOWS_DESKTOP)
+			, file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+#elif !defined(KLAYGE_PLATFORM_WINDOWS)
+			, mapped_(false)
+#endif
+	{
+	}
+
+	MappedFile::~MappedFile()
+	{
+		this->Unmap();
+	}
+
+	bool MappedFile::Map(std::string_view file_name)
+	{
+		this->Unmap();
+
+		std::string const file_name_str(file_name);
+
+#if defined(KLAYGE_PLATFORM_WINDOWS_DESKTOP)
+		file_ = ::CreateFileA(file_name_str.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (file_ != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER file_size;
+			if (::GetFileSizeEx(file_, &file_size) && (file_size.QuadPart > 0))
+			{
+				mapping_ = ::CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				if (mapping_ != nullptr)
+				{
+					data_ = static_cast<uint8_t const *>(::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+					if (data_ != nullptr)
+					{
+						size_ = file_size.QuadPart;
+						return true;
+					}
+				}
+			}
+			this->Unmap();
+		}
+#elif !defined(KLAYGE_PLATFORM_WINDOWS)
+		int fd = ::open(file_name_str.c_str(), O_RDONLY);
+		if (fd != -1)
+		{
+			struct stat file_stat;
+			if ((::fstat(fd, &file_stat) == 0) && (file_stat.st_size > 0))
+			{
+				void* p = ::mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p != MAP_FAILED)
+				{
+					data_ = static_cast<uint8_t const *>(p);
+					size_ = static_cast<uint64_t>(file_stat.st_size);
+					mapped_ = true;
+				}
+			}
+			::close(fd);
+
+			if (mapped_)
+			{
+				return true;
+			}
+		}
+#endif
+
+		// Fallback to read the whole file
+		std::ifstream file(file_name_str.c_str(), std::ios_base::binary);
+		if (file)
+		{
+			file.seekg(0, std::ios_base::end);
+			std::streamoff const file_size = file.tellg();
+			if (file_size > 0)
+			{
+				file_data_.resize(static_cast<size_t>(file_size));
+				file.seekg(0, std::ios_base::beg);
+				file.read(reinterpret_cast<char*>(file_data_.data()), static_cast<std::streamsize>(file_data_.size()));
+			}
+			if (file && !file_data_.empty())
+			{
+				data_ = file_data_.data();
+				size_ = file_data_.size();
+				return true;
+			}
+			file_data_.clear();
+		}
+
+		return false;
+	}
+
+	void MappedFile::Unmap()
+	{
+#if defined(KLAYGE_PLATFORM_WINDOWS_DESKTOP)
+		if (mapping_ != nullptr)
+		{
+			if (data_ != nullptr)
+			{
+				::UnmapViewOfFile(data_);
+			}
+			::CloseHandle(mapping_);
+			mapping_ = nullptr;
+		}
+		if (file_ != INVALID_HANDLE_VALUE)
+		{
+			::CloseHandle(file_);
+			file_ = INVALID_HANDLE_VALUE;
+		}
+#elif !defined(KLAYGE_PLATFORM_WINDOWS)
+		if (mapped_)
+		{
+			::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+			mapped_ = false;
+		}
+#endif
+
+		file_data_.clear();
+		file_data_.shrink_to_fit();
+		data_ = nullptr;
+		size_ = 0;
+	}
+}
@@ -282,5 +282,62 @@ namespace KlayGE
 	}
 
 
+	template <typename T>
+	void AABBoxSoA_T<T>::Resize(size_t size)
+	{
+		min_x_.resize(size);
+		min_y_.resize(size);
+		min_z_.resize(size);
+		max_x_.resize(size);
+		max_y_.resize(size);
+		max_z_.resize(size);
+	}
+
+	template <typename T>
+	void AABBoxSoA_T<T>::Clear() noexcept
+	{
+		min_x_.clear();
+		min_y_.clear();
+		min_z_.clear();
+		max_x_.clear();
+		max_y_.clear();
+		max_z_.clear();
+	}
+
+	template <typename T>
+	void AABBoxSoA_T<T>::PushBack(AABBox_T<T> const & aabb)
+	{
+		min_x_.push_back(aabb.Min().x());
+		min_y_.push_back(aabb.Min().y());
+		min_z_.push_back(aabb.Min().z());
+		max_x_.push_back(aabb.Max().x());
+		max_y_.push_back(aabb.Max().y());
+		max_z_.push_back(aabb.Max().z());
+	}
+
+	template <typename T>
+	void AABBoxSoA_T<T>::Set(size_t index, AABBox_T<T> const & aabb) noexcept
+	{
+		BOOST_ASSERT(index < this->Size());
+
+		min_x_[index] = aabb.Min().x();
+		min_y_[index] = aabb.Min().y();
+		min_z_[index] = aabb.Min().z();
+		max_x_[index] = aabb.Max().x();
+		max_y_[index] = aabb.Max().y();
+		max_z_[index] = aabb.Max().z();
+	}
+
+	template <typename T>
+	AABBox_T<T> AABBoxSoA_T<T>::Get(size_t index) const noexcept
+	{
+		BOOST_ASSERT(index < this->Size());
+
+		return AABBox_T<T>(Vector_T<T, 3>(min_x_[index], min_y_[index], min_z_[index]),
+			Vector_T<T, 3>(max_x_[index], max_y_[index], max_z_[index]));
+	}
+
+
 	template class AABBox_T<float>;
+	template class AABBoxSoA_T<float>;
 }
@@ -33,8 +33,233 @@
 
 #include <KFL/Math.hpp>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+	#include <xmmintrin.h>
+#endif
+
 namespace KlayGE
 {
+	namespace detail
+	{
+		// Vectorized part of the batch AABB vs frustum test. Returns the number of boxes it handled.
+		template <typename T>
+		struct aabb_frustum_batch_helper
+		{
+			static size_t Do(T const * v0[6][3], T const * v1[6][3], Frustum_T<T> const & frustum,
+				size_t first, size_t count, BoundOverlap* results) noexcept
+			{
+				KFL_UNUSED(v0);
+				KFL_UNUSED(v1);
+				KFL_UNUSED(frustum);
+				KFL_UNUSED(first);
+				KFL_UNUSED(count);
+				KFL_UNUSED(results);
+				return 0;
+			}
+		};
+
+#if defined(KLAYGE_SSE_SUPPORT)
+		template <>
+		struct aabb_frustum_batch_helper<float>
+		{
+			static size_t Do(float const * v0[6][3], float const * v1[6][3], Frustum const & frustum,
+				size_t first, size_t count, BoundOverlap* results) noexcept
+			{
+				__m128 a[6], b[6], c[6], d[6];
+				for (int j = 0; j < 6; ++ j)
+				{
+					Plane const & plane = frustum.FrustumPlane(j);
+					a[j] = _mm_set1_ps(plane.a());
+					b[j] = _mm_set1_ps(plane.b());
+					c[j] = _mm_set1_ps(plane.c());
+					d[j] = _mm_set1_ps(plane.d());
+				}
+
+				// Same operation order as dot_coord, so the results match the scalar path exactly
+				__m128 const zero = _mm_setzero_ps();
+				size_t i = 0;
+				for (; i + 4 <= count; i += 4)
+				{
+					size_t const index = first + i;
+					__m128 outside = zero;
+					__m128 intersect = zero;
+					for (int j = 0; j < 6; ++ j)
+					{
+						__m128 const d0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(a[j], _mm_loadu_ps(v0[j][0] + index)),
+							_mm_mul_ps(b[j], _mm_loadu_ps(v0[j][1] + index))),
+							_mm_mul_ps(c[j], _mm_loadu_ps(v0[j][2] + index))), d[j]);
+						__m128 const d1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(a[j], _mm_loadu_ps(v1[j][0] + index)),
+							_mm_mul_ps(b[j], _mm_loadu_ps(v1[j][1] + index))),
+							_mm_mul_ps(c[j], _mm_loadu_ps(v1[j][2] + index))), d[j]);
+						outside = _mm_or_ps(outside, _mm_cmplt_ps(d0, zero));
+						intersect = _mm_or_ps(intersect, _mm_cmplt_ps(d1, zero));
+					}
+
+					int const outside_mask = _mm_movemask_ps(outside);
+					int const intersect_mask = _mm_movemask_ps(intersect);
+					for (int k = 0; k < 4; ++ k)
+					{
+						if (outside_mask & (1 << k))
+						{
+							results[i + k] = BO_No;
+						}
+						else
+						{
+							results[i + k] = (intersect_mask & (1 << k)) ? BO_Partial : BO_Yes;
+						}
+					}
+				}
+
+				return i;
+			}
+		};
+#endif
+
+		// Vectorized part of the batch AABB vs frustum visibility mask. Returns the number of boxes it handled.
+		template <typename T>
+		struct aabb_frustum_mask_batch_helper
+		{
+			static size_t Do(T const * v0[6][3], Frustum_T<T> const & frustum, size_t first, size_t count,
+				uint32_t* visible_masks) noexcept
+			{
+				KFL_UNUSED(v0);
+				KFL_UNUSED(frustum);
+				KFL_UNUSED(first);
+				KFL_UNUSED(count);
+				KFL_UNUSED(visible_masks);
+				return 0;
+			}
+		};
+
+		// Vectorized part of the batch sphere vs frustum test. Returns the number of spheres it handled.
+		template <typename T>
+		struct sphere_frustum_batch_helper
+		{
+			static size_t Do(SphereSoA_T<T> const & spheres, Frustum_T<T> const & frustum, size_t first, size_t count,
+				BoundOverlap* results, uint32_t* visible_masks) noexcept
+			{
+				KFL_UNUSED(spheres);
+				KFL_UNUSED(frustum);
+				KFL_UNUSED(first);
+				KFL_UNUSED(count);
+				KFL_UNUSED(results);
+				KFL_UNUSED(visible_masks);
+				return 0;
+			}
+		};
+
+#if defined(KLAYGE_SSE_SUPPORT)
+		template <>
+		struct aabb_frustum_mask_batch_helper<float>
+		{
+			static size_t Do(float const * v0[6][3], Frustum const & frustum, size_t first, size_t count,
+				uint32_t* visible_masks) noexcept
+			{
+				__m128 a[6], b[6], c[6], d[6];
+				for (int j = 0; j < 6; ++ j)
+				{
+					Plane const & plane = frustum.FrustumPlane(j);
+					a[j] = _mm_set1_ps(plane.a());
+					b[j] = _mm_set1_ps(plane.b());
+					c[j] = _mm_set1_ps(plane.c());
+					d[j] = _mm_set1_ps(plane.d());
+				}
+
+				// Only the vertex farthest along each plane normal matters for the mask
+				__m128 const zero = _mm_setzero_ps();
+				size_t i = 0;
+				for (; i + 4 <= count; i += 4)
+				{
+					size_t const index = first + i;
+					__m128 outside = zero;
+					for (int j = 0; j < 6; ++ j)
+					{
+						__m128 const d0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(a[j], _mm_loadu_ps(v0[j][0] + index)),
+							_mm_mul_ps(b[j], _mm_loadu_ps(v0[j][1] + index))),
+							_mm_mul_ps(c[j], _mm_loadu_ps(v0[j][2] + index))), d[j]);
+						outside = _mm_or_ps(outside, _mm_cmplt_ps(d0, zero));
+					}
+
+					uint32_t const visible = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFU;
+					visible_masks[i / 32] |= visible << (i % 32);
+				}
+
+				return i;
+			}
+		};
+
+		template <>
+		struct sphere_frustum_batch_helper<float>
+		{
+			// Fills either results or visible_masks, whichever is not null
+			static size_t Do(SphereSoA const & spheres, Frustum const & frustum, size_t first, size_t count,
+				BoundOverlap* results, uint32_t* visible_masks) noexcept
+			{
+				__m128 a[6], b[6], c[6], d[6];
+				for (int j = 0; j < 6; ++ j)
+				{
+					Plane const & plane = frustum.FrustumPlane(j);
+					a[j] = _mm_set1_ps(plane.a());
+					b[j] = _mm_set1_ps(plane.b());
+					c[j] = _mm_set1_ps(plane.c());
+					d[j] = _mm_set1_ps(plane.d());
+				}
+
+				// Same operation order as dot_coord, so the results match the scalar path exactly
+				__m128 const sign_mask = _mm_set1_ps(-0.0f);
+				__m128 const zero = _mm_setzero_ps();
+				size_t i = 0;
+				for (; i + 4 <= count; i += 4)
+				{
+					size_t const index = first + i;
+					__m128 const x = _mm_loadu_ps(spheres.CenterX() + index);
+					__m128 const y = _mm_loadu_ps(spheres.CenterY() + index);
+					__m128 const z = _mm_loadu_ps(spheres.CenterZ() + index);
+					__m128 const r = _mm_loadu_ps(spheres.Radius() + index);
+					__m128 const neg_r = _mm_xor_ps(r, sign_mask);
+
+					__m128 outside = zero;
+					__m128 intersect = zero;
+					for (int j = 0; j < 6; ++ j)
+					{
+						__m128 const dist = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(a[j], x), _mm_mul_ps(b[j], y)), _mm_mul_ps(c[j], z)), d[j]);
+						outside = _mm_or_ps(outside, _mm_cmple_ps(dist, neg_r));
+						intersect = _mm_or_ps(intersect, _mm_cmpgt_ps(dist, r));
+					}
+
+					int const outside_mask = _mm_movemask_ps(outside);
+					if (visible_masks != nullptr)
+					{
+						uint32_t const visible = ~static_cast<uint32_t>(outside_mask) & 0xFU;
+						visible_masks[i / 32] |= visible << (i % 32);
+					}
+					else
+					{
+						int const intersect_mask = _mm_movemask_ps(intersect);
+						for (int k = 0; k < 4; ++ k)
+						{
+							if (outside_mask & (1 << k))
+							{
+								results[i + k] = BO_No;
+							}
+							else
+							{
+								results[i + k] = (intersect_mask & (1 << k)) ? BO_Partial : BO_Yes;
+							}
+						}
+					}
+				}
+
+				return i;
+			}
+		};
+#endif
+	}
+
 	namespace MathLib
 	{
 		template int1 abs(int1 const & x) noexcept;
@@ -3000,6 +3225,133 @@ namespace KlayGE
 			return BO_Partial;
 		}
 
+		template void intersect_aabb_frustum(AABBoxSoA const & aabbs, size_t first, size_t count, Frustum const & frustum,
+			BoundOverlap* results) noexcept;
+
+		template <typename T>
+		void intersect_aabb_frustum(AABBoxSoA_T<T> const & aabbs, size_t first, size_t count, Frustum_T<T> const & frustum,
+			BoundOverlap* results) noexcept
+		{
+			BOOST_ASSERT(first + count <= aabbs.Size());
+
+			// v1 is diagonally opposed to v0
+			T const * v0[6][3];
+			T const * v1[6][3];
+			for (int j = 0; j < 6; ++ j)
+			{
+				Plane_T<T> const & plane = frustum.FrustumPlane(j);
+				v0[j][0] = (plane.a() < 0) ? aabbs.MinX() : aabbs.MaxX();
+				v0[j][1] = (plane.b() < 0) ? aabbs.MinY() : aabbs.MaxY();
+				v0[j][2] = (plane.c() < 0) ? aabbs.MinZ() : aabbs.MaxZ();
+				v1[j][0] = (plane.a() < 0) ? aabbs.MaxX() : aabbs.MinX();
+				v1[j][1] = (plane.b() < 0) ? aabbs.MaxY() : aabbs.MinY();
+				v1[j][2] = (plane.c() < 0) ? aabbs.MaxZ() : aabbs.MinZ();
+			}
+
+			size_t i = detail::aabb_frustum_batch_helper<T>::Do(v0, v1, frustum, first, count, results);
+			for (; i < count; ++ i)
+			{
+				size_t const index = first + i;
+
+				BoundOverlap bo = BO_Yes;
+				for (int j = 0; j < 6; ++ j)
+				{
+					Vector_T<T, 3> const p0(v0[j][0][index], v0[j][1][index], v0[j][2][index]);
+					if (dot_coord(frustum.FrustumPlane(j), p0) < 0)
+					{
+						bo = BO_No;
+						break;
+					}
+					Vector_T<T, 3> const p1(v1[j][0][index], v1[j][1][index], v1[j][2][index]);
+					if (dot_coord(frustum.FrustumPlane(j), p1) < 0)
+					{
+						bo = BO_Partial;
+					}
+				}
+				results[i] = bo;
+			}
+		}
+
+		template void intersect_aabb_frustum_mask(AABBoxSoA const & aabbs, size_t first, size_t count, Frustum const & frustum,
+			uint32_t* visible_masks) noexcept;
+
+		template <typename T>
+		void intersect_aabb_frustum_mask(AABBoxSoA_T<T> const & aabbs, size_t first, size_t count, Frustum_T<T> const & frustum,
+			uint32_t* visible_masks) noexcept
+		{
+			BOOST_ASSERT(first + count <= aabbs.Size());
+
+			std::fill(visible_masks, visible_masks + (count + 31) / 32, 0U);
+
+			// v0 is the corner farthest along the plane normal, a box is out once v0 is behind any plane
+			T const * v0[6][3];
+			for (int j = 0; j < 6; ++ j)
+			{
+				Plane_T<T> const & plane = frustum.FrustumPlane(j);
+				v0[j][0] = (plane.a() < 0) ? aabbs.MinX() : aabbs.MaxX();
+				v0[j][1] = (plane.b() < 0) ? aabbs.MinY() : aabbs.MaxY();
+				v0[j][2] = (plane.c() < 0) ? aabbs.MinZ() : aabbs.MaxZ();
+			}
+
+			size_t i = detail::aabb_frustum_mask_batch_helper<T>::Do(v0, frustum, first, count, visible_masks);
+			for (; i < count; ++ i)
+			{
+				size_t const index = first + i;
+
+				bool visible = true;
+				for (int j = 0; j < 6; ++ j)
+				{
+					Vector_T<T, 3> const p0(v0[j][0][index], v0[j][1][index], v0[j][2][index]);
+					if (dot_coord(frustum.FrustumPlane(j), p0) < 0)
+					{
+						visible = false;
+						break;
+					}
+				}
+				if (visible)
+				{
+					visible_masks[i / 32] |= 1U << (i % 32);
+				}
+			}
+		}
+
+		template void intersect_sphere_frustum(SphereSoA const & spheres, size_t first, size_t count, Frustum const & frustum,
+			BoundOverlap* results) noexcept;
+
+		template <typename T>
+		void intersect_sphere_frustum(SphereSoA_T<T> const & spheres, size_t first, size_t count, Frustum_T<T> const & frustum,
+			BoundOverlap* results) noexcept
+		{
+			BOOST_ASSERT(first + count <= spheres.Size());
+
+			size_t i = detail::sphere_frustum_batch_helper<T>::Do(spheres, frustum, first, count, results, nullptr);
+			for (; i < count; ++ i)
+			{
+				results[i] = intersect_sphere_frustum(spheres.Get(first + i), frustum);
+			}
+		}
+
+		template void intersect_sphere_frustum_mask(SphereSoA const & spheres, size_t first, size_t count, Frustum const & frustum,
+			uint32_t* visible_masks) noexcept;
+
+		template <typename T>
+		void intersect_sphere_frustum_mask(SphereSoA_T<T> const & spheres, size_t first, size_t count, Frustum_T<T> const & frustum,
+			uint32_t* visible_masks) noexcept
+		{
+			BOOST_ASSERT(first + count <= spheres.Size());
+
+			std::fill(visible_masks, visible_masks + (count + 31) / 32, 0U);
+
+			size_t i = detail::sphere_frustum_batch_helper<T>::Do(spheres, frustum, first, count, nullptr, visible_masks);
+			for (; i < count; ++ i)
+			{
+				if (intersect_sphere_frustum(spheres.Get(first + i), frustum) != BO_No)
+				{
+					visible_masks[i / 32] |= 1U << (i % 32);
+				}
+			}
+		}
+
 
 		template void intersect(float3 const & v0, float3 const & v1, float3 const & v2,
 						float3 const & ray_orig, float3 const & ray_dir,
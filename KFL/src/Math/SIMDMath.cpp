@@ -29,2145 +29,798 @@
  */
 
 #include <KFL/KFL.hpp>
+#include <KFL/CpuInfo.hpp>
 #include <KFL/SIMDMath.hpp>
 
-#ifdef SIMD_MATH_SSE
-	#include <emmintrin.h>
-#endif
-
-namespace KlayGE
-{
-	namespace SIMDMathLib
-	{
-		// General Vector
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Add(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_add_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = lhs.Vec()[i] + rhs.Vec()[i];
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Substract(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_sub_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = lhs.Vec()[i] - rhs.Vec()[i];
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Multiply(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_mul_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = lhs.Vec()[i] * rhs.Vec()[i];
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Divide(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_div_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = lhs.Vec()[i] / rhs.Vec()[i];
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Negative(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_sub_ps(_mm_setzero_ps(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = -rhs.Vec()[i];
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 BaryCentric(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3,
-			float f, float g)
-		{
-			return (1 - f - g) * v1 + f * v2 + g * v3;
-		}
-
-		SIMDVectorF4 CatmullRom(SIMDVectorF4 const & v0, SIMDVectorF4 const & v1,
-			SIMDVectorF4 const & v2, SIMDVectorF4 const & v3, float s)
-		{
-			float const s2 = s * s;
-			float const s3 = s2 * s;
-			return ((-s3 + 2 * s2 - s) * v0 + (3 * s3 - 5 * s2 + 2) * v1
-				+ (-3 * s3 + 4 * s2 + s) * v2 + (s3 - s2) * v3) * 0.5f;
-		}
-
-		SIMDVectorF4 CubicBezier(SIMDVectorF4 const & v0, SIMDVectorF4 const & v1,
-			SIMDVectorF4 const & v2, SIMDVectorF4 const & v3, float s)
-		{
-			// From http://en.wikipedia.org/wiki/B%C3%A9zier_curve
-
-			float const s2 = s * s;
-			float const s3 = s2 * s;
-			return ((-s3 + 3 * s2 - 3 * s + 1) * v0 + (3 * s3 - 6 * s2 + 3 * s) * v1
-				+ (-3 * s3 + 3 * s2) * v2 + s3 * v3);
-		}
-
-		SIMDVectorF4 CubicBSpline(SIMDVectorF4 const & v0, SIMDVectorF4 const & v1,
-			SIMDVectorF4 const & v2, SIMDVectorF4 const & v3, float s)
-		{
-			// From http://en.wikipedia.org/wiki/B-spline
-
-			float const s2 = s * s;
-			float const s3 = s2 * s;
-			return ((-s3 + 3 * s2 - 3 * s + 1) * v0 + (3 * s3 - 6 * s2 + 4) * v1
-				+ (-3 * s3 + 3 * s2 + 3 * s + 1) * v2 + s3 * v3) / 6;
-		}
-
-		SIMDVectorF4 Hermite(SIMDVectorF4 const & v1, SIMDVectorF4 const & t1,
-			SIMDVectorF4 const & v2, SIMDVectorF4 const & t2, float s)
-		{
-			float const s2 = s * s;
-			float const s3 = s2 * s;
-			float const h1 = 2 * s3 - 3 * s2 + 1;
-			float const h2 = s3 - 2 * s2 + s;
-			float const h3 = -2 * s3 + 3 * s2;
-			float const h4 = s3 - s2;
-			return h1 * v1 + h2 * t1 + h3 * v2 + h4 * t2;
-		}
-
-		SIMDVectorF4 Lerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s)
-		{
-			return lhs + (rhs - lhs) * s;
-		}
-
-		SIMDVectorF4 Abs(SIMDVectorF4 const & x)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 res = x.Vec();
-			__m128 data_temp = _mm_sub_ps(_mm_setzero_ps(), res);
-			ret.Vec() = _mm_max_ps(data_temp, res);
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = MathLib::abs(x.Vec()[i]);
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Sgn(SIMDVectorF4 const & x)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 const zero = _mm_setzero_ps();
-
-			__m128 res1 = _mm_cmplt_ps(x.Vec(), zero);
-			res1 = _mm_cvtepi32_ps(_mm_castps_si128(res1));
-			__m128 res2 = _mm_cmpgt_ps(x.Vec(), zero);
-			res2 = _mm_cvtepi32_ps(_mm_castps_si128(res2));
-			res2 = _mm_sub_ps(zero, res2);
-			ret.Vec() = _mm_add_ps(res1,res2);
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = MathLib::sgn(x.Vec()[i]);
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Sqr(SIMDVectorF4 const & x)
-		{
-			return x * x;
-		}
-
-		SIMDVectorF4 Cube(SIMDVectorF4 const & x)
-		{
-			return Sqr(x) * x;
-		}
-
-		SIMDVectorF4 LoadVector1(float v)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_load_ss(&v);
-#else
-			ret.Vec()[0] = v;
-			for (int i = 1; i < 4; ++ i)
-			{
-				ret.Vec()[i] = 0;
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LoadVector2(float2 const & v)
-		{
-			return LoadVector2(&v[0]);
-		}
-
-		SIMDVectorF4 LoadVector3(float3 const & v)
-		{
-			return LoadVector3(&v[0]);
-		}
-
-		SIMDVectorF4 LoadVector4(float4 const & v)
-		{
-			return LoadVector4(&v[0]);
-		}
-
-		SIMDVectorF4 LoadVector2(float const * v)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 x = _mm_load_ss(&v[0]);
-			__m128 y = _mm_load_ss(&v[1]);
-			ret.Vec() = _mm_unpacklo_ps(x, y);
-#else
-			for (int i = 0; i < 2; ++ i)
-			{
-				ret.Vec()[i] = v[i];
-			}
-			for (int i = 2; i < 4; ++ i)
-			{
-				ret.Vec()[i] = 0;
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LoadVector3(float const * v)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 x = _mm_load_ss(&v[0]);
-			__m128 y = _mm_load_ss(&v[1]);
-			__m128 z = _mm_load_ss(&v[2]);
-			__m128 xy = _mm_unpacklo_ps(x, y);
-			ret.Vec() = _mm_movelh_ps(xy, z);
-#else
-			for (int i = 0; i < 3; ++ i)
-			{
-				ret.Vec()[i] = v[i];
-			}
-			for (int i = 3; i < 4; ++ i)
-			{
-				ret.Vec()[i] = 0;
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LoadVector4(float const * v)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_load_ps(&v[0]);
-#else
-			for (int i = 0; i < 4; ++i)
-			{
-				ret.Vec()[i] = v[i];
-			}
-#endif
-			return ret;
-		}
-
-		void StoreVector1(float& fs, SIMDVectorF4 const & v)
-		{
-#if defined(SIMD_MATH_SSE)
-			_mm_store_ss(&fs, v.Vec());
-#else
-			fs = v.Vec()[0];
-#endif
-		}
-
-		void StoreVector2(float2& fs, SIMDVectorF4 const & v)
-		{
-#if defined(SIMD_MATH_SSE)
-			__m128 x = v.Vec();
-			__m128 y = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
-			_mm_store_ss(&fs[0], x);
-			_mm_store_ss(&fs[1], y);
-#else
-			for (int i = 0; i < 2; ++ i)
-			{
-				fs[i] = v.Vec()[i];
-			}
-#endif
-		}
-
-		void StoreVector3(float3& fs, SIMDVectorF4 const & v)
-		{
-#if defined(SIMD_MATH_SSE)
-			__m128 x = v.Vec();
-			__m128 y = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
-			__m128 z = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2));
-			_mm_store_ss(&fs[0], x);
-			_mm_store_ss(&fs[1], y);
-			_mm_store_ss(&fs[2], z);
-#else
-			for (int i = 0; i < 3; ++ i)
-			{
-				fs[i] = v.Vec()[i];
-			}
-#endif
-		}
-
-		void StoreVector4(float4& fs, SIMDVectorF4 const & v)
-		{
-#if defined(SIMD_MATH_SSE)
-			_mm_store_ps(&fs[0], v.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				fs[i] = v.Vec()[i];
-			}
-#endif
-		}
-
-		SIMDVectorF4 SetVector(float x, float y, float z, float w)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_set_ps(w, z, y, x);
-#else
-			ret.Vec()[0] = x;
-			ret.Vec()[1] = y;
-			ret.Vec()[2] = z;
-			ret.Vec()[3] = w;
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 SetVector(float v)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_set_ps1(v);
-#else
-			ret.Vec()[0] = v;
-			ret.Vec()[1] = v;
-			ret.Vec()[2] = v;
-			ret.Vec()[3] = v;
-#endif
-			return ret;
-		}
-
-		float GetX(SIMDVectorF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			return _mm_cvtss_f32(rhs.Vec());
-#else
-			return GetByIndex(rhs, 0);
-#endif
-		}
-
-		float GetY(SIMDVectorF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(1, 1, 1, 1));
-			return _mm_cvtss_f32(tmp);
-#else
-			return GetByIndex(rhs, 1);
-#endif
-		}
-
-		float GetZ(SIMDVectorF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(2, 2, 2, 2));
-			return _mm_cvtss_f32(tmp);
-#else
-			return GetByIndex(rhs, 2);
-#endif
-		}
-
-		float GetW(SIMDVectorF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			__m128 tmp = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 3, 3, 3));
-			return _mm_cvtss_f32(tmp);
-#else
-			return GetByIndex(rhs, 3);
-#endif
-		}
-
-		float GetByIndex(SIMDVectorF4 const & rhs, size_t index)
-		{
-#if defined(SIMD_MATH_SSE)
-#ifdef KLAYGE_COMPILER_MSVC
-			return rhs.Vec().m128_f32[index];
-#else
-			union
-			{
-				__m128 v;
-				float comp[4];
-			} converter;
-			converter.v = rhs.Vec();
-			return converter.comp[index];
-#endif
-#else
-			return rhs.Vec()[index];
-#endif
-		}
-
-		SIMDVectorF4 SetX(SIMDVectorF4 const & rhs, float v)
-		{
-#if defined(SIMD_MATH_SSE)
-			SIMDVectorF4 ret;
-			ret.Vec() = _mm_move_ss(rhs.Vec(), _mm_set_ss(v));
-			return ret;
-#else
-			return SetByIndex(rhs, v, 0);
-#endif
-		}
-
-		SIMDVectorF4 SetY(SIMDVectorF4 const & rhs, float v)
-		{
-#if defined(SIMD_MATH_SSE)
-			SIMDVectorF4 ret;
-			__m128 yxzw = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 2, 0, 1));
-			yxzw = _mm_move_ss(yxzw, _mm_set_ss(v));
-			ret.Vec() = _mm_shuffle_ps(yxzw, yxzw, _MM_SHUFFLE(3, 2, 0, 1));
-			return ret;
-#else
-			return SetByIndex(rhs, v, 1);
-#endif
-		}
-
-		SIMDVectorF4 SetZ(SIMDVectorF4 const & rhs, float v)
-		{
-#if defined(SIMD_MATH_SSE)
-			SIMDVectorF4 ret;
-			__m128 zyxw = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(3, 0, 1, 2));
-			zyxw = _mm_move_ss(zyxw, _mm_set_ss(v));
-			ret.Vec() = _mm_shuffle_ps(zyxw, zyxw, _MM_SHUFFLE(3, 0, 1, 2));
-			return ret;
-#else
-			return SetByIndex(rhs, v, 2);
-#endif
-		}
-
-		SIMDVectorF4 SetW(SIMDVectorF4 const & rhs, float v)
-		{
-#if defined(SIMD_MATH_SSE)
-			SIMDVectorF4 ret;
-			__m128 wyzx = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 2, 1, 3));
-			wyzx = _mm_move_ss(wyzx, _mm_set_ss(v));
-			ret.Vec() = _mm_shuffle_ps(wyzx, wyzx, _MM_SHUFFLE(0, 2, 1, 3));
-			return ret;
-#else
-			return SetByIndex(rhs, v, 3);
-#endif
-		}
-
-		SIMDVectorF4 SetByIndex(SIMDVectorF4 const & rhs, float v, size_t index)
-		{
-			SIMDVectorF4 ret = rhs;
-#if defined(SIMD_MATH_SSE)
-#ifdef KLAYGE_COMPILER_MSVC
-			ret.Vec().m128_f32[index] = v;
-#else
-			union
-			{
-				__m128 v;
-				float comp[4];
-			} converter;
-			converter.v = rhs.Vec();
-			converter.comp[index] = v;
-			ret.Vec() = converter.v;
-#endif
-#else
-			ret.Vec()[index] = v;
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Maximize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_max_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = std::max(lhs.Vec()[i], rhs.Vec()[i]);
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Minimize(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_min_ps(lhs.Vec(), rhs.Vec());
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = std::min(lhs.Vec()[i], rhs.Vec()[i]);
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 Reflect(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal)
-		{
-			return incident - 2 * DotVector3(incident, normal) * normal;
-		}
-
-		SIMDVectorF4 Refract(SIMDVectorF4 const & incident, SIMDVectorF4 const & normal, float refraction_index)
-		{
-			float const t = GetX(DotVector3(incident, normal));
-			float const r = 1 - refraction_index * refraction_index * (1 - t * t);
-
-			if (r < 0)
-			{
-				// Total internal reflection
-				return SIMDVectorF4::Zero();
-			}
-			else
-			{
-				float const s = refraction_index * t + sqrt(std::abs(r));
-				return refraction_index * incident - s * normal;
-			}
-		}
-
-		// 2D Vector
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 CrossVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 res1 = lhs.Vec();
-			__m128 res2 = rhs.Vec();
-			res2 = _mm_shuffle_ps(res2, res2, _MM_SHUFFLE(0, 0, 0, 1));
-			res1 = _mm_mul_ps(res1, res2);
-			res2 = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
-			res1 = _mm_sub_ps(res1, res2);
-			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
-#else
-			ret = SetVector(GetX(lhs) * GetY(rhs) - GetY(lhs) * GetX(rhs));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 DotVector2(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 res1 = lhs.Vec();
-			__m128 res2 = rhs.Vec();
-			res1 = _mm_mul_ps(res1, res2);
-			__m128 y = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
-			res1 = _mm_add_ps(res1, y);
-			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
-#else
-			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LengthSqVector2(SIMDVectorF4 const & rhs)
-		{
-			return DotVector2(rhs, rhs);
-		}
-
-		SIMDVectorF4 LengthVector2(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_sqrt_ps(LengthSqVector2(rhs).Vec());
-#else
-			ret = SetVector(sqrt(GetX(LengthSqVector2(rhs))));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 NormalizeVector2(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = _mm_sqrt_ps(LengthSqVector2(rhs).Vec());
-			temp = _mm_rcp_ps(temp);
-			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
-#else
-			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector2(rhs)));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformCoordVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = v.Vec();
-			__m128 res1 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0)), mat.Row(0).Vec());
-			__m128 res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1)), mat.Row(1).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			res1 = _mm_add_ps(res1, mat.Row(3).Vec());
-			__m128 w = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(3, 3, 3, 3));
-			__m128 inv_w = _mm_rcp_ps(w);
-			ret.Vec() = _mm_mul_ps(res1, inv_w);
-#else
-			SIMDVectorF4 temp;
-			for (int i = 0; i < 4; ++ i)
-			{
-				temp.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i) + mat(3, i);
-			}
-			if (MathLib::equal(GetW(temp), 0.0f))
-			{
-				ret = SIMDVectorF4::Zero();
-			}
-			else
-			{
-				for (int i = 0; i < 2; ++ i)
-				{
-					ret.Vec()[i] = temp.Vec()[i] / GetW(temp);
-				}
-				for (int i = 2; i < 4; ++ i)
-				{
-					ret.Vec()[i] = 0;
-				}
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformNormalVector2(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = v.Vec();
-			__m128 res1 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0)), mat.Row(0).Vec());
-			__m128 res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1)), mat.Row(1).Vec());
-			ret.Vec() = _mm_add_ps(res1, res2);
-#else
-			for (int i = 0; i < 2; ++ i)
-			{
-				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i);
-			}
-			for (int i = 2; i < 4; ++ i)
-			{
-				ret.Vec()[i] = 0;
-			}
-#endif
-			return ret;
-		}
-
-		// 3D Vector
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Angle(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			return SetVector(MathLib::acos(GetX(DotVector3(lhs, rhs) / (LengthVector3(lhs) * LengthVector3(rhs)))));
-		}
-
-		SIMDVectorF4 CrossVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 m1 = _mm_shuffle_ps(lhs.Vec(), lhs.Vec(), _MM_SHUFFLE(0, 0, 2, 1));
-			__m128 m2 = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 1, 0, 2));
-			__m128 res1 = _mm_mul_ps(m1, m2);
-			m1 = _mm_shuffle_ps(lhs.Vec(), lhs.Vec(), _MM_SHUFFLE(0, 1, 0, 2));
-			m2 = _mm_shuffle_ps(rhs.Vec(), rhs.Vec(), _MM_SHUFFLE(0, 0, 2, 1));
-			__m128 res2 = _mm_mul_ps(m1, m2);
-			ret.Vec() = _mm_sub_ps(res1, res2);
-#else
-			ret = SetVector(GetY(lhs) * GetZ(rhs) - GetZ(lhs) * GetY(rhs),
-				GetZ(lhs) * GetX(rhs) - GetX(lhs) * GetZ(rhs),
-				GetX(lhs) * GetY(rhs) - GetY(lhs) * GetX(rhs),
-				0.0f);
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 DotVector3(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 res1 = lhs.Vec();
-			__m128 res2 = rhs.Vec();
-			res1 = _mm_mul_ps(res1, res2);
-			__m128 y = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 1, 1));
-			__m128 z = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(2, 2, 2, 2));
-			res1 = _mm_add_ps(res1, y);
-			res1 = _mm_add_ps(res1, z);
-			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
-#else
-			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs)
-				+ GetZ(lhs) * GetZ(rhs));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LengthSqVector3(SIMDVectorF4 const & rhs)
-		{
-			return DotVector3(rhs, rhs);
-		}
+#include <limits>
 
-		SIMDVectorF4 LengthVector3(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_sqrt_ps(LengthSqVector3(rhs).Vec());
-#else
-			ret = SetVector(sqrt(GetX(LengthSqVector3(rhs))));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 NormalizeVector3(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = _mm_sqrt_ps(LengthSqVector3(rhs).Vec());
-			temp = _mm_rcp_ps(temp);
-			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
-#else
-			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector3(rhs)));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformCoordVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = v.Vec();
-			__m128 res1 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0)), mat.Row(0).Vec());
-			__m128 res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1)), mat.Row(1).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(2, 2, 2, 2)), mat.Row(2).Vec());
-			res2 = _mm_add_ps(res2, mat.Row(3).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			__m128 w = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(3, 3, 3, 3));
-			__m128 inv_w = _mm_rcp_ps(w);
-			ret.Vec() = _mm_mul_ps(res1, inv_w);
-#else
-			SIMDVectorF4 temp;
-			for (int i = 0; i < 4; ++ i)
-			{
-				temp.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
-					+ GetZ(v) * mat(2, i) + mat(3, i);
-			}
-			if (MathLib::equal(GetW(temp), 0.0f))
-			{
-				ret = SIMDVectorF4::Zero();
-			}
-			else
-			{
-				for (int i = 0; i < 3; ++ i)
-				{
-					ret.Vec()[i] = temp.Vec()[i] / GetW(temp);
-				}
-				for (int i = 3; i < 4; ++ i)
-				{
-					ret.Vec()[i] = 0;
-				}
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformNormalVector3(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = v.Vec();
-			__m128 res1 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0)), mat.Row(0).Vec());
-			__m128 res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1)), mat.Row(1).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(2, 2, 2, 2)), mat.Row(2).Vec());
-			ret.Vec() = _mm_add_ps(res1, res2);
-#else
-			for (int i = 0; i < 3; ++ i)
-			{
-				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
-					+ GetZ(v) * mat(2, i);
-			}
-			for (int i = 3; i < 4; ++ i)
-			{
-				ret.Vec()[i] = 0;
-			}
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformQuat(SIMDVectorF4 const & v, SIMDVectorF4 const & quat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			ret = v + CrossVector3(quat, CrossVector3(quat, v) + GetW(quat) * v) * 2;
-			return ret;
-		}
-
-		SIMDVectorF4 Project(SIMDVectorF4 const & vec,
-			SIMDMatrixF4 const & world, SIMDMatrixF4 const & view, SIMDMatrixF4 const & proj,
-			int const viewport[4], float near_plane, float far_plane)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			SIMDVectorF4 temp(TransformVector4(vec, world));
-			temp = TransformVector4(temp, view);
-			temp = TransformVector4(temp, proj);
-			temp /= GetW(temp);
-
-			ret = SetVector((GetX(temp) + 1) * viewport[2] / 2 + viewport[0],
-				(-GetY(temp) + 1) * viewport[3] / 2 + viewport[1],
-				GetZ(temp) * (far_plane - near_plane) + near_plane,
-				1.0f);
-			return ret;
-		}
-
-		SIMDVectorF4 Unproject(SIMDVectorF4 const & win_vec, float clip_w,
-			SIMDMatrixF4 const & world, SIMDMatrixF4 const & view, SIMDMatrixF4 const & proj,
-			int const viewport[4], float near_plane, float far_plane)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			SIMDVectorF4 temp = SetVector(2 * (GetX(win_vec) - viewport[0]) / viewport[2] - 1,
-				-(2 * (GetY(win_vec) - viewport[1]) / viewport[3] - 1),
-				(GetZ(win_vec) - near_plane) / (far_plane - near_plane),
-				clip_w);
-
-			SIMDMatrixF4 const mat(Inverse(world * view * proj));
-			temp = TransformVector4(temp, mat);
-
-			ret = SetVector(GetX(temp), GetY(temp), GetZ(temp), 0.0f) / GetW(temp);
-			return ret;
-		}
-
-		// 4D Vector
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 CrossVector4(SIMDVectorF4 const & v1, SIMDVectorF4 const & v2, SIMDVectorF4 const & v3)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			//    RA	 * RB  -   RC     * RD +   f*RE    * RF
-			// (GetY(v1) * F) - (GetZ(v1) * E) + (GetW(v1) * D),
-			// (GetZ(v1) * C) - (GetX(v1) * F) - (GetW(v1) * B),
-			// (GetX(v1) * E) - (GetY(v1) * C) + (GetW(v1) * A),
-			// (GetY(v1) * B) - (GetX(v1) * D) - (GetZ(v1) * A));	
-			__m128 ABDE = _mm_sub_ps(
-				_mm_mul_ps(_mm_shuffle_ps(v2.Vec(), v2.Vec(), _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(v3.Vec(), v3.Vec(), _MM_SHUFFLE(3, 2, 2, 1))),
-				_mm_mul_ps(_mm_shuffle_ps(v3.Vec(), v3.Vec(), _MM_SHUFFLE(1, 1, 0, 0)), _mm_shuffle_ps(v2.Vec(), v2.Vec(), _MM_SHUFFLE(3, 2, 2, 1))));
-			__m128 CDEF = _mm_sub_ps(
-				_mm_mul_ps(_mm_shuffle_ps(v2.Vec(), v2.Vec(), _MM_SHUFFLE(2, 1, 1, 0)), _mm_shuffle_ps(v3.Vec(), v3.Vec(), _MM_SHUFFLE(3, 3, 2, 3))),
-				_mm_mul_ps(_mm_shuffle_ps(v3.Vec(), v3.Vec(), _MM_SHUFFLE(2, 1, 1, 0)), _mm_shuffle_ps(v2.Vec(), v2.Vec(), _MM_SHUFFLE(3, 3, 2, 3))));
-
-			__m128 RA = _mm_shuffle_ps(v1.Vec(), v1.Vec(), _MM_SHUFFLE(1, 0, 2, 1));
-			__m128 RB = _mm_shuffle_ps(CDEF, ABDE, _MM_SHUFFLE(1, 3, 0, 3));
-			__m128 RC = _mm_shuffle_ps(v1.Vec(), v1.Vec(), _MM_SHUFFLE(0, 1, 0, 2));
-			__m128 RD = _mm_shuffle_ps(CDEF, CDEF, _MM_SHUFFLE(1, 0, 3, 2));
-			__m128 f = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
-			__m128 RE = _mm_shuffle_ps(v1.Vec(), v1.Vec(), _MM_SHUFFLE(2, 3, 3, 3));
-			__m128 RF = _mm_shuffle_ps(ABDE, ABDE, _MM_SHUFFLE(0, 0, 1, 2));
-
-			ret.Vec() = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(RA, RB), _mm_mul_ps(RC, RD)),
-				_mm_mul_ps(f, _mm_mul_ps(RE, RF)));
-#else
-			float const A = (GetX(v2) * GetY(v3)) - (GetY(v2) * GetX(v3));
-			float const B = (GetX(v2) * GetZ(v3)) - (GetZ(v2) * GetX(v3));
-			float const C = (GetX(v2) * GetW(v3)) - (GetW(v2) * GetX(v3));
-			float const D = (GetY(v2) * GetZ(v3)) - (GetZ(v2) * GetY(v3));
-			float const E = (GetY(v2) * GetW(v3)) - (GetW(v2) * GetY(v3));
-			float const F = (GetZ(v2) * GetW(v3)) - (GetW(v2) * GetZ(v3));
-
-			ret = SetVector((GetY(v1) * F) - (GetZ(v1) * E) + (GetW(v1) * D),
-				-(GetX(v1) * F) + (GetZ(v1) * C) - (GetW(v1) * B),
-				(GetX(v1) * E) - (GetY(v1) * C) + (GetW(v1) * A),
-				-(GetX(v1) * D) + (GetY(v1) * B) - (GetZ(v1) * A));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 DotVector4(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 res1 = lhs.Vec();
-			__m128 res2 = rhs.Vec();
-			res1 = _mm_mul_ps(res1, res2);
-			__m128 yw = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(1, 1, 3, 3));
-			res1 = _mm_add_ps(res1, yw);
-			__m128 zw = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(2, 2, 2, 2));
-			res1 = _mm_add_ps(res1, zw);
-			ret.Vec() = _mm_shuffle_ps(res1, res1, _MM_SHUFFLE(0, 0, 0, 0));
-#else
-			ret = SetVector(GetX(lhs) * GetX(rhs) + GetY(lhs) * GetY(rhs)
-				+ GetZ(lhs) * GetZ(rhs) + GetW(lhs) * GetW(rhs));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 LengthSqVector4(SIMDVectorF4 const & rhs)
-		{
-			return DotVector4(rhs, rhs);
-		}
-
-		SIMDVectorF4 LengthVector4(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			ret.Vec() = _mm_sqrt_ps(LengthSqVector4(rhs).Vec());
-#else
-			ret = SetVector(sqrt(GetX(LengthSqVector4(rhs))));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 NormalizeVector4(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = _mm_sqrt_ps(LengthSqVector4(rhs).Vec());
-			temp = _mm_rcp_ps(temp);
-			ret.Vec() = _mm_mul_ps(rhs.Vec(), temp);
-#else
-			ret = rhs * MathLib::recip_sqrt(GetX(LengthSqVector4(rhs)));
-#endif
-			return ret;
-		}
-
-		SIMDVectorF4 TransformVector4(SIMDVectorF4 const & v, SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 temp = v.Vec();
-			__m128 res1 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(0, 0, 0, 0)), mat.Row(0).Vec());
-			__m128 res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(1, 1, 1, 1)), mat.Row(1).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(2, 2, 2, 2)), mat.Row(2).Vec());
-			res1 = _mm_add_ps(res1, res2);
-			res2 = _mm_mul_ps(_mm_shuffle_ps(temp, temp, _MM_SHUFFLE(3, 3, 3, 3)), mat.Row(3).Vec());
-			ret.Vec() = _mm_add_ps(res1, res2);
-#else
-			for (int i = 0; i < 4; ++ i)
-			{
-				ret.Vec()[i] = GetX(v) * mat(0, i) + GetY(v) * mat(1, i)
-					+ GetZ(v) * mat(2, i) + GetW(v) * mat(3, i);
-			}
-#endif
-			return ret;
-		}
-
-		// 4D Matrix
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDMatrixF4 Add(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
-		{
-			return SIMDMatrixF4(Add(lhs.Row(0), rhs.Row(0)),
-				Add(lhs.Row(1), rhs.Row(1)),
-				Add(lhs.Row(2), rhs.Row(2)),
-				Add(lhs.Row(3), rhs.Row(3)));
-		}
-
-		SIMDMatrixF4 Substract(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
-		{
-			return SIMDMatrixF4(Substract(lhs.Row(0), rhs.Row(0)),
-				Substract(lhs.Row(1), rhs.Row(1)),
-				Substract(lhs.Row(2), rhs.Row(2)),
-				Substract(lhs.Row(3), rhs.Row(3)));
-		}
-#if defined(SIMD_MATH_SSE)
-		#define GetVector(v, i) _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i))
-#endif
-
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, SIMDMatrixF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			V4TYPE const & l0 = lhs.Row(0).Vec();
-			V4TYPE const & l1 = lhs.Row(1).Vec();
-			V4TYPE const & l2 = lhs.Row(2).Vec();
-			V4TYPE const & l3 = lhs.Row(3).Vec();
-
-			V4TYPE const & t0 = rhs.Row(0).Vec();
-			V4TYPE const & t1 = rhs.Row(1).Vec();
-			V4TYPE const & t2 = rhs.Row(2).Vec();
-			V4TYPE const & t3 = rhs.Row(3).Vec();
-
-			SIMDVectorF4 row1;			
-			SIMDVectorF4 row2;			
-			SIMDVectorF4 row3;	
-			SIMDVectorF4 row4;
-			row1.Vec() = _mm_mul_ps(t0, GetVector(l0, 0));
-			row2.Vec() = _mm_mul_ps(t0, GetVector(l1, 0));
-			row3.Vec() = _mm_mul_ps(t0, GetVector(l2, 0));
-			row4.Vec() = _mm_mul_ps(t0, GetVector(l3, 0));
-
-			row1.Vec() = _mm_add_ps(row1.Vec(), _mm_mul_ps(t1, GetVector(l0, 1)));
-			row2.Vec() = _mm_add_ps(row2.Vec(), _mm_mul_ps(t1, GetVector(l1, 1)));
-			row3.Vec() = _mm_add_ps(row3.Vec(), _mm_mul_ps(t1, GetVector(l2, 1)));
-			row4.Vec() = _mm_add_ps(row4.Vec(), _mm_mul_ps(t1, GetVector(l3, 1)));
-
-			row1.Vec() = _mm_add_ps(row1.Vec(), _mm_mul_ps(t2, GetVector(l0, 2)));
-			row2.Vec() = _mm_add_ps(row2.Vec(), _mm_mul_ps(t2, GetVector(l1, 2)));
-			row3.Vec() = _mm_add_ps(row3.Vec(), _mm_mul_ps(t2, GetVector(l2, 2)));
-			row4.Vec() = _mm_add_ps(row4.Vec(), _mm_mul_ps(t2, GetVector(l3, 2)));
-
-			row1.Vec() = _mm_add_ps(row1.Vec(), _mm_mul_ps(t3, GetVector(l0, 3)));
-			row2.Vec() = _mm_add_ps(row2.Vec(), _mm_mul_ps(t3, GetVector(l1, 3)));
-			row3.Vec() = _mm_add_ps(row3.Vec(), _mm_mul_ps(t3, GetVector(l2, 3)));
-			row4.Vec() = _mm_add_ps(row4.Vec(), _mm_mul_ps(t3, GetVector(l3, 3)));
-
-			return SIMDMatrixF4(row1, row2,row3,row4);
-#else
-			SIMDMatrixF4 const tmp = Transpose(rhs);
-
-			V4TYPE const & l0 = lhs.Row(0).Vec();
-			V4TYPE const & l1 = lhs.Row(1).Vec();
-			V4TYPE const & l2 = lhs.Row(2).Vec();
-			V4TYPE const & l3 = lhs.Row(3).Vec();
-
-			V4TYPE const & t0 = tmp.Row(0).Vec();
-			V4TYPE const & t1 = tmp.Row(1).Vec();
-			V4TYPE const & t2 = tmp.Row(2).Vec();
-			V4TYPE const & t3 = tmp.Row(3).Vec();
-
-			return SIMDMatrixF4(
-				l0[0] * t0[0] + l0[1] * t0[1] + l0[2] * t0[2] + l0[3] * t0[3],
-				l0[0] * t1[0] + l0[1] * t1[1] + l0[2] * t1[2] + l0[3] * t1[3],
-				l0[0] * t2[0] + l0[1] * t2[1] + l0[2] * t2[2] + l0[3] * t2[3],
-				l0[0] * t3[0] + l0[1] * t3[1] + l0[2] * t3[2] + l0[3] * t3[3],
-
-				l1[0] * t0[0] + l1[1] * t0[1] + l1[2] * t0[2] + l1[3] * t0[3],
-				l1[0] * t1[0] + l1[1] * t1[1] + l1[2] * t1[2] + l1[3] * t1[3],
-				l1[0] * t2[0] + l1[1] * t2[1] + l1[2] * t2[2] + l1[3] * t2[3],
-				l1[0] * t3[0] + l1[1] * t3[1] + l1[2] * t3[2] + l1[3] * t3[3],
-
-				l2[0] * t0[0] + l2[1] * t0[1] + l2[2] * t0[2] + l2[3] * t0[3],
-				l2[0] * t1[0] + l2[1] * t1[1] + l2[2] * t1[2] + l2[3] * t1[3],
-				l2[0] * t2[0] + l2[1] * t2[1] + l2[2] * t2[2] + l2[3] * t2[3],
-				l2[0] * t3[0] + l2[1] * t3[1] + l2[2] * t3[2] + l2[3] * t3[3],
-
-				l3[0] * t0[0] + l3[1] * t0[1] + l3[2] * t0[2] + l3[3] * t0[3],
-				l3[0] * t1[0] + l3[1] * t1[1] + l3[2] * t1[2] + l3[3] * t1[3],
-				l3[0] * t2[0] + l3[1] * t2[1] + l3[2] * t2[2] + l3[3] * t2[3],
-				l3[0] * t3[0] + l3[1] * t3[1] + l3[2] * t3[2] + l3[3] * t3[3]);
-#endif
-		}
-
-		SIMDMatrixF4 Multiply(SIMDMatrixF4 const & lhs, float rhs)
-		{
-			SIMDVectorF4 r = SetVector(rhs, rhs, rhs, rhs);
-			return SIMDMatrixF4(Multiply(lhs.Row(0), r),
-				Multiply(lhs.Row(1), r),
-				Multiply(lhs.Row(2), r),
-				Multiply(lhs.Row(3), r));
-		}
-
-		SIMDVectorF4 Determinant(SIMDMatrixF4 const & rhs)
-		{
-			SIMDVectorF4 ret;
-#if defined(SIMD_MATH_SSE)	
-			__m128 row0 = rhs.Row(0).Vec();
-			__m128 row1 = rhs.Row(1).Vec();
-			__m128 row2 = rhs.Row(2).Vec();
-			__m128 row3 = rhs.Row(3).Vec();
-			__m128 f = _mm_set_ps(-1.0f, 1.0f, -1.0f, 1.0f);
-			__m128 r1 = _mm_shuffle_ps(row1, row1, _MM_SHUFFLE(1, 0, 2, 1));
-			__m128 r2 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(0, 1, 0, 2));
-			__m128 r3 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(2, 3, 3, 3));
-			__m128 r4 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(2, 3, 3, 3));
-			__m128 r5 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(0, 1, 0, 2));
-			__m128 r6 = _mm_shuffle_ps(row1, row1, _MM_SHUFFLE(0, 1, 0, 2));
-			__m128 r7 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(1, 0, 2, 1));
-			//__m128 r8 = r3
-			//__m128 r9 = r4
-			__m128 r10 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(1, 0, 2, 1));
-			__m128 r11 = _mm_shuffle_ps(row0, row0, _MM_SHUFFLE(3, 1, 1, 0));
-			__m128 r12 = _mm_shuffle_ps(row1, row1, _MM_SHUFFLE(2, 3, 3, 3));
-			__m128 r13 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(0, 0, 0, 1));
-			__m128 r14 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(2, 1, 2, 2));
-			__m128 r15 = _mm_shuffle_ps(row2, row2, _MM_SHUFFLE(1, 1, 2, 2));
-			__m128 r16 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(0, 0, 0, 1));
-	
-			__m128 t1 = _mm_mul_ps(r2, r3);
-			__m128 t2 = _mm_mul_ps(r4, r5);
-			__m128 t3 = _mm_mul_ps(r7, r3);
-			__m128 t4 = _mm_mul_ps(r4, r10);
-			__m128 t5 = _mm_mul_ps(r13, r14);
-			__m128 t6 = _mm_mul_ps(r15, r16);
-
-			t1 = _mm_sub_ps(t1, t2);
-			t3 = _mm_sub_ps(t3, t4);
-			t5 = _mm_sub_ps(t5, t6);
-
-			t1 = _mm_mul_ps(r1, t1);
-			t3 = _mm_mul_ps(r6, t3);
-			t5 = _mm_mul_ps(r12, t5);
-
-			t1 = _mm_sub_ps(t1, t3);
-			t5 = _mm_mul_ps(r11, t5);
-
-			t1 = _mm_mul_ps(row0, t1);
-			t5 = _mm_mul_ps(f, t5);
-
-			t1 = _mm_add_ps(t1, t5);
-
-			__m128 res2 = _mm_set_ps(1, 1, 1, 1);
-			t1 = _mm_mul_ps(t1, res2);
-			__m128 y = _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(1, 1, 1, 1));
-			__m128 z = _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(2, 2, 2, 2));
-			t1 = _mm_add_ps(t1, y);
-			t1 = _mm_add_ps(t1, z);
-			ret.Vec() = _mm_shuffle_ps(t1, t1, _MM_SHUFFLE(0, 0, 0, 0));
-#else
-			float const _3142_3241 = rhs(2, 0) * rhs(3, 1) - rhs(2, 1) * rhs(3, 0);
-			float const _3143_3341 = rhs(2, 0) * rhs(3, 2) - rhs(2, 2) * rhs(3, 0);
-			float const _3144_3441 = rhs(2, 0) * rhs(3, 3) - rhs(2, 3) * rhs(3, 0);
-			float const _3243_3342 = rhs(2, 1) * rhs(3, 2) - rhs(2, 2) * rhs(3, 1);
-			float const _3244_3442 = rhs(2, 1) * rhs(3, 3) - rhs(2, 3) * rhs(3, 1);
-			float const _3344_3443 = rhs(2, 2) * rhs(3, 3) - rhs(2, 3) * rhs(3, 2);
-
-			ret.Vec()[0] = rhs(0, 0) * (rhs(1, 1) * _3344_3443 - rhs(1, 2) * _3244_3442 + rhs(1, 3) * _3243_3342)
-				- rhs(0, 1) * (rhs(1, 0) * _3344_3443 - rhs(1, 2) * _3144_3441 + rhs(1, 3) * _3143_3341)
-				+ rhs(0, 2) * (rhs(1, 0) * _3244_3442 - rhs(1, 1) * _3144_3441 + rhs(1, 3) * _3142_3241)
-				- rhs(0, 3) * (rhs(1, 0) * _3243_3342 - rhs(1, 1) * _3143_3341 + rhs(1, 2) * _3142_3241);
-			ret.Vec()[1] = ret.Vec()[0];
-			ret.Vec()[2] = ret.Vec()[0];
-			ret.Vec()[3] = ret.Vec()[0];
-#endif
-			return ret;
-		}
-
-		SIMDMatrixF4 Negative(SIMDMatrixF4 const & rhs)
-		{
-			return SIMDMatrixF4(Negative(rhs.Row(0)),
-				Negative(rhs.Row(1)),
-				Negative(rhs.Row(2)),
-				Negative(rhs.Row(3)));
-		}
-
-		SIMDMatrixF4 Inverse(SIMDMatrixF4 const & rhs)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			__m128 minor0, minor1, minor2, minor3;
-			__m128 row0, row1, row2, row3;
-			__m128 det, tmp1;
-
-			row0 = rhs.Col(0).Vec();
-			row1 = rhs.Col(1).Vec();
-			row2 = rhs.Col(2).Vec();
-			row3 = rhs.Col(3).Vec();
-			row1 = _mm_shuffle_ps(row1, row1, _MM_SHUFFLE(1, 0, 3, 2));
-			row3 = _mm_shuffle_ps(row3, row3, _MM_SHUFFLE(1, 0, 3, 2));
-
-			tmp1= _mm_mul_ps(row2, row3);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-			minor0= _mm_mul_ps(row1, tmp1);
-			minor1= _mm_mul_ps(row0, tmp1);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor0= _mm_sub_ps(_mm_mul_ps(row1, tmp1), minor0);
-			minor1= _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor1);
-			minor1= _mm_shuffle_ps(minor1, minor1, 0x4E);
-
-			tmp1= _mm_mul_ps(row1, row2);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-			minor0= _mm_add_ps(_mm_mul_ps(row3, tmp1), minor0);
-			minor3= _mm_mul_ps(row0, tmp1);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor0= _mm_sub_ps(minor0, _mm_mul_ps(row3, tmp1));
-			minor3= _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor3);
-			minor3= _mm_shuffle_ps(minor3, minor3, 0x4E);
-
-			tmp1= _mm_mul_ps(_mm_shuffle_ps(row1, row1, 0x4E), row3);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-			row2= _mm_shuffle_ps(row2, row2, 0x4E);
-			minor0= _mm_add_ps(_mm_mul_ps(row2, tmp1), minor0);
-			minor2= _mm_mul_ps(row0, tmp1);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor0= _mm_sub_ps(minor0, _mm_mul_ps(row2, tmp1));
-			minor2= _mm_sub_ps(_mm_mul_ps(row0, tmp1), minor2);
-			minor2= _mm_shuffle_ps(minor2, minor2, 0x4E);
-
-			tmp1= _mm_mul_ps(row0, row1);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-
-			minor2= _mm_add_ps(_mm_mul_ps(row3, tmp1), minor2);
-			minor3= _mm_sub_ps(_mm_mul_ps(row2, tmp1), minor3);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor2= _mm_sub_ps(_mm_mul_ps(row3, tmp1), minor2);
-			minor3= _mm_sub_ps(minor3, _mm_mul_ps(row2, tmp1));
-
-			tmp1= _mm_mul_ps(row0, row3);
-			tmp1= _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-			minor1= _mm_sub_ps(minor1, _mm_mul_ps(row2, tmp1));
-			minor2= _mm_add_ps(_mm_mul_ps(row1, tmp1), minor2);
-			tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor1 = _mm_add_ps(_mm_mul_ps(row2, tmp1), minor1);
-			minor2 = _mm_sub_ps(minor2, _mm_mul_ps(row1, tmp1));
-
-			tmp1 = _mm_mul_ps(row0, row2);
-			tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0xB1);
-			minor1 = _mm_add_ps(_mm_mul_ps(row3, tmp1), minor1);
-			minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row1, tmp1));
-			tmp1 = _mm_shuffle_ps(tmp1, tmp1, 0x4E);
-			minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row3, tmp1));
-			minor3 = _mm_add_ps(_mm_mul_ps(row1, tmp1), minor3);
-			// -----------------------------------------------
-			// -----------------------------------------------
-			// -----------------------------------------------
-			det = _mm_mul_ps(row0, minor0);
-			det = _mm_add_ps(_mm_shuffle_ps(det, det, 0x4E), det);
-			det = _mm_add_ss(_mm_shuffle_ps(det, det, 0xB1), det);
-			tmp1 = _mm_rcp_ss(det);
-			det = _mm_sub_ss(_mm_add_ss(tmp1, tmp1), _mm_mul_ss(det, _mm_mul_ss(tmp1, tmp1)));
-			det = _mm_shuffle_ps(det, det, 0x00);
-			SIMDVectorF4 r0;
-			SIMDVectorF4 r1;
-			SIMDVectorF4 r2;
-			SIMDVectorF4 r3;
-			r0.Vec() = _mm_mul_ps(det, minor0);
-			r1.Vec() = _mm_mul_ps(det, minor1);
-			r2.Vec() = _mm_mul_ps(det, minor2);
-			r3.Vec() = _mm_mul_ps(det, minor3);
-			
-			ret = SIMDMatrixF4(r0, r1, r2, r3);
-
-#else
-			float const _2132_2231 = rhs(1, 0) * rhs(2, 1) - rhs(1, 1) * rhs(2, 0);
-			float const _2133_2331 = rhs(1, 0) * rhs(2, 2) - rhs(1, 2) * rhs(2, 0);
-			float const _2134_2431 = rhs(1, 0) * rhs(2, 3) - rhs(1, 3) * rhs(2, 0);
-			float const _2142_2241 = rhs(1, 0) * rhs(3, 1) - rhs(1, 1) * rhs(3, 0);
-			float const _2143_2341 = rhs(1, 0) * rhs(3, 2) - rhs(1, 2) * rhs(3, 0);
-			float const _2144_2441 = rhs(1, 0) * rhs(3, 3) - rhs(1, 3) * rhs(3, 0);
-			float const _2233_2332 = rhs(1, 1) * rhs(2, 2) - rhs(1, 2) * rhs(2, 1);
-			float const _2234_2432 = rhs(1, 1) * rhs(2, 3) - rhs(1, 3) * rhs(2, 1);
-			float const _2243_2342 = rhs(1, 1) * rhs(3, 2) - rhs(1, 2) * rhs(3, 1);
-			float const _2244_2442 = rhs(1, 1) * rhs(3, 3) - rhs(1, 3) * rhs(3, 1);
-			float const _2334_2433 = rhs(1, 2) * rhs(2, 3) - rhs(1, 3) * rhs(2, 2);
-			float const _2344_2443 = rhs(1, 2) * rhs(3, 3) - rhs(1, 3) * rhs(3, 2);
-			float const _3142_3241 = rhs(2, 0) * rhs(3, 1) - rhs(2, 1) * rhs(3, 0);
-			float const _3143_3341 = rhs(2, 0) * rhs(3, 2) - rhs(2, 2) * rhs(3, 0);
-			float const _3144_3441 = rhs(2, 0) * rhs(3, 3) - rhs(2, 3) * rhs(3, 0);
-			float const _3243_3342 = rhs(2, 1) * rhs(3, 2) - rhs(2, 2) * rhs(3, 1);
-			float const _3244_3442 = rhs(2, 1) * rhs(3, 3) - rhs(2, 3) * rhs(3, 1);
-			float const _3344_3443 = rhs(2, 2) * rhs(3, 3) - rhs(2, 3) * rhs(3, 2);
-
-			float const det = GetX(Determinant(rhs));
-			if (MathLib::equal(det, 0.0f))
-			{
-				ret = rhs;
-			}
-			else
-			{
-				float const inv_det = 1.0f / det;
-
-				ret = SIMDMatrixF4(
-					+inv_det * (rhs(1, 1) * _3344_3443 - rhs(1, 2) * _3244_3442 + rhs(1, 3) * _3243_3342),
-					-inv_det * (rhs(0, 1) * _3344_3443 - rhs(0, 2) * _3244_3442 + rhs(0, 3) * _3243_3342),
-					+inv_det * (rhs(0, 1) * _2344_2443 - rhs(0, 2) * _2244_2442 + rhs(0, 3) * _2243_2342),
-					-inv_det * (rhs(0, 1) * _2334_2433 - rhs(0, 2) * _2234_2432 + rhs(0, 3) * _2233_2332),
-
-					-inv_det * (rhs(1, 0) * _3344_3443 - rhs(1, 2) * _3144_3441 + rhs(1, 3) * _3143_3341),
-					+inv_det * (rhs(0, 0) * _3344_3443 - rhs(0, 2) * _3144_3441 + rhs(0, 3) * _3143_3341),
-					-inv_det * (rhs(0, 0) * _2344_2443 - rhs(0, 2) * _2144_2441 + rhs(0, 3) * _2143_2341),
-					+inv_det * (rhs(0, 0) * _2334_2433 - rhs(0, 2) * _2134_2431 + rhs(0, 3) * _2133_2331),
-
-					+inv_det * (rhs(1, 0) * _3244_3442 - rhs(1, 1) * _3144_3441 + rhs(1, 3) * _3142_3241),
-					-inv_det * (rhs(0, 0) * _3244_3442 - rhs(0, 1) * _3144_3441 + rhs(0, 3) * _3142_3241),
-					+inv_det * (rhs(0, 0) * _2244_2442 - rhs(0, 1) * _2144_2441 + rhs(0, 3) * _2142_2241),
-					-inv_det * (rhs(0, 0) * _2234_2432 - rhs(0, 1) * _2134_2431 + rhs(0, 3) * _2132_2231),
-
-					-inv_det * (rhs(1, 0) * _3243_3342 - rhs(1, 1) * _3143_3341 + rhs(1, 2) * _3142_3241),
-					+inv_det * (rhs(0, 0) * _3243_3342 - rhs(0, 1) * _3143_3341 + rhs(0, 2) * _3142_3241),
-					-inv_det * (rhs(0, 0) * _2243_2342 - rhs(0, 1) * _2143_2341 + rhs(0, 2) * _2142_2241),
-					+inv_det * (rhs(0, 0) * _2233_2332 - rhs(0, 1) * _2133_2331 + rhs(0, 2) * _2132_2231));
-			}
-#endif
-			return ret;
-		}
-
-		SIMDMatrixF4 LookAtLH(SIMDVectorF4 const & eye, SIMDVectorF4 const & at)
-		{
-			return LookAtLH(eye, at, SetVector(0, 1, 0, 0));
-		}
-
-		SIMDMatrixF4 LookAtLH(SIMDVectorF4 const & eye, SIMDVectorF4 const & at,
-			SIMDVectorF4 const & up)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			SIMDVectorF4 const z_axis = NormalizeVector3(at - eye);
-			SIMDVectorF4 const x_axis = NormalizeVector3(CrossVector3(up, z_axis));
-			SIMDVectorF4 const y_axis = CrossVector3(z_axis, x_axis);
-
-			ret = SIMDMatrixF4(
-				GetX(x_axis), GetX(y_axis), GetX(z_axis), 0,
-				GetY(x_axis), GetY(y_axis), GetY(z_axis), 0,
-				GetZ(x_axis), GetZ(y_axis), GetZ(z_axis), 0,
-				-GetX(DotVector3(x_axis, eye)), -GetX(DotVector3(y_axis, eye)), -GetX(DotVector3(z_axis, eye)), 1);
-			return ret;
-		}
-
-		SIMDMatrixF4 LookAtRH(SIMDVectorF4 const & eye, SIMDVectorF4 const & at)
-		{
-			return LookAtRH(eye, at, SetVector(0, 1, 0, 0));
-		}
-
-		SIMDMatrixF4 LookAtRH(SIMDVectorF4 const & eye, SIMDVectorF4 const & at,
-			SIMDVectorF4 const & up)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			SIMDVectorF4 const z_axis = NormalizeVector3(eye - at);
-			SIMDVectorF4 const x_axis = NormalizeVector3(CrossVector3(up, z_axis));
-			SIMDVectorF4 const y_axis = CrossVector3(z_axis, x_axis);
-
-			ret = SIMDMatrixF4(
-				GetX(x_axis), GetX(y_axis), GetX(z_axis), 0,
-				GetY(x_axis), GetY(y_axis), GetY(z_axis), 0,
-				GetZ(x_axis), GetZ(y_axis), GetZ(z_axis), 0,
-				-GetX(DotVector3(x_axis, eye)), -GetX(DotVector3(y_axis, eye)), -GetX(DotVector3(z_axis, eye)), 1);
-			return ret;
-		}
-
-		SIMDMatrixF4 OrthoLH(float w, float h, float near_plane, float far_plane)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			float const w_2 = w / 2;
-			float const h_2 = h / 2;
-			ret = OrthoOffCenterLH(-w_2, w_2, -h_2, h_2, near_plane, far_plane);
-			return ret;
-		}
-
-		SIMDMatrixF4 OrthoOffCenterLH(float left, float right, float bottom, float top,
-			float near_plane, float far_plane)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			float const q = 1 / (far_plane - near_plane);
-			float const inv_width = 1 / (right - left);
-			float const inv_height = 1 / (top - bottom);
-
-			ret = SIMDMatrixF4(
-				inv_width + inv_width, 0, 0, 0,
-				0, inv_height + inv_height, 0, 0,
-				0, 0, q, 0,
-				-(left + right) * inv_width, -(top + bottom) * inv_height, -near_plane * q, 1);
-			return ret;
-		}
-
-		SIMDMatrixF4 OrthoRH(float width, float height, float near_plane, float far_plane)
-		{
-			return LHToRH(OrthoLH(width, height, near_plane, far_plane));
-		}
-
-		SIMDMatrixF4 OrthoOffCenterRH(float left, float right, float bottom, float top,
-			float near_plane, float far_plane)
-		{
-			return LHToRH(OrthoOffCenterLH(left, right, bottom, top, near_plane, far_plane));
-		}
-
-		SIMDMatrixF4 PerspectiveLH(float width, float height, float near_plane, float far_plane)
-		{
-			SIMDMatrixF4 ret;
-#if defined(SIMD_MATH_SSE)
-			// TODO
-#endif
-			float const q = far_plane / (far_plane - near_plane);
-			float const near2 = near_plane + near_plane;
-
-			ret = SIMDMatrixF4(
-				near2 / width,	0,				0,					0,
-				0,				near2 / height,	0,					0,
-				0,				0,				q,					1,
-				0,				0,				-near_plane * q,	0);
-			return ret;
-		}
-
-		SIMDMatrixF4 PerspectiveFovLH(float fov, float aspect, float near_plane, float far_plane)
-		{
-			SIMDMatrixF4 ret;
 #if defined(SIMD_MATH_SSE)
-			// TODO
+	#include <immintrin.h>
+	#if defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
+		#define KLAYGE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+	#else
+		#define KLAYGE_TARGET_AVX2
+	#endif
 #endif
-			float const h = 1 / tan(fov / 2);
-			float const w = h / aspect;
-			float const q = far_plane / (far_plane - near_plane);
-
-			ret = SIMDMatrixF4(
-				w, 0, 0, 0,
-				0, h, 0, 0,
-				0, 0, q, 1,
-				0, 0, -near_plane * q, 0);
-			return ret;
-		}
-
-		SIMDMatrixF4 PerspectiveOffCenterLH(float left, float right, float bottom, float top,
-			float near_plane, float far_plane)
-		{
-			float const q = far_plane / (far_plane - near_plane);
-			float const near2 = near_plane + near_plane;
-			float const inv_width = 1 / (right - left);
-			float const inv_height = 1 / (top - bottom);
-
-			return SIMDMatrixF4(
-				near2 * inv_width, 0, 0, 0,
-				0, near2 * inv_height, 0, 0,
-				-(left + right) * inv_width, -(top + bottom) * inv_height, q, 1,
-				0, 0, -near_plane * q, 0);
-		}
 
-		SIMDMatrixF4 PerspectiveRH(float width, float height, float near_plane, float far_plane)
-		{
-			return LHToRH(PerspectiveLH(width, height, near_plane, far_plane));
-		}
-
-		SIMDMatrixF4 PerspectiveFovRH(float fov, float aspect, float near_plane, float far_plane)
-		{
-			return LHToRH(PerspectiveFovLH(fov, aspect, near_plane, far_plane));
-		}
+namespace
+{
+	using namespace KlayGE;
 
-		SIMDMatrixF4 PerspectiveOffCenterRH(float left, float right, float bottom, float top,
-			float near_plane, float far_plane)
-		{
-			return LHToRH(PerspectiveOffCenterLH(left, right, bottom, top, near_plane, far_plane));
-		}
+	static_assert(sizeof(float3) == sizeof(float) * 3, "float3 must be tightly packed.");
+	static_assert(sizeof(Quaternion) == sizeof(float) * 4, "Quaternion must be tightly packed.");
 
-		SIMDMatrixF4 Reflect(SIMDVectorF4 const & p)
-		{
-			SIMDVectorF4 const np = NormalizePlane(p);
-			float const aa2 = -2 * GetX(np) * GetX(np);
-			float const ab2 = -2 * GetX(np) * GetY(np);
-			float const ac2 = -2 * GetX(np) * GetZ(np);
-			float const ad2 = -2 * GetX(np) * GetW(np);
-			float const bb2 = -2 * GetY(np) * GetY(np);
-			float const bc2 = -2 * GetY(np) * GetZ(np);
-			float const bd2 = -2 * GetY(np) * GetW(np);
-			float const cc2 = -2 * GetZ(np) * GetZ(np);
-			float const cd2 = -2 * GetZ(np) * GetW(np);
-
-			return SIMDMatrixF4(
-				aa2 + 1, ab2, ac2, 0,
-				ab2, bb2 + 1, bc2, 0,
-				ac2, bc2, cc2 + 1, 0,
-				ad2, bd2, cd2, 1);
-		}
+	// The kernels below do the same operations in the same order as these, so the SSE and NEON results are
+	// bitwise identical to MathLib. AVX2 kernels use FMA and can differ in the last bit.
 
-		SIMDMatrixF4 RotationX(float x)
+	void TransformCoordVector3General(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		for (size_t i = 0; i < num; ++ i)
 		{
-			float sx, cx;
-			MathLib::sincos(x, sx, cx);
-
-			return SIMDMatrixF4(
-				1, 0, 0, 0,
-				0, cx, sx, 0,
-				0, -sx, cx, 0,
-				0, 0, 0, 1);
+			out[i] = MathLib::transform_coord(in[i], mat);
 		}
+	}
 
-		SIMDMatrixF4 RotationY(float y)
+	void TransformAABBoxGeneral(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		for (size_t i = 0; i < num; ++ i)
 		{
-			float sy, cy;
-			MathLib::sincos(y, sy, cy);
-
-			return SIMDMatrixF4(
-				cy, 0, -sy, 0,
-				0, 1, 0, 0,
-				sy, 0, cy, 0,
-				0, 0, 0, 1);
+			out[i] = MathLib::transform_aabb(in[i], mat);
 		}
+	}
 
-		SIMDMatrixF4 RotationZ(float z)
+	void MultiplyDualQuatGeneral(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * lhs_real, Quaternion const * lhs_dual,
+		Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
 		{
-			float sz, cz;
-			MathLib::sincos(z, sz, cz);
-
-			return SIMDMatrixF4(
-				cz, sz, 0, 0,
-				-sz, cz, 0, 0,
-				0, 0, 1, 0,
-				0, 0, 0, 1);
+			Quaternion const real = MathLib::mul_real(lhs_real[i], rhs_real[i]);
+			Quaternion const dual = MathLib::mul_dual(lhs_real[i], lhs_dual[i], rhs_real[i], rhs_dual[i]);
+			out_real[i] = real;
+			out_dual[i] = dual;
 		}
+	}
 
-		SIMDMatrixF4 Rotation(float angle, float x, float y, float z)
+	void BlendDualQuatGeneral(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * real0, Quaternion const * dual0,
+		Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num)
+	{
+		for (size_t i = 0; i < num; ++ i)
 		{
-			SIMDVectorF4 const quat = RotationAxis(SetVector(x, y, z, 0), angle);
-			return QuatToMatrix(quat);
-		}
+			Quaternion const & r0 = real0[i];
+			Quaternion const & r1 = real1[i];
+			Quaternion const & d0 = dual0[i];
+			Quaternion const & d1 = dual1[i];
 
-		SIMDMatrixF4 RotationMatrixYawPitchRoll(float yaw, float pitch, float roll)
-		{
-			SIMDMatrixF4 const rotX(RotationX(pitch));
-			SIMDMatrixF4 const rotY(RotationY(yaw));
-			SIMDMatrixF4 const rotZ(RotationZ(roll));
-			return rotZ * rotX * rotY;
-		}
+			float const dot = r0.x() * r1.x() + r0.y() * r1.y() + r0.z() * r1.z() + r0.w() * r1.w();
+			float const w0 = 1 - factors[i];
+			float const w1 = (dot < 0) ? -factors[i] : factors[i];
 
-		SIMDMatrixF4 RotationMatrixYawPitchRoll(SIMDVectorF4 const & ang)
-		{
-			return RotationMatrixYawPitchRoll(GetX(ang), GetY(ang), GetZ(ang));
-		}
+			Quaternion real(r0.x() * w0 + r1.x() * w1, r0.y() * w0 + r1.y() * w1,
+				r0.z() * w0 + r1.z() * w1, r0.w() * w0 + r1.w() * w1);
+			Quaternion dual(d0.x() * w0 + d1.x() * w1, d0.y() * w0 + d1.y() * w1,
+				d0.z() * w0 + d1.z() * w1, d0.w() * w0 + d1.w() * w1);
 
-		SIMDMatrixF4 Scaling(float sx, float sy, float sz)
-		{
-			return SIMDMatrixF4(
-				sx, 0, 0, 0,
-				0, sy, 0, 0,
-				0, 0, sz, 0,
-				0,	0,	0,	1);
+			float const inv_len = 1 / std::sqrt(real.x() * real.x() + real.y() * real.y() + real.z() * real.z() + real.w() * real.w());
+			out_real[i] = Quaternion(real.x() * inv_len, real.y() * inv_len, real.z() * inv_len, real.w() * inv_len);
+			out_dual[i] = Quaternion(dual.x() * inv_len, dual.y() * inv_len, dual.z() * inv_len, dual.w() * inv_len);
 		}
+	}
 
-		SIMDMatrixF4 Scaling(SIMDVectorF4 const & s)
-		{
-			return Scaling(GetX(s), GetY(s), GetZ(s));
-		}
+	bool IsAffine(float4x4 const & mat)
+	{
+		return (mat(0, 3) == 0) && (mat(1, 3) == 0) && (mat(2, 3) == 0) && (mat(3, 3) == 1);
+	}
 
-		SIMDMatrixF4 Shadow(SIMDVectorF4 const & l, SIMDVectorF4 const & p)
-		{
-			SIMDVectorF4 const v = -l;
-			SIMDVectorF4 const np = NormalizePlane(p);
-			float const d = -GetX(DotPlane(np, v));
-
-			return SIMDMatrixF4(
-				GetX(np) * GetX(v) + d, GetX(np) * GetY(v),     GetX(np) * GetZ(v),     GetX(np) * GetW(v),
-				GetY(np) * GetX(v),     GetY(np) * GetY(v) + d, GetY(np) * GetZ(v),     GetY(np) * GetW(v),
-				GetZ(np) * GetX(v),     GetZ(np) * GetY(v),     GetZ(np) * GetZ(v) + d, GetZ(np) * GetW(v),
-				GetW(np) * GetX(v),     GetW(np) * GetY(v),     GetW(np) * GetZ(v),     GetW(np) * GetW(v) + d);
-		}
+#if defined(SIMD_MATH_SSE)
+	// SSE
 
-		SIMDMatrixF4 QuatToMatrix(SIMDVectorF4 const & quat)
-		{
-			// calculate coefficients
-			float const x2 = GetX(quat) + GetX(quat);
-			float const y2 = GetY(quat) + GetY(quat);
-			float const z2 = GetZ(quat) + GetZ(quat);
-
-			float const xx2 = GetX(quat) * x2, xy2 = GetX(quat) * y2, xz2 = GetX(quat) * z2;
-			float const yy2 = GetY(quat) * y2, yz2 = GetY(quat) * z2, zz2 = GetZ(quat) * z2;
-			float const wx2 = GetW(quat) * x2, wy2 = GetW(quat) * y2, wz2 = GetW(quat) * z2;
-
-			return SIMDMatrixF4(
-				1 - yy2 - zz2, xy2 + wz2, xz2 - wy2, 0,
-				xy2 - wz2, 1 - xx2 - zz2, yz2 + wx2, 0,
-				xz2 + wy2, yz2 - wx2, 1 - xx2 - yy2, 0,
-				0, 0, 0, 1);
-		}
+	__m128 AbsSSE(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
 
-		SIMDMatrixF4 Translation(float x, float y, float z)
-		{
-			return SIMDMatrixF4(
-				1, 0, 0, 0,
-				0, 1, 0, 0,
-				0, 0, 1, 0,
-				x, y, z, 1);
-		}
+	// xyz * (1 / w), or 0 where w is 0, as in MathLib::transform_coord
+	__m128 DivideByWSSE(__m128 v, __m128 w)
+	{
+		__m128 const not_zero = _mm_cmpgt_ps(AbsSSE(w), _mm_set1_ps(std::numeric_limits<float>::epsilon()));
+		return _mm_and_ps(_mm_mul_ps(v, _mm_div_ps(_mm_set1_ps(1), w)), not_zero);
+	}
 
-		SIMDMatrixF4 Translation(SIMDVectorF4 const & pos)
-		{
-			return Translation(GetX(pos), GetY(pos), GetZ(pos));
-		}
+	void TransformCoordVector3SSE(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		__m128 const m00 = _mm_set1_ps(mat(0, 0)), m01 = _mm_set1_ps(mat(0, 1)), m02 = _mm_set1_ps(mat(0, 2)), m03 = _mm_set1_ps(mat(0, 3));
+		__m128 const m10 = _mm_set1_ps(mat(1, 0)), m11 = _mm_set1_ps(mat(1, 1)), m12 = _mm_set1_ps(mat(1, 2)), m13 = _mm_set1_ps(mat(1, 3));
+		__m128 const m20 = _mm_set1_ps(mat(2, 0)), m21 = _mm_set1_ps(mat(2, 1)), m22 = _mm_set1_ps(mat(2, 2)), m23 = _mm_set1_ps(mat(2, 3));
+		__m128 const m30 = _mm_set1_ps(mat(3, 0)), m31 = _mm_set1_ps(mat(3, 1)), m32 = _mm_set1_ps(mat(3, 2)), m33 = _mm_set1_ps(mat(3, 3));
+
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
+		{
+			float const * src = &in[i].x();
+			__m128 const a = _mm_loadu_ps(src + 0);
+			__m128 const b = _mm_loadu_ps(src + 4);
+			__m128 const c = _mm_loadu_ps(src + 8);
+
+			__m128 const x = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 0)),
+				_mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+			__m128 const y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+				_mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 const z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+				_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+			__m128 tx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)), m30);
+			__m128 ty = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)), m31);
+			__m128 tz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22)), m32);
+			__m128 const tw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m03), _mm_mul_ps(y, m13)), _mm_mul_ps(z, m23)), m33);
+			tx = DivideByWSSE(tx, tw);
+			ty = DivideByWSSE(ty, tw);
+			tz = DivideByWSSE(tz, tw);
+
+			__m128 const xy_lo = _mm_unpacklo_ps(tx, ty);
+			__m128 const xy_hi = _mm_unpackhi_ps(tx, ty);
+			float* dst = &out[i].x();
+			_mm_storeu_ps(dst + 0, _mm_shuffle_ps(xy_lo, _mm_shuffle_ps(tz, tx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps(dst + 4, _mm_shuffle_ps(_mm_shuffle_ps(ty, tz, _MM_SHUFFLE(1, 1, 1, 1)), xy_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+			_mm_storeu_ps(dst + 8, _mm_shuffle_ps(_mm_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 3, 2, 2)),
+				_mm_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+
+		TransformCoordVector3General(out + i, in + i, num - i, mat);
+	}
 
-		SIMDMatrixF4 Transpose(SIMDMatrixF4 const & rhs)
-		{
-#if defined(SIMD_MATH_SSE)
-			SIMDVectorF4 r0;
-			SIMDVectorF4 r1;
-			SIMDVectorF4 r2;
-			SIMDVectorF4 r3;
-			r0.Vec() = rhs.Row(0).Vec();
-			r1.Vec() = rhs.Row(1).Vec();
-			r2.Vec() = rhs.Row(2).Vec();
-			r3.Vec() = rhs.Row(3).Vec();
-			_MM_TRANSPOSE4_PS(r0.Vec(), r1.Vec(), r2.Vec(), r3.Vec());
-			return SIMDMatrixF4(r0, r1, r2, r3);
-#else
-			V4TYPE const & r0 = rhs.Row(0).Vec();
-			V4TYPE const & r1 = rhs.Row(1).Vec();
-			V4TYPE const & r2 = rhs.Row(2).Vec();
-			V4TYPE const & r3 = rhs.Row(3).Vec();
-			return SIMDMatrixF4(
-				r0[0], r1[0], r2[0], r3[0],
-				r0[1], r1[1], r2[1], r3[1],
-				r0[2], r1[2], r2[2], r3[2],
-				r0[3], r1[3], r2[3], r3[3]);
-#endif
-		}
+	void TransformAABBoxSSE(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		__m128 const r0 = _mm_loadu_ps(&mat(0, 0));
+		__m128 const r1 = _mm_loadu_ps(&mat(1, 0));
+		__m128 const r2 = _mm_loadu_ps(&mat(2, 0));
+		__m128 const r3 = _mm_loadu_ps(&mat(3, 0));
+		bool const affine = IsAffine(mat);
 
-		SIMDMatrixF4 LHToRH(SIMDMatrixF4 const & rhs)
-		{
-			SIMDMatrixF4 ret = rhs;
-			ret.Row(2, -ret.Row(2));
-			return ret;
-		}
+		BOOST_ASSERT((num == 0) || (&in[0].Max().x() == &in[0].Min().x() + 3));
 
-		SIMDMatrixF4 RHToLH(SIMDMatrixF4 const & rhs)
+		for (size_t i = 0; i < num; ++ i)
 		{
-			return LHToRH(rhs);
-		}
+			// lo: min.x min.y min.z max.x, hi: min.z max.x max.y max.z
+			float const * src = &in[i].Min().x();
+			__m128 const lo = _mm_loadu_ps(src + 0);
+			__m128 const hi = _mm_loadu_ps(src + 2);
 
-		void Decompose(SIMDVectorF4& scale, SIMDVectorF4& rot, SIMDVectorF4& trans, SIMDMatrixF4 const & rhs)
-		{
-			scale = SetVector(sqrt(rhs(0, 0) * rhs(0, 0) + rhs(0, 1) * rhs(0, 1) + rhs(0, 2) * rhs(0, 2)),
-				sqrt(rhs(1, 0) * rhs(1, 0) + rhs(1, 1) * rhs(1, 1) + rhs(1, 2) * rhs(1, 2)),
-				sqrt(rhs(2, 0) * rhs(2, 0) + rhs(2, 1) * rhs(2, 1) + rhs(2, 2) * rhs(2, 2)),
-				1);
-
-			trans = SetVector(rhs(3, 0), rhs(3, 1), rhs(3, 2), 0);
-
-			SIMDMatrixF4 rot_mat;
-			rot_mat.Set(0, 0, rhs(0, 0) / GetX(scale));
-			rot_mat.Set(0, 1, rhs(0, 1) / GetX(scale));
-			rot_mat.Set(0, 2, rhs(0, 2) / GetX(scale));
-			rot_mat.Set(0, 3, 0);
-			rot_mat.Set(1, 0, rhs(1, 0) / GetY(scale));
-			rot_mat.Set(1, 1, rhs(1, 1) / GetY(scale));
-			rot_mat.Set(1, 2, rhs(1, 2) / GetY(scale));
-			rot_mat.Set(1, 3, 0);
-			rot_mat.Set(2, 0, rhs(2, 0) / GetZ(scale));
-			rot_mat.Set(2, 1, rhs(2, 1) / GetZ(scale));
-			rot_mat.Set(2, 2, rhs(2, 2) / GetZ(scale));
-			rot_mat.Set(2, 3, 0);
-			rot_mat.Set(3, 0, 0);
-			rot_mat.Set(3, 1, 0);
-			rot_mat.Set(3, 2, 0);
-			rot_mat.Set(3, 3, 1);
-			rot = ToQuaternion(rot_mat);
-		}
+			__m128 const x0 = _mm_mul_ps(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+			__m128 const x1 = _mm_mul_ps(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(3, 3, 3, 3)), r0);
+			__m128 const y0 = _mm_mul_ps(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 1, 1, 1)), r1);
+			__m128 const y1 = _mm_mul_ps(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 2, 2, 2)), r1);
+			__m128 const z0 = _mm_mul_ps(_mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 2, 2, 2)), r2);
+			__m128 const z1 = _mm_mul_ps(_mm_shuffle_ps(hi, hi, _MM_SHUFFLE(3, 3, 3, 3)), r2);
 
-		SIMDMatrixF4 Transformation(SIMDVectorF4 const * scaling_center, SIMDVectorF4 const * scaling_rotation, SIMDVectorF4 const * scale,
-			SIMDVectorF4 const * rotation_center, SIMDVectorF4 const * rotation, SIMDVectorF4 const * trans)
-		{
-			SIMDVectorF4 psc, prc, pt;
-			if (scaling_center)
-			{
-				psc = *scaling_center;
-			}
-			else
-			{
-				psc = SIMDVectorF4::Zero();
-			}
-			if (rotation_center)
-			{
-				prc = *rotation_center;
-			}
-			else
-			{
-				prc = SIMDVectorF4::Zero();
-			}
-			if (trans)
+			__m128 const xy[] = { _mm_add_ps(x0, y0), _mm_add_ps(x1, y0), _mm_add_ps(x0, y1), _mm_add_ps(x1, y1) };
+			__m128 corners[8];
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				pt = *trans;
+				corners[j * 2 + 0] = _mm_add_ps(_mm_add_ps(xy[j], z0), r3);
+				corners[j * 2 + 1] = _mm_add_ps(_mm_add_ps(xy[j], z1), r3);
 			}
-			else
+			if (!affine)
 			{
-				pt = SIMDVectorF4::Zero();
+				for (size_t j = 0; j < 8; ++ j)
+				{
+					corners[j] = DivideByWSSE(corners[j], _mm_shuffle_ps(corners[j], corners[j], _MM_SHUFFLE(3, 3, 3, 3)));
+				}
 			}
 
-			SIMDMatrixF4 m1, m2, m3, m4, m5, m6, m7;
-			m1 = Translation(-psc);
-			if (scaling_rotation)
-			{
-				m4 = QuatToMatrix(*scaling_rotation);
-				m2 = Inverse(m4);
-			}
-			else
-			{
-				m2 = m4 = SIMDMatrixF4::Identity();
-			}
-			if (scale)
-			{
-				m3 = Scaling(*scale);
-			}
-			else
-			{
-				m3 = SIMDMatrixF4::Identity();
-			}
-			if (rotation)
-			{
-				m6 = QuatToMatrix(*rotation);
-			}
-			else
+			__m128 min_v = corners[0];
+			__m128 max_v = corners[0];
+			for (size_t j = 1; j < 8; ++ j)
 			{
-				m6 = SIMDMatrixF4::Identity();
+				min_v = _mm_min_ps(min_v, corners[j]);
+				max_v = _mm_max_ps(max_v, corners[j]);
 			}
-			m5 = Translation(psc - prc);
-			m7 = Translation(prc + pt);
 
-			return m1 * m2 * m3 * m4 * m5 * m6 * m7;
+			float min_f[4];
+			float max_f[4];
+			_mm_storeu_ps(min_f, min_v);
+			_mm_storeu_ps(max_f, max_v);
+			out[i] = AABBox(float3(min_f[0], min_f[1], min_f[2]), float3(max_f[0], max_f[1], max_f[2]));
 		}
+	}
 
-		// Quaternion
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 Conjugate(SIMDVectorF4 const & rhs)
-		{
-			return SetVector(-GetX(rhs), -GetY(rhs), -GetZ(rhs), GetW(rhs));
-		}
+	// Same operation order as MathLib::mul
+	void MultiplyQuatSSE(__m128& x, __m128& y, __m128& z, __m128& w,
+		__m128 lx, __m128 ly, __m128 lz, __m128 lw, __m128 rx, __m128 ry, __m128 rz, __m128 rw)
+	{
+		x = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(lx, rw), _mm_mul_ps(ly, rz)), _mm_mul_ps(lz, ry)), _mm_mul_ps(lw, rx));
+		y = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(lx, rz), _mm_mul_ps(ly, rw)), _mm_mul_ps(lz, rx)), _mm_mul_ps(lw, ry));
+		z = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(ly, rx), _mm_mul_ps(lx, ry)), _mm_mul_ps(lz, rw)), _mm_mul_ps(lw, rz));
+		w = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(lw, rw), _mm_mul_ps(lx, rx)), _mm_mul_ps(ly, ry)), _mm_mul_ps(lz, rz));
+	}
 
-		SIMDVectorF4 AxisToAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to)
-		{
-			SIMDVectorF4 const a = NormalizeVector3(from);
-			SIMDVectorF4 const b = NormalizeVector3(to);
-			return UnitAxisToUnitAxis(a, b);
-		}
+	void LoadQuatsSSE(__m128& x, __m128& y, __m128& z, __m128& w, Quaternion const * q)
+	{
+		x = _mm_loadu_ps(&q[0].x());
+		y = _mm_loadu_ps(&q[1].x());
+		z = _mm_loadu_ps(&q[2].x());
+		w = _mm_loadu_ps(&q[3].x());
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+	}
 
-		SIMDVectorF4 UnitAxisToUnitAxis(SIMDVectorF4 const & from, SIMDVectorF4 const & to)
-		{
-			float const cos_theta = GetX(DotVector3(from, to));
-			if (MathLib::equal(cos_theta, 1.0f))
-			{
-				return SetVector(0, 0, 0, 1);
-			}
-			else
-			{
-				if (MathLib::equal(cos_theta, -1.0f))
-				{
-					return SetVector(1, 0, 0, 0);
-				}
-				else
-				{
-					// From http://lolengine.net/blog/2013/09/18/beautiful-maths-quaternion-from-vectors
+	void StoreQuatsSSE(Quaternion* q, __m128 x, __m128 y, __m128 z, __m128 w)
+	{
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&q[0].x(), x);
+		_mm_storeu_ps(&q[1].x(), y);
+		_mm_storeu_ps(&q[2].x(), z);
+		_mm_storeu_ps(&q[3].x(), w);
+	}
 
-					SIMDVectorF4 const w = CrossVector3(from, to);
-					return NormalizeVector4(SetVector(GetX(w), GetY(w), GetZ(w), 1 + cos_theta));
-				}
-			}
-		}
+	void MultiplyDualQuatSSE(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * lhs_real, Quaternion const * lhs_dual,
+		Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
+		{
+			__m128 lrx, lry, lrz, lrw;
+			__m128 ldx, ldy, ldz, ldw;
+			__m128 rrx, rry, rrz, rrw;
+			__m128 rdx, rdy, rdz, rdw;
+			LoadQuatsSSE(lrx, lry, lrz, lrw, lhs_real + i);
+			LoadQuatsSSE(ldx, ldy, ldz, ldw, lhs_dual + i);
+			LoadQuatsSSE(rrx, rry, rrz, rrw, rhs_real + i);
+			LoadQuatsSSE(rdx, rdy, rdz, rdw, rhs_dual + i);
+
+			__m128 x, y, z, w;
+			MultiplyQuatSSE(x, y, z, w, lrx, lry, lrz, lrw, rrx, rry, rrz, rrw);
+			StoreQuatsSSE(out_real + i, x, y, z, w);
+
+			__m128 x0, y0, z0, w0;
+			__m128 x1, y1, z1, w1;
+			MultiplyQuatSSE(x0, y0, z0, w0, lrx, lry, lrz, lrw, rdx, rdy, rdz, rdw);
+			MultiplyQuatSSE(x1, y1, z1, w1, ldx, ldy, ldz, ldw, rrx, rry, rrz, rrw);
+			StoreQuatsSSE(out_dual + i, _mm_add_ps(x0, x1), _mm_add_ps(y0, y1), _mm_add_ps(z0, z1), _mm_add_ps(w0, w1));
+		}
+
+		MultiplyDualQuatGeneral(out_real + i, out_dual + i, lhs_real + i, lhs_dual + i, rhs_real + i, rhs_dual + i, num - i);
+	}
 
-		SIMDVectorF4 BaryCentricQuat(SIMDVectorF4 const & q1, SIMDVectorF4 const & q2, SIMDVectorF4 const & q3,
-			float f, float g)
+	void BlendDualQuatSSE(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * real0, Quaternion const * dual0,
+		Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
 		{
-			SIMDVectorF4 ret;
-			float const s = f + g;
-			if (s != 0)
+			__m128 r0[4], d0[4], r1[4], d1[4];
+			LoadQuatsSSE(r0[0], r0[1], r0[2], r0[3], real0 + i);
+			LoadQuatsSSE(d0[0], d0[1], d0[2], d0[3], dual0 + i);
+			LoadQuatsSSE(r1[0], r1[1], r1[2], r1[3], real1 + i);
+			LoadQuatsSSE(d1[0], d1[1], d1[2], d1[3], dual1 + i);
+
+			__m128 const dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r0[0], r1[0]), _mm_mul_ps(r0[1], r1[1])),
+				_mm_mul_ps(r0[2], r1[2])), _mm_mul_ps(r0[3], r1[3]));
+			__m128 const t = _mm_loadu_ps(factors + i);
+			__m128 const w0 = _mm_sub_ps(_mm_set1_ps(1), t);
+			__m128 const w1 = _mm_xor_ps(t, _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.0f)));
+
+			__m128 real[4], dual[4];
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				ret = Slerp(Slerp(q1, q2, s), Slerp(q1, q3, s), g / s);
+				real[j] = _mm_add_ps(_mm_mul_ps(r0[j], w0), _mm_mul_ps(r1[j], w1));
+				dual[j] = _mm_add_ps(_mm_mul_ps(d0[j], w0), _mm_mul_ps(d1[j], w1));
 			}
-			else
+
+			__m128 const len_sq = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(real[0], real[0]), _mm_mul_ps(real[1], real[1])),
+				_mm_mul_ps(real[2], real[2])), _mm_mul_ps(real[3], real[3]));
+			__m128 const inv_len = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(len_sq));
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				ret = q1;
+				real[j] = _mm_mul_ps(real[j], inv_len);
+				dual[j] = _mm_mul_ps(dual[j], inv_len);
 			}
-			return ret;
-		}
 
-		SIMDVectorF4 Exp(SIMDVectorF4 const & rhs)
-		{
-			float const theta = GetX(LengthVector3(rhs));
-			SIMDVectorF4 ret = NormalizeVector3(rhs) * sin(theta);
-			ret = SetW(ret, cos(theta));
-			return ret;
+			StoreQuatsSSE(out_real + i, real[0], real[1], real[2], real[3]);
+			StoreQuatsSSE(out_dual + i, dual[0], dual[1], dual[2], dual[3]);
 		}
 
-		SIMDVectorF4 Ln(SIMDVectorF4 const & rhs)
-		{
-			float const theta_2 = acos(GetW(rhs));
-			SIMDVectorF4 ret = NormalizeVector3(rhs) * (theta_2 + theta_2);
-			ret = SetW(ret, 0);
-			return ret;
-		}
+		BlendDualQuatGeneral(out_real + i, out_dual + i, real0 + i, dual0 + i, real1 + i, dual1 + i, factors + i, num - i);
+	}
 
-		SIMDVectorF4 Inverse(SIMDVectorF4 const & rhs)
-		{
-			SIMDVectorF4 const inv = Divide(SetVector(1), LengthVector4(rhs));
-			return SetVector(-GetX(rhs), -GetY(rhs), -GetZ(rhs), GetW(rhs)) * inv;
-		}
+	// AVX2
+	// Two SSE-sized groups go side by side in the 128-bit lanes, so the in-lane shuffles of the SSE kernels carry over.
 
-		SIMDVectorF4 MultiplyQuat(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			return SetVector(
-				GetX(lhs) * GetW(rhs) - GetY(lhs) * GetZ(rhs) + GetZ(lhs) * GetY(rhs) + GetW(lhs) * GetX(rhs),
-				GetX(lhs) * GetZ(rhs) + GetY(lhs) * GetW(rhs) - GetZ(lhs) * GetX(rhs) + GetW(lhs) * GetY(rhs),
-				GetY(lhs) * GetX(rhs) - GetX(lhs) * GetY(rhs) + GetZ(lhs) * GetW(rhs) + GetW(lhs) * GetZ(rhs),
-				GetW(lhs) * GetW(rhs) - GetX(lhs) * GetX(rhs) - GetY(lhs) * GetY(rhs) - GetZ(lhs) * GetZ(rhs));
-		}
+	KLAYGE_TARGET_AVX2 __m256 LoadLanesAVX2(float const * lo, float const * hi)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+	}
 
-		SIMDVectorF4 RotationAxis(SIMDVectorF4 const & v, float angle)
-		{
-			float sa, ca;
-			MathLib::sincos(angle * 0.5f, sa, ca);
+	KLAYGE_TARGET_AVX2 void StoreLanesAVX2(float* lo, float* hi, __m256 v)
+	{
+		_mm_storeu_ps(lo, _mm256_castps256_ps128(v));
+		_mm_storeu_ps(hi, _mm256_extractf128_ps(v, 1));
+	}
 
-			SIMDVectorF4 ret;
-			if (MathLib::equal(GetX(LengthSqVector3(v)), 0.0f))
-			{
-				ret = SetVector(sa, sa, sa, ca);
-			}
-			else
+	KLAYGE_TARGET_AVX2 __m256 DivideByWAVX2(__m256 v, __m256 w)
+	{
+		__m256 const abs_w = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), w);
+		__m256 const not_zero = _mm256_cmp_ps(abs_w, _mm256_set1_ps(std::numeric_limits<float>::epsilon()), _CMP_GT_OQ);
+		return _mm256_and_ps(_mm256_mul_ps(v, _mm256_div_ps(_mm256_set1_ps(1), w)), not_zero);
+	}
+
+	KLAYGE_TARGET_AVX2 void TransformCoordVector3AVX2(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		__m256 m[4][4];
+		for (int r = 0; r < 4; ++ r)
+		{
+			for (int c = 0; c < 4; ++ c)
 			{
-				ret = NormalizeVector3(v) * sa;
-				ret = SetW(ret, ca);
+				m[r][c] = _mm256_set1_ps(mat(r, c));
 			}
-			return ret;
 		}
 
-		SIMDVectorF4 RotationQuatYawPitchRoll(float yaw, float pitch, float roll)
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
 		{
-			float const ang_x = pitch / 2;
-			float const ang_y = yaw / 2;
-			float const ang_z = roll / 2;
-			float sx, sy, sz;
-			float cx, cy, cz;
-			MathLib::sincos(ang_x, sx, cx);
-			MathLib::sincos(ang_y, sy, cy);
-			MathLib::sincos(ang_z, sz, cz);
-
-			return SetVector(
-				sx * cy * cz + cx * sy * sz,
-				cx * sy * cz - sx * cy * sz,
-				cx * cy * sz - sx * sy * cz,
-				sx * sy * sz + cx * cy * cz);
-		}
+			float const * src = &in[i].x();
+			__m256 const a = LoadLanesAVX2(src + 0, src + 12);
+			__m256 const b = LoadLanesAVX2(src + 4, src + 16);
+			__m256 const c = LoadLanesAVX2(src + 8, src + 20);
 
-		SIMDVectorF4 RotationQuatYawPitchRoll(SIMDVectorF4 const & ang)
-		{
-			return RotationQuatYawPitchRoll(GetX(ang), GetY(ang), GetZ(ang));
-		}
+			__m256 const x = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 0)),
+				_mm256_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+			__m256 const y = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+				_mm256_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 const z = _mm256_shuffle_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+				_mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
 
-		// From http://www.euclideanspace.com/maths/geometry/rotations/conversions/quaternionToEuler/index.htm
-		void ToYawPitchRoll(float& yaw, float& pitch, float& roll, SIMDVectorF4 const & quat)
-		{
-			float const sqx = GetX(quat) * GetX(quat);
-			float const sqy = GetY(quat) * GetY(quat);
-			float const sqz = GetZ(quat) * GetZ(quat);
-			float const sqw = GetW(quat) * GetW(quat);
-			float const unit = sqx + sqy + sqz + sqw;
-			float const test = GetW(quat) * GetX(quat) + GetY(quat) * GetZ(quat);
-			if (test > 0.499f * unit)
+			__m256 t[4];
+			for (int col = 0; col < 4; ++ col)
 			{
-				// singularity at north pole
-				yaw = 2 * atan2(GetZ(quat), GetW(quat));
-				pitch = PI / 2;
-				roll = 0;
+				t[col] = _mm256_add_ps(_mm256_fmadd_ps(z, m[2][col], _mm256_fmadd_ps(y, m[1][col], _mm256_mul_ps(x, m[0][col]))), m[3][col]);
 			}
-			else
-			{
-				if (test < -0.499f * unit)
-				{
-					// singularity at south pole
-					yaw = -2 * atan2(GetZ(quat), GetW(quat));
-					pitch = -PI / 2;
-					roll = 0;
-				}
-				else
+			__m256 const tx = DivideByWAVX2(t[0], t[3]);
+			__m256 const ty = DivideByWAVX2(t[1], t[3]);
+			__m256 const tz = DivideByWAVX2(t[2], t[3]);
+
+			__m256 const xy_lo = _mm256_unpacklo_ps(tx, ty);
+			__m256 const xy_hi = _mm256_unpackhi_ps(tx, ty);
+			float* dst = &out[i].x();
+			StoreLanesAVX2(dst + 0, dst + 12,
+				_mm256_shuffle_ps(xy_lo, _mm256_shuffle_ps(tz, tx, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+			StoreLanesAVX2(dst + 4, dst + 16,
+				_mm256_shuffle_ps(_mm256_shuffle_ps(ty, tz, _MM_SHUFFLE(1, 1, 1, 1)), xy_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+			StoreLanesAVX2(dst + 8, dst + 20, _mm256_shuffle_ps(_mm256_shuffle_ps(tz, tx, _MM_SHUFFLE(3, 3, 2, 2)),
+				_mm256_shuffle_ps(ty, tz, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+		}
+
+		TransformCoordVector3SSE(out + i, in + i, num - i, mat);
+	}
+
+	KLAYGE_TARGET_AVX2 void TransformAABBoxAVX2(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		__m256 const r0 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&mat(0, 0)));
+		__m256 const r1 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&mat(1, 0)));
+		__m256 const r2 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&mat(2, 0)));
+		__m256 const r3 = _mm256_broadcast_ps(reinterpret_cast<__m128 const *>(&mat(3, 0)));
+		bool const affine = IsAffine(mat);
+
+		BOOST_ASSERT((num == 0) || (&in[0].Max().x() == &in[0].Min().x() + 3));
+
+		for (size_t i = 0; i < num; ++ i)
+		{
+			// Both lanes: min.x min.y min.z max.x | min.z max.x max.y max.z
+			float const * src = &in[i].Min().x();
+			__m256 const lo_hi = LoadLanesAVX2(src + 0, src + 2);
+			__m256 const lo = _mm256_permute2f128_ps(lo_hi, lo_hi, 0x00);
+			__m256 const hi = _mm256_permute2f128_ps(lo_hi, lo_hi, 0x11);
+
+			// Low lane takes min.x, high lane takes max.x
+			__m256 const xr = _mm256_mul_ps(_mm256_blend_ps(_mm256_permute_ps(lo, _MM_SHUFFLE(0, 0, 0, 0)),
+				_mm256_permute_ps(hi, _MM_SHUFFLE(1, 1, 1, 1)), 0xF0), r0);
+			__m256 const y0 = _mm256_permute_ps(lo, _MM_SHUFFLE(1, 1, 1, 1));
+			__m256 const y1 = _mm256_permute_ps(hi, _MM_SHUFFLE(2, 2, 2, 2));
+			__m256 const z0 = _mm256_permute_ps(lo, _MM_SHUFFLE(2, 2, 2, 2));
+			__m256 const z1 = _mm256_permute_ps(hi, _MM_SHUFFLE(3, 3, 3, 3));
+
+			__m256 corners[4];
+			corners[0] = _mm256_add_ps(_mm256_fmadd_ps(z0, r2, _mm256_fmadd_ps(y0, r1, xr)), r3);
+			corners[1] = _mm256_add_ps(_mm256_fmadd_ps(z1, r2, _mm256_fmadd_ps(y0, r1, xr)), r3);
+			corners[2] = _mm256_add_ps(_mm256_fmadd_ps(z0, r2, _mm256_fmadd_ps(y1, r1, xr)), r3);
+			corners[3] = _mm256_add_ps(_mm256_fmadd_ps(z1, r2, _mm256_fmadd_ps(y1, r1, xr)), r3);
+			if (!affine)
+			{
+				for (size_t j = 0; j < 4; ++ j)
 				{
-					yaw = atan2(2 * (GetY(quat) * GetW(quat) - GetX(quat) * GetZ(quat)), -sqx - sqy + sqz + sqw);
-					pitch = asin(2 * test / unit);
-					roll = atan2(2 * (GetZ(quat) * GetW(quat) - GetX(quat) * GetY(quat)), -sqx + sqy - sqz + sqw);
+					corners[j] = DivideByWAVX2(corners[j], _mm256_permute_ps(corners[j], _MM_SHUFFLE(3, 3, 3, 3)));
 				}
 			}
-		}
 
-		void ToAxisAngle(SIMDVectorF4& vec, float& ang, SIMDVectorF4 const & quat)
-		{
-			float const tw = acos(GetW(quat));
-			float const stw = sin(tw);
+			__m256 const min_v = _mm256_min_ps(_mm256_min_ps(corners[0], corners[1]), _mm256_min_ps(corners[2], corners[3]));
+			__m256 const max_v = _mm256_max_ps(_mm256_max_ps(corners[0], corners[1]), _mm256_max_ps(corners[2], corners[3]));
 
-			ang = tw + tw;
-			vec = SetW(quat, 0);
-			if (!MathLib::equal(stw, 0.0f))
-			{
-				vec /= stw;
-			}
+			float min_f[4];
+			float max_f[4];
+			_mm_storeu_ps(min_f, _mm_min_ps(_mm256_castps256_ps128(min_v), _mm256_extractf128_ps(min_v, 1)));
+			_mm_storeu_ps(max_f, _mm_max_ps(_mm256_castps256_ps128(max_v), _mm256_extractf128_ps(max_v, 1)));
+			out[i] = AABBox(float3(min_f[0], min_f[1], min_f[2]), float3(max_f[0], max_f[1], max_f[2]));
 		}
+	}
 
-		SIMDVectorF4 ToQuaternion(SIMDMatrixF4 const & mat)
-		{
-			SIMDVectorF4 quat;
-			float s = 0;
-			float s2 = 0;
-			float const tr = mat(0, 0) + mat(1, 1) + mat(2, 2) + 1;
+	KLAYGE_TARGET_AVX2 void MultiplyQuatAVX2(__m256& x, __m256& y, __m256& z, __m256& w,
+		__m256 lx, __m256 ly, __m256 lz, __m256 lw, __m256 rx, __m256 ry, __m256 rz, __m256 rw)
+	{
+		x = _mm256_fmadd_ps(lw, rx, _mm256_fmadd_ps(lz, ry, _mm256_fnmadd_ps(ly, rz, _mm256_mul_ps(lx, rw))));
+		y = _mm256_fmadd_ps(lw, ry, _mm256_fnmadd_ps(lz, rx, _mm256_fmadd_ps(ly, rw, _mm256_mul_ps(lx, rz))));
+		z = _mm256_fmadd_ps(lw, rz, _mm256_fmadd_ps(lz, rw, _mm256_fnmadd_ps(lx, ry, _mm256_mul_ps(ly, rx))));
+		w = _mm256_fnmadd_ps(lz, rz, _mm256_fnmadd_ps(ly, ry, _mm256_fnmadd_ps(lx, rx, _mm256_mul_ps(lw, rw))));
+	}
 
-			// check the diagonal
-			if (tr > 1)
-			{
-				s = sqrt(tr);
-				s2 = 0.5f / s;
-				quat = SetVector(mat(1, 2) - mat(2, 1), mat(2, 0) - mat(0, 2),
-					mat(0, 1) - mat(1, 0), 0.5f) * SetVector(s2, s2, s2, s);
-			}
-			else
-			{
-				int max_i = 0;
-				float max_diag = mat(0, 0);
-				for (int i = 1; i < 3; ++ i)
-				{
-					if (mat(i, i) > max_diag)
-					{
-						max_i = i;
-						max_diag = mat(i, i);
-					}
-				}
+	// In-lane 4x4 transpose, the same steps as _MM_TRANSPOSE4_PS
+	KLAYGE_TARGET_AVX2 void Transpose4AVX2(__m256& a, __m256& b, __m256& c, __m256& d)
+	{
+		__m256 const t0 = _mm256_unpacklo_ps(a, b);
+		__m256 const t1 = _mm256_unpacklo_ps(c, d);
+		__m256 const t2 = _mm256_unpackhi_ps(a, b);
+		__m256 const t3 = _mm256_unpackhi_ps(c, d);
+		a = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+		b = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+		c = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		d = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	}
 
-				switch (max_i)
-				{
-				case 0:
-					s = sqrt((mat(0, 0) - (mat(1, 1) + mat(2, 2))) + 1);
-					s2 = MathLib::equal(s, 0.0f) ? s : 0.5f / s;
-
-					quat = SetVector(0.5f, mat(1, 0) + mat(0, 1), mat(2, 0) + mat(0, 2), mat(1, 2) - mat(2, 1))
-						* SetVector(s, s2, s2, s2);
-					break;
-
-				case 1:
-					s = sqrt((mat(1, 1) - (mat(2, 2) + mat(0, 0))) + 1);
-					s2 = MathLib::equal(s, 0.0f) ? s : 0.5f / s;
-
-					quat = SetVector(mat(0, 1) + mat(1, 0), 0.5f, mat(2, 1) + mat(1, 2), mat(2, 0) - mat(0, 2))
-						* SetVector(s2, s, s2, s2);
-					break;
-
-				case 2:
-				default:
-					s = sqrt((mat(2, 2) - (mat(0, 0) + mat(1, 1))) + 1);
-					s2 = MathLib::equal(s, 0.0f) ? s : 0.5f / s;
-
-					quat = SetVector(mat(0, 2) + mat(2, 0), mat(1, 2) + mat(2, 1), 0.5f, mat(0, 1) - mat(1, 0))
-						* SetVector(s2, s2, s, s2);
-					break;
-				}
-			}
+	KLAYGE_TARGET_AVX2 void LoadQuatsAVX2(__m256& x, __m256& y, __m256& z, __m256& w, Quaternion const * q)
+	{
+		x = LoadLanesAVX2(&q[0].x(), &q[4].x());
+		y = LoadLanesAVX2(&q[1].x(), &q[5].x());
+		z = LoadLanesAVX2(&q[2].x(), &q[6].x());
+		w = LoadLanesAVX2(&q[3].x(), &q[7].x());
+		Transpose4AVX2(x, y, z, w);
+	}
 
-			return NormalizeVector4(quat);
-		}
+	KLAYGE_TARGET_AVX2 void StoreQuatsAVX2(Quaternion* q, __m256 x, __m256 y, __m256 z, __m256 w)
+	{
+		Transpose4AVX2(x, y, z, w);
+		StoreLanesAVX2(&q[0].x(), &q[4].x(), x);
+		StoreLanesAVX2(&q[1].x(), &q[5].x(), y);
+		StoreLanesAVX2(&q[2].x(), &q[6].x(), z);
+		StoreLanesAVX2(&q[3].x(), &q[7].x(), w);
+	}
+
+	KLAYGE_TARGET_AVX2 void MultiplyDualQuatAVX2(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * lhs_real, Quaternion const * lhs_dual,
+		Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
+		{
+			__m256 lrx, lry, lrz, lrw;
+			__m256 ldx, ldy, ldz, ldw;
+			__m256 rrx, rry, rrz, rrw;
+			__m256 rdx, rdy, rdz, rdw;
+			LoadQuatsAVX2(lrx, lry, lrz, lrw, lhs_real + i);
+			LoadQuatsAVX2(ldx, ldy, ldz, ldw, lhs_dual + i);
+			LoadQuatsAVX2(rrx, rry, rrz, rrw, rhs_real + i);
+			LoadQuatsAVX2(rdx, rdy, rdz, rdw, rhs_dual + i);
+
+			__m256 x, y, z, w;
+			MultiplyQuatAVX2(x, y, z, w, lrx, lry, lrz, lrw, rrx, rry, rrz, rrw);
+			StoreQuatsAVX2(out_real + i, x, y, z, w);
+
+			__m256 x0, y0, z0, w0;
+			__m256 x1, y1, z1, w1;
+			MultiplyQuatAVX2(x0, y0, z0, w0, lrx, lry, lrz, lrw, rdx, rdy, rdz, rdw);
+			MultiplyQuatAVX2(x1, y1, z1, w1, ldx, ldy, ldz, ldw, rrx, rry, rrz, rrw);
+			StoreQuatsAVX2(out_dual + i, _mm256_add_ps(x0, x1), _mm256_add_ps(y0, y1), _mm256_add_ps(z0, z1), _mm256_add_ps(w0, w1));
+		}
+
+		MultiplyDualQuatSSE(out_real + i, out_dual + i, lhs_real + i, lhs_dual + i, rhs_real + i, rhs_dual + i, num - i);
+	}
 
-		SIMDVectorF4 ToQuaternion(SIMDVectorF4 const & tangent, SIMDVectorF4 const & binormal, SIMDVectorF4 const & normal, int bits)
+	KLAYGE_TARGET_AVX2 void BlendDualQuatAVX2(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * real0, Quaternion const * dual0,
+		Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 8 <= num; i += 8)
 		{
-			float k = 1;
-			if (GetX(DotVector3(binormal, CrossVector3(normal, tangent))) < 0)
-			{
-				k = -1;
-			}
+			__m256 r0[4], d0[4], r1[4], d1[4];
+			LoadQuatsAVX2(r0[0], r0[1], r0[2], r0[3], real0 + i);
+			LoadQuatsAVX2(d0[0], d0[1], d0[2], d0[3], dual0 + i);
+			LoadQuatsAVX2(r1[0], r1[1], r1[2], r1[3], real1 + i);
+			LoadQuatsAVX2(d1[0], d1[1], d1[2], d1[3], dual1 + i);
 
-			SIMDMatrixF4 tangent_frame(GetX(tangent), GetY(tangent), GetZ(tangent), 0,
-				GetX(binormal), GetY(binormal), GetZ(binormal), 0,
-				GetX(normal), GetY(normal), GetZ(normal), 0,
-				0, 0, 0, 1);
-			tangent_frame.Row(1, tangent_frame.Row(1) * k);
-			SIMDVectorF4 tangent_quat = ToQuaternion(tangent_frame);
-			if (GetW(tangent_quat) < 0)
-			{
-				tangent_quat = -tangent_quat;
-			}
-			if (bits > 0)
+			__m256 const dot = _mm256_fmadd_ps(r0[3], r1[3], _mm256_fmadd_ps(r0[2], r1[2],
+				_mm256_fmadd_ps(r0[1], r1[1], _mm256_mul_ps(r0[0], r1[0]))));
+			__m256 const t = _mm256_loadu_ps(factors + i);
+			__m256 const w0 = _mm256_sub_ps(_mm256_set1_ps(1), t);
+			__m256 const w1 = _mm256_xor_ps(t,
+				_mm256_and_ps(_mm256_cmp_ps(dot, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_set1_ps(-0.0f)));
+
+			__m256 real[4], dual[4];
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				float const bias = 1.0f / ((1UL << (bits - 1)) - 1);
-				if (GetW(tangent_quat) < bias)
-				{
-					float const factor = sqrt(1 - bias * bias);
-					tangent_quat *= factor;
-					tangent_quat = SetW(tangent_quat, bias);
-				}
+				real[j] = _mm256_fmadd_ps(r1[j], w1, _mm256_mul_ps(r0[j], w0));
+				dual[j] = _mm256_fmadd_ps(d1[j], w1, _mm256_mul_ps(d0[j], w0));
 			}
-			if (k < 0)
+
+			__m256 const len_sq = _mm256_fmadd_ps(real[3], real[3], _mm256_fmadd_ps(real[2], real[2],
+				_mm256_fmadd_ps(real[1], real[1], _mm256_mul_ps(real[0], real[0]))));
+			__m256 const inv_len = _mm256_div_ps(_mm256_set1_ps(1), _mm256_sqrt_ps(len_sq));
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				tangent_quat = -tangent_quat;
+				real[j] = _mm256_mul_ps(real[j], inv_len);
+				dual[j] = _mm256_mul_ps(dual[j], inv_len);
 			}
 
-			return tangent_quat;
+			StoreQuatsAVX2(out_real + i, real[0], real[1], real[2], real[3]);
+			StoreQuatsAVX2(out_dual + i, dual[0], dual[1], dual[2], dual[3]);
 		}
 
-		SIMDVectorF4 Slerp(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs, float s)
-		{
-			float scale0 = 0;
-			float scale1 = 0;
+		BlendDualQuatSSE(out_real + i, out_dual + i, real0 + i, dual0 + i, real1 + i, dual1 + i, factors + i, num - i);
+	}
+#elif defined(SIMD_MATH_NEON)
+	// NEON
 
-			// DOT the quats to get the cosine of the angle between them
-			float cosom = GetX(DotVector4(lhs, rhs));
+	// xyz * (1 / w), or 0 where w is 0, as in MathLib::transform_coord
+	float32x4_t DivideByWNEON(float32x4_t v, float32x4_t w)
+	{
+		uint32x4_t const not_zero = vcagtq_f32(w, vdupq_n_f32(std::numeric_limits<float>::epsilon()));
+#if defined(KLAYGE_CPU_ARM64)
+		float32x4_t const inv_w = vdivq_f32(vdupq_n_f32(1), w);
+#else
+		float32x4_t inv_w = vrecpeq_f32(w);
+		inv_w = vmulq_f32(vrecpsq_f32(w, inv_w), inv_w);
+		inv_w = vmulq_f32(vrecpsq_f32(w, inv_w), inv_w);
+#endif
+		return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(v, inv_w)), not_zero));
+	}
 
-			float dir = 1;
-			if (cosom < 0)
-			{
-				dir = -1;
-				cosom = -cosom;
-			}
+	float32x4_t RecipSqrtNEON(float32x4_t v)
+	{
+#if defined(KLAYGE_CPU_ARM64)
+		return vdivq_f32(vdupq_n_f32(1), vsqrtq_f32(v));
+#else
+		float32x4_t r = vrsqrteq_f32(v);
+		r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(v, r), r), r);
+		r = vmulq_f32(vrsqrtsq_f32(vmulq_f32(v, r), r), r);
+		return r;
+#endif
+	}
 
-			// make sure they are different enough to avoid a divide by 0
-			if (cosom < 1 - std::numeric_limits<float>::epsilon())
+	void TransformCoordVector3NEON(float3* out, float3 const * in, size_t num, float4x4 const & mat)
+	{
+		float32x4_t m[4][4];
+		for (int r = 0; r < 4; ++ r)
+		{
+			for (int c = 0; c < 4; ++ c)
 			{
-				// SLERP away
-				float const omega = acos(cosom);
-				float const isinom = 1 / sin(omega);
-				scale0 = sin((1 - s) * omega) * isinom;
-				scale1 = sin(s * omega) * isinom;
+				m[r][c] = vdupq_n_f32(mat(r, c));
 			}
-			else
+		}
+
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
+		{
+			float32x4x3_t const xyz = vld3q_f32(&in[i].x());
+
+			float32x4_t t[4];
+			for (int col = 0; col < 4; ++ col)
 			{
-				// LERP is good enough at this distance
-				scale0 = 1 - s;
-				scale1 = s;
+				t[col] = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(xyz.val[0], m[0][col]), vmulq_f32(xyz.val[1], m[1][col])),
+					vmulq_f32(xyz.val[2], m[2][col])), m[3][col]);
 			}
 
-			// Compute the result
-			return scale0 * lhs + dir * scale1 * rhs;
+			float32x4x3_t result;
+			result.val[0] = DivideByWNEON(t[0], t[3]);
+			result.val[1] = DivideByWNEON(t[1], t[3]);
+			result.val[2] = DivideByWNEON(t[2], t[3]);
+			vst3q_f32(&out[i].x(), result);
 		}
 
-		void SquadSetup(SIMDVectorF4& a, SIMDVectorF4& b, SIMDVectorF4& c,
-			SIMDVectorF4 const & q0, SIMDVectorF4 const & q1, SIMDVectorF4 const & q2,
-			SIMDVectorF4 const & q3)
+		TransformCoordVector3General(out + i, in + i, num - i, mat);
+	}
+
+	void TransformAABBoxNEON(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
+	{
+		float32x4_t const r0 = vld1q_f32(&mat(0, 0));
+		float32x4_t const r1 = vld1q_f32(&mat(1, 0));
+		float32x4_t const r2 = vld1q_f32(&mat(2, 0));
+		float32x4_t const r3 = vld1q_f32(&mat(3, 0));
+		bool const affine = IsAffine(mat);
+
+		for (size_t i = 0; i < num; ++ i)
 		{
-			SIMDVectorF4 q, temp1, temp2, temp3;
+			float3 const & mn = in[i].Min();
+			float3 const & mx = in[i].Max();
 
-			if (GetX(DotVector4(q0, q1)) < 0)
-			{
-				temp2 = -q0;
-			}
-			else
-			{
-				temp2 = q0;
-			}
+			float32x4_t const x0 = vmulq_n_f32(r0, mn.x());
+			float32x4_t const x1 = vmulq_n_f32(r0, mx.x());
+			float32x4_t const y0 = vmulq_n_f32(r1, mn.y());
+			float32x4_t const y1 = vmulq_n_f32(r1, mx.y());
+			float32x4_t const z0 = vmulq_n_f32(r2, mn.z());
+			float32x4_t const z1 = vmulq_n_f32(r2, mx.z());
 
-			if (GetX(DotVector4(q1, q2)) < 0)
+			float32x4_t const xy[] = { vaddq_f32(x0, y0), vaddq_f32(x1, y0), vaddq_f32(x0, y1), vaddq_f32(x1, y1) };
+			float32x4_t corners[8];
+			for (size_t j = 0; j < 4; ++ j)
 			{
-				c = -q2;
+				corners[j * 2 + 0] = vaddq_f32(vaddq_f32(xy[j], z0), r3);
+				corners[j * 2 + 1] = vaddq_f32(vaddq_f32(xy[j], z1), r3);
 			}
-			else
+			if (!affine)
 			{
-				c = q2;
+				for (size_t j = 0; j < 8; ++ j)
+				{
+					corners[j] = DivideByWNEON(corners[j], vdupq_lane_f32(vget_high_f32(corners[j]), 1));
+				}
 			}
 
-			if (GetX(DotVector4(c, q3)) < 0)
-			{
-				temp3 = -q3;
-			}
-			else
+			float32x4_t min_v = corners[0];
+			float32x4_t max_v = corners[0];
+			for (size_t j = 1; j < 8; ++ j)
 			{
-				temp3 = q3;
+				min_v = vminq_f32(min_v, corners[j]);
+				max_v = vmaxq_f32(max_v, corners[j]);
 			}
 
-			temp1 = Inverse(q1);
-			temp2 = Ln(Multiply(temp1, temp2));
-			q = Ln(Multiply(temp1, c));
-			temp1 = temp2 + q;
-			temp1 = Exp(temp1 * -0.25f);
-			a = Multiply(q1, temp1);
-
-			temp1 = Inverse(c);
-			temp2 = Ln(Multiply(temp1, q1));
-			q = Ln(Multiply(temp1, temp3));
-			temp1 = temp2 + q;
-			temp1 = Exp(temp1 * -0.25f);
-			b = Multiply(c, temp1);
+			out[i] = AABBox(float3(vgetq_lane_f32(min_v, 0), vgetq_lane_f32(min_v, 1), vgetq_lane_f32(min_v, 2)),
+				float3(vgetq_lane_f32(max_v, 0), vgetq_lane_f32(max_v, 1), vgetq_lane_f32(max_v, 2)));
 		}
+	}
 
-		SIMDVectorF4 Squad(SIMDVectorF4 const & q1, SIMDVectorF4 const & a, SIMDVectorF4 const & b,
-			SIMDVectorF4 const & c, float t)
-		{
-			return Slerp(Slerp(q1, c, t), Slerp(a, b, t), 2 * t * (1 - t));
-		}
+	// Same operation order as MathLib::mul
+	float32x4x4_t MultiplyQuatNEON(float32x4x4_t const & lhs, float32x4x4_t const & rhs)
+	{
+		float32x4_t const lx = lhs.val[0], ly = lhs.val[1], lz = lhs.val[2], lw = lhs.val[3];
+		float32x4_t const rx = rhs.val[0], ry = rhs.val[1], rz = rhs.val[2], rw = rhs.val[3];
+
+		float32x4x4_t ret;
+		ret.val[0] = vaddq_f32(vaddq_f32(vsubq_f32(vmulq_f32(lx, rw), vmulq_f32(ly, rz)), vmulq_f32(lz, ry)), vmulq_f32(lw, rx));
+		ret.val[1] = vaddq_f32(vsubq_f32(vaddq_f32(vmulq_f32(lx, rz), vmulq_f32(ly, rw)), vmulq_f32(lz, rx)), vmulq_f32(lw, ry));
+		ret.val[2] = vaddq_f32(vaddq_f32(vsubq_f32(vmulq_f32(ly, rx), vmulq_f32(lx, ry)), vmulq_f32(lz, rw)), vmulq_f32(lw, rz));
+		ret.val[3] = vsubq_f32(vsubq_f32(vsubq_f32(vmulq_f32(lw, rw), vmulq_f32(lx, rx)), vmulq_f32(ly, ry)), vmulq_f32(lz, rz));
+		return ret;
+	}
 
-		// Plane
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 DotPlane(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+	void MultiplyDualQuatNEON(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * lhs_real, Quaternion const * lhs_dual,
+		Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
 		{
-			return DotVector4(lhs, rhs);
-		}
+			float32x4x4_t const lr = vld4q_f32(&lhs_real[i].x());
+			float32x4x4_t const ld = vld4q_f32(&lhs_dual[i].x());
+			float32x4x4_t const rr = vld4q_f32(&rhs_real[i].x());
+			float32x4x4_t const rd = vld4q_f32(&rhs_dual[i].x());
 
-		SIMDVectorF4 DotCoord(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			return DotVector4(lhs, SetW(rhs, 1));
-		}
+			float32x4x4_t const real = MultiplyQuatNEON(lr, rr);
+			float32x4x4_t const dual0 = MultiplyQuatNEON(lr, rd);
+			float32x4x4_t const dual1 = MultiplyQuatNEON(ld, rr);
+			float32x4x4_t dual;
+			for (int j = 0; j < 4; ++ j)
+			{
+				dual.val[j] = vaddq_f32(dual0.val[j], dual1.val[j]);
+			}
 
-		SIMDVectorF4 DotNormal(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
-		{
-			return DotVector4(lhs, SetW(rhs, 0));
+			vst4q_f32(&out_real[i].x(), real);
+			vst4q_f32(&out_dual[i].x(), dual);
 		}
 
-		SIMDVectorF4 FromPointNormal(SIMDVectorF4 const & point, SIMDVectorF4 const & normal)
-		{
-			return SetW(normal, -GetX(DotVector3(point, normal)));
-		}
+		MultiplyDualQuatGeneral(out_real + i, out_dual + i, lhs_real + i, lhs_dual + i, rhs_real + i, rhs_dual + i, num - i);
+	}
 
-		SIMDVectorF4 FromPoints(SIMDVectorF4 const & v0, SIMDVectorF4 const & v1, SIMDVectorF4 const & v2)
+	void BlendDualQuatNEON(Quaternion* out_real, Quaternion* out_dual,
+		Quaternion const * real0, Quaternion const * dual0,
+		Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num)
+	{
+		size_t i = 0;
+		for (; i + 4 <= num; i += 4)
 		{
-			SIMDVectorF4 const vec = CrossVector3(v1 - v0, v2 - v0);
-			return FromPointNormal(v0, NormalizeVector3(vec));
-		}
+			float32x4x4_t const r0 = vld4q_f32(&real0[i].x());
+			float32x4x4_t const d0 = vld4q_f32(&dual0[i].x());
+			float32x4x4_t const r1 = vld4q_f32(&real1[i].x());
+			float32x4x4_t const d1 = vld4q_f32(&dual1[i].x());
 
-		SIMDVectorF4 MultiplyPlane(SIMDVectorF4 const & p, SIMDMatrixF4 const & mat)
-		{
-			return SetVector(
-				GetX(p) * mat(0, 0) + GetY(p) * mat(1, 0) + GetZ(p) * mat(2, 0) + GetW(p) * mat(3, 0),
-				GetX(p) * mat(0, 1) + GetY(p) * mat(1, 1) + GetZ(p) * mat(2, 1) + GetW(p) * mat(3, 1),
-				GetX(p) * mat(0, 2) + GetY(p) * mat(1, 2) + GetZ(p) * mat(2, 2) + GetW(p) * mat(3, 2),
-				GetX(p) * mat(0, 3) + GetY(p) * mat(1, 3) + GetZ(p) * mat(2, 3) + GetW(p) * mat(3, 3));
+			float32x4_t const dot = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(r0.val[0], r1.val[0]), vmulq_f32(r0.val[1], r1.val[1])),
+				vmulq_f32(r0.val[2], r1.val[2])), vmulq_f32(r0.val[3], r1.val[3]));
+			float32x4_t const t = vld1q_f32(factors + i);
+			float32x4_t const w0 = vsubq_f32(vdupq_n_f32(1), t);
+			float32x4_t const w1 = vbslq_f32(vcltq_f32(dot, vdupq_n_f32(0)), vnegq_f32(t), t);
+
+			float32x4x4_t real;
+			float32x4x4_t dual;
+			for (int j = 0; j < 4; ++ j)
+			{
+				real.val[j] = vaddq_f32(vmulq_f32(r0.val[j], w0), vmulq_f32(r1.val[j], w1));
+				dual.val[j] = vaddq_f32(vmulq_f32(d0.val[j], w0), vmulq_f32(d1.val[j], w1));
+			}
+
+			float32x4_t const len_sq = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(real.val[0], real.val[0]),
+				vmulq_f32(real.val[1], real.val[1])), vmulq_f32(real.val[2], real.val[2])), vmulq_f32(real.val[3], real.val[3]));
+			float32x4_t const inv_len = RecipSqrtNEON(len_sq);
+			for (int j = 0; j < 4; ++ j)
+			{
+				real.val[j] = vmulq_f32(real.val[j], inv_len);
+				dual.val[j] = vmulq_f32(dual.val[j], inv_len);
+			}
+
+			vst4q_f32(&out_real[i].x(), real);
+			vst4q_f32(&out_dual[i].x(), dual);
 		}
 
-		SIMDVectorF4 NormalizePlane(SIMDVectorF4 const & rhs)
+		BlendDualQuatGeneral(out_real + i, out_dual + i, real0 + i, dual0 + i, real1 + i, dual1 + i, factors + i, num - i);
+	}
+#endif
+
+	struct BatchKernels
+	{
+		char const * name;
+		decltype(&TransformCoordVector3General) transform_coord_vector3;
+		decltype(&TransformAABBoxGeneral) transform_aabbox;
+		decltype(&MultiplyDualQuatGeneral) multiply_dual_quat;
+		decltype(&BlendDualQuatGeneral) blend_dual_quat;
+	};
+
+	BatchKernels const & Kernels()
+	{
+		static BatchKernels const kernels = []
+			{
+#if defined(SIMD_MATH_SSE)
+				CPUInfo cpu;
+				if (cpu.IsFeatureSupport(CPUInfo::CF_AVX) && cpu.IsFeatureSupport(CPUInfo::CF_AVX2)
+					&& cpu.IsFeatureSupport(CPUInfo::CF_FMA3))
+				{
+					return BatchKernels{ "AVX2", TransformCoordVector3AVX2, TransformAABBoxAVX2,
+						MultiplyDualQuatAVX2, BlendDualQuatAVX2 };
+				}
+				else
+				{
+					return BatchKernels{ "SSE", TransformCoordVector3SSE, TransformAABBoxSSE,
+						MultiplyDualQuatSSE, BlendDualQuatSSE };
+				}
+#elif defined(SIMD_MATH_NEON)
+				return BatchKernels{ "NEON", TransformCoordVector3NEON, TransformAABBoxNEON,
+					MultiplyDualQuatNEON, BlendDualQuatNEON };
+#else
+				return BatchKernels{ "General", TransformCoordVector3General, TransformAABBoxGeneral,
+					MultiplyDualQuatGeneral, BlendDualQuatGeneral };
+#endif
+			}();
+		return kernels;
+	}
+}
+
+namespace KlayGE
+{
+	namespace SIMDMathLib
+	{
+		char const * BatchBackendName()
 		{
-			SIMDVectorF4 const inv = Divide(SetVector(1), LengthVector3(rhs));
-			return rhs * inv;
+			return Kernels().name;
 		}
 
-		float IntersectRay(SIMDVectorF4 const & p, SIMDVectorF4 const & orig, SIMDVectorF4 const & dir)
+		void TransformCoordVector3(float3* out, float3 const * in, size_t num, float4x4 const & mat)
 		{
-			float deno = GetX(DotVector3(dir, p));
-			if (MathLib::equal(deno, 0.0f))
-			{
-				deno = 0.0001f;
-			}
-
-			return -GetX(DotCoord(p, orig)) / deno;
+			Kernels().transform_coord_vector3(out, in, num, mat);
 		}
 
-		// From Game Programming Gems 5, Section 2.6.
-		void ObliqueClipping(SIMDMatrixF4& proj, SIMDVectorF4 const & clip_plane)
+		void TransformAABBox(AABBox* out, AABBox const * in, size_t num, float4x4 const & mat)
 		{
-			SIMDVectorF4 const q = SetVector(
-				(MathLib::sgn(GetX(clip_plane)) - proj(2, 0)) / proj(0, 0),
-				(MathLib::sgn(GetY(clip_plane)) - proj(2, 1)) / proj(1, 1),
-				1,
-				(1 - proj(2, 2)) / proj(3, 2));
-
-			float const c = 1 / GetX(DotPlane(clip_plane, q));
-			proj.Col(2, clip_plane * SetVector(c));
+			Kernels().transform_aabbox(out, in, num, mat);
 		}
 
-		// Color
-		///////////////////////////////////////////////////////////////////////////////
-		SIMDVectorF4 NegativeColor(SIMDVectorF4 const & rhs)
+		void MultiplyDualQuat(Quaternion* out_real, Quaternion* out_dual,
+			Quaternion const * lhs_real, Quaternion const * lhs_dual,
+			Quaternion const * rhs_real, Quaternion const * rhs_dual, size_t num)
 		{
-			SIMDVectorF4 ret;
-			ret = SetVector(1) - rhs;
-			ret = SetW(ret, GetW(rhs));
-			return ret;
+			Kernels().multiply_dual_quat(out_real, out_dual, lhs_real, lhs_dual, rhs_real, rhs_dual, num);
 		}
 
-		SIMDVectorF4 ModulateColor(SIMDVectorF4 const & lhs, SIMDVectorF4 const & rhs)
+		void BlendDualQuat(Quaternion* out_real, Quaternion* out_dual,
+			Quaternion const * real0, Quaternion const * dual0,
+			Quaternion const * real1, Quaternion const * dual1, float const * factors, size_t num)
 		{
-			return lhs * rhs;
+			Kernels().blend_dual_quat(out_real, out_dual, real0, dual0, real1, dual1, factors, num);
 		}
 	}
 }
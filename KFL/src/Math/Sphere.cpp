@@ -157,5 +157,54 @@ namespace KlayGE
 	}
 
 
+
+	template <typename T>
+	void SphereSoA_T<T>::Resize(size_t size)
+	{
+		center_x_.resize(size);
+		center_y_.resize(size);
+		center_z_.resize(size);
+		radius_.resize(size);
+	}
+
+	template <typename T>
+	void SphereSoA_T<T>::Clear() noexcept
+	{
+		center_x_.clear();
+		center_y_.clear();
+		center_z_.clear();
+		radius_.clear();
+	}
+
+	template <typename T>
+	void SphereSoA_T<T>::PushBack(Sphere_T<T> const & sphere)
+	{
+		center_x_.push_back(sphere.Center().x());
+		center_y_.push_back(sphere.Center().y());
+		center_z_.push_back(sphere.Center().z());
+		radius_.push_back(sphere.Radius());
+	}
+
+	template <typename T>
+	void SphereSoA_T<T>::Set(size_t index, Sphere_T<T> const & sphere) noexcept
+	{
+		BOOST_ASSERT(index < this->Size());
+
+		center_x_[index] = sphere.Center().x();
+		center_y_[index] = sphere.Center().y();
+		center_z_[index] = sphere.Center().z();
+		radius_[index] = sphere.Radius();
+	}
+
+	template <typename T>
+	Sphere_T<T> SphereSoA_T<T>::Get(size_t index) const noexcept
+	{
+		BOOST_ASSERT(index < this->Size());
+
+		return Sphere_T<T>(Vector_T<T, 3>(center_x_[index], center_y_[index], center_z_[index]), radius_[index]);
+	}
+
+
 	template class Sphere_T<float>;
+	template class SphereSoA_T<float>;
 }
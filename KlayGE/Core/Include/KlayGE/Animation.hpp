@@ -0,0 +1,207 @@
+/**
+ * @file Animation.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#ifndef KLAYGE_CORE_ANIMATION_HPP
+#define KLAYGE_CORE_ANIMATION_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <vector>
+
+#include <KFL/ArrayRef.hpp>
+#include <KFL/Math.hpp>
+
+namespace KlayGE
+{
+	// Quantized key frames of all joints of a skinned model. Rotations keep the smallest three components in 64 bits,
+	// translations are 16-bit fractions of the joint's translation range, so a key takes 14 bytes instead of the 36 of
+	// KeyFrameSet. A rotation, translation or scale channel whose keys are all the same keeps one key. Immutable, so it can
+	// be shared by all instances of a model.
+	class KLAYGE_CORE_API AnimationClip final
+	{
+		friend class AnimationSampler;
+
+	public:
+		explicit AnimationClip(std::vector<KeyFrameSet> const & key_frame_sets);
+
+		uint32_t NumJoints() const
+		{
+			return static_cast<uint32_t>(tracks_.size());
+		}
+
+		// Bytes of key frame data
+		size_t CompressedSize() const;
+
+	private:
+		struct Track
+		{
+			uint32_t first_frame;
+			uint32_t num_keys;
+			// Timeline length, frames wrap around it
+			float length;
+
+			uint32_t first_rotation;
+			uint32_t first_translation;
+			uint32_t first_scale;
+			// 0 for constant channels, 1 otherwise
+			uint32_t rotation_stride;
+			uint32_t translation_stride;
+			uint32_t scale_stride;
+
+			float3 translation_min;
+			float3 translation_step;
+		};
+
+		Quaternion DecodeRotation(Track const & track, uint32_t key) const;
+		float3 DecodeTranslation(Track const & track, uint32_t key) const;
+		float DecodeScale(Track const & track, uint32_t key) const;
+
+	private:
+		std::vector<Track> tracks_;
+
+		std::vector<uint32_t> frame_ids_;
+		std::vector<uint64_t> rotations_;
+		std::vector<uint16_t> translations_;
+		std::vector<float> scales_;
+	};
+
+	// Samples the local pose of all joints from an AnimationClip, one per model instance. The last key found is cached
+	// per joint and per layer, so playing forward finds the keys in O(1). Joints are interpolated in one SoA batch.
+	class KLAYGE_CORE_API AnimationSampler final
+	{
+	public:
+		AnimationSampler();
+
+		void Clip(AnimationClipPtr const & clip);
+		AnimationClipPtr const & Clip() const
+		{
+			return clip_;
+		}
+
+		// The pose at one frame of the timeline
+		void Sample(float frame);
+		// Weighted blend of the poses at several frames of the timeline. The weights are normalized.
+		void Sample(ArrayRef<float> frames, ArrayRef<float> weights);
+
+		std::vector<Quaternion> const & Reals() const
+		{
+			return reals_;
+		}
+		std::vector<Quaternion> const & Duals() const
+		{
+			return duals_;
+		}
+		std::vector<float> const & Scales() const
+		{
+			return scales_;
+		}
+
+	private:
+		void SampleLayer(uint32_t layer, float frame, Quaternion* reals, Quaternion* duals, float* scales);
+
+	private:
+		AnimationClipPtr clip_;
+
+		// One entry per joint per layer
+		std::vector<uint32_t> key_caches_;
+
+		std::vector<Quaternion> key_dqs_;
+		std::vector<float> factors_;
+		std::vector<Quaternion> layer_dqs_;
+		std::vector<float> layer_scales_;
+
+		std::vector<Quaternion> reals_;
+		std::vector<Quaternion> duals_;
+		std::vector<float> scales_;
+	};
+
+	// Poses many skinned models together. SetFrame and BlendActions on a member only record what to play, Update then
+	// evaluates all members in parallel jobs and writes their palettes into one pooled buffer. Members playing one frame
+	// of the same AnimationClip object share a palette, so a clip is assumed to be used with one skeleton.
+	class KLAYGE_CORE_API SkinningCrowd final
+	{
+	public:
+		SkinningCrowd();
+		~SkinningCrowd();
+
+		SkinningCrowd(SkinningCrowd const & rhs) = delete;
+		SkinningCrowd& operator=(SkinningCrowd const & rhs) = delete;
+
+		// A model is in one crowd at most. It's removed automatically when destroyed.
+		void Add(SkinnedModelPtr const & model);
+		void Remove(SkinnedModelPtr const & model);
+		uint32_t NumModels() const
+		{
+			return static_cast<uint32_t>(models_.size());
+		}
+
+		void Update();
+
+		// Number of palettes evaluated in the last Update. The other members shared one of them.
+		uint32_t NumPalettesEvaluated() const
+		{
+			return static_cast<uint32_t>(leaders_.size());
+		}
+		std::vector<float4> const & PaletteBuffer() const
+		{
+			return palettes_;
+		}
+
+	private:
+		struct Job
+		{
+			SkinnedModel* model;
+			AnimationClip const * clip;
+			float frame;
+			bool blended;
+			uint32_t palette;
+			uint32_t leader;
+		};
+
+		static void ReleasePalette(SkinnedModel& model);
+
+	private:
+		std::vector<std::weak_ptr<SkinnedModel>> models_;
+
+		// Members alive during an Update
+		std::vector<SkinnedModelPtr> active_models_;
+		std::vector<Job> jobs_;
+		std::vector<uint32_t> job_order_;
+		// Job index that evaluates each palette
+		std::vector<uint32_t> leaders_;
+
+		std::vector<float4> palettes_;
+	};
+}
+
+#endif		// KLAYGE_CORE_ANIMATION_HPP
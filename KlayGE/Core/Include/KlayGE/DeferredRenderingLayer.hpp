@@ -41,6 +41,7 @@
 #include <KlayGE/Light.hpp>
 #include <KlayGE/IndirectLightingLayer.hpp>
 #include <KlayGE/CascadedShadowLayer.hpp>
+#include <KlayGE/LightCluster.hpp>
 #include <KlayGE/Renderable.hpp>
 
 #define TRIDITIONAL_DEFERRED 0
@@ -131,6 +132,10 @@ namespace KlayGE
 		IndirectLightingLayerPtr il_layer;
 
 		std::vector<char> light_visibles;
+		// Local lights binned into view space clusters, the light indices in the clusters index clustered_lights
+		LightClusterBuilder light_clusters;
+		std::vector<uint32_t> clustered_lights;
+		bool light_clusters_built = false;
 
 #if DEFAULT_DEFERRED == TRIDITIONAL_DEFERRED
 		FrameBufferPtr lighting_fb;
@@ -207,6 +212,8 @@ namespace KlayGE
 		void TranslucencyStrength(float strength);
 		void SSREnabled(bool ssr);
 		void TemporalAAEnabled(bool taa);
+		// Off by default. Light shading doesn't read the clusters yet, they are only built for callers of LightClusters.
+		void LightClustersEnabled(bool clusters);
 
 		void AddDecal(RenderDecalPtr const & decal);
 
@@ -318,6 +325,17 @@ namespace KlayGE
 			return viewports_[vp].sample_quality;
 		}
 
+		// Only built with LightClustersEnabled(true) and for perspective cameras.
+		// Light i of the clusters is lights_[ClusteredLights(vp)[i]].
+		LightClusterBuilder const & LightClusters(uint32_t vp) const
+		{
+			return viewports_[vp].light_clusters;
+		}
+		std::vector<uint32_t> const & ClusteredLights(uint32_t vp) const
+		{
+			return viewports_[vp].clustered_lights;
+		}
+
 		void DisplayIllum(int illum);
 		void IndirectScale(float scale);
 
@@ -396,7 +414,7 @@ namespace KlayGE
 		void BuildLightList();
 		void BuildVisibleSceneObjList(bool& has_opaque_objs, bool& has_transparency_back_objs, bool& has_transparency_front_objs);
 		void BuildPassScanList(bool has_opaque_objs, bool has_transparency_back_objs, bool has_transparency_front_objs);
-		void CheckLightVisible(uint32_t vp_index, uint32_t light_index);
+		void CheckLightsVisible(uint32_t vp_index);
 		void AppendGBufferPassScanCode(uint32_t vp_index, PassTargetBuffer pass_tb);
 		void AppendShadowPassScanCode(uint32_t light_index);
 		void AppendCascadedShadowPassScanCode(uint32_t vp_index, uint32_t light_index);
@@ -435,6 +453,7 @@ namespace KlayGE
 			std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end);
 		void UpdateLightIndexedLightingPointSpotArea(PerViewport const & pvp, PassTargetBuffer pass_tb,
 			std::vector<uint32_t>::const_iterator iter_beg, std::vector<uint32_t>::const_iterator iter_end);
+		void UploadLightClusters(PerViewport const & pvp);
 		void CreateDepthMinMaxMap(PerViewport const & pvp);
 
 		void UpdateClusteredLighting(PerViewport const & pvp, PassTargetBuffer pass_tb);
@@ -512,6 +531,11 @@ namespace KlayGE
 		AABBox pyramid_aabb_;
 		AABBox box_aabb_;
 
+		AABBoxSoA light_aabbs_;
+		SphereSoA light_spheres_;
+		bool light_clusters_enabled_;
+		std::vector<uint32_t> light_visible_masks_;
+
 		LightSourcePtr default_ambient_light_;
 		LightSourcePtr merged_ambient_light_;
 		std::vector<LightSource*> lights_;
@@ -634,6 +658,24 @@ namespace KlayGE
 		RenderEffectParameter* light_index_tex_param_;
 		RenderEffectParameter* tile_scale_param_;
 		RenderEffectParameter* camera_proj_01_param_;
+
+		// The cluster lists of the light indexed lighting pass. Lights are renamed to slots, a batch starting at slot n has
+		// the lights in slots [n, n + light_batch_).
+		bool light_clusters_tex_support_ = false;
+		std::vector<uint32_t> light_cluster_slots_;
+		std::vector<uint32_t> light_cluster_offsets_;
+		std::vector<uint32_t> light_cluster_counts_;
+		std::vector<uint32_t> light_cluster_indices_;
+		std::vector<float2> light_cluster_ranges_data_;
+		std::vector<float> light_cluster_indices_data_;
+		TexturePtr light_cluster_ranges_tex_;
+		TexturePtr light_cluster_indices_tex_;
+		RenderEffectParameter* light_cluster_ranges_tex_param_;
+		RenderEffectParameter* light_cluster_indices_tex_param_;
+		RenderEffectParameter* light_cluster_dims_param_;
+		RenderEffectParameter* light_cluster_slicing_param_;
+		RenderEffectParameter* light_cluster_indices_size_param_;
+		RenderEffectParameter* light_cluster_first_slot_param_;
 		PostProcessPtr depth_to_min_max_pp_;
 		PostProcessPtr reduce_min_max_pp_;
 
@@ -84,6 +84,14 @@ namespace KlayGE
 			std::wstring_view text, float font_size, uint32_t align);
 		void RenderText(float4x4 const & mvp, Color const & clr, std::wstring_view text, float font_size);
 
+		// Number of glyphs the distance texture holds
+		uint32_t CharCacheCapacity() const;
+		// Glyphs in the distance texture, the most recently used first
+		std::wstring CachedChars() const;
+		uint32_t NumCachedLayouts() const;
+		// Texture coordinates of the glyphs of text drawn at a point, loading the missing glyphs like RenderText
+		std::vector<Rect> CharTexRects(std::wstring_view text, float font_size);
+
 	private:
 		std::shared_ptr<FontRenderable> font_renderable_;
 		uint32_t fsn_attrib_;
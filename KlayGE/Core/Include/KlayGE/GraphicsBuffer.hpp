@@ -145,6 +145,8 @@ namespace KlayGE
 	{
 	public:
 		SoftwareGraphicsBuffer(uint32_t size_in_byte, bool ref_only);
+		// Refers to the data inside data_holder without copying, and keeps it alive
+		SoftwareGraphicsBuffer(uint32_t size_in_byte, std::shared_ptr<void const> const & data_holder);
 
 		void CopyToBuffer(GraphicsBuffer& target) override;
 		void CopyToSubBuffer(GraphicsBuffer& target,
@@ -162,6 +164,7 @@ namespace KlayGE
 
 	private:
 		bool ref_only_;
+		std::shared_ptr<void const> data_holder_;
 
 		uint8_t* subres_data_ = nullptr;
 		std::vector<uint8_t> data_block_;
@@ -0,0 +1,148 @@
+/**
+ * @file LightCluster.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef KLAYGE_CORE_LIGHT_CLUSTER_HPP
+#define KLAYGE_CORE_LIGHT_CLUSTER_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <vector>
+
+#include <KFL/AABBox.hpp>
+#include <KFL/Sphere.hpp>
+
+namespace KlayGE
+{
+	// Bins light bounding spheres into view space clusters. A cluster is a screen tile times a depth slice, the slices are
+	// exponentially distributed between the near and far planes. Tile (0, 0) is at the top left. Perspective projections only.
+	class KLAYGE_CORE_API LightClusterBuilder final
+	{
+	public:
+		static uint32_t constexpr INVALID_SLOT = 0xFFFFFFFFU;
+
+	public:
+		LightClusterBuilder();
+		LightClusterBuilder(uint32_t tiles_x, uint32_t tiles_y, uint32_t slices);
+
+		// lights_ws are bounding spheres in world space. The view matrix is assumed to have no scale.
+		void Build(float4x4 const & view, float4x4 const & proj, float near_plane, float far_plane, SphereSoA const & lights_ws);
+
+		uint32_t TilesX() const
+		{
+			return tiles_x_;
+		}
+		uint32_t TilesY() const
+		{
+			return tiles_y_;
+		}
+		uint32_t Slices() const
+		{
+			return slices_;
+		}
+		uint32_t NumClusters() const
+		{
+			return tiles_x_ * tiles_y_ * slices_;
+		}
+		uint32_t ClusterIndex(uint32_t x, uint32_t y, uint32_t slice) const
+		{
+			return (slice * tiles_y_ + y) * tiles_x_ + x;
+		}
+		// The cluster a view space position falls in, or -1 if it's outside the clustered volume
+		int32_t ClusterIndex(float3 const & pos_es) const;
+		AABBox ClusterBound(uint32_t cluster) const;
+
+		// Lights of a cluster are LightIndices()[offset, offset + count), sorted by light index
+		uint32_t ClusterLightOffset(uint32_t cluster) const
+		{
+			return cluster_offsets_[cluster];
+		}
+		uint32_t ClusterLightCount(uint32_t cluster) const
+		{
+			return cluster_counts_[cluster];
+		}
+		std::vector<uint32_t> const & LightIndices() const
+		{
+			return light_indices_;
+		}
+		// Number of clusters a light is in, 0 means it can't affect anything on screen
+		uint32_t NumLightClusters(uint32_t light) const
+		{
+			return num_light_clusters_[light];
+		}
+
+		// Rewrites the lists with light i renamed to slots[i], dropping the lights in INVALID_SLOT. Like LightIndices(), the
+		// lists are compact and in cluster order, and each one is sorted by slot.
+		void RemapLights(std::vector<uint32_t> const & slots, std::vector<uint32_t>& offsets, std::vector<uint32_t>& counts,
+			std::vector<uint32_t>& indices) const;
+
+	private:
+		struct LightRange
+		{
+			uint32_t x0, x1;
+			uint32_t y0, y1;
+			uint32_t slice0, slice1;
+		};
+
+		void UpdateClusterBounds(float4x4 const & proj, float near_plane, float far_plane);
+		uint32_t SliceOf(float z) const;
+		uint32_t TileXOf(float ndc_x) const;
+		uint32_t TileYOf(float ndc_y) const;
+		bool CalcLightRange(float3 const & center_es, float radius, LightRange& range) const;
+		void BinSlices(uint32_t first_slice, uint32_t last_slice, std::vector<uint32_t>& hits) const;
+
+	private:
+		uint32_t tiles_x_;
+		uint32_t tiles_y_;
+		uint32_t slices_;
+
+		float4x4 proj_;
+		float near_plane_;
+		float far_plane_;
+		std::vector<float> slice_depths_;
+		AABBoxSoA cluster_bounds_;
+
+		std::vector<float3> centers_es_;
+		std::vector<float> radii_;
+		std::vector<LightRange> light_ranges_;
+		std::vector<char> light_valid_;
+
+		// Each worker owns a range of slices, and records (cluster, light) pairs for them
+		std::vector<std::vector<uint32_t>> worker_hits_;
+
+		std::vector<uint32_t> cluster_offsets_;
+		std::vector<uint32_t> cluster_counts_;
+		std::vector<uint32_t> light_indices_;
+		std::vector<uint32_t> num_light_clusters_;
+	};
+}
+
+#endif		// KLAYGE_CORE_LIGHT_CLUSTER_HPP
@@ -28,7 +28,9 @@
 #pragma once
 
 #include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
 #include <KFL/CXX17/string_view.hpp>
+#include <KlayGE/Animation.hpp>
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/RenderLayout.hpp>
 #include <KFL/Math.hpp>
@@ -269,8 +271,18 @@ namespace KlayGE
 		uint32_t end_frame;
 	};
 
+	// One action played in SkinnedModel::BlendActions. frame is relative to the action's start, and loops over it.
+	struct KLAYGE_CORE_API AnimationLayer
+	{
+		uint32_t action;
+		float frame;
+		float weight;
+	};
+
 	class KLAYGE_CORE_API SkinnedModel : public RenderModel
 	{
+		friend class SkinningCrowd;
+
 	public:
 		explicit SkinnedModel(SceneNodePtr const & root_node);
 		SkinnedModel(std::wstring_view name, uint32_t node_attrib);
@@ -302,6 +314,7 @@ namespace KlayGE
 			joints_.assign(first, last);
 			this->UpdateBinds();
 		}
+		// Palette built by the model itself. Not updated for models in a SkinningCrowd, use BindRealPalette/BindDualPalette.
 		std::vector<float4> const & GetBindRealParts() const
 		{
 			return bind_reals_;
@@ -310,14 +323,30 @@ namespace KlayGE
 		{
 			return bind_duals_;
 		}
-		void AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf)
+		// The palette to skin with. For models in a SkinningCrowd it's in the crowd's buffer, and valid until its next Update.
+		ArrayRef<float4> BindRealPalette() const
+		{
+			return ArrayRef<float4>(palette_reals_, joints_.size());
+		}
+		ArrayRef<float4> BindDualPalette() const
+		{
+			return ArrayRef<float4>(palette_duals_, joints_.size());
+		}
+		SkinningCrowd* Crowd() const
 		{
-			key_frame_sets_ = kf;
+			return crowd_;
 		}
+		// clip is the compressed kf, it's built from kf if null. Models in a SkinningCrowd only share palettes when they
+		// share the clip object, so pass the same clip to all models using kf.
+		void AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf, AnimationClipPtr const & clip = AnimationClipPtr());
 		std::shared_ptr<std::vector<KeyFrameSet>> const & GetKeyFrameSets() const
 		{
 			return key_frame_sets_;
 		}
+		AnimationClipPtr const & GetAnimationClip() const
+		{
+			return anim_sampler_.Clip();
+		}
 		uint32_t NumFrames() const
 		{
 			return num_frames_;
@@ -336,7 +365,10 @@ namespace KlayGE
 		}
 
 		float GetFrame() const;
+		// Models in a SkinningCrowd are posed in the crowd's next Update
 		void SetFrame(float frame);
+		// Weighted blend of several actions. Weights are normalized.
+		void BlendActions(ArrayRef<AnimationLayer> layers);
 
 		void RebindJoints();
 		void UnbindJoints();
@@ -353,15 +385,29 @@ namespace KlayGE
 
 	protected:
 		void BuildBones(float frame);
+		void BuildBlendedBones();
+		void SampleBlendedPose();
+		void BuildBonesFromPose();
 		void UpdateBinds();
+		void UpdateBinds(float4* reals, float4* duals);
+		// Poses the joints for the current frame or layers, and writes the palette to reals and duals
+		void EvaluatePalette(float4* reals, float4* duals);
 
 	protected:
 		std::vector<Joint> joints_;
 		std::vector<float4> bind_reals_;
 		std::vector<float4> bind_duals_;
+		std::vector<Quaternion> bind_dq_scratch_;
+		float4 const * palette_reals_;
+		float4 const * palette_duals_;
+		SkinningCrowd* crowd_;
 
 		std::shared_ptr<std::vector<KeyFrameSet>> key_frame_sets_;
+		AnimationSampler anim_sampler_;
 		float last_frame_;
+		std::vector<AnimationLayer> last_layers_;
+		std::vector<float> layer_frames_;
+		std::vector<float> layer_weights_;
 
 		uint32_t num_frames_;
 		uint32_t frame_rate_;
@@ -34,37 +34,153 @@
 #pragma once
 
 #include <KlayGE/PreDeclare.hpp>
+#include <KFL/ArrayRef.hpp>
 #include <KFL/CXX17/string_view.hpp>
 
+#include <functional>
+#include <list>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
 struct IInArchive;
 
 namespace KlayGE
 {
-	class KLAYGE_CORE_API Package
+	class KLAYGE_CORE_API Package : boost::noncopyable
 	{
 	public:
 		explicit Package(ResIdentifierPtr const & archive_is);
-		Package(ResIdentifierPtr const & archive_is, std::string_view password);
+		virtual ~Package();
 
-		bool Locate(std::string_view extract_file_path);
-		ResIdentifierPtr Extract(std::string_view extract_file_path, std::string_view res_name);
+		virtual bool Locate(std::string_view extract_file_path) = 0;
+		virtual ResIdentifierPtr Extract(std::string_view extract_file_path, std::string_view res_name) = 0;
 
 		ResIdentifier* ArchiveStream() const
 		{
 			return archive_is_.get();
 		}
 
+		// Paths in packages are case insensitive and separated by '/'
+		static std::string NormalizePath(std::string_view path);
+
+	protected:
+		ResIdentifierPtr archive_is_;
+	};
+
+	class KLAYGE_CORE_API SevenZipPackage : public Package
+	{
+	public:
+		// Budget of the decoded solid block cache. Blocks larger than it are decoded item by item.
+		static uint64_t constexpr MAX_DECODED_BLOCKS_SIZE = 64 * 1024 * 1024;
+
+	public:
+		explicit SevenZipPackage(ResIdentifierPtr const & archive_is);
+		SevenZipPackage(ResIdentifierPtr const & archive_is, std::string_view password);
+
+		bool Locate(std::string_view extract_file_path) override;
+		ResIdentifierPtr Extract(std::string_view extract_file_path, std::string_view res_name) override;
+
+		uint32_t NumDecodedBlocks() const
+		{
+			return static_cast<uint32_t>(decoded_blocks_.size());
+		}
+		uint64_t DecodedBlocksSize() const
+		{
+			return decoded_blocks_size_;
+		}
+
 	private:
 		uint32_t Find(std::string_view extract_file_path);
+		void BuildIndex();
+		std::shared_ptr<std::vector<char>> DecodeItem(uint32_t index);
+		std::unordered_map<uint32_t, std::shared_ptr<std::vector<char>>> DecodeItems(std::vector<uint32_t> const & indices);
 
 	private:
-		ResIdentifierPtr archive_is_;
-
 		std::shared_ptr<IInArchive> archive_;
 		std::string password_;
 
 		uint32_t num_items_;
+
+		// Lower case path in package -> item index
+		std::unordered_map<std::string, uint32_t> path_to_index_;
+
+		struct ItemInfo
+		{
+			uint32_t block;
+			uint64_t size;
+			uint64_t mtime;
+		};
+		std::vector<ItemInfo> items_;
+		// Solid block -> items inside it, and their total decoded size
+		std::unordered_map<uint32_t, std::pair<std::vector<uint32_t>, uint64_t>> block_items_;
+
+		// LRU of decoded solid blocks, most recently used at front
+		struct DecodedBlock
+		{
+			uint32_t block;
+			uint64_t size;
+			std::unordered_map<uint32_t, std::shared_ptr<std::vector<char>>> items;
+		};
+		std::list<DecodedBlock> decoded_blocks_;
+		uint64_t decoded_blocks_size_;
 	};
+
+	// KlayGE's own package format (.kpk). Entries are 4K aligned and compressed one by one, or stored. The file is
+	// memory mapped, so a stored entry is read in place without any copy.
+	class KLAYGE_CORE_API KPackage : public Package
+	{
+	public:
+		enum CompressionMethod
+		{
+			CM_Stored = 0,
+			CM_LZMA
+		};
+
+		static uint32_t constexpr VERSION = 1;
+		static uint32_t constexpr ALIGNMENT = 4096;
+
+		// The first bytes of a .kpk file
+		static bool IsKPackage(ResIdentifierPtr const & archive_is);
+
+	public:
+		explicit KPackage(ResIdentifierPtr const & archive_is);
+
+		bool Locate(std::string_view extract_file_path) override;
+		ResIdentifierPtr Extract(std::string_view extract_file_path, std::string_view res_name) override;
+
+	private:
+		uint32_t Find(std::string_view extract_file_path) const;
+
+	private:
+		struct Entry
+		{
+			uint64_t offset;
+			uint64_t stored_size;
+			uint64_t original_size;
+			uint64_t mtime;
+			std::string_view name;
+			uint32_t compression;
+		};
+
+		// Either the MappedFile, or the whole package in memory if it can't be mapped
+		std::shared_ptr<void const> storage_;
+		ArrayRef<uint8_t> data_;
+
+		// Sorted by the lower case path in package
+		std::vector<Entry> entries_;
+	};
+
+	// Opens a .7z or a .kpk, depending on the content of the stream
+	KLAYGE_CORE_API PackagePtr OpenPackage(ResIdentifierPtr const & archive_is, std::string_view password);
+
+	// Each file is (path in package, content, compress or not). A file is stored if compressing it doesn't pay.
+	KLAYGE_CORE_API void SaveKPackage(std::string_view pkg_name,
+		std::vector<std::tuple<std::string, ResIdentifierPtr, bool>> const & files);
+	// Same, but the content of a file is only opened when it's packed, and closed right after
+	KLAYGE_CORE_API void SaveKPackage(std::string_view pkg_name,
+		std::vector<std::tuple<std::string, std::function<ResIdentifierPtr()>, bool>> const & files);
 }
 
 #endif		// KLAYGE_CORE_PACKAGE_HPP
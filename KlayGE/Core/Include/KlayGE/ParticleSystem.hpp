@@ -55,6 +55,85 @@ namespace KlayGE
 		float init_life;
 	};
 
+	// A range of particles in a ParticlePool, one array per attribute
+	struct KLAYGE_CORE_API ParticleSpan
+	{
+		float* pos_x;
+		float* pos_y;
+		float* pos_z;
+		float* vel_x;
+		float* vel_y;
+		float* vel_z;
+		float* life;
+		float* spin;
+		float* size;
+		float* alpha;
+		float* init_life;
+
+		uint32_t num;
+
+		Particle Get(uint32_t i) const;
+		void Set(uint32_t i, Particle const & par) const;
+		ParticleSpan SubSpan(uint32_t first, uint32_t count) const;
+	};
+
+	// SoA particle storage. Particles alive are packed in [0, NumAlive()).
+	class KLAYGE_CORE_API ParticlePool
+	{
+	public:
+		explicit ParticlePool(uint32_t capacity);
+
+		uint32_t Capacity() const
+		{
+			return capacity_;
+		}
+		uint32_t NumAlive() const
+		{
+			return num_alive_;
+		}
+		void NumAlive(uint32_t num)
+		{
+			BOOST_ASSERT(num <= capacity_);
+			num_alive_ = num;
+		}
+
+		ParticleSpan Span(uint32_t first, uint32_t num);
+		ParticleSpan AliveSpan()
+		{
+			return this->Span(0, num_alive_);
+		}
+
+		Particle Get(uint32_t i) const;
+		void Set(uint32_t i, Particle const & par);
+
+		// Packs the particles with life > 0 in [first, first + num) to the front of the range, returns how many there are
+		uint32_t Compact(uint32_t first, uint32_t num);
+		// Moves [src, src + num) to [dst, dst + num). The ranges can overlap.
+		void Move(uint32_t dst, uint32_t src, uint32_t num);
+
+	private:
+		enum
+		{
+			PA_PosX = 0,
+			PA_PosY,
+			PA_PosZ,
+			PA_VelX,
+			PA_VelY,
+			PA_VelZ,
+			PA_Life,
+			PA_Spin,
+			PA_Size,
+			PA_Alpha,
+			PA_InitLife,
+
+			PA_NumAttribs
+		};
+
+		uint32_t capacity_;
+		uint32_t num_alive_;
+		std::vector<float> attribs_[PA_NumAttribs];
+	};
+
 	class KLAYGE_CORE_API ParticleEmitter
 	{
 	public:
@@ -179,7 +258,8 @@ namespace KlayGE
 		}
 
 		uint32_t Update(float elapsed_time);
-		virtual void Emit(Particle& par) = 0;
+		// Initializes all particles of the span
+		virtual void Emit(ParticleSpan const & particles) = 0;
 
 	protected:
 		void DoClone(ParticleEmitterPtr const & rhs);
@@ -215,7 +295,8 @@ namespace KlayGE
 		virtual std::string const & Type() const = 0;
 		virtual ParticleUpdaterPtr Clone() = 0;
 
-		virtual void Update(Particle& par, float elapse_time) = 0;
+		// Systems with many particles call this on several spans at the same time from worker threads
+		virtual void Update(ParticleSpan const & particles, float elapse_time) = 0;
 		virtual void SnapParams() = 0;
 
 	protected:
@@ -291,19 +372,14 @@ namespace KlayGE
 
 		uint32_t NumParticles() const
 		{
-			return static_cast<uint32_t>(particles_.size());
+			return particles_.Capacity();
 		}
 		uint32_t NumActiveParticles() const;
 		uint32_t GetActiveParticleIndex(uint32_t i) const;
-		Particle const & GetParticle(uint32_t i) const
+		Particle GetParticle(uint32_t i) const
 		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
-		}
-		Particle& GetParticle(uint32_t i)
-		{
-			BOOST_ASSERT(i < particles_.size());
-			return particles_[i];
+			BOOST_ASSERT(i < particles_.Capacity());
+			return particles_.Get(i);
 		}
 		void ClearParticles();
 
@@ -332,16 +408,25 @@ namespace KlayGE
 
 	private:
 		void UpdateParticlesNoLock(float elapsed_time);
+		void SortParticlesNoLock(uint32_t num_prev_alive, uint32_t num_survived, float min_depth, float max_depth);
 		void UpdateParticleBufferNoLock();
 
 	protected:
 		std::vector<ParticleEmitterPtr> emitters_;
 		std::vector<ParticleUpdaterPtr> updaters_;
 
-		std::vector<Particle> particles_;
-		std::vector<std::pair<uint32_t, float>> actived_particles_;
+		ParticlePool particles_;
+		// Pool indices of the particles alive from back to front. Only used when sorting, the pool order is used otherwise.
+		std::vector<uint32_t> actived_particles_;
 		mutable std::mutex actived_particles_mutex_;
 
+		// Maps last frame's pool indices to this frame's, so last frame's order can be reused as the initial order
+		std::vector<uint32_t> particle_remap_;
+		std::vector<float> particle_depths_;
+		std::vector<uint16_t> sort_keys_;
+		std::vector<uint16_t> sort_tmp_keys_;
+		std::vector<uint32_t> sort_tmp_indices_;
+
 		float gravity_;
 		float3 force_;
 		float media_density_;
@@ -370,14 +455,13 @@ namespace KlayGE
 		virtual std::string const & Type() const override;
 		virtual ParticleEmitterPtr Clone() override;
 
-		virtual void Emit(Particle& par) override;
+		virtual void Emit(ParticleSpan const & particles) override;
 
 	private:
-		float RandomGen();
+		void Emit(ParticleSpan const & particles, std::ranlux24_base& gen) const;
 
 	private:
 		std::ranlux24_base gen_;
-		std::uniform_int_distribution<> random_dis_;
 	};
 
 	class KLAYGE_CORE_API PolylineParticleUpdater : public ParticleUpdater
@@ -416,7 +500,7 @@ namespace KlayGE
 			return opacity_over_life_;
 		}
 
-		void Update(Particle& par, float elapse_time) override;
+		void Update(ParticleSpan const & particles, float elapse_time) override;
 		void SnapParams() override;
 
 	private:
@@ -42,10 +42,12 @@
 
 namespace KlayGE
 {
+	// CPU time is summed over all Begin/End pairs between two CollectData calls, so a range can wrap code that runs
+	// several times a frame. A range without GPU timing reports a negative GPU time.
 	class KLAYGE_CORE_API PerfRange : boost::noncopyable
 	{
 	public:
-		PerfRange();
+		explicit PerfRange(bool gpu_timing = true);
 
 		void Begin();
 		void End();
@@ -77,7 +79,7 @@ namespace KlayGE
 		void Suspend();
 		void Resume();
 
-		PerfRangePtr CreatePerfRange(int category, std::string const & name);
+		PerfRangePtr CreatePerfRange(int category, std::string const & name, bool gpu_timing = true);
 		void CollectData();
 
 		void ExportToCSV(std::string const & file_name) const;
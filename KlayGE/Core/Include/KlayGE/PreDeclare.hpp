@@ -175,6 +175,12 @@ namespace KlayGE
 	typedef std::shared_ptr<SkinnedModel> SkinnedModelPtr;
 	class SkinnedMesh;
 	typedef std::shared_ptr<SkinnedMesh> SkinnedMeshPtr;
+	struct KeyFrameSet;
+	class AnimationClip;
+	typedef std::shared_ptr<AnimationClip> AnimationClipPtr;
+	class AnimationSampler;
+	class SkinningCrowd;
+	typedef std::shared_ptr<SkinningCrowd> SkinningCrowdPtr;
 	class RenderableLightSourceProxy;
 	typedef std::shared_ptr<RenderableLightSourceProxy> RenderableLightSourceProxyPtr;
 	class RenderableCameraProxy;
@@ -279,6 +285,8 @@ namespace KlayGE
 	typedef std::shared_ptr<PSSMCascadedShadowLayer> PSSMCascadedShadowLayerPtr;
 	class SDSMCascadedShadowLayer;
 	typedef std::shared_ptr<SDSMCascadedShadowLayer> SDSMCascadedShadowLayerPtr;
+	class LightClusterBuilder;
+	typedef std::shared_ptr<LightClusterBuilder> LightClusterBuilderPtr;
 	class GpuFft;
 	typedef std::shared_ptr<GpuFft> GpuFftPtr;
 	class GpuFftPS;
@@ -1017,6 +1017,9 @@ namespace KlayGE
 			return has_tessellation_;
 		}
 
+		// True if the vertex shaders of all passes read this vertex element
+		bool HasVertexInput(VertexElementUsage usage, uint8_t usage_index) const;
+
 	private:
 		std::string name_;
 		size_t name_hash_;
@@ -1094,12 +1097,16 @@ namespace KlayGE
 			return (*macros_)[n];
 		}
 
+		// The vertex elements are found from the input semantics in the declaration of the vertex shader's entry function
+		bool HasVertexInput(VertexElementUsage usage, uint8_t usage_index) const;
+
 	private:
 		std::string name_;
 		size_t name_hash_;
 		std::shared_ptr<std::vector<RenderEffectAnnotationPtr>> annotations_;
 		std::shared_ptr<std::vector<std::pair<std::string, std::string>>> macros_;
 		std::array<uint32_t, NumShaderStages> shader_desc_ids_;
+		std::vector<std::pair<VertexElementUsage, uint8_t>> vs_inputs_;
 
 		RenderStateObjectPtr render_state_obj_;
 		uint32_t shader_obj_index_;
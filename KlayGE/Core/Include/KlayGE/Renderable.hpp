@@ -24,6 +24,7 @@
 #include <KlayGE/PreDeclare.hpp>
 #include <KFL/ArrayRef.hpp>
 #include <vector>
+#include <KlayGE/RenderLayout.hpp>
 #include <KlayGE/RenderMaterial.hpp>
 #include <KlayGE/SceneComponent.hpp>
 
@@ -164,6 +165,11 @@ namespace KlayGE
 		virtual AABBox const & PosBound() const;
 		virtual AABBox const & TexcoordBound() const;
 
+		RenderMaterialPtr const & GetMaterial() const
+		{
+			return mtl_;
+		}
+
 		virtual void AddToRenderQueue();
 
 		virtual void Render();
@@ -179,6 +185,16 @@ namespace KlayGE
 		}
 		void AddInstance(SceneNode const * node);
 		void ClearInstances();
+
+		// With auto instancing, SceneManager merges renderables that share geometry, material and technique into one
+		// instanced draw. The technique must read the world matrix of each instance from the instance stream, laid out
+		// as AutoInstanceFormat(), instead of from the model parameters. Renderables with a technique whose vertex shaders
+		// don't take these inputs are drawn one by one.
+		void AutoInstancing(bool auto_inst);
+		bool AutoInstancing() const;
+		static std::vector<VertexElement> const & AutoInstanceFormat();
+		// Draws all instances of rl with the states of this renderable
+		void RenderInstances(RenderLayout const & rl);
 		uint32_t NumInstances() const
 		{
 			return static_cast<uint32_t>(instances_.size());
@@ -278,6 +294,7 @@ namespace KlayGE
 		int32_t active_lod_ = 0;
 
 		bool enabled_ = true;
+		bool auto_instancing_ = false;
 
 		// For select mode
 
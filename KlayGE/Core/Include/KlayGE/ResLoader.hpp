@@ -34,12 +34,14 @@
 #pragma once
 
 #include <KlayGE/PreDeclare.hpp>
+#include <array>
+#include <atomic>
 #include <istream>
+#include <queue>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include <boost/lockfree/spsc_queue.hpp>
-
 #include <KFL/ResIdentifier.hpp>
 #include <KFL/Thread.hpp>
 
@@ -69,6 +71,11 @@ namespace KlayGE
 
 		virtual bool HasSubThreadStage() const = 0;
 
+		// Descs that Match() each other must have the same key hash. The default one puts all descs of a type in one bucket.
+		virtual uint64_t KeyHash() const
+		{
+			return this->Type();
+		}
 		virtual bool Match(ResLoadingDesc const & rhs) const = 0;
 		virtual void CopyDataFrom(ResLoadingDesc const & rhs) = 0;
 		virtual std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource) = 0;
@@ -105,7 +112,7 @@ namespace KlayGE
 		std::string AbsPath(std::string_view path);
 
 		std::shared_ptr<void> SyncQuery(ResLoadingDescPtr const & res_desc);
-		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc);
+		std::shared_ptr<void> ASyncQuery(ResLoadingDescPtr const & res_desc, int32_t priority = 0);
 		void Unload(std::shared_ptr<void> const & res);
 
 		template <typename T>
@@ -115,9 +122,9 @@ namespace KlayGE
 		}
 
 		template <typename T>
-		std::shared_ptr<T> ASyncQueryT(ResLoadingDescPtr const & res_desc)
+		std::shared_ptr<T> ASyncQueryT(ResLoadingDescPtr const & res_desc, int32_t priority = 0)
 		{
-			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc));
+			return std::static_pointer_cast<T>(this->ASyncQuery(res_desc, priority));
 		}
 
 		template <typename T>
@@ -128,7 +135,21 @@ namespace KlayGE
 
 		void Update();
 
+		// Number of worker threads running SubThreadStage of async loading requests.
+		void NumLoadingThreads(uint32_t num);
+		uint32_t NumLoadingThreads() const
+		{
+			return num_loading_threads_;
+		}
+
 	private:
+		enum LoadingStatus
+		{
+			LS_Loading,
+			LS_Complete,
+			LS_CanBeRemoved
+		};
+
 		std::string RealPath(std::string_view path);
 		std::string RealPath(std::string_view path,
 			std::string& package_path, std::string& password, std::string& path_in_package);
@@ -137,9 +158,13 @@ namespace KlayGE
 
 		void AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res);
 		std::shared_ptr<void> FindMatchLoadedResource(ResLoadingDescPtr const & res_desc);
+		std::shared_ptr<volatile LoadingStatus> FindMatchLoadingResource(ResLoadingDescPtr const & res_desc);
+		void AddLoadingResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<volatile LoadingStatus> const & status);
 		void RemoveUnrefResources();
 
 		void LoadingThreadFunc();
+		void StartLoadingThreads(uint32_t num);
+		void StopLoadingThreads();
 
 #if defined(KLAYGE_PLATFORM_ANDROID)
 		AAsset* LocateFileAndroid(std::string_view name);
@@ -152,27 +177,53 @@ namespace KlayGE
 	private:
 		static std::unique_ptr<ResLoader> res_loader_instance_;
 
-		enum LoadingStatus
-		{
-			LS_Loading,
-			LS_Complete,
-			LS_CanBeRemoved
-		};
-
 		std::string exe_path_;
 		std::string local_path_;
 		std::vector<std::tuple<uint64_t, uint32_t, std::string, PackagePtr>> paths_;
 		std::mutex paths_mutex_;
 
-		std::mutex loaded_mutex_;
-		std::mutex loading_mutex_;
-		std::vector<std::pair<ResLoadingDescPtr, std::weak_ptr<void>>> loaded_res_;
-		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> loading_res_;
-		boost::lockfree::spsc_queue<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>,
-			boost::lockfree::capacity<1024>> loading_res_queue_;
+		struct LoadingTask
+		{
+			ResLoadingDescPtr res_desc;
+			std::shared_ptr<volatile LoadingStatus> status;
+			int32_t priority;
+			uint64_t seq;
+
+			// Higher priority goes first. Requests with the same priority are served in FIFO order.
+			bool operator<(LoadingTask const & rhs) const
+			{
+				return (priority < rhs.priority) || ((priority == rhs.priority) && (seq > rhs.seq));
+			}
+		};
+
+		// Resource tables are hash maps from ResLoadingDesc::KeyHash(), split into shards with their own locks
+		template <typename T>
+		struct ResTableShard
+		{
+			std::mutex mutex;
+			std::unordered_multimap<uint64_t, std::pair<ResLoadingDescPtr, T>> table;
+		};
+		static uint32_t constexpr NUM_RES_TABLE_SHARDS = 16;
+
+		template <typename T>
+		static ResTableShard<T>& Shard(std::array<ResTableShard<T>, NUM_RES_TABLE_SHARDS>& tables, uint64_t key_hash)
+		{
+			return tables[(key_hash ^ (key_hash >> 32)) % NUM_RES_TABLE_SHARDS];
+		}
+
+		std::array<ResTableShard<std::weak_ptr<void>>, NUM_RES_TABLE_SHARDS> loaded_res_;
+		std::array<ResTableShard<std::shared_ptr<volatile LoadingStatus>>, NUM_RES_TABLE_SHARDS> loading_res_;
+		std::atomic<uint32_t> sweep_shard_;
+
+		std::mutex loading_queue_mutex_;
+		std::condition_variable loading_queue_cond_;
+		std::priority_queue<LoadingTask> loading_res_queue_;
+		uint64_t loading_seq_;
 
-		std::unique_ptr<joiner<void>> loading_thread_;
-		volatile bool quit_;
+		std::mutex loading_threads_mutex_;
+		std::vector<joiner<void>> loading_threads_;
+		uint32_t num_loading_threads_;
+		bool quit_;
 	};
 }
 
@@ -28,6 +28,8 @@
 #include <KFL/Frustum.hpp>
 #include <KFL/Thread.hpp>
 
+#include <atomic>
+#include <list>
 #include <vector>
 #include <unordered_map>
 
@@ -89,6 +91,9 @@ namespace KlayGE
 		virtual BoundOverlap OBBVisible(OBBox const & obb) const;
 		virtual BoundOverlap SphereVisible(Sphere const & sphere) const;
 		virtual BoundOverlap FrustumVisible(Frustum const & frustum) const;
+		// Bit i % 32 of visible_masks[i / 32] is set when AABBVisible(aabbs.Get(i)) != BO_No, tested in one batch.
+		// visible_masks needs (aabbs.Size() + 31) / 32 words.
+		virtual void AABBsVisible(AABBoxSoA const & aabbs, uint32_t* visible_masks) const;
 
 		virtual void ClearCamera();
 		virtual void ClearLight();
@@ -103,7 +108,16 @@ namespace KlayGE
 		uint32_t NumDrawCalls() const;
 		uint32_t NumDispatchCalls() const;
 
-		virtual void OnSceneChanged() = 0;
+		// The results of ClipScene are cached per camera, view projection and set of invisible nodes, and reused until
+		// a node moves, appears or disappears. Hits and misses are counted over the last frame.
+		void VisibleMarksCacheCapacity(uint32_t capacity);
+		uint32_t VisibleMarksCacheCapacity() const;
+		uint32_t NumVisibleMarksCacheHits() const;
+		uint32_t NumVisibleMarksCacheMisses() const;
+		size_t VisibleMarksCacheMemory() const;
+
+		virtual void OnSceneChanged();
+		void OnSceneNodeVisibleChanged(SceneNode const & node);
 
 		bool NodesUpdated() const
 		{
@@ -119,6 +133,11 @@ namespace KlayGE
 		virtual void DoResume() = 0;
 
 		void UpdateThreadFunc();
+		void RunSubThreadUpdates(float app_time, float elapsed_time);
+
+		void FlattenSceneNodes();
+		void UpdateSceneNodeTransforms();
+		bool UpdateSceneNodeBounds();
 
 		BoundOverlap VisibleTestFromParent(SceneNode const & node, float3 const & view_dir, float3 const & eye_pos,
 			float4x4 const & view_proj);
@@ -130,7 +149,24 @@ namespace KlayGE
 		SceneNode scene_root_;
 		SceneNode overlay_root_;
 
-		std::unordered_map<size_t, std::unique_ptr<BoundOverlap[]>> visible_marks_map_;
+		// LRU of visible marks, most recently used at front
+		struct VisibleMarksEntry
+		{
+			size_t key;
+			uint32_t scene_version;
+			float4x4 view_proj;
+			std::vector<BoundOverlap> marks;
+		};
+		std::list<VisibleMarksEntry> visible_marks_lru_;
+		std::unordered_map<size_t, std::list<VisibleMarksEntry>::iterator> visible_marks_map_;
+		uint32_t visible_marks_cache_capacity_;
+		uint32_t num_visible_marks_cache_hits_;
+		uint32_t num_visible_marks_cache_misses_;
+
+		// Bumped whenever a node's bound changes or the scene graph changes, which invalidates all cached marks
+		uint32_t scene_version_;
+		// XOR of a per-node hash over the nodes whose visibility flipped, so the key doesn't need a walk over all nodes
+		std::atomic<size_t> visible_nodes_hash_;
 
 		float small_obj_threshold_;
 		float update_elapse_;
@@ -138,13 +174,73 @@ namespace KlayGE
 		std::vector<SceneNode*> all_scene_nodes_;
 		std::vector<SceneNode*> all_overlay_nodes_;
 
+		// The scene graph flattened breadth first. Parents come before their children, the children of a node are
+		// contiguous, and every depth level is a contiguous range [flat_level_offsets_[l], flat_level_offsets_[l + 1]).
+		std::vector<SceneNode*> flat_nodes_;
+		std::vector<int32_t> flat_parents_;
+		std::vector<uint32_t> flat_first_children_;
+		std::vector<uint32_t> flat_num_children_;
+		std::vector<uint32_t> flat_level_offsets_;
+		std::vector<uint8_t> flat_world_changed_;
+		std::vector<uint8_t> flat_bound_changed_;
+		bool flat_nodes_dirty_;
+
+		// Taken under update_mutex_ at the start of each sub thread pass, one contiguous range per top level subtree.
+		// Holding the pointers keeps nodes removed meanwhile alive until the recorded writes are applied.
+		std::vector<SceneNodePtr> sub_thread_nodes_;
+		std::vector<uint32_t> sub_thread_subtree_offsets_;
+		std::vector<std::vector<std::function<void()>>> sub_thread_writes_;
+
 	private:
 		void FlushScene();
+		void BuildAutoInstanceBatches();
+		RenderLayout& AutoInstanceLayout(RenderLayout const & geometry);
 
 	private:
 		uint32_t urt_;
 
-		std::vector<std::pair<RenderTechnique const *, std::vector<Renderable*>>> render_queue_;
+		// The render queue is a flat list of renderables, drawn in the order of 64-bit sort keys:
+		// technique rank by weight (16 bits) | material (16 bits) | min view depth (32 bits).
+		// Material and depth are only keyed for opaque techniques without discard, others keep their queue order.
+		std::vector<Renderable*> render_queue_;
+		std::vector<uint32_t> render_queue_tech_ids_;
+		std::vector<uint32_t> render_queue_mtl_ids_;
+		std::vector<RenderTechnique const *> render_queue_techs_;
+		std::unordered_map<RenderTechnique const *, uint32_t> render_queue_tech_map_;
+		std::unordered_map<RenderMaterial const *, uint32_t> render_queue_mtl_map_;
+		std::vector<uint32_t> render_queue_tech_ranks_;
+		std::vector<uint64_t> render_queue_keys_;
+		std::vector<uint32_t> render_queue_order_;
+		std::vector<uint64_t> render_queue_tmp_keys_;
+		std::vector<uint32_t> render_queue_tmp_order_;
+
+		// Auto instancing. Queued renderables with the same technique, material and geometry form a batch, drawn once
+		// where its first renderable is in the sorted queue. World matrices of all batches go to one pooled buffer.
+		struct AutoInstanceBatch
+		{
+			Renderable* renderable;
+			RenderTechnique const * tech;
+			RenderMaterial const * mtl;
+			RenderLayout const * geometry;
+			uint32_t first_instance;
+			uint32_t num_instances;
+			uint32_t num_written;
+		};
+		std::vector<AutoInstanceBatch> auto_inst_batches_;
+		std::unordered_map<size_t, uint32_t> auto_inst_batch_map_;
+		std::vector<uint32_t> render_queue_batch_ids_;
+		GraphicsBufferPtr auto_inst_buffer_;
+		// Instanced copies of the source layouts. Entries not used during a frame are evicted at the end of Update, so a
+		// destroyed source layout is forgotten before its address can be reused.
+		struct AutoInstanceLayoutEntry
+		{
+			RenderLayoutPtr rl;
+			bool used;
+		};
+		std::unordered_map<RenderLayout const *, AutoInstanceLayoutEntry> auto_inst_layouts_;
+
+		PerfRangePtr render_queue_build_perf_;
+		PerfRangePtr render_queue_sort_perf_;
 
 		uint32_t num_objects_rendered_;
 		uint32_t num_renderables_rendered_;
@@ -141,6 +141,15 @@ namespace KlayGE
 
 		void TransformToParent(float4x4 const& mat);
 		void TransformToWorld(float4x4 const& mat);
+
+		// SceneManager runs the sub thread updates of independent subtrees on the thread pool, without its update lock.
+		// Between Begin and End on a worker, writes that Flush may read are recorded in writes instead of being done, and
+		// SceneManager applies all of them under the lock once every subtree is finished. The transform setters record
+		// themselves, other writes go through DeferSubThreadWrite, which runs them right away outside of such a pass.
+		static void BeginSubThreadWrites(std::vector<std::function<void()>>& writes);
+		static void EndSubThreadWrites();
+		static void DeferSubThreadWrite(std::function<void()> const & write);
+
 		float4x4 const& TransformToParent() const;
 		float4x4 const& InverseTransformToParent() const;
 		float4x4 const& TransformToWorld() const;
@@ -148,7 +157,13 @@ namespace KlayGE
 		AABBox const& PosBoundOS() const;
 		AABBox const& PosBoundWS() const;
 		void UpdateTransforms();
-		void UpdatePosBoundSubtree();
+		bool TransformsDirty() const;
+		bool PosBoundDirty() const;
+		// Recomputes the bound of this node only, assuming its children are up to date. Returns true if the world space
+		// bound changed.
+		bool UpdatePosBound();
+		// Returns true if the world space bound of any node in the subtree changed
+		bool UpdatePosBoundSubtree();
 		bool Updated() const;
 		void VisibleMark(BoundOverlap vm);
 		BoundOverlap VisibleMark() const;
@@ -212,6 +227,7 @@ namespace KlayGE
 		std::unique_ptr<AABBox> pos_aabb_os_;
 		std::unique_ptr<AABBox> pos_aabb_ws_;
 		bool pos_aabb_dirty_ = true;
+		bool xform_dirty_ = true;
 		BoundOverlap visible_mark_ = BO_No;
 
 		UpdateEvent sub_thread_update_event_;
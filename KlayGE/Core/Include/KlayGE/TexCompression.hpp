@@ -36,6 +36,7 @@
 #include <KlayGE/PreDeclare.hpp>
 
 #include <array>
+#include <functional>
 
 namespace KlayGE
 {
@@ -61,6 +62,10 @@ namespace KlayGE
 	class KLAYGE_CORE_API TexCompression : boost::noncopyable
 	{
 	public:
+		TexCompression()
+			: num_threads_(0), use_simd_(true)
+		{
+		}
 		virtual ~TexCompression()
 		{
 		}
@@ -68,6 +73,30 @@ namespace KlayGE
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) = 0;
 		virtual void DecodeBlock(void* output, void const * input) = 0;
 
+		// An instance for one more worker thread. Codecs that keep per-block scratch state in members return a fresh
+		// one. Stateless codecs return nullptr to share this instance with all workers.
+		virtual TexCompressionPtr Clone() const = 0;
+
+		// Number of threads used by EncodeMem/DecodeMem. 0 means one per hardware thread.
+		void NumThreads(uint32_t num)
+		{
+			num_threads_ = num;
+		}
+		uint32_t NumThreads() const
+		{
+			return num_threads_;
+		}
+
+		// Codecs with SIMD kernels use them when the CPU supports them. The scalar path produces identical results.
+		virtual void UseSIMD(bool use)
+		{
+			use_simd_ = use;
+		}
+		bool UseSIMD() const
+		{
+			return use_simd_;
+		}
+
 		virtual void EncodeMem(uint32_t width, uint32_t height, 
 			void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 			void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -79,8 +108,17 @@ namespace KlayGE
 		virtual void EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method);
 		virtual void DecodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex);
 
+	private:
+		uint32_t NumWorkers(uint32_t num_block_rows, uint32_t num_blocks_per_row, uint32_t min_blocks_per_worker) const;
+		void RunWorkers(uint32_t num_workers, uint32_t num_block_rows,
+			std::function<void(TexCompression&, uint32_t, uint32_t)> const & process_rows);
+
 	protected:
 		ElementFormat compression_format_;
+
+	private:
+		uint32_t num_threads_;
+		bool use_simd_;
 	};
 
 	class ARGBColor32 : boost::equality_comparable<ARGBColor32>
@@ -34,6 +34,7 @@
 #pragma once
 
 #include <cstring>
+#include <random>
 
 #include <KlayGE/TexCompression.hpp>
 
@@ -82,6 +83,7 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
 		void EncodeBC1Internal(BC1Block& bc1, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
 
@@ -100,6 +102,10 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+		using TexCompression::UseSIMD;
+		virtual void UseSIMD(bool use) override;
 
 	private:
 		TexCompressionBC1 bc1_codec_;
@@ -112,6 +118,7 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC3 : public TexCompression
@@ -121,6 +128,10 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+		using TexCompression::UseSIMD;
+		virtual void UseSIMD(bool use) override;
 
 	private:
 		TexCompressionBC1 bc1_codec_;
@@ -134,6 +145,10 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+		using TexCompression::UseSIMD;
+		virtual void UseSIMD(bool use) override;
 
 	private:
 		TexCompressionBC4 bc4_codec_;
@@ -146,16 +161,15 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
+		void EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt);
 		void DecodeBC6Internal(void* output, void const * input, bool signed_fmt);
 
-	private:
-		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
-		int FinishUnquantize(int comp, bool signed_fmt);
-
 	private:
 		static uint32_t const BC6_MAX_REGIONS = 2;
 		static uint32_t const BC6_MAX_INDICES = 16;
+		static uint32_t const BC6_MAX_SHAPES = 32;
 
 		static int32_t const BC6_WEIGHT_MAX = 64;
 		static uint32_t const BC6_WEIGHT_SHIFT = 6;
@@ -195,6 +209,22 @@ namespace KlayGE
 			ARGBColor32 rgba_prec[BC6_MAX_REGIONS][2];
 		};
 
+	private:
+		float EncodeBC6Mode(void* output, uint32_t mode_index, uint32_t shape,
+			std::pair<float3, float3> const * end_pts, int3 const * pixels, uint32_t num_refinements, bool signed_fmt);
+		float AssignBC6Indices(uint8_t* indices, std::pair<int3, int3> const * end_pts,
+			ModeInfo const & info, uint32_t shape, int3 const * pixels, bool signed_fmt);
+		void FixAnchorIndices(std::pair<int3, int3>* end_pts, uint8_t* indices, ModeInfo const & info, uint32_t shape);
+		bool TransformForward(std::pair<int3, int3>* end_pts, ModeInfo const & info);
+		void PackBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+			std::pair<int3, int3> const * end_pts, uint8_t const * indices);
+
+		int Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
+		int3 QuantizeEndPoint(float3 const & pt, ARGBColor32 const & prec, bool signed_fmt);
+		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
+		int FinishUnquantize(int comp, bool signed_fmt);
+
+	private:
 		static ModeDescriptor const mode_desc_[][82];
 		static ModeInfo const mode_info_[];
 		static int const mode_to_info_[];
@@ -207,6 +237,7 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
 	private:
 		TexCompressionBC6U bc6u_codec_;
@@ -272,6 +303,7 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
 	private:
 		void PackBC7UniformBlock(void* output, ARGBColor32 const & pixel);
@@ -311,6 +343,10 @@ namespace KlayGE
 		int rotate_mode_;
 		int index_mode_;
 
+		// Simulated annealing random numbers. It's seeded from each block, so the result of a block doesn't depend on
+		// which blocks this codec encoded before.
+		mutable std::mt19937 sa_gen_;
+
 		static ModeInfo const mode_info_[];
 	};
 
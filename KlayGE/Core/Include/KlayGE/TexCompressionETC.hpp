@@ -89,6 +89,13 @@ namespace KlayGE
 		ETC2HModeBlock etc2_h_mode;
 		ETC2PlanarModeBlock etc2_planar_mode;
 	};
+
+	struct EACBlock
+	{
+		uint8_t base;
+		uint8_t mul_table;
+		uint8_t indices[6];
+	};
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(pop)
 #endif
@@ -131,6 +138,7 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
 		uint64_t EncodeETC1BlockInternal(ETC1Block& output, ARGBColor32 const * argb, TexCompressionMethod method);
 		void DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const;
@@ -208,7 +216,11 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
 
+		uint64_t EncodeETCTModeInternal(ETC2TModeBlock& etc2, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
+		uint64_t EncodeETCHModeInternal(ETC2HModeBlock& etc2, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
+		uint64_t EncodeETCPlanarModeInternal(ETC2PlanarModeBlock& etc2, ARGBColor32 const * argb, TexCompressionMethod method) const;
 		void DecodeETCTModeInternal(ARGBColor32* argb, ETC2TModeBlock const & etc2, bool alpha);
 		void DecodeETCHModeInternal(ARGBColor32* argb, ETC2HModeBlock const & etc2, bool alpha);
 		void DecodeETCPlanarModeInternal(ARGBColor32* argb, ETC2PlanarModeBlock const & etc2);
@@ -224,11 +236,45 @@ namespace KlayGE
 
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+	private:
+		uint64_t EncodeETCDifferentialModeInternal(ETC1Block& etc1, ARGBColor32 const * argb, bool alpha,
+			TexCompressionMethod method) const;
 
 	private:
 		TexCompressionETC1Ptr etc1_codec_;
 		TexCompressionETC2RGB8Ptr etc2_rgb8_codec_;
 	};
+
+	class KLAYGE_CORE_API TexCompressionETC2R11 : public TexCompression
+	{
+	public:
+		explicit TexCompressionETC2R11(bool signed_fmt = false);
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+		void EncodeEACBlockInternal(EACBlock& eac, int const * values, TexCompressionMethod method) const;
+		void DecodeEACBlockInternal(int* values, EACBlock const & eac) const;
+
+	private:
+		bool signed_;
+	};
+
+	class KLAYGE_CORE_API TexCompressionETC2RG11 : public TexCompression
+	{
+	public:
+		explicit TexCompressionETC2RG11(bool signed_fmt = false);
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+		virtual TexCompressionPtr Clone() const override;
+
+	private:
+		TexCompressionETC2R11 r11_codec_;
+	};
 }
 
 #endif		// _TEXCOMPRESSIONETC_HPP
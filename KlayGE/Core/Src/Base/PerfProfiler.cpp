@@ -47,10 +47,10 @@ namespace KlayGE
 {
 	std::unique_ptr<PerfProfiler> PerfProfiler::perf_profiler_instance_;
 
-	PerfRange::PerfRange()
-		: cpu_time_(0), gpu_time_(0), dirty_(false)
+	PerfRange::PerfRange(bool gpu_timing)
+		: cpu_time_(0), gpu_time_(gpu_timing ? 0 : -1), dirty_(false)
 	{
-		if (Context::Instance().Config().perf_profiler)
+		if (gpu_timing && Context::Instance().Config().perf_profiler)
 		{
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			gpu_timer_query_ = rf.MakeTimerQuery();
@@ -61,7 +61,11 @@ namespace KlayGE
 	{
 		if (Context::Instance().Config().perf_profiler)
 		{
-			dirty_ = true;
+			if (!dirty_)
+			{
+				cpu_time_ = 0;
+				dirty_ = true;
+			}
 			cpu_timer_.restart();
 			if (gpu_timer_query_)
 			{
@@ -74,7 +78,7 @@ namespace KlayGE
 	{
 		if (Context::Instance().Config().perf_profiler)
 		{
-			cpu_time_ = cpu_timer_.elapsed();
+			cpu_time_ += cpu_timer_.elapsed();
 			if (gpu_timer_query_)
 			{
 				gpu_timer_query_->End();
@@ -142,9 +146,9 @@ namespace KlayGE
 	{
 	}
 
-	PerfRangePtr PerfProfiler::CreatePerfRange(int category, std::string const & name)
+	PerfRangePtr PerfProfiler::CreatePerfRange(int category, std::string const & name, bool gpu_timing)
 	{
-		PerfRangePtr range = MakeSharedPtr<PerfRange>();
+		PerfRangePtr range = MakeSharedPtr<PerfRange>(gpu_timing);
 		typedef std::remove_reference<decltype(std::get<3>(perf_ranges_[0]))>::type PerfDataType;
 		perf_ranges_.push_back(std::make_tuple(category, name, range, PerfDataType()));
 		return range;
@@ -30,6 +30,7 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/MappedFile.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/Package.hpp>
 #include <KFL/CXX17/filesystem.hpp>
@@ -101,7 +102,7 @@ namespace KlayGE
 	std::unique_ptr<ResLoader> ResLoader::res_loader_instance_;
 
 	ResLoader::ResLoader()
-		: quit_(false)
+		: sweep_shard_(0), loading_seq_(0), num_loading_threads_(0), quit_(false)
 	{
 #if defined KLAYGE_PLATFORM_WINDOWS
 #if defined KLAYGE_PLATFORM_WINDOWS_DESKTOP
@@ -232,14 +233,14 @@ namespace KlayGE
 #endif
 #endif
 
-		loading_thread_ = MakeUniquePtr<joiner<void>>(Context::Instance().ThreadPool()(
-			[this] { this->LoadingThreadFunc(); }));
+		// Leave one core for the main thread
+		uint32_t const num_cores = std::thread::hardware_concurrency();
+		this->StartLoadingThreads(std::min(std::max(num_cores, 2U) - 1, 8U));
 	}
 
 	ResLoader::~ResLoader()
 	{
-		quit_ = true;
-		(*loading_thread_)();
+		this->StopLoadingThreads();
 	}
 
 	ResLoader& ResLoader::Instance()
@@ -375,13 +376,25 @@ namespace KlayGE
 		password = "";
 		path_in_package = "";
 
+		std::string_view const package_exts[] = { ".7z", ".kpk" };
+
 		size_t start_offset = 0;
 		for (;;)
 		{
-			auto const pkt_offset = path.find(".7z", start_offset);
+			auto pkt_offset = std::string_view::npos;
+			size_t pkt_end = 0;
+			for (auto const & ext : package_exts)
+			{
+				auto const offset = path.find(ext, start_offset);
+				if (offset < pkt_offset)
+				{
+					pkt_offset = offset;
+					pkt_end = offset + ext.size();
+				}
+			}
 			if (pkt_offset != std::string_view::npos)
 			{
-				package_path = std::string(path.substr(0, pkt_offset + 3));
+				package_path = std::string(path.substr(0, pkt_end));
 				std::filesystem::path pkt_path(package_path);
 #if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
 				std::error_code ec;
@@ -391,10 +404,10 @@ namespace KlayGE
 #endif
 					&& (std::filesystem::is_regular_file(pkt_path) || std::filesystem::is_symlink(pkt_path)))
 				{
-					auto const next_slash_offset = path.find('/', pkt_offset + 3);
-					if ((path.size() > pkt_offset + 3) && (path[pkt_offset + 3] == '|'))
+					auto const next_slash_offset = path.find('/', pkt_end);
+					if ((path.size() > pkt_end) && (path[pkt_end] == '|'))
 					{
-						auto const password_start_offset = pkt_offset + 4;
+						auto const password_start_offset = pkt_end + 1;
 						if (next_slash_offset != std::string_view::npos)
 						{
 							password = std::string(path.substr(password_start_offset, next_slash_offset - password_start_offset));
@@ -412,7 +425,7 @@ namespace KlayGE
 				}
 				else
 				{
-					start_offset = pkt_offset + 3;
+					start_offset = pkt_end;
 				}
 			}
 			else
@@ -520,7 +533,7 @@ namespace KlayGE
 							MakeSharedPtr<std::ifstream>(package_path.c_str(),
 								static_cast<std::ios_base::openmode>(std::ios_base::binary)));
 
-						package = MakeSharedPtr<Package>(package_res, password);
+						package = OpenPackage(package_res, password);
 					}
 				}
 
@@ -679,6 +692,14 @@ namespace KlayGE
 						uint64_t timestamp = std::filesystem::last_write_time(res_path).time_since_epoch().count();
 #else
 						uint64_t timestamp = std::filesystem::last_write_time(res_path);
+#endif
+#if defined(KLAYGE_PLATFORM_LINUX)
+						// Map the file, so the loaders are able to parse it in place through ResIdentifier::View()
+						auto mapped_file = MakeSharedPtr<MappedFile>();
+						if (mapped_file->Map(res_name))
+						{
+							return MakeSharedPtr<ResIdentifier>(name, timestamp, mapped_file->View(), mapped_file);
+						}
 #endif
 						// The static_cast is a workaround for a bug in clang/c2
 						return MakeSharedPtr<ResIdentifier>(name, timestamp,
@@ -759,24 +780,8 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
-			bool found = false;
-			{
-				std::lock_guard<std::mutex> lock(loading_mutex_);
-
-				for (auto const & lrq : loading_res_)
-				{
-					if (lrq.first->Match(*res_desc))
-					{
-						res_desc->CopyDataFrom(*lrq.first);
-						async_is_done = lrq.second;
-						found = true;
-						break;
-					}
-				}
-			}
-
-			if (found)
+			std::shared_ptr<volatile LoadingStatus> async_is_done = this->FindMatchLoadingResource(res_desc);
+			if (async_is_done)
 			{
 				*async_is_done = LS_Complete;
 			}
@@ -798,7 +803,7 @@ namespace KlayGE
 		return res;
 	}
 
-	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc)
+	std::shared_ptr<void> ResLoader::ASyncQuery(ResLoadingDescPtr const & res_desc, int32_t priority)
 	{
 		this->RemoveUnrefResources();
 
@@ -821,31 +826,14 @@ namespace KlayGE
 		}
 		else
 		{
-			std::shared_ptr<volatile LoadingStatus> async_is_done;
-			bool found = false;
-			{
-				std::lock_guard<std::mutex> lock(loading_mutex_);
-
-				for (auto const & lrq : loading_res_)
-				{
-					if (lrq.first->Match(*res_desc))
-					{
-						res_desc->CopyDataFrom(*lrq.first);
-						async_is_done = lrq.second;
-						found = true;
-						break;
-					}
-				}
-			}
-
-			if (found)
+			std::shared_ptr<volatile LoadingStatus> async_is_done = this->FindMatchLoadingResource(res_desc);
+			if (async_is_done)
 			{
 				res = res_desc->Resource();
 
 				if (!res_desc->StateLess())
 				{
-					std::lock_guard<std::mutex> lock(loading_mutex_);
-					loading_res_.emplace_back(res_desc, async_is_done);
+					this->AddLoadingResource(res_desc, async_is_done);
 				}
 			}
 			else
@@ -856,11 +844,13 @@ namespace KlayGE
 
 					async_is_done = MakeSharedPtr<LoadingStatus>(LS_Loading);
 
+					this->AddLoadingResource(res_desc, async_is_done);
 					{
-						std::lock_guard<std::mutex> lock(loading_mutex_);
-						loading_res_.emplace_back(res_desc, async_is_done);
+						std::lock_guard<std::mutex> lock(loading_queue_mutex_);
+						loading_res_queue_.push(LoadingTask{ res_desc, async_is_done, priority, loading_seq_ });
+						++ loading_seq_;
 					}
-					loading_res_queue_.push(std::make_pair(res_desc, async_is_done));
+					loading_queue_cond_.notify_one();
 				}
 				else
 				{
@@ -875,67 +865,108 @@ namespace KlayGE
 
 	void ResLoader::Unload(std::shared_ptr<void> const & res)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
-
-		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end(); ++ iter)
+		for (auto& shard : loaded_res_)
 		{
-			if (res == iter->second.lock())
+			std::lock_guard<std::mutex> lock(shard.mutex);
+
+			for (auto iter = shard.table.begin(); iter != shard.table.end(); ++ iter)
 			{
-				loaded_res_.erase(iter);
-				break;
+				if (res == iter->second.second.lock())
+				{
+					shard.table.erase(iter);
+					return;
+				}
 			}
 		}
 	}
 
 	void ResLoader::AddLoadedResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<void> const & res)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		uint64_t const key_hash = res_desc->KeyHash();
+		auto& shard = Shard(loaded_res_, key_hash);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
 
-		bool found = false;
-		for (auto& c_desc : loaded_res_)
+		auto const range = shard.table.equal_range(key_hash);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
-			if (c_desc.first == res_desc)
+			if (iter->second.first == res_desc)
 			{
-				c_desc.second = std::weak_ptr<void>(res);
-				found = true;
-				break;
+				iter->second.second = std::weak_ptr<void>(res);
+				return;
 			}
 		}
-		if (!found)
+		shard.table.emplace(key_hash, std::make_pair(res_desc, std::weak_ptr<void>(res)));
+	}
+
+	std::shared_ptr<void> ResLoader::FindMatchLoadedResource(ResLoadingDescPtr const & res_desc)
+	{
+		uint64_t const key_hash = res_desc->KeyHash();
+		auto& shard = Shard(loaded_res_, key_hash);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto const range = shard.table.equal_range(key_hash);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
-			loaded_res_.emplace_back(res_desc, std::weak_ptr<void>(res));
+			if (iter->second.first->Match(*res_desc))
+			{
+				// Expired entries could still be here until the sweep reaches this shard
+				std::shared_ptr<void> loaded_res = iter->second.second.lock();
+				if (loaded_res)
+				{
+					return loaded_res;
+				}
+			}
 		}
+		return std::shared_ptr<void>();
 	}
 
-	std::shared_ptr<void> ResLoader::FindMatchLoadedResource(ResLoadingDescPtr const & res_desc)
+	// Copies the data from a matching desc that is still in loading, and returns its status
+	std::shared_ptr<volatile ResLoader::LoadingStatus> ResLoader::FindMatchLoadingResource(ResLoadingDescPtr const & res_desc)
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		uint64_t const key_hash = res_desc->KeyHash();
+		auto& shard = Shard(loading_res_, key_hash);
 
-		std::shared_ptr<void> loaded_res;
-		for (auto const & lr : loaded_res_)
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto const range = shard.table.equal_range(key_hash);
+		for (auto iter = range.first; iter != range.second; ++ iter)
 		{
-			if (lr.first->Match(*res_desc))
+			if (iter->second.first->Match(*res_desc))
 			{
-				loaded_res = lr.second.lock();
-				break;
+				res_desc->CopyDataFrom(*iter->second.first);
+				return iter->second.second;
 			}
 		}
-		return loaded_res;
+		return std::shared_ptr<volatile LoadingStatus>();
+	}
+
+	void ResLoader::AddLoadingResource(ResLoadingDescPtr const & res_desc, std::shared_ptr<volatile LoadingStatus> const & status)
+	{
+		uint64_t const key_hash = res_desc->KeyHash();
+		auto& shard = Shard(loading_res_, key_hash);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.table.emplace(key_hash, std::make_pair(res_desc, status));
 	}
 
 	void ResLoader::RemoveUnrefResources()
 	{
-		std::lock_guard<std::mutex> lock(loaded_mutex_);
+		// Sweep one shard per call, so the cost doesn't grow with the number of loaded resources
+		auto& shard = loaded_res_[sweep_shard_.fetch_add(1) % NUM_RES_TABLE_SHARDS];
 
-		for (auto iter = loaded_res_.begin(); iter != loaded_res_.end();)
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		for (auto iter = shard.table.begin(); iter != shard.table.end();)
 		{
-			if (iter->second.lock())
+			if (iter->second.second.expired())
 			{
-				++ iter;
+				iter = shard.table.erase(iter);
 			}
 			else
 			{
-				iter = loaded_res_.erase(iter);
+				++ iter;
 			}
 		}
 	}
@@ -943,9 +974,13 @@ namespace KlayGE
 	void ResLoader::Update()
 	{
 		std::vector<std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>>> tmp_loading_res;
+		for (auto& shard : loading_res_)
 		{
-			std::lock_guard<std::mutex> lock(loading_mutex_);
-			tmp_loading_res = loading_res_;
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto const & lr : shard.table)
+			{
+				tmp_loading_res.push_back(lr.second);
+			}
 		}
 
 		for (auto& lrq : tmp_loading_res)
@@ -983,13 +1018,14 @@ namespace KlayGE
 			}
 		}
 
+		for (auto& shard : loading_res_)
 		{
-			std::lock_guard<std::mutex> lock(loading_mutex_);
-			for (auto iter = loading_res_.begin(); iter != loading_res_.end();)
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto iter = shard.table.begin(); iter != shard.table.end();)
 			{
-				if (LS_CanBeRemoved == *(iter->second))
+				if (LS_CanBeRemoved == *(iter->second.second))
 				{
-					iter = loading_res_.erase(iter);
+					iter = shard.table.erase(iter);
 				}
 				else
 				{
@@ -999,21 +1035,74 @@ namespace KlayGE
 		}
 	}
 
+	void ResLoader::NumLoadingThreads(uint32_t num)
+	{
+		num = std::max(num, 1U);
+		if (num != num_loading_threads_)
+		{
+			// Pending requests stay in the queue and are picked up by the new workers
+			this->StopLoadingThreads();
+			this->StartLoadingThreads(num);
+		}
+	}
+
+	void ResLoader::StartLoadingThreads(uint32_t num)
+	{
+		std::lock_guard<std::mutex> lock(loading_threads_mutex_);
+
+		{
+			std::lock_guard<std::mutex> queue_lock(loading_queue_mutex_);
+			quit_ = false;
+		}
+
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			loading_threads_.push_back(Context::Instance().ThreadPool()(
+				[this] { this->LoadingThreadFunc(); }));
+		}
+		num_loading_threads_ = num;
+	}
+
+	void ResLoader::StopLoadingThreads()
+	{
+		std::lock_guard<std::mutex> lock(loading_threads_mutex_);
+
+		{
+			std::lock_guard<std::mutex> queue_lock(loading_queue_mutex_);
+			quit_ = true;
+		}
+		loading_queue_cond_.notify_all();
+
+		for (auto& thread : loading_threads_)
+		{
+			thread();
+		}
+		loading_threads_.clear();
+		num_loading_threads_ = 0;
+	}
+
 	void ResLoader::LoadingThreadFunc()
 	{
-		while (!quit_)
+		for (;;)
 		{
-			std::pair<ResLoadingDescPtr, std::shared_ptr<volatile LoadingStatus>> res_pair;
-			while (loading_res_queue_.pop(res_pair))
+			LoadingTask task;
 			{
-				if (LS_Loading == *res_pair.second)
+				std::unique_lock<std::mutex> lock(loading_queue_mutex_);
+				loading_queue_cond_.wait(lock, [this] { return quit_ || !loading_res_queue_.empty(); });
+				if (quit_)
 				{
-					res_pair.first->SubThreadStage();
-					*res_pair.second = LS_Complete;
+					break;
 				}
+
+				task = loading_res_queue_.top();
+				loading_res_queue_.pop();
 			}
 
-			Sleep(10);
+			if (LS_Loading == *task.status)
+			{
+				task.res_desc->SubThreadStage();
+				*task.status = LS_Complete;
+			}
 		}
 	}
 
@@ -43,6 +43,13 @@ namespace KlayGE
 		Convert(password_, pw);
 	}
 
+	ArchiveExtractCallback::ArchiveExtractCallback(std::string_view pw,
+			std::map<uint32_t, std::shared_ptr<ISequentialOutStream>> const & out_file_streams)
+		: password_is_defined_(!pw.empty()), out_file_streams_(out_file_streams)
+	{
+		Convert(password_, pw);
+	}
+
 	STDMETHODIMP_(ULONG) ArchiveExtractCallback::AddRef()
 	{
 		++ ref_count_;
@@ -94,8 +101,6 @@ namespace KlayGE
 
 	STDMETHODIMP ArchiveExtractCallback::GetStream(UInt32 index, ISequentialOutStream** out_stream, Int32 ask_extract_mode)
 	{
-		KFL_UNUSED(index);
-
 		enum
 		{
 			kExtract = 0,
@@ -103,14 +108,23 @@ namespace KlayGE
 			kSkip,
 		};
 
+		*out_stream = nullptr;
 		if (kExtract == ask_extract_mode)
 		{
-			out_file_stream_->AddRef();
-			*out_stream = out_file_stream_.get();
-		}
-		else
-		{
-			*out_stream = nullptr;
+			ISequentialOutStream* stream = out_file_stream_.get();
+			if (!stream)
+			{
+				auto iter = out_file_streams_.find(index);
+				if (iter != out_file_streams_.end())
+				{
+					stream = iter->second.get();
+				}
+			}
+			if (stream)
+			{
+				stream->AddRef();
+				*out_stream = stream;
+			}
 		}
 		return S_OK;
 	}
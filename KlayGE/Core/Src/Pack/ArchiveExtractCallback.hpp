@@ -34,6 +34,7 @@
 #pragma once
 
 #include <atomic>
+#include <map>
 #include <string>
 
 #include <CPP/7zip/Archive/IArchive.h>
@@ -63,6 +64,8 @@ namespace KlayGE
 
 	public:
 		ArchiveExtractCallback(std::string_view pw, std::shared_ptr<ISequentialOutStream> const & out_file_stream);
+		// Extracts multiple items in one pass, each into its own stream
+		ArchiveExtractCallback(std::string_view pw, std::map<uint32_t, std::shared_ptr<ISequentialOutStream>> const & out_file_streams);
 		virtual ~ArchiveExtractCallback() = default;
 
 	private:
@@ -72,6 +75,7 @@ namespace KlayGE
 		std::wstring password_;
 
 		std::shared_ptr<ISequentialOutStream> out_file_stream_;
+		std::map<uint32_t, std::shared_ptr<ISequentialOutStream>> out_file_streams_;
 	};
 }
 
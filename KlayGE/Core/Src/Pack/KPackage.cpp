@@ -0,0 +1,336 @@
+/**
+ * @file KPackage.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/MappedFile.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/LZMACodec.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Package.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const INVALID_INDEX = 0xFFFFFFFF;
+
+	// All in little endian
+	struct KPackageHeader
+	{
+		uint32_t fourcc;
+		uint32_t version;
+		uint32_t num_entries;
+		uint32_t alignment;
+		uint64_t toc_offset;
+		uint64_t names_offset;
+	};
+	static_assert(sizeof(KPackageHeader) == 32, "sizeof(KPackageHeader) must be 32.");
+
+	struct KPackageTocEntry
+	{
+		uint64_t offset;
+		uint64_t stored_size;
+		uint64_t original_size;
+		uint64_t mtime;
+		uint32_t name_offset;
+		uint32_t name_len;
+		uint32_t compression;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(KPackageTocEntry) == 48, "sizeof(KPackageTocEntry) must be 48.");
+
+	uint32_t const KPACKAGE_FOURCC = MakeFourCC<'K', 'P', 'A', 'K'>::value;
+}
+
+namespace KlayGE
+{
+	bool KPackage::IsKPackage(ResIdentifierPtr const & archive_is)
+	{
+		uint32_t fourcc = 0;
+		archive_is->seekg(0, std::ios_base::beg);
+		archive_is->read(&fourcc, sizeof(fourcc));
+		bool const ret = *archive_is && (LE2Native(fourcc) == KPACKAGE_FOURCC);
+		archive_is->clear();
+		archive_is->seekg(0, std::ios_base::beg);
+		return ret;
+	}
+
+	KPackage::KPackage(ResIdentifierPtr const & archive_is)
+		: Package(archive_is)
+	{
+		auto mapped_file = MakeSharedPtr<MappedFile>();
+		if (mapped_file->Map(archive_is_->ResName()))
+		{
+			data_ = mapped_file->View();
+			storage_ = mapped_file;
+		}
+		else
+		{
+			// Not a file on disk. Read the whole package into memory.
+			archive_is_->seekg(0, std::ios_base::end);
+			auto file_data = MakeSharedPtr<std::vector<uint8_t>>(static_cast<size_t>(archive_is_->tellg()));
+			archive_is_->seekg(0, std::ios_base::beg);
+			archive_is_->read(file_data->data(), file_data->size());
+			data_ = *file_data;
+			storage_ = file_data;
+		}
+
+		KPackageHeader header;
+		if (data_.size() < sizeof(header))
+		{
+			TERRC(std::errc::illegal_byte_sequence);
+		}
+		std::memcpy(&header, data_.data(), sizeof(header));
+		header.fourcc = LE2Native(header.fourcc);
+		header.version = LE2Native(header.version);
+		header.num_entries = LE2Native(header.num_entries);
+		header.alignment = LE2Native(header.alignment);
+		header.toc_offset = LE2Native(header.toc_offset);
+		header.names_offset = LE2Native(header.names_offset);
+		if ((header.fourcc != KPACKAGE_FOURCC) || (header.version != VERSION)
+			|| (header.toc_offset + header.num_entries * sizeof(KPackageTocEntry) > data_.size())
+			|| (header.names_offset > data_.size()))
+		{
+			TERRC(std::errc::illegal_byte_sequence);
+		}
+
+		char const * names = reinterpret_cast<char const *>(data_.data() + header.names_offset);
+		uint64_t const names_size = data_.size() - header.names_offset;
+
+		entries_.resize(header.num_entries);
+		for (uint32_t i = 0; i < header.num_entries; ++ i)
+		{
+			KPackageTocEntry toc_entry;
+			std::memcpy(&toc_entry, data_.data() + header.toc_offset + i * sizeof(toc_entry), sizeof(toc_entry));
+
+			Entry& entry = entries_[i];
+			entry.offset = LE2Native(toc_entry.offset);
+			entry.stored_size = LE2Native(toc_entry.stored_size);
+			entry.original_size = LE2Native(toc_entry.original_size);
+			entry.mtime = LE2Native(toc_entry.mtime);
+			entry.compression = LE2Native(toc_entry.compression);
+
+			uint32_t const name_offset = LE2Native(toc_entry.name_offset);
+			uint32_t const name_len = LE2Native(toc_entry.name_len);
+			if ((entry.offset + entry.stored_size > data_.size()) || (name_offset + static_cast<uint64_t>(name_len) > names_size))
+			{
+				TERRC(std::errc::illegal_byte_sequence);
+			}
+			entry.name = std::string_view(names + name_offset, name_len);
+		}
+	}
+
+	bool KPackage::Locate(std::string_view extract_file_path)
+	{
+		return (this->Find(extract_file_path) != INVALID_INDEX);
+	}
+
+	ResIdentifierPtr KPackage::Extract(std::string_view extract_file_path, std::string_view res_name)
+	{
+		uint32_t const index = this->Find(extract_file_path);
+		if (index == INVALID_INDEX)
+		{
+			return ResIdentifierPtr();
+		}
+
+		Entry const & entry = entries_[index];
+		ArrayRef<uint8_t> const stored(data_.data() + entry.offset, static_cast<size_t>(entry.stored_size));
+
+		switch (entry.compression)
+		{
+		case CM_Stored:
+			return MakeSharedPtr<ResIdentifier>(res_name, entry.mtime, stored, storage_);
+
+		case CM_LZMA:
+			{
+				auto decoded = MakeSharedPtr<std::vector<uint8_t>>();
+				LZMACodec lzma;
+				lzma.Decode(*decoded, stored, entry.original_size);
+				return MakeSharedPtr<ResIdentifier>(res_name, entry.mtime, ArrayRef<uint8_t>(*decoded), decoded);
+			}
+
+		default:
+			TERRC(std::errc::function_not_supported);
+		}
+	}
+
+	uint32_t KPackage::Find(std::string_view extract_file_path) const
+	{
+		std::string const path = NormalizePath(extract_file_path);
+		auto iter = std::lower_bound(entries_.begin(), entries_.end(), path,
+			[](Entry const & lhs, std::string const & rhs)
+			{
+				return lhs.name < rhs;
+			});
+		if ((iter != entries_.end()) && (iter->name == path))
+		{
+			return static_cast<uint32_t>(iter - entries_.begin());
+		}
+		else
+		{
+			return INVALID_INDEX;
+		}
+	}
+
+
+	void SaveKPackage(std::string_view pkg_name, std::vector<std::tuple<std::string, ResIdentifierPtr, bool>> const & files)
+	{
+		std::vector<std::tuple<std::string, std::function<ResIdentifierPtr()>, bool>> lazy_files;
+		lazy_files.reserve(files.size());
+		for (auto const & file : files)
+		{
+			ResIdentifierPtr const & res = std::get<1>(file);
+			lazy_files.emplace_back(std::get<0>(file), [res] { return res; }, std::get<2>(file));
+		}
+		SaveKPackage(pkg_name, lazy_files);
+	}
+
+	void SaveKPackage(std::string_view pkg_name,
+		std::vector<std::tuple<std::string, std::function<ResIdentifierPtr()>, bool>> const & files)
+	{
+		struct SortedFile
+		{
+			std::string name;
+			std::function<ResIdentifierPtr()> open;
+			bool compress;
+		};
+		std::vector<SortedFile> sorted_files;
+		sorted_files.reserve(files.size());
+		for (auto const & file : files)
+		{
+			sorted_files.push_back({ Package::NormalizePath(std::get<0>(file)), std::get<1>(file), std::get<2>(file) });
+		}
+		std::stable_sort(sorted_files.begin(), sorted_files.end(),
+			[](SortedFile const & lhs, SortedFile const & rhs)
+			{
+				return lhs.name < rhs.name;
+			});
+		// Only the first file of a path counts
+		sorted_files.erase(std::unique(sorted_files.begin(), sorted_files.end(),
+			[](SortedFile const & lhs, SortedFile const & rhs)
+			{
+				return lhs.name == rhs.name;
+			}), sorted_files.end());
+
+		std::ofstream ofs(std::string(pkg_name).c_str(), std::ios_base::binary);
+		if (!ofs)
+		{
+			TERRC(std::errc::no_such_file_or_directory);
+		}
+
+		auto pad_to = [&ofs](uint64_t alignment)
+		{
+			uint64_t const pos = static_cast<uint64_t>(ofs.tellp());
+			uint64_t const padding = (alignment - pos % alignment) % alignment;
+			for (uint64_t i = 0; i < padding; ++ i)
+			{
+				ofs.put(0);
+			}
+		};
+
+		KPackageHeader header;
+		std::memset(&header, 0, sizeof(header));
+		ofs.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+		std::vector<KPackageTocEntry> toc(sorted_files.size());
+		std::string names;
+		LZMACodec lzma;
+		std::vector<uint8_t> content;
+		std::vector<uint8_t> compressed;
+		for (size_t i = 0; i < sorted_files.size(); ++ i)
+		{
+			auto const & file = sorted_files[i];
+
+			ResIdentifierPtr const res = file.open();
+			if (!res)
+			{
+				TERRC(std::errc::no_such_file_or_directory);
+			}
+
+			res->seekg(0, std::ios_base::end);
+			content.resize(static_cast<size_t>(res->tellg()));
+			res->seekg(0, std::ios_base::beg);
+			res->read(content.data(), content.size());
+
+			ArrayRef<uint8_t> stored = content;
+			uint32_t compression = KPackage::CM_Stored;
+			if (file.compress && !content.empty())
+			{
+				compressed.clear();
+				lzma.Encode(compressed, content);
+				// Keep it stored if compressing saves less than 1/8, it would only slow down loading
+				if (compressed.size() < content.size() - content.size() / 8)
+				{
+					stored = compressed;
+					compression = KPackage::CM_LZMA;
+				}
+			}
+
+			pad_to(KPackage::ALIGNMENT);
+
+			KPackageTocEntry& toc_entry = toc[i];
+			toc_entry.offset = Native2LE(static_cast<uint64_t>(ofs.tellp()));
+			toc_entry.stored_size = Native2LE(static_cast<uint64_t>(stored.size()));
+			toc_entry.original_size = Native2LE(static_cast<uint64_t>(content.size()));
+			toc_entry.mtime = Native2LE(res->Timestamp());
+			toc_entry.name_offset = Native2LE(static_cast<uint32_t>(names.size()));
+			toc_entry.name_len = Native2LE(static_cast<uint32_t>(file.name.size()));
+			toc_entry.compression = Native2LE(compression);
+			toc_entry.reserved = 0;
+
+			ofs.write(reinterpret_cast<char const *>(stored.data()), static_cast<std::streamsize>(stored.size()));
+			names += file.name;
+		}
+
+		pad_to(8);
+		header.toc_offset = static_cast<uint64_t>(ofs.tellp());
+		ofs.write(reinterpret_cast<char const *>(toc.data()), static_cast<std::streamsize>(toc.size() * sizeof(toc[0])));
+		header.names_offset = static_cast<uint64_t>(ofs.tellp());
+		ofs.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+		header.fourcc = Native2LE(KPACKAGE_FOURCC);
+		header.version = Native2LE(KPackage::VERSION);
+		header.num_entries = Native2LE(static_cast<uint32_t>(toc.size()));
+		header.alignment = Native2LE(KPackage::ALIGNMENT);
+		header.toc_offset = Native2LE(header.toc_offset);
+		header.names_offset = Native2LE(header.names_offset);
+		ofs.seekp(0, std::ios_base::beg);
+		ofs.write(reinterpret_cast<char const *>(&header), sizeof(header));
+	}
+}
@@ -31,6 +31,7 @@
 #include <KlayGE/KlayGE.hpp>
 #define INITGUID
 #include <KFL/COMPtr.hpp>
+#include <KFL/CustomizedStreamBuf.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/ResIdentifier.hpp>
 #include <KFL/Util.hpp>
@@ -40,11 +41,11 @@
 #include <KFL/DllLoader.hpp>
 
 #include <algorithm>
-#include <sstream>
+#include <cctype>
+#include <map>
 #include <string>
 
 #include <boost/assert.hpp>
-#include <boost/algorithm/string/predicate.hpp>
 
 #include <CPP/7zip/Archive/IArchive.h>
 
@@ -72,6 +73,8 @@ namespace
 
 	typedef KlayGE::uint32_t (WINAPI *CreateObjectFunc)(const GUID* clsID, const GUID* interfaceID, void** outObject);
 
+	uint32_t const INVALID_INDEX = 0xFFFFFFFF;
+
 	HRESULT GetArchiveItemPath(std::shared_ptr<IInArchive> const & archive, uint32_t index, std::string& result)
 	{
 		PROPVARIANT prop;
@@ -92,6 +95,34 @@ namespace
 		}
 	}
 
+	HRESULT GetArchiveItemUInt64(std::shared_ptr<IInArchive> const & archive, uint32_t index, PROPID prop_id,
+		uint64_t& result, bool& defined)
+	{
+		PROPVARIANT prop;
+		prop.vt = VT_EMPTY;
+		TIFHR(archive->GetProperty(index, prop_id, &prop));
+		switch (prop.vt)
+		{
+		case VT_UI4:
+			result = prop.ulVal;
+			defined = true;
+			return S_OK;
+
+		case VT_UI8:
+			result = prop.uhVal.QuadPart;
+			defined = true;
+			return S_OK;
+
+		case VT_EMPTY:
+			result = 0;
+			defined = false;
+			return S_OK;
+
+		default:
+			return E_FAIL;
+		}
+	}
+
 	HRESULT IsArchiveItemFolder(std::shared_ptr<IInArchive> const & archive, uint32_t index, bool &result)
 	{
 		PROPVARIANT prop;
@@ -145,15 +176,36 @@ namespace
 namespace KlayGE
 {
 	Package::Package(ResIdentifierPtr const & archive_is)
-		: Package(archive_is, "")
+		: archive_is_(archive_is)
 	{
+		BOOST_ASSERT(archive_is);
 	}
 
-	Package::Package(ResIdentifierPtr const & archive_is, std::string_view password)
-		: archive_is_(archive_is), password_(password)
+	Package::~Package()
 	{
-		BOOST_ASSERT(archive_is);
+	}
+
+	std::string Package::NormalizePath(std::string_view path)
+	{
+		std::string ret(path);
+		std::replace(ret.begin(), ret.end(), '\\', '/');
+		std::transform(ret.begin(), ret.end(), ret.begin(),
+			[](char ch)
+			{
+				return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+			});
+		return ret;
+	}
+
+
+	SevenZipPackage::SevenZipPackage(ResIdentifierPtr const & archive_is)
+		: SevenZipPackage(archive_is, "")
+	{
+	}
 
+	SevenZipPackage::SevenZipPackage(ResIdentifierPtr const & archive_is, std::string_view password)
+		: Package(archive_is), password_(password), decoded_blocks_size_(0)
+	{
 		{
 			IInArchive* tmp;
 			TIFHR(SevenZipLoader::Instance().CreateObject(&CLSID_CFormat7z, &IID_IInArchive, reinterpret_cast<void**>(&tmp)));
@@ -165,88 +217,179 @@ namespace KlayGE
 		TIFHR(archive_->Open(file.get(), 0, ocb.get()));
 
 		TIFHR(archive_->GetNumberOfItems(&num_items_));
+
+		this->BuildIndex();
 	}
 
-	bool Package::Locate(std::string_view extract_file_path)
+	bool SevenZipPackage::Locate(std::string_view extract_file_path)
 	{
 		uint32_t real_index = this->Find(extract_file_path);
-		return (real_index != 0xFFFFFFFF);
+		return (real_index != INVALID_INDEX);
 	}
 
-	ResIdentifierPtr Package::Extract(std::string_view extract_file_path, std::string_view res_name)
+	ResIdentifierPtr SevenZipPackage::Extract(std::string_view extract_file_path, std::string_view res_name)
 	{
 		uint32_t real_index = this->Find(extract_file_path);
-		if (real_index != 0xFFFFFFFF)
+		if (real_index != INVALID_INDEX)
 		{
-			auto decoded_file = MakeSharedPtr<std::stringstream>();
-			auto out_stream = MakeCOMPtr(new OutStream(decoded_file));
-			auto ecb = MakeCOMPtr(new ArchiveExtractCallback(password_, out_stream));
-			TIFHR(archive_->Extract(&real_index, 1, false, ecb.get()));
-
-			PROPVARIANT prop;
-			prop.vt = VT_EMPTY;
-			TIFHR(archive_->GetProperty(real_index, kpidMTime, &prop));
-			uint64_t mtime;
-			if (prop.vt == VT_FILETIME)
-			{
-				mtime = (static_cast<uint64_t>(prop.filetime.dwHighDateTime) << 32)
-					+ prop.filetime.dwLowDateTime;
-				mtime -= 116444736000000000ULL;
-			}
-			else
-			{
-				mtime = archive_is_->Timestamp();
-			}
-
-			return MakeSharedPtr<ResIdentifier>(res_name, mtime, decoded_file);
+			auto decoded = this->DecodeItem(real_index);
+			ArrayRef<uint8_t> const decoded_data(reinterpret_cast<uint8_t const *>(decoded->data()), decoded->size());
+			return MakeSharedPtr<ResIdentifier>(res_name, items_[real_index].mtime, decoded_data, decoded);
 		}
 		return ResIdentifierPtr();
 	}
 
-	uint32_t Package::Find(std::string_view extract_file_path)
+	uint32_t SevenZipPackage::Find(std::string_view extract_file_path)
 	{
-		uint32_t real_index = 0xFFFFFFFF;
+		auto iter = path_to_index_.find(NormalizePath(extract_file_path));
+		if (iter != path_to_index_.end())
+		{
+			return iter->second;
+		}
+		else
+		{
+			return INVALID_INDEX;
+		}
+	}
 
+	void SevenZipPackage::BuildIndex()
+	{
+		items_.resize(num_items_);
 		for (uint32_t i = 0; i < num_items_; ++ i)
 		{
+			ItemInfo& item = items_[i];
+			item.block = INVALID_INDEX;
+			item.size = 0;
+			item.mtime = archive_is_->Timestamp();
+
 			bool is_folder = true;
 			TIFHR(IsArchiveItemFolder(archive_, i, is_folder));
-			if (!is_folder)
+			if (is_folder)
 			{
-				std::string file_path;
-				TIFHR(GetArchiveItemPath(archive_, i, file_path));
-				std::replace(file_path.begin(), file_path.end(), '\\', '/');
-				if (!boost::algorithm::ilexicographical_compare(extract_file_path, file_path)
-					&& !boost::algorithm::ilexicographical_compare(file_path, extract_file_path))
-				{
-					real_index = i;
-					break;
-				}
+				continue;
 			}
-		}
-		if (real_index != 0xFFFFFFFF)
-		{
+
+			bool valid = false;
 			PROPVARIANT prop;
 			prop.vt = VT_EMPTY;
-			TIFHR(archive_->GetProperty(real_index, kpidIsAnti, &prop));
+			TIFHR(archive_->GetProperty(i, kpidIsAnti, &prop));
 			if ((VT_BOOL == prop.vt) && (VARIANT_FALSE == prop.boolVal))
 			{
 				prop.vt = VT_EMPTY;
-				TIFHR(archive_->GetProperty(real_index, kpidPosition, &prop));
-				if (prop.vt != VT_EMPTY)
+				TIFHR(archive_->GetProperty(i, kpidPosition, &prop));
+				valid = (prop.vt == VT_EMPTY) || ((prop.vt == VT_UI8) && (prop.uhVal.QuadPart == 0));
+			}
+
+			std::string file_path;
+			TIFHR(GetArchiveItemPath(archive_, i, file_path));
+			// Only the first item of a path counts, the same as a linear search
+			path_to_index_.emplace(NormalizePath(file_path), valid ? i : INVALID_INDEX);
+			if (!valid)
+			{
+				continue;
+			}
+
+			bool defined;
+			TIFHR(GetArchiveItemUInt64(archive_, i, kpidSize, item.size, defined));
+
+			uint64_t block;
+			TIFHR(GetArchiveItemUInt64(archive_, i, kpidBlock, block, defined));
+			if (defined)
+			{
+				item.block = static_cast<uint32_t>(block);
+
+				auto& block_items = block_items_[item.block];
+				block_items.first.push_back(i);
+				block_items.second += item.size;
+			}
+
+			prop.vt = VT_EMPTY;
+			TIFHR(archive_->GetProperty(i, kpidMTime, &prop));
+			if (prop.vt == VT_FILETIME)
+			{
+				item.mtime = (static_cast<uint64_t>(prop.filetime.dwHighDateTime) << 32)
+					+ prop.filetime.dwLowDateTime;
+				item.mtime -= 116444736000000000ULL;
+			}
+		}
+	}
+
+	std::shared_ptr<std::vector<char>> SevenZipPackage::DecodeItem(uint32_t index)
+	{
+		uint32_t const block = items_[index].block;
+		if (block != INVALID_INDEX)
+		{
+			for (auto iter = decoded_blocks_.begin(); iter != decoded_blocks_.end(); ++ iter)
+			{
+				if (iter->block == block)
 				{
-					if ((prop.vt != VT_UI8) || (prop.uhVal.QuadPart != 0))
-					{
-						real_index = 0xFFFFFFFF;
-					}
+					decoded_blocks_.splice(decoded_blocks_.begin(), decoded_blocks_, iter);
+					return decoded_blocks_.front().items[index];
 				}
 			}
-			else
+
+			// Items in a solid block can only be decoded from the beginning of the block. Decode them all at once and
+			// keep them, so the siblings don't need to decode the block again.
+			auto const & block_items = block_items_[block];
+			if (block_items.second <= MAX_DECODED_BLOCKS_SIZE)
 			{
-				real_index = 0xFFFFFFFF;
+				DecodedBlock decoded_block;
+				decoded_block.block = block;
+				decoded_block.size = block_items.second;
+				decoded_block.items = this->DecodeItems(block_items.first);
+
+				decoded_blocks_size_ += decoded_block.size;
+				decoded_blocks_.push_front(std::move(decoded_block));
+				while ((decoded_blocks_size_ > MAX_DECODED_BLOCKS_SIZE) && (decoded_blocks_.size() > 1))
+				{
+					decoded_blocks_size_ -= decoded_blocks_.back().size;
+					decoded_blocks_.pop_back();
+				}
+
+				return decoded_blocks_.front().items[index];
 			}
 		}
 
-		return real_index;
+		return this->DecodeItems(std::vector<uint32_t>(1, index))[index];
+	}
+
+	std::unordered_map<uint32_t, std::shared_ptr<std::vector<char>>> SevenZipPackage::DecodeItems(std::vector<uint32_t> const & indices)
+	{
+		std::unordered_map<uint32_t, std::shared_ptr<std::vector<char>>> ret;
+
+		std::vector<std::shared_ptr<VectorOutputStreamBuf>> decoded_bufs;
+		std::map<uint32_t, std::shared_ptr<ISequentialOutStream>> out_streams;
+		for (auto index : indices)
+		{
+			auto decoded_data = MakeSharedPtr<std::vector<char>>();
+			decoded_data->reserve(static_cast<size_t>(items_[index].size));
+			auto decoded_buf = MakeSharedPtr<VectorOutputStreamBuf>(*decoded_data);
+			out_streams.emplace(index, MakeCOMPtr(new OutStream(MakeSharedPtr<std::ostream>(decoded_buf.get()))));
+
+			decoded_bufs.push_back(decoded_buf);
+			ret.emplace(index, decoded_data);
+		}
+
+		// 7z requires the indices in ascending order
+		std::vector<uint32_t> sorted_indices = indices;
+		std::sort(sorted_indices.begin(), sorted_indices.end());
+
+		auto ecb = MakeCOMPtr(new ArchiveExtractCallback(password_, out_streams));
+		TIFHR(archive_->Extract(sorted_indices.data(), static_cast<uint32_t>(sorted_indices.size()), false, ecb.get()));
+
+		return ret;
+	}
+
+
+	PackagePtr OpenPackage(ResIdentifierPtr const & archive_is, std::string_view password)
+	{
+		if (KPackage::IsKPackage(archive_is))
+		{
+			return MakeSharedPtr<KPackage>(archive_is);
+		}
+		else
+		{
+			return MakeSharedPtr<SevenZipPackage>(archive_is, password);
+		}
 	}
 }
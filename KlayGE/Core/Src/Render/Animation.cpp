@@ -0,0 +1,575 @@
+/**
+ * @file Animation.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Mesh.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+
+#include <boost/assert.hpp>
+
+#include <KlayGE/Animation.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const ROTATION_BITS = 20;
+	uint64_t const ROTATION_MASK = (1ULL << ROTATION_BITS) - 1;
+	float const ROTATION_SCALE = static_cast<float>(ROTATION_MASK);
+
+	uint32_t const TRANSLATION_MAX = 0xFFFF;
+
+	// Playing forward passes a few keys per frame at most. Beyond this it's a seek, and binary search is faster.
+	uint32_t const MAX_KEY_STEPS = 4;
+
+	// The largest component's index in the top bits, the other three scaled from [-1/sqrt(2), 1/sqrt(2)] to 20 bits each.
+	// The largest component is made positive, which is the same rotation.
+	uint64_t PackRotation(Quaternion const & quat)
+	{
+		uint32_t largest = 0;
+		for (uint32_t i = 1; i < 4; ++ i)
+		{
+			if (std::abs(quat[i]) > std::abs(quat[largest]))
+			{
+				largest = i;
+			}
+		}
+		float const sign = (quat[largest] < 0) ? -1.0f : 1.0f;
+
+		uint64_t packed = largest;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				float const v = MathLib::clamp(quat[i] * sign * SQRT_2 + 0.5f, 0.0f, 1.0f);
+				packed = (packed << ROTATION_BITS) | static_cast<uint64_t>(v * ROTATION_SCALE + 0.5f);
+			}
+		}
+		return packed;
+	}
+
+	Quaternion UnpackRotation(uint64_t packed)
+	{
+		uint32_t const largest = static_cast<uint32_t>(packed >> (ROTATION_BITS * 3));
+
+		Quaternion quat;
+		float sum_sq = 0;
+		uint32_t shift = ROTATION_BITS * 2;
+		for (uint32_t i = 0; i < 4; ++ i)
+		{
+			if (i != largest)
+			{
+				float const v = (static_cast<float>((packed >> shift) & ROTATION_MASK) / ROTATION_SCALE - 0.5f) * SQRT2;
+				quat[i] = v;
+				sum_sq += v * v;
+				shift -= ROTATION_BITS;
+			}
+		}
+		quat[largest] = std::sqrt(std::max(1 - sum_sq, 0.0f));
+		return quat;
+	}
+
+	float WrapFrame(float frame, float length)
+	{
+		frame = std::fmod(frame, length);
+		if (frame < 0)
+		{
+			frame += length;
+		}
+		return frame;
+	}
+
+	// Index of the last key at or before frame. cache is the index found last time.
+	uint32_t FindKey(uint32_t const * frame_ids, uint32_t num_keys, float frame, uint32_t& cache)
+	{
+		uint32_t key = std::min(cache, num_keys - 1);
+		if (frame_ids[key] <= frame)
+		{
+			for (uint32_t step = 0; (step < MAX_KEY_STEPS) && (key + 1 < num_keys) && (frame_ids[key + 1] <= frame); ++ step)
+			{
+				++ key;
+			}
+			if ((key + 1 < num_keys) && (frame_ids[key + 1] <= frame))
+			{
+				key = static_cast<uint32_t>(std::upper_bound(frame_ids + key, frame_ids + num_keys, frame) - frame_ids) - 1;
+			}
+		}
+		else
+		{
+			// Looped, or played backward
+			uint32_t const upper = static_cast<uint32_t>(std::upper_bound(frame_ids, frame_ids + key, frame) - frame_ids);
+			key = (upper > 0) ? upper - 1 : 0;
+		}
+
+		cache = key;
+		return key;
+	}
+
+	// Below this many models, posing them on one thread is faster than waking up the pool
+	uint32_t const MIN_MODELS_PER_WORKER = 8;
+}
+
+namespace KlayGE
+{
+	AnimationClip::AnimationClip(std::vector<KeyFrameSet> const & key_frame_sets)
+	{
+		tracks_.resize(key_frame_sets.size());
+
+		std::vector<uint64_t> rotations;
+		std::vector<float3> translations;
+		std::vector<uint16_t> quantized_translations;
+		for (size_t i = 0; i < key_frame_sets.size(); ++ i)
+		{
+			KeyFrameSet const & kf = key_frame_sets[i];
+			Track& track = tracks_[i];
+
+			uint32_t const num_keys = static_cast<uint32_t>(kf.frame_id.size());
+			BOOST_ASSERT(num_keys > 0);
+
+			rotations.resize(num_keys);
+			translations.resize(num_keys);
+			float3 min_translation = float3(+1e10f, +1e10f, +1e10f);
+			float3 max_translation = float3(-1e10f, -1e10f, -1e10f);
+			for (uint32_t k = 0; k < num_keys; ++ k)
+			{
+				rotations[k] = PackRotation(kf.bind_real[k]);
+				translations[k] = MathLib::udq_to_trans(kf.bind_real[k], kf.bind_dual[k]);
+				min_translation = MathLib::minimize(min_translation, translations[k]);
+				max_translation = MathLib::maximize(max_translation, translations[k]);
+			}
+
+			track.translation_min = min_translation;
+			quantized_translations.resize(num_keys * 3);
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				float const extent = max_translation[c] - min_translation[c];
+				track.translation_step[c] = extent / TRANSLATION_MAX;
+				float const inv_step = (extent > 0) ? TRANSLATION_MAX / extent : 0.0f;
+				for (uint32_t k = 0; k < num_keys; ++ k)
+				{
+					quantized_translations[k * 3 + c]
+						= static_cast<uint16_t>((translations[k][c] - min_translation[c]) * inv_step + 0.5f);
+				}
+			}
+
+			track.rotation_stride = std::all_of(rotations.begin(), rotations.end(),
+				[&rotations](uint64_t r)
+				{
+					return r == rotations[0];
+				}) ? 0 : 1;
+			track.translation_stride = std::equal(quantized_translations.begin() + 3, quantized_translations.end(),
+				quantized_translations.begin()) ? 0 : 1;
+			track.scale_stride = std::all_of(kf.bind_scale.begin(), kf.bind_scale.end(),
+				[&kf](float s)
+				{
+					return s == kf.bind_scale[0];
+				}) ? 0 : 1;
+
+			// A joint that doesn't move at all needs only one key
+			uint32_t const num_stored_keys
+				= (track.rotation_stride | track.translation_stride | track.scale_stride) ? num_keys : 1;
+
+			track.first_frame = static_cast<uint32_t>(frame_ids_.size());
+			track.num_keys = num_stored_keys;
+			track.length = static_cast<float>(kf.frame_id.back() + 1);
+			frame_ids_.insert(frame_ids_.end(), kf.frame_id.begin(), kf.frame_id.begin() + num_stored_keys);
+
+			track.first_rotation = static_cast<uint32_t>(rotations_.size());
+			rotations_.insert(rotations_.end(), rotations.begin(), rotations.begin() + (track.rotation_stride ? num_keys : 1));
+
+			track.first_translation = static_cast<uint32_t>(translations_.size() / 3);
+			translations_.insert(translations_.end(), quantized_translations.begin(),
+				quantized_translations.begin() + (track.translation_stride ? num_keys : 1) * 3);
+
+			track.first_scale = static_cast<uint32_t>(scales_.size());
+			scales_.insert(scales_.end(), kf.bind_scale.begin(), kf.bind_scale.begin() + (track.scale_stride ? num_keys : 1));
+		}
+	}
+
+	size_t AnimationClip::CompressedSize() const
+	{
+		return tracks_.size() * sizeof(tracks_[0]) + frame_ids_.size() * sizeof(frame_ids_[0])
+			+ rotations_.size() * sizeof(rotations_[0]) + translations_.size() * sizeof(translations_[0])
+			+ scales_.size() * sizeof(scales_[0]);
+	}
+
+	Quaternion AnimationClip::DecodeRotation(Track const & track, uint32_t key) const
+	{
+		return UnpackRotation(rotations_[track.first_rotation + key * track.rotation_stride]);
+	}
+
+	float3 AnimationClip::DecodeTranslation(Track const & track, uint32_t key) const
+	{
+		uint16_t const * quantized = &translations_[(track.first_translation + key * track.translation_stride) * 3];
+		return track.translation_min
+			+ float3(quantized[0] * track.translation_step.x(), quantized[1] * track.translation_step.y(),
+				quantized[2] * track.translation_step.z());
+	}
+
+	float AnimationClip::DecodeScale(Track const & track, uint32_t key) const
+	{
+		return scales_[track.first_scale + key * track.scale_stride];
+	}
+
+
+	AnimationSampler::AnimationSampler() = default;
+
+	void AnimationSampler::Clip(AnimationClipPtr const & clip)
+	{
+		clip_ = clip;
+		key_caches_.clear();
+
+		uint32_t const num_joints = clip_ ? clip_->NumJoints() : 0;
+		key_dqs_.resize(num_joints * 4);
+		factors_.resize(num_joints);
+		reals_.resize(num_joints);
+		duals_.resize(num_joints);
+		scales_.resize(num_joints);
+	}
+
+	void AnimationSampler::Sample(float frame)
+	{
+		BOOST_ASSERT(clip_);
+
+		uint32_t const num_joints = clip_->NumJoints();
+		if (key_caches_.size() < num_joints)
+		{
+			key_caches_.resize(num_joints, 0);
+		}
+
+		this->SampleLayer(0, frame, reals_.data(), duals_.data(), scales_.data());
+	}
+
+	void AnimationSampler::Sample(ArrayRef<float> frames, ArrayRef<float> weights)
+	{
+		BOOST_ASSERT(clip_);
+		BOOST_ASSERT(frames.size() == weights.size());
+		BOOST_ASSERT(!frames.empty());
+
+		if (frames.size() == 1)
+		{
+			this->Sample(frames[0]);
+			return;
+		}
+
+		uint32_t const num_layers = static_cast<uint32_t>(frames.size());
+		uint32_t const num_joints = clip_->NumJoints();
+		if (key_caches_.size() < num_layers * num_joints)
+		{
+			key_caches_.resize(num_layers * num_joints, 0);
+		}
+		layer_dqs_.resize(num_joints * 2);
+		layer_scales_.resize(num_joints);
+
+		float total_weight = 0;
+		for (float w : weights)
+		{
+			total_weight += w;
+		}
+		BOOST_ASSERT(total_weight > 0);
+		float const inv_total_weight = 1 / total_weight;
+
+		this->SampleLayer(0, frames[0], reals_.data(), duals_.data(), scales_.data());
+		float const weight0 = weights[0] * inv_total_weight;
+		for (uint32_t j = 0; j < num_joints; ++ j)
+		{
+			reals_[j] *= weight0;
+			duals_[j] *= weight0;
+			scales_[j] *= weight0;
+		}
+
+		Quaternion* layer_reals = layer_dqs_.data();
+		Quaternion* layer_duals = layer_reals + num_joints;
+		for (uint32_t layer = 1; layer < num_layers; ++ layer)
+		{
+			this->SampleLayer(layer, frames[layer], layer_reals, layer_duals, layer_scales_.data());
+
+			float const weight = weights[layer] * inv_total_weight;
+			for (uint32_t j = 0; j < num_joints; ++ j)
+			{
+				// Along the shortest path to what's blended so far
+				float const w = (MathLib::dot(reals_[j], layer_reals[j]) < 0) ? -weight : weight;
+				Quaternion real = layer_reals[j];
+				Quaternion dual = layer_duals[j];
+				real *= w;
+				dual *= w;
+				reals_[j] += real;
+				duals_[j] += dual;
+				scales_[j] += layer_scales_[j] * weight;
+			}
+		}
+
+		for (uint32_t j = 0; j < num_joints; ++ j)
+		{
+			float const inv_len = 1 / std::sqrt(MathLib::dot(reals_[j], reals_[j]));
+			reals_[j] *= inv_len;
+			duals_[j] *= inv_len;
+		}
+	}
+
+	void AnimationSampler::SampleLayer(uint32_t layer, float frame, Quaternion* reals, Quaternion* duals, float* scales)
+	{
+		AnimationClip const & clip = *clip_;
+		uint32_t const num_joints = clip.NumJoints();
+		uint32_t* key_cache = &key_caches_[layer * num_joints];
+
+		Quaternion* reals0 = key_dqs_.data();
+		Quaternion* duals0 = reals0 + num_joints;
+		Quaternion* reals1 = duals0 + num_joints;
+		Quaternion* duals1 = reals1 + num_joints;
+		for (uint32_t j = 0; j < num_joints; ++ j)
+		{
+			AnimationClip::Track const & track = clip.tracks_[j];
+
+			uint32_t key0 = 0;
+			uint32_t key1 = 0;
+			float factor = 0;
+			if (track.num_keys > 1)
+			{
+				float const wrapped_frame = WrapFrame(frame, track.length);
+				uint32_t const * frame_ids = &clip.frame_ids_[track.first_frame];
+				key0 = FindKey(frame_ids, track.num_keys, wrapped_frame, key_cache[j]);
+				// Past the last key, it's held until the timeline wraps
+				if (key0 + 1 < track.num_keys)
+				{
+					key1 = key0 + 1;
+					factor = std::max((wrapped_frame - frame_ids[key0]) / (frame_ids[key1] - frame_ids[key0]), 0.0f);
+				}
+				else
+				{
+					key1 = key0;
+				}
+			}
+
+			Quaternion const real0 = clip.DecodeRotation(track, key0);
+			reals0[j] = real0;
+			duals0[j] = MathLib::quat_trans_to_udq(real0, clip.DecodeTranslation(track, key0));
+			float const scale0 = clip.DecodeScale(track, key0);
+			if (key1 != key0)
+			{
+				Quaternion const real1 = clip.DecodeRotation(track, key1);
+				reals1[j] = real1;
+				duals1[j] = MathLib::quat_trans_to_udq(real1, clip.DecodeTranslation(track, key1));
+				scales[j] = MathLib::lerp(scale0, clip.DecodeScale(track, key1), factor);
+			}
+			else
+			{
+				reals1[j] = reals0[j];
+				duals1[j] = duals0[j];
+				scales[j] = scale0;
+			}
+			factors_[j] = factor;
+		}
+
+		SIMDMathLib::BlendDualQuat(reals, duals, reals0, duals0, reals1, duals1, factors_.data(), num_joints);
+	}
+
+
+	SkinningCrowd::SkinningCrowd() = default;
+
+	// A model leaving the crowd poses itself again. Without a clip there is nothing to pose, it falls back to its bind pose.
+	void SkinningCrowd::ReleasePalette(SkinnedModel& model)
+	{
+		if (model.GetAnimationClip())
+		{
+			model.RebindJoints();
+		}
+		else
+		{
+			model.UnbindJoints();
+		}
+	}
+
+	SkinningCrowd::~SkinningCrowd()
+	{
+		for (auto const & weak_model : models_)
+		{
+			if (SkinnedModelPtr model = weak_model.lock())
+			{
+				model->crowd_ = nullptr;
+				ReleasePalette(*model);
+			}
+		}
+	}
+
+	void SkinningCrowd::Add(SkinnedModelPtr const & model)
+	{
+		BOOST_ASSERT(model);
+		BOOST_ASSERT(model->crowd_ == nullptr);
+
+		model->crowd_ = this;
+		models_.push_back(model);
+	}
+
+	void SkinningCrowd::Remove(SkinnedModelPtr const & model)
+	{
+		BOOST_ASSERT(model);
+
+		auto iter = std::find_if(models_.begin(), models_.end(),
+			[&model](std::weak_ptr<SkinnedModel> const & weak_model)
+			{
+				return weak_model.lock() == model;
+			});
+		if (iter != models_.end())
+		{
+			models_.erase(iter);
+
+			model->crowd_ = nullptr;
+			ReleasePalette(*model);
+		}
+	}
+
+	void SkinningCrowd::Update()
+	{
+		models_.erase(std::remove_if(models_.begin(), models_.end(),
+			[](std::weak_ptr<SkinnedModel> const & weak_model)
+			{
+				return weak_model.expired();
+			}), models_.end());
+
+		active_models_.clear();
+		jobs_.clear();
+		for (auto const & weak_model : models_)
+		{
+			SkinnedModelPtr model = weak_model.lock();
+			if (model && model->GetAnimationClip() && (model->NumJoints() > 0))
+			{
+				Job job;
+				job.model = model.get();
+				job.clip = model->GetAnimationClip().get();
+				job.frame = model->last_frame_;
+				job.blended = !model->last_layers_.empty();
+				jobs_.push_back(job);
+
+				active_models_.push_back(std::move(model));
+			}
+		}
+
+		// Members that can share a palette end up next to each other
+		job_order_.resize(jobs_.size());
+		std::iota(job_order_.begin(), job_order_.end(), 0U);
+		std::sort(job_order_.begin(), job_order_.end(),
+			[this](uint32_t lhs_index, uint32_t rhs_index)
+			{
+				Job const & lhs = jobs_[lhs_index];
+				Job const & rhs = jobs_[rhs_index];
+				if (lhs.blended != rhs.blended)
+				{
+					return rhs.blended;
+				}
+				if (lhs.clip != rhs.clip)
+				{
+					return std::less<AnimationClip const *>()(lhs.clip, rhs.clip);
+				}
+				if (lhs.frame != rhs.frame)
+				{
+					return lhs.frame < rhs.frame;
+				}
+				return lhs_index < rhs_index;
+			});
+
+		leaders_.clear();
+		uint32_t num_palette_entries = 0;
+		for (uint32_t const index : job_order_)
+		{
+			Job& job = jobs_[index];
+			if (!job.blended && !leaders_.empty())
+			{
+				Job const & leader = jobs_[leaders_.back()];
+				if (!leader.blended && (leader.clip == job.clip) && (leader.frame == job.frame))
+				{
+					BOOST_ASSERT(leader.model->NumJoints() == job.model->NumJoints());
+
+					job.palette = leader.palette;
+					job.leader = leaders_.back();
+					continue;
+				}
+			}
+
+			job.palette = num_palette_entries;
+			job.leader = index;
+			leaders_.push_back(index);
+			num_palette_entries += job.model->NumJoints() * 2;
+		}
+		palettes_.resize(num_palette_entries);
+
+		uint32_t const num_leaders = static_cast<uint32_t>(leaders_.size());
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_leaders, num_parallel_workers(num_leaders, MIN_MODELS_PER_WORKER),
+			[this](uint32_t worker, uint32_t first, uint32_t last)
+			{
+				KFL_UNUSED(worker);
+				for (uint32_t i = first; i < last; ++ i)
+				{
+					Job const & job = jobs_[leaders_[i]];
+					float4* reals = &palettes_[job.palette];
+					job.model->EvaluatePalette(reals, reals + job.model->NumJoints());
+				}
+			});
+
+		// Point every member at its palette. The ones sharing take the leader's joints too.
+		uint32_t const num_jobs = static_cast<uint32_t>(jobs_.size());
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_jobs, num_parallel_workers(num_jobs, MIN_MODELS_PER_WORKER),
+			[this](uint32_t worker, uint32_t first, uint32_t last)
+			{
+				KFL_UNUSED(worker);
+				for (uint32_t i = first; i < last; ++ i)
+				{
+					Job const & job = jobs_[i];
+					SkinnedModel& model = *job.model;
+					model.palette_reals_ = &palettes_[job.palette];
+					model.palette_duals_ = model.palette_reals_ + model.NumJoints();
+
+					if (job.leader != i)
+					{
+						SkinnedModel const & leader = *jobs_[job.leader].model;
+						for (uint32_t j = 0; j < model.NumJoints(); ++ j)
+						{
+							Joint& joint = model.joints_[j];
+							Joint const & leader_joint = leader.joints_[j];
+							joint.bind_real = leader_joint.bind_real;
+							joint.bind_dual = leader_joint.bind_dual;
+							joint.bind_scale = leader_joint.bind_scale;
+						}
+					}
+				}
+			});
+
+		active_models_.clear();
+	}
+}
@@ -52,6 +52,8 @@
 #include <KlayGE/SSSBlur.hpp>
 #include <KlayGE/PerfProfiler.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <string>
 
 #include <KlayGE/DeferredRenderingLayer.hpp>
@@ -73,6 +75,7 @@ namespace
 
 #if DEFAULT_DEFERRED == LIGHT_INDEXED_DEFERRED
 	uint32_t const TILE_SIZE = 32;
+	uint32_t const LIGHT_CLUSTER_INDICES_WIDTH = 1024;
 #endif
 
 	union EffectIndex
@@ -415,7 +418,7 @@ namespace KlayGE
 	DeferredRenderingLayer::DeferredRenderingLayer()
 		: active_viewport_(0),
 			sss_enabled_(true), translucency_enabled_(true),
-			ssr_enabled_(true), taa_enabled_(true),
+			ssr_enabled_(true), taa_enabled_(true), light_clusters_enabled_(false),
 			light_scale_(1), illum_(0), indirect_scale_(1.0f),
 			curr_cascade_index_(-1), force_line_mode_(false),
 			dr_debug_pp_(MakeSharedPtr<DeferredRenderingDebugPostProcess>()),
@@ -840,6 +843,14 @@ namespace KlayGE
 		else
 		{
 			light_index_tex_param_ = dr_effect->ParameterByName("light_index_tex");
+
+			light_clusters_tex_support_ = caps.TextureFormatSupport(EF_GR32F) && caps.TextureFormatSupport(EF_R32F);
+			light_cluster_ranges_tex_param_ = dr_effect->ParameterByName("light_cluster_ranges_tex");
+			light_cluster_indices_tex_param_ = dr_effect->ParameterByName("light_cluster_indices_tex");
+			light_cluster_dims_param_ = dr_effect->ParameterByName("light_cluster_dims");
+			light_cluster_slicing_param_ = dr_effect->ParameterByName("light_cluster_slicing");
+			light_cluster_indices_size_param_ = dr_effect->ParameterByName("light_cluster_indices_size");
+			light_cluster_first_slot_param_ = dr_effect->ParameterByName("light_cluster_first_slot");
 		}
 
 		depth_to_min_max_pp_ = SyncLoadPostProcess("Depth.ppml", "DepthToMinMax");
@@ -962,6 +973,11 @@ namespace KlayGE
 		taa_enabled_ = taa;
 	}
 
+	void DeferredRenderingLayer::LightClustersEnabled(bool clusters)
+	{
+		light_clusters_enabled_ = clusters;
+	}
+
 	void DeferredRenderingLayer::AddDecal(RenderDecalPtr const & decal)
 	{
 		decals_.push_back(decal);
@@ -1622,19 +1638,7 @@ namespace KlayGE
 					pvp.g_buffer_enables[PTB_TransparencyFront]
 						= (pvp.attrib & VPAM_NoTransparencyFront) ? false : has_transparency_front_objs;
 
-					pvp.light_visibles.resize(lights_.size());
-					for (uint32_t li = 0; li < lights_.size(); ++ li)
-					{
-						auto const & light = *lights_[li];
-						if (light.Enabled())
-						{
-							this->CheckLightVisible(vpi, li);
-						}
-						else
-						{
-							pvp.light_visibles[li] = false;
-						}
-					}
+					this->CheckLightsVisible(vpi);
 
 					for (uint32_t i = PTB_Opaque; i < PTB_None; ++ i)
 					{
@@ -1738,40 +1742,89 @@ namespace KlayGE
 		}
 	}
 
-	void DeferredRenderingLayer::CheckLightVisible(uint32_t vp_index, uint32_t light_index)
+	void DeferredRenderingLayer::CheckLightsVisible(uint32_t vp_index)
 	{
 		SceneManager& scene_mgr = Context::Instance().SceneManagerInstance();
 
 		PerViewport& pvp = viewports_[vp_index];
-		auto const & light = *lights_[light_index];
+		pvp.light_visibles.resize(lights_.size());
 
-		float light_scale = std::min(light.Range() * 0.01f, 1.0f) * light_scale_;
-		switch (light.Type())
+		// Collect the volumes of local lights, then cull them in one batch
+		light_aabbs_.Clear();
+		pvp.clustered_lights.clear();
+		for (uint32_t li = 0; li < lights_.size(); ++ li)
 		{
-		case LightSource::LT_Spot:
+			auto const & light = *lights_[li];
+			if (!light.Enabled())
 			{
-				float4x4 const & inv_light_view = light.SMCamera(0)->InverseViewMatrix();
-				float const scale = light.CosOuterInner().w();
-				float4x4 mat = MathLib::scaling(scale * light_scale, scale * light_scale, light_scale);
-				float4x4 light_model = mat * inv_light_view;
-				pvp.light_visibles[light_index] = (scene_mgr.AABBVisible(MathLib::transform_aabb(cone_aabb_, light_model)) != BO_No);
+				pvp.light_visibles[li] = false;
+				continue;
 			}
-			break;
 
-		case LightSource::LT_Point:
-		case LightSource::LT_SphereArea:
-		case LightSource::LT_TubeArea:
+			float light_scale = std::min(light.Range() * 0.01f, 1.0f) * light_scale_;
+			switch (light.Type())
 			{
-				float3 const & p = light.Position();
-				float4x4 light_model = MathLib::scaling(light_scale, light_scale, light_scale)
-					* MathLib::translation(p);
-				pvp.light_visibles[light_index] = (scene_mgr.AABBVisible(MathLib::transform_aabb(box_aabb_, light_model)) != BO_No);
+			case LightSource::LT_Spot:
+				{
+					float4x4 const & inv_light_view = light.SMCamera(0)->InverseViewMatrix();
+					float const scale = light.CosOuterInner().w();
+					float4x4 mat = MathLib::scaling(scale * light_scale, scale * light_scale, light_scale);
+					float4x4 light_model = mat * inv_light_view;
+					light_aabbs_.PushBack(MathLib::transform_aabb(cone_aabb_, light_model));
+					pvp.clustered_lights.push_back(li);
+				}
+				break;
+
+			case LightSource::LT_Point:
+			case LightSource::LT_SphereArea:
+			case LightSource::LT_TubeArea:
+				{
+					float3 const & p = light.Position();
+					float4x4 light_model = MathLib::scaling(light_scale, light_scale, light_scale)
+						* MathLib::translation(p);
+					light_aabbs_.PushBack(MathLib::transform_aabb(box_aabb_, light_model));
+					pvp.clustered_lights.push_back(li);
+				}
+				break;
+
+			default:
+				pvp.light_visibles[li] = true;
+				break;
 			}
-			break;
+		}
 
-		default:
-			pvp.light_visibles[light_index] = true;
-			break;
+		if (!pvp.clustered_lights.empty())
+		{
+			light_visible_masks_.resize((pvp.clustered_lights.size() + 31) / 32);
+			scene_mgr.AABBsVisible(light_aabbs_, light_visible_masks_.data());
+			for (size_t i = 0; i < pvp.clustered_lights.size(); ++ i)
+			{
+				pvp.light_visibles[pvp.clustered_lights[i]] = (light_visible_masks_[i / 32] & (1U << (i % 32))) != 0;
+			}
+		}
+
+		// Bin the light volumes into clusters. A light that doesn't reach any cluster can't light anything in this view.
+		Camera const & camera = *pvp.frame_buffer->GetViewport()->camera;
+		pvp.light_clusters_built = light_clusters_enabled_ && !camera.OmniDirectionalMode() && (camera.ProjMatrix()(3, 3) == 0);
+		if (pvp.light_clusters_built)
+		{
+			light_spheres_.Clear();
+			for (size_t i = 0; i < pvp.clustered_lights.size(); ++ i)
+			{
+				AABBox const aabb = light_aabbs_.Get(i);
+				light_spheres_.PushBack(Sphere(aabb.Center(), MathLib::length(aabb.HalfSize())));
+			}
+
+			pvp.light_clusters.Build(camera.ViewMatrix(), camera.ProjMatrix(), camera.NearPlane(), camera.FarPlane(),
+				light_spheres_);
+
+			for (size_t i = 0; i < pvp.clustered_lights.size(); ++ i)
+			{
+				if (0 == pvp.light_clusters.NumLightClusters(static_cast<uint32_t>(i)))
+				{
+					pvp.light_visibles[pvp.clustered_lights[i]] = false;
+				}
+			}
 		}
 	}
 
@@ -3118,6 +3171,31 @@ namespace KlayGE
 			}
 		}
 
+		if (light_clusters_tex_support_ && pvp.light_clusters_built)
+		{
+			// The slots follow the order of the batches below, so the lights of a batch are in consecutive slots
+			light_cluster_slots_.assign(pvp.clustered_lights.size(), LightClusterBuilder::INVALID_SLOT);
+			uint32_t slot = 0;
+			for (auto const * batched_lights : { &point_lights_no_shadow, &point_lights_shadow, &spot_lights_no_shadow,
+				&spot_lights_shadow, &sphere_area_lights_no_shadow, &sphere_area_lights_shadow, &tube_area_lights_no_shadow,
+				&tube_area_lights_shadow })
+			{
+				for (uint32_t const li : *batched_lights)
+				{
+					auto const iter = std::lower_bound(pvp.clustered_lights.begin(), pvp.clustered_lights.end(), li);
+					BOOST_ASSERT((iter != pvp.clustered_lights.end()) && (*iter == li));
+					light_cluster_slots_[iter - pvp.clustered_lights.begin()] = slot;
+					++ slot;
+				}
+			}
+
+			this->UploadLightClusters(pvp);
+		}
+		else
+		{
+			*light_cluster_dims_param_ = float4(0, 0, 0, 0);
+		}
+
 		{
 			uint32_t li = 0;
 			while (li < directional_lights.size())
@@ -3453,6 +3531,12 @@ namespace KlayGE
 		*lights_aabb_min_param_ = lights_aabb_min;
 		*lights_aabb_max_param_ = lights_aabb_max;
 
+		if (light_clusters_tex_support_ && pvp.light_clusters_built)
+		{
+			auto const iter = std::lower_bound(pvp.clustered_lights.begin(), pvp.clustered_lights.end(), *iter_beg);
+			*light_cluster_first_slot_param_ = light_cluster_slots_[iter - pvp.clustered_lights.begin()];
+		}
+
 		RenderTechnique* tech;
 		if ((LightSource::LT_Point == type) || (LightSource::LT_SphereArea == type)
 			|| (LightSource::LT_TubeArea == type))
@@ -3503,6 +3587,57 @@ namespace KlayGE
 		re.Render(*dr_effect_, *tech, *rl_quad_);
 	}
 
+	void DeferredRenderingLayer::UploadLightClusters(PerViewport const & pvp)
+	{
+		LightClusterBuilder const & clusters = pvp.light_clusters;
+		clusters.RemapLights(light_cluster_slots_, light_cluster_offsets_, light_cluster_counts_, light_cluster_indices_);
+
+		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+
+		// One row per depth slice
+		uint32_t const ranges_width = clusters.TilesX() * clusters.TilesY();
+		if (!light_cluster_ranges_tex_ || (light_cluster_ranges_tex_->Width(0) != ranges_width)
+			|| (light_cluster_ranges_tex_->Height(0) != clusters.Slices()))
+		{
+			light_cluster_ranges_tex_ = rf.MakeTexture2D(ranges_width, clusters.Slices(), 1, 1, EF_GR32F, 1, 0, EAH_GPU_Read);
+		}
+		light_cluster_ranges_data_.resize(clusters.NumClusters());
+		for (uint32_t c = 0; c < clusters.NumClusters(); ++ c)
+		{
+			light_cluster_ranges_data_[c] = float2(static_cast<float>(light_cluster_offsets_[c]),
+				static_cast<float>(light_cluster_counts_[c]));
+		}
+		light_cluster_ranges_tex_->UpdateSubresource2D(0, 0, 0, 0, ranges_width, clusters.Slices(),
+			light_cluster_ranges_data_.data(), ranges_width * sizeof(float2));
+
+		// The indices are in rows of a fixed width. The texture only grows, in powers of 2.
+		uint32_t const num_rows = std::max(static_cast<uint32_t>(light_cluster_indices_.size() + LIGHT_CLUSTER_INDICES_WIDTH - 1)
+			/ LIGHT_CLUSTER_INDICES_WIDTH, 1U);
+		if (!light_cluster_indices_tex_ || (light_cluster_indices_tex_->Height(0) < num_rows))
+		{
+			uint32_t height = 1;
+			while (height < num_rows)
+			{
+				height *= 2;
+			}
+			light_cluster_indices_tex_ = rf.MakeTexture2D(LIGHT_CLUSTER_INDICES_WIDTH, height, 1, 1, EF_R32F, 1, 0, EAH_GPU_Read);
+		}
+		light_cluster_indices_data_.assign(light_cluster_indices_.begin(), light_cluster_indices_.end());
+		light_cluster_indices_data_.resize(num_rows * LIGHT_CLUSTER_INDICES_WIDTH, 0.0f);
+		light_cluster_indices_tex_->UpdateSubresource2D(0, 0, 0, 0, LIGHT_CLUSTER_INDICES_WIDTH, num_rows,
+			light_cluster_indices_data_.data(), LIGHT_CLUSTER_INDICES_WIDTH * sizeof(float));
+
+		Camera const & camera = *pvp.frame_buffer->GetViewport()->camera;
+		*light_cluster_ranges_tex_param_ = light_cluster_ranges_tex_;
+		*light_cluster_indices_tex_param_ = light_cluster_indices_tex_;
+		*light_cluster_dims_param_ = float4(static_cast<float>(clusters.TilesX()), static_cast<float>(clusters.TilesY()),
+			static_cast<float>(clusters.Slices()), 1.0f);
+		*light_cluster_slicing_param_ = float2(camera.NearPlane(),
+			clusters.Slices() / std::log(camera.FarPlane() / camera.NearPlane()));
+		*light_cluster_indices_size_param_ = float2(static_cast<float>(LIGHT_CLUSTER_INDICES_WIDTH),
+			static_cast<float>(light_cluster_indices_tex_->Height(0)));
+	}
+
 	void DeferredRenderingLayer::CreateDepthMinMaxMap(PerViewport const & pvp)
 	{
 		uint32_t w = pvp.g_buffer_depth_tex->Width(0);
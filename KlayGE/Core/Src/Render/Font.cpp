@@ -48,6 +48,8 @@
 #include <KlayGE/LZMACodec.hpp>
 #include <KlayGE/TransientBuffer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/ArrayRef.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/Window.hpp>
 
@@ -65,6 +67,27 @@
 
 #include <KlayGE/Font.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	// Missing glyphs decoded by each worker at least. Smaller batches stay on the calling thread.
+	uint32_t const MIN_CHARS_PER_WORKER = 16;
+
+	// Once there are twice this many text layouts, all but this many most recently used ones are dropped
+	uint32_t const MAX_CACHED_LAYOUTS = 256;
+
+	uint32_t const INVALID_CHAR_SLOT = 0xFFFFFFFFU;
+
+	// HashValue truncates floats, so they are hashed by their bits
+	uint32_t FloatBits(float v)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &v, sizeof(bits));
+		return bits;
+	}
+}
+
 namespace KlayGE
 {
 	class FontRenderable : public Renderable
@@ -72,6 +95,7 @@ namespace KlayGE
 	public:
 		explicit FontRenderable(std::shared_ptr<KFont> const & kfl)
 				: Renderable(L"Font"),
+					lru_head_(INVALID_CHAR_SLOT), lru_tail_(INVALID_CHAR_SLOT),
 					three_dim_(false),
 					kfont_loader_(kfl),
 					tick_(0)
@@ -96,9 +120,14 @@ namespace KlayGE
 			RenderDeviceCaps const & caps = renderEngine.DeviceCaps();
 			uint32_t size = std::min<uint32_t>(2048U, std::min<uint32_t>(caps.max_texture_width, caps.max_texture_height)) / kfont_char_size * kfont_char_size;
 			dist_texture_ = rf.MakeTexture2D(size, size, 1, 1, EF_R8, 1, 0, EAH_GPU_Read);
-			a_char_data_.resize(kfont_char_size * kfont_char_size);
 
-			char_free_list_.emplace_back(0, size * size / kfont_char_size / kfont_char_size);
+			uint32_t const num_total_chars = size * size / kfont_char_size / kfont_char_size;
+			char_slots_.resize(num_total_chars);
+			char_free_slots_.resize(num_total_chars);
+			for (uint32_t i = 0; i < num_total_chars; ++ i)
+			{
+				char_free_slots_[i] = num_total_chars - 1 - i;
+			}
 
 			effect_ = SyncLoadRenderEffect("Font.fxml");
 			*(effect_->ParameterByName("distance_tex")) = dist_texture_;
@@ -253,94 +282,217 @@ namespace KlayGE
 			this->AddText(0, 0, 0, 1, 1, clr, text, font_size);
 		}
 
+		uint32_t CharCacheCapacity() const
+		{
+			return static_cast<uint32_t>(char_slots_.size());
+		}
+
+		std::wstring CachedChars() const
+		{
+			std::wstring ret;
+			for (uint32_t slot = lru_head_; slot != INVALID_CHAR_SLOT; slot = char_slots_[slot].next)
+			{
+				ret.push_back(char_slots_[slot].ch);
+			}
+			return ret;
+		}
+
+		uint32_t NumCachedLayouts() const
+		{
+			return static_cast<uint32_t>(layouts_.size());
+		}
+
+		std::vector<Rect> CharTexRects(std::wstring_view text, float font_size)
+		{
+			TextLayout& layout = this->FindLayout(text, font_size, 1, 1, nullptr, 0);
+			this->UpdateTexture(layout.chars);
+
+			std::vector<Rect> ret;
+			ret.reserve(layout.quads.size());
+			for (auto& quad : layout.quads)
+			{
+				if (this->ResolveCharSlot(quad))
+				{
+					ret.push_back(char_slots_[quad.slot].rc);
+				}
+			}
+			return ret;
+		}
+
 	private:
+		struct CharInfo
+		{
+			Rect rc;
+			wchar_t ch;
+
+			// Neighbours in the LRU list, as slot indices. The head is the most recently used one.
+			uint32_t prev;
+			uint32_t next;
+		};
+
+		struct PendingChar
+		{
+			uint32_t slot;
+			int32_t offset;
+			wchar_t ch;
+		};
+
+		struct GlyphQuad
+		{
+			Rect pos_rc;
+			wchar_t ch;
+			uint32_t slot;
+		};
+
+		// Positions of the glyphs of a string. Quads of text drawn at a point are relative to it, so moving text keeps its
+		// layout. Only the texture coordinates are looked up each time, because glyphs can move in the texture.
+		struct TextLayout
+		{
+			std::wstring text;
+			float font_size;
+			float x_scale;
+			float y_scale;
+			bool in_rect;
+			Rect rc;
+			uint32_t align;
+
+			std::vector<GlyphQuad> quads;
+			std::wstring chars;
+			float2 min_pos;
+			float2 max_pos;
+
+			uint64_t last_used;
+		};
+
 		void AddText(Rect const & rc, float sz,
 			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size, uint32_t align)
 		{
-			this->UpdateTexture(text);
+			TextLayout& layout = this->FindLayout(text, font_size, xScale, yScale, &rc, align);
+			this->UpdateTexture(layout.chars);
+			this->AddLayout(layout, 0, 0, sz, clr);
+		}
 
-			KFont const & kl = *kfont_loader_;
-			auto const & cim = char_info_map_;
+		void AddText(float sx, float sy, float sz,
+			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size)
+		{
+			TextLayout& layout = this->FindLayout(text, font_size, xScale, yScale, nullptr, 0);
+			this->UpdateTexture(layout.chars);
+			this->AddLayout(layout, sx, sy, sz, clr);
+		}
 
-			std::vector<FontVert> vertices;
-			std::vector<uint16_t> indices;
+		TextLayout& FindLayout(std::wstring_view text, float font_size, float xScale, float yScale, Rect const * rc, uint32_t align)
+		{
+			++ tick_;
 
-			float const h = font_size * yScale;
-			float const rel_size = font_size / kl.CharSize();
-			float const rel_size_x = rel_size * xScale;
-			float const rel_size_y = rel_size * yScale;
+			size_t seed = HashRange(text.begin(), text.end());
+			HashCombine(seed, FloatBits(font_size));
+			HashCombine(seed, FloatBits(xScale));
+			HashCombine(seed, FloatBits(yScale));
+			HashCombine(seed, align);
+			if (rc != nullptr)
+			{
+				HashCombine(seed, FloatBits(rc->left()));
+				HashCombine(seed, FloatBits(rc->top()));
+				HashCombine(seed, FloatBits(rc->right()));
+				HashCombine(seed, FloatBits(rc->bottom()));
+			}
 
-			std::vector<std::pair<float, std::wstring>> lines(1, std::make_pair(0.0f, L""));
+			auto iter = layouts_.find(seed);
+			if (iter == layouts_.end())
+			{
+				if (layouts_.size() >= MAX_CACHED_LAYOUTS * 2)
+				{
+					this->PurgeLayouts();
+				}
+				iter = layouts_.emplace(seed, TextLayout()).first;
+			}
 
-			for (auto const & ch : text)
+			TextLayout& layout = iter->second;
+			bool const same = (layout.text == text) && (layout.font_size == font_size) && (layout.x_scale == xScale)
+				&& (layout.y_scale == yScale) && (layout.in_rect == (rc != nullptr)) && (layout.align == align)
+				&& ((rc == nullptr) || (layout.rc == *rc));
+			if (!same)
 			{
-				if (ch != L'\n')
+				layout.text = std::wstring(text);
+				layout.font_size = font_size;
+				layout.x_scale = xScale;
+				layout.y_scale = yScale;
+				layout.in_rect = (rc != nullptr);
+				layout.rc = (rc != nullptr) ? *rc : Rect(0, 0, 0, 0);
+				layout.align = align;
+				if (rc != nullptr)
 				{
-					uint32_t advance = kl.CharAdvance(ch);
-					lines.back().first += (advance & 0xFFFF) * rel_size * xScale;
-					lines.back().second.push_back(ch);
+					this->LayoutText(layout, *rc);
 				}
 				else
 				{
-					lines.emplace_back(0.0f, L"");
+					this->LayoutText(layout);
 				}
 			}
+			layout.last_used = tick_;
 
-			std::vector<float> sx(lines.size());
-			if (align & Font::FA_Hor_Left)
-			{
-				std::fill(sx.begin(), sx.end(), rc.left());
-			}
-			else if (align & Font::FA_Hor_Right)
-			{
-				std::transform(lines.begin(), lines.end(), sx.begin(),
-					[&rc](std::pair<float, std::wstring> const& p) { return rc.right() - p.first; });
-			}
-			else
-			{
-				BOOST_ASSERT(align & Font::FA_Hor_Center);
+			return layout;
+		}
 
-				std::transform(lines.begin(), lines.end(), sx.begin(),
-					[&rc](std::pair<float, std::wstring> const& p) { return (rc.left() + rc.right()) / 2 - p.first / 2; });
+		// Called when 2 * MAX_CACHED_LAYOUTS layouts are cached. Keeps the MAX_CACHED_LAYOUTS most recently used ones.
+		void PurgeLayouts()
+		{
+			std::vector<uint64_t> last_used;
+			last_used.reserve(layouts_.size());
+			for (auto const & layout : layouts_)
+			{
+				last_used.push_back(layout.second.last_used);
 			}
+			std::nth_element(last_used.begin(), last_used.end() - MAX_CACHED_LAYOUTS, last_used.end());
+			uint64_t const threshold = *(last_used.end() - MAX_CACHED_LAYOUTS);
 
-			std::vector<float> sy;
-			sy.reserve(lines.size());
-			if (align & Font::FA_Ver_Top)
+			for (auto iter = layouts_.begin(); iter != layouts_.end();)
 			{
-				for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
+				if (iter->second.last_used < threshold)
 				{
-					sy.push_back(rc.top() + (iter - lines.begin()) * h);
+					iter = layouts_.erase(iter);
 				}
-			}
-			else if (align & Font::FA_Ver_Bottom)
-			{
-				for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
+				else
 				{
-					sy.push_back(rc.bottom() - (lines.size() - (iter - lines.begin())) * h);
+					++ iter;
 				}
 			}
-			else
-			{
-				BOOST_ASSERT(align & Font::FA_Ver_Middle);
+		}
 
-				for (auto iter = lines.begin(); iter != lines.end(); ++ iter)
-				{
-					sy.push_back((rc.top() + rc.bottom()) / 2 - lines.size() * h / 2 + (iter - lines.begin()) * h);
-				}
+		void AddQuad(TextLayout& layout, wchar_t ch, Rect const & pos_rc)
+		{
+			GlyphQuad quad;
+			quad.pos_rc = pos_rc;
+			quad.ch = ch;
+			quad.slot = INVALID_CHAR_SLOT;
+			layout.quads.push_back(quad);
+
+			if (layout.chars.find(ch) == std::wstring::npos)
+			{
+				layout.chars.push_back(ch);
 			}
+		}
 
-			uint32_t const index_per_char = restart_ ? 5 : 6;
+		// Text drawn at a point, relative to it
+		void LayoutText(TextLayout& layout)
+		{
+			KFont const & kl = *kfont_loader_;
 
-			uint32_t const clr32 = clr.ABGR();
-			for (size_t i = 0; i < sx.size(); ++ i)
-			{
-				size_t const maxSize = lines[i].second.length();
-				float x = sx[i], y = sy[i];
+			layout.quads.clear();
+			layout.chars.clear();
+
+			float const h = layout.font_size * layout.y_scale;
+			float const rel_size = layout.font_size / kl.CharSize();
+			float const rel_size_x = rel_size * layout.x_scale;
+			float const rel_size_y = rel_size * layout.y_scale;
+			float x = 0, y = 0;
+			float maxx = 0, maxy = 0;
 
-				vertices.reserve(maxSize * 4);
+			layout.quads.reserve(layout.text.length());
 
-				for (auto const & ch : lines[i].second)
+			for (auto const & ch : layout.text)
+			{
+				if (ch != L'\n')
 				{
 					std::pair<int32_t, uint32_t> const & offset_adv = kl.CharIndexAdvance(ch);
 					if (offset_adv.first != -1)
@@ -352,91 +504,116 @@ namespace KlayGE
 						float width = ci.width * rel_size_x;
 						float height = ci.height * rel_size_y;
 
-						auto cmiter = cim.find(ch);
-						Rect const & texRect(cmiter->second.rc);
-
-						Rect pos_rc(x + left, y + top, x + left + width, y + top + height);
-						Rect intersect_rc = pos_rc & rc;
-						if ((intersect_rc.Width() > 0) && (intersect_rc.Height() > 0))
-						{
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.top(), sz),
-													clr32,
-													float2(texRect.left(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.top(), sz),
-													clr32,
-													float2(texRect.right(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.bottom(), sz),
-													clr32,
-													float2(texRect.right(), texRect.bottom())));
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.bottom(), sz),
-													clr32,
-													float2(texRect.left(), texRect.bottom())));
-						}
+						this->AddQuad(layout, ch, Rect(x + left, y + top, x + left + width, y + top + height));
 					}
 
 					x += (offset_adv.second & 0xFFFF) * rel_size_x;
 					y += (offset_adv.second >> 16) * rel_size_y;
-				}
 
-				tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
-
-				uint16_t last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(FontVert));
-				uint32_t const num_chars = static_cast<uint32_t>(vertices.size() / 4);
-				indices.reserve(num_chars * index_per_char);
-				for (uint32_t c = 0; c < num_chars; ++ c)
-				{
-					indices.push_back(last_index + 0);
-					indices.push_back(last_index + 1);
-					if (restart_)
+					if (x > maxx)
 					{
-						indices.push_back(last_index + 3);
-						indices.push_back(last_index + 2);
-						indices.push_back(0xFFFF);
+						maxx = x;
 					}
-					else
+				}
+				else
+				{
+					y += h;
+					x = 0;
+
+					if (y > maxy)
 					{
-						indices.push_back(last_index + 2);
-						indices.push_back(last_index + 2);
-						indices.push_back(last_index + 3);
-						indices.push_back(last_index + 0);
+						maxy = y;
 					}
-					last_index += 4;
 				}
-				BOOST_ASSERT(last_index + 3 <= 0xFFFF);
-				tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
-
-				pos_aabb_ |= AABBox(float3(sx[i], sy[i], sz), float3(sx[i] + lines[i].first, sy[i] + h, sz + 0.1f));
 			}
+
+			layout.min_pos = float2(0, 0);
+			layout.max_pos = float2(maxx, maxy);
 		}
 
-		void AddText(float sx, float sy, float sz,
-			float xScale, float yScale, Color const & clr, std::wstring_view text, float font_size)
+		// Text aligned in a rectangle and clipped by it
+		void LayoutText(TextLayout& layout, Rect const & rc)
 		{
-			this->UpdateTexture(text);
-
 			KFont const & kl = *kfont_loader_;
-			auto const & cim = char_info_map_;
+			std::wstring const & text = layout.text;
+			uint32_t const align = layout.align;
 
-			std::vector<FontVert> vertices;
-			std::vector<uint16_t> indices;
+			layout.quads.clear();
+			layout.chars.clear();
 
-			uint32_t const clr32 = clr.ABGR();
-			float const h = font_size * yScale;
-			float const rel_size = font_size / kl.CharSize();
-			float const rel_size_x = rel_size * xScale;
-			float const rel_size_y = rel_size * yScale;
-			size_t const maxSize = text.length() - std::count(text.begin(), text.end(), L'\n');
-			float x = sx, y = sy;
-			float maxx = sx, maxy = sy;
+			float const h = layout.font_size * layout.y_scale;
+			float const rel_size = layout.font_size / kl.CharSize();
+			float const rel_size_x = rel_size * layout.x_scale;
+			float const rel_size_y = rel_size * layout.y_scale;
 
-			uint32_t const index_per_char = restart_ ? 5 : 6;
+			// Width, first and last character of each line
+			std::vector<std::tuple<float, size_t, size_t>> lines(1, std::make_tuple(0.0f, 0, 0));
+			for (size_t i = 0; i < text.length(); ++ i)
+			{
+				if (text[i] != L'\n')
+				{
+					uint32_t advance = kl.CharAdvance(text[i]);
+					std::get<0>(lines.back()) += (advance & 0xFFFF) * rel_size_x;
+					std::get<2>(lines.back()) = i + 1;
+				}
+				else
+				{
+					lines.emplace_back(0.0f, i + 1, i + 1);
+				}
+			}
 
-			vertices.reserve(maxSize * 4);
+			layout.quads.reserve(text.length());
 
-			for (auto const & ch : text)
+			for (size_t i = 0; i < lines.size(); ++ i)
 			{
-				if (ch != L'\n')
+				float const line_width = std::get<0>(lines[i]);
+
+				float x;
+				if (align & Font::FA_Hor_Left)
+				{
+					x = rc.left();
+				}
+				else if (align & Font::FA_Hor_Right)
+				{
+					x = rc.right() - line_width;
+				}
+				else
+				{
+					BOOST_ASSERT(align & Font::FA_Hor_Center);
+
+					x = (rc.left() + rc.right()) / 2 - line_width / 2;
+				}
+
+				float y;
+				if (align & Font::FA_Ver_Top)
+				{
+					y = rc.top() + i * h;
+				}
+				else if (align & Font::FA_Ver_Bottom)
+				{
+					y = rc.bottom() - (lines.size() - i) * h;
+				}
+				else
 				{
+					BOOST_ASSERT(align & Font::FA_Ver_Middle);
+
+					y = (rc.top() + rc.bottom()) / 2 - lines.size() * h / 2 + i * h;
+				}
+
+				if (i == 0)
+				{
+					layout.min_pos = float2(x, y);
+					layout.max_pos = float2(x + line_width, y + h);
+				}
+				else
+				{
+					layout.min_pos = MathLib::minimize(layout.min_pos, float2(x, y));
+					layout.max_pos = MathLib::maximize(layout.max_pos, float2(x + line_width, y + h));
+				}
+
+				for (size_t c = std::get<1>(lines[i]); c < std::get<2>(lines[i]); ++ c)
+				{
+					wchar_t const ch = text[c];
 					std::pair<int32_t, uint32_t> const & offset_adv = kl.CharIndexAdvance(ch);
 					if (offset_adv.first != -1)
 					{
@@ -447,95 +624,164 @@ namespace KlayGE
 						float width = ci.width * rel_size_x;
 						float height = ci.height * rel_size_y;
 
-						auto cmiter = cim.find(ch);
-						if (cmiter != cim.end())
+						Rect pos_rc(x + left, y + top, x + left + width, y + top + height);
+						Rect intersect_rc = pos_rc & rc;
+						if ((intersect_rc.Width() > 0) && (intersect_rc.Height() > 0))
 						{
-							Rect const & texRect(cmiter->second.rc);
-							Rect pos_rc(x + left, y + top, x + left + width, y + top + height);
-
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.top(), sz),
-												clr32,
-												float2(texRect.left(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.top(), sz),
-												clr32,
-												float2(texRect.right(), texRect.top())));
-							vertices.push_back(FontVert(float3(pos_rc.right(), pos_rc.bottom(), sz),
-												clr32,
-												float2(texRect.right(), texRect.bottom())));
-							vertices.push_back(FontVert(float3(pos_rc.left(), pos_rc.bottom(), sz),
-												clr32,
-												float2(texRect.left(), texRect.bottom())));
+							this->AddQuad(layout, ch, pos_rc);
 						}
 					}
 
 					x += (offset_adv.second & 0xFFFF) * rel_size_x;
 					y += (offset_adv.second >> 16) * rel_size_y;
-
-					if (x > maxx)
-					{
-						maxx = x;
-					}
 				}
-				else
-				{
-					y += h;
-					x = sx;
+			}
+		}
 
-					if (y > maxy)
-					{
-						maxy = y;
-					}
+		bool ResolveCharSlot(GlyphQuad& quad) const
+		{
+			if ((quad.slot == INVALID_CHAR_SLOT) || (char_slots_[quad.slot].ch != quad.ch))
+			{
+				// The glyph is new or has moved in the texture since the last time
+				auto cmiter = char_info_map_.find(quad.ch);
+				if (cmiter == char_info_map_.end())
+				{
+					// More different characters than the texture can hold
+					return false;
 				}
+				quad.slot = cmiter->second;
 			}
+			return true;
+		}
 
-			tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])), &vertices[0]));
+		void AddLayout(TextLayout& layout, float sx, float sy, float sz, Color const & clr)
+		{
+			uint32_t const clr32 = clr.ABGR();
+			uint32_t const index_per_char = restart_ ? 5 : 6;
 
-			uint16_t last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(FontVert));
-			uint32_t const num_chars = static_cast<uint32_t>(vertices.size() / 4);
-			indices.reserve(num_chars * index_per_char);
-			for (uint32_t c = 0; c < num_chars; ++ c)
+			vertices_.clear();
+			vertices_.reserve(layout.quads.size() * 4);
+			for (auto& quad : layout.quads)
 			{
-				indices.push_back(last_index + 0);
-				indices.push_back(last_index + 1);
-				if (restart_)
+				if (!this->ResolveCharSlot(quad))
 				{
-					indices.push_back(last_index + 3);
-					indices.push_back(last_index + 2);
-					indices.push_back(0xFFFF);
+					continue;
 				}
-				else
+
+				Rect const & texRect = char_slots_[quad.slot].rc;
+				Rect const pos_rc(quad.pos_rc.left() + sx, quad.pos_rc.top() + sy,
+					quad.pos_rc.right() + sx, quad.pos_rc.bottom() + sy);
+
+				vertices_.push_back(FontVert(float3(pos_rc.left(), pos_rc.top(), sz),
+									clr32,
+									float2(texRect.left(), texRect.top())));
+				vertices_.push_back(FontVert(float3(pos_rc.right(), pos_rc.top(), sz),
+									clr32,
+									float2(texRect.right(), texRect.top())));
+				vertices_.push_back(FontVert(float3(pos_rc.right(), pos_rc.bottom(), sz),
+									clr32,
+									float2(texRect.right(), texRect.bottom())));
+				vertices_.push_back(FontVert(float3(pos_rc.left(), pos_rc.bottom(), sz),
+									clr32,
+									float2(texRect.left(), texRect.bottom())));
+			}
+
+			if (!vertices_.empty())
+			{
+				tb_vb_sub_allocs_.push_back(tb_vb_->Alloc(static_cast<uint32_t>(vertices_.size() * sizeof(vertices_[0])), &vertices_[0]));
+
+				uint16_t last_index = static_cast<uint16_t>(tb_vb_sub_allocs_.back().offset_ / sizeof(FontVert));
+				uint32_t const num_chars = static_cast<uint32_t>(vertices_.size() / 4);
+				indices_.clear();
+				indices_.reserve(num_chars * index_per_char);
+				for (uint32_t c = 0; c < num_chars; ++ c)
 				{
-					indices.push_back(last_index + 2);
-					indices.push_back(last_index + 2);
-					indices.push_back(last_index + 3);
-					indices.push_back(last_index + 0);
+					indices_.push_back(last_index + 0);
+					indices_.push_back(last_index + 1);
+					if (restart_)
+					{
+						indices_.push_back(last_index + 3);
+						indices_.push_back(last_index + 2);
+						indices_.push_back(0xFFFF);
+					}
+					else
+					{
+						indices_.push_back(last_index + 2);
+						indices_.push_back(last_index + 2);
+						indices_.push_back(last_index + 3);
+						indices_.push_back(last_index + 0);
+					}
+					last_index += 4;
 				}
-				last_index += 4;
+				BOOST_ASSERT(last_index + 3 <= 0xFFFF);
+				tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices_.size() * sizeof(indices_[0])), &indices_[0]));
+			}
+
+			pos_aabb_ |= AABBox(float3(layout.min_pos.x() + sx, layout.min_pos.y() + sy, sz),
+				float3(layout.max_pos.x() + sx, layout.max_pos.y() + sy, sz + 0.1f));
+		}
+
+		void UnlinkChar(uint32_t slot)
+		{
+			CharInfo& char_info = char_slots_[slot];
+			if (char_info.prev != INVALID_CHAR_SLOT)
+			{
+				char_slots_[char_info.prev].next = char_info.next;
+			}
+			else
+			{
+				lru_head_ = char_info.next;
+			}
+			if (char_info.next != INVALID_CHAR_SLOT)
+			{
+				char_slots_[char_info.next].prev = char_info.prev;
+			}
+			else
+			{
+				lru_tail_ = char_info.prev;
+			}
+		}
+
+		void PushFrontChar(uint32_t slot)
+		{
+			CharInfo& char_info = char_slots_[slot];
+			char_info.prev = INVALID_CHAR_SLOT;
+			char_info.next = lru_head_;
+			if (lru_head_ != INVALID_CHAR_SLOT)
+			{
+				char_slots_[lru_head_].prev = slot;
+			}
+			else
+			{
+				lru_tail_ = slot;
 			}
-			tb_ib_sub_allocs_.push_back(tb_ib_->Alloc(static_cast<uint32_t>(indices.size() * sizeof(indices[0])), &indices[0]));
+			lru_head_ = slot;
+		}
 
-			pos_aabb_ |= AABBox(float3(sx, sy, sz), float3(maxx, maxy, sz + 0.1f));
+		void TouchChar(uint32_t slot)
+		{
+			if (slot != lru_head_)
+			{
+				this->UnlinkChar(slot);
+				this->PushFrontChar(slot);
+			}
 		}
 
 		// ʹLRU㷨
 		/////////////////////////////////////////////////////////////////////////////////
 		void UpdateTexture(std::wstring_view text)
 		{
-			++ tick_;
-
-			uint32_t const tex_size = dist_texture_->Width(0);
-
-			KFont& kl = *kfont_loader_;
+			KFont const & kl = *kfont_loader_;
 			auto& cim = char_info_map_;
 
+			uint32_t const tex_size = dist_texture_->Width(0);
 			uint32_t const kfont_char_size = kl.CharSize();
-
 			uint32_t const num_chars_a_row = tex_size / kfont_char_size;
-			uint32_t const num_total_chars = num_chars_a_row * num_chars_a_row;
 
+			pending_chars_.clear();
 			for (auto const & ch : text)
 			{
-				int32_t offset = kl.CharIndex(ch);
+				int32_t const offset = kl.CharIndex(ch);
 				if (offset != -1)
 				{
 					auto cmiter = cim.find(ch);
@@ -543,123 +789,115 @@ namespace KlayGE
 					{
 						// ҵ
 
-						cmiter->second.tick = tick_;
+						this->TouchChar(cmiter->second);
 					}
 					else
 					{
 						// ҲԵ
 
-						KFont::font_info const & ci = kl.CharInfo(offset);
-
-						uint32_t width = ci.width;
-						uint32_t height = ci.height;
-
-						int2 char_pos;
-						CharInfo charInfo;
-						if (cim.size() < num_total_chars)
+						uint32_t slot;
+						if (!char_free_slots_.empty())
 						{
 							// пռ
 
-							uint32_t const s = char_free_list_.front().first;
-						
-							char_pos.y() = s / num_chars_a_row;
-							char_pos.x() = s - char_pos.y() * num_chars_a_row;
-
-							char_pos.x() *= kfont_char_size;
-							char_pos.y() *= kfont_char_size;
-
-							charInfo.rc.left() = static_cast<float>(char_pos.x()) / tex_size;
-							charInfo.rc.top() = static_cast<float>(char_pos.y()) / tex_size;
-
-							++ char_free_list_.front().first;
-							if (char_free_list_.front().first == char_free_list_.front().second)
-							{
-								char_free_list_.pop_front();
-							}
+							slot = char_free_slots_.back();
+							char_free_slots_.pop_back();
 						}
 						else
 						{
 							// ҵʹʱûʹõ
 
-							uint64_t min_tick = cim.begin()->second.tick;
-							auto min_chiter = cim.begin();
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick < min_tick)
-								{
-									min_tick = chiter->second.tick;
-									min_chiter = chiter;
-								}
-							}
-
-							char_pos.x() = static_cast<int32_t>(min_chiter->second.rc.left() * tex_size);
-							char_pos.y() = static_cast<int32_t>(min_chiter->second.rc.top() * tex_size);
-							charInfo.rc.left() = min_chiter->second.rc.left();
-							charInfo.rc.top() = min_chiter->second.rc.top();
-
-							for (auto chiter = cim.begin(); chiter != cim.end(); ++ chiter)
-							{
-								if (chiter->second.tick == min_tick)
-								{
-									uint32_t const x = static_cast<int32_t>(chiter->second.rc.left() * tex_size);
-									uint32_t const y = static_cast<int32_t>(chiter->second.rc.top() * tex_size);
-									uint32_t const id = y * num_chars_a_row + x;
-									auto freeiter = char_free_list_.begin();
-									while ((freeiter != char_free_list_.end()) && (freeiter->second <= id))
-									{
-										++ freeiter;
-									}
-									char_free_list_.emplace(freeiter, id, id + 1);
-
-									cim.erase(chiter);
-									break;
-								}
-							}
-							for (auto freeiter = char_free_list_.begin(); freeiter != char_free_list_.end();)
-							{
-								auto nextiter = freeiter;
-								++ nextiter;
-
-								if (nextiter != char_free_list_.end())
-								{
-									if (freeiter->second == nextiter->first)
-									{
-										freeiter->second = nextiter->second;
-										char_free_list_.erase(nextiter);
-									}
-									else
-									{
-										++ freeiter;
-									}
-								}
-								else
-								{
-									break;
-								}
-							}
+							slot = lru_tail_;
+							this->UnlinkChar(slot);
+							cim.erase(char_slots_[slot].ch);
 						}
 
-						charInfo.rc.right()		= charInfo.rc.left() + static_cast<float>(width) / tex_size;
-						charInfo.rc.bottom()	= charInfo.rc.top() + static_cast<float>(height) / tex_size;
-						charInfo.tick			= tick_;
+						KFont::font_info const & ci = kl.CharInfo(offset);
+
+						uint32_t const x = slot % num_chars_a_row * kfont_char_size;
+						uint32_t const y = slot / num_chars_a_row * kfont_char_size;
 
-						kl.GetDistanceData(&a_char_data_[0], kfont_char_size, offset);
-						dist_texture_->UpdateSubresource2D(0, 0, char_pos.x(), char_pos.y(), kfont_char_size, kfont_char_size,
-							&a_char_data_[0], kfont_char_size);
+						CharInfo& char_info = char_slots_[slot];
+						char_info.rc.left() = static_cast<float>(x) / tex_size;
+						char_info.rc.top() = static_cast<float>(y) / tex_size;
+						char_info.rc.right() = char_info.rc.left() + static_cast<float>(ci.width) / tex_size;
+						char_info.rc.bottom() = char_info.rc.top() + static_cast<float>(ci.height) / tex_size;
+						char_info.ch = ch;
+						this->PushFrontChar(slot);
 
-						cim.emplace(ch, charInfo);
+						cim.emplace(ch, slot);
+
+						PendingChar pending;
+						pending.slot = slot;
+						pending.offset = offset;
+						pending.ch = ch;
+						pending_chars_.push_back(pending);
 					}
 				}
 			}
+
+			if (!pending_chars_.empty())
+			{
+				this->DecodePendingChars();
+			}
 		}
 
-	private:
-		struct CharInfo
+		void DecodePendingChars()
 		{
-			Rect rc;
-			uint64_t tick;
-		};
+			KFont const & kl = *kfont_loader_;
+
+			uint32_t const tex_size = dist_texture_->Width(0);
+			uint32_t const kfont_char_size = kl.CharSize();
+			uint32_t const num_chars_a_row = tex_size / kfont_char_size;
+			uint32_t const char_data_size = kfont_char_size * kfont_char_size;
+			uint32_t const num_pending = static_cast<uint32_t>(pending_chars_.size());
+
+			// The compressed data can come from the font file, so it's read here in order
+			lzma_offsets_.resize(num_pending + 1);
+			lzma_offsets_[0] = 0;
+			for (uint32_t i = 0; i < num_pending; ++ i)
+			{
+				uint32_t size;
+				kl.GetLZMADistanceData(nullptr, size, pending_chars_[i].offset);
+				lzma_offsets_[i + 1] = lzma_offsets_[i] + size;
+			}
+			lzma_data_.resize(lzma_offsets_.back());
+			for (uint32_t i = 0; i < num_pending; ++ i)
+			{
+				uint32_t size;
+				kl.GetLZMADistanceData(&lzma_data_[lzma_offsets_[i]], size, pending_chars_[i].offset);
+			}
 
+			a_char_data_.resize(num_pending * char_data_size);
+			parallel_for_chunks(Context::Instance().ThreadPool(), num_pending,
+				num_parallel_workers(num_pending, MIN_CHARS_PER_WORKER),
+				[this, char_data_size](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					KFL_UNUSED(worker);
+					LZMACodec lzma;
+					for (uint32_t i = first; i < last; ++ i)
+					{
+						lzma.Decode(&a_char_data_[i * char_data_size],
+							MakeArrayRef(&lzma_data_[lzma_offsets_[i]], lzma_offsets_[i + 1] - lzma_offsets_[i]), char_data_size);
+					}
+				});
+
+			for (uint32_t i = 0; i < num_pending; ++ i)
+			{
+				PendingChar const & pending = pending_chars_[i];
+
+				// Skips glyphs replaced by later ones in the same text
+				if (char_slots_[pending.slot].ch == pending.ch)
+				{
+					uint32_t const x = pending.slot % num_chars_a_row * kfont_char_size;
+					uint32_t const y = pending.slot / num_chars_a_row * kfont_char_size;
+					dist_texture_->UpdateSubresource2D(0, 0, x, y, kfont_char_size, kfont_char_size,
+						&a_char_data_[i * char_data_size], kfont_char_size);
+				}
+			}
+		}
+
+	private:
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(push, 1)
 #endif
@@ -683,8 +921,18 @@ namespace KlayGE
 
 		bool restart_;
 
-		std::unordered_map<wchar_t, CharInfo> char_info_map_;
-		std::list<std::pair<uint32_t, uint32_t>> char_free_list_;
+		// A slot is a char_size x char_size cell of the distance texture
+		std::vector<CharInfo> char_slots_;
+		std::vector<uint32_t> char_free_slots_;
+		std::unordered_map<wchar_t, uint32_t> char_info_map_;
+		uint32_t lru_head_;
+		uint32_t lru_tail_;
+
+		std::vector<PendingChar> pending_chars_;
+		std::vector<uint8_t> lzma_data_;
+		std::vector<uint32_t> lzma_offsets_;
+
+		std::unordered_map<size_t, TextLayout> layouts_;
 
 		bool three_dim_;
 
@@ -692,6 +940,8 @@ namespace KlayGE
 		std::unique_ptr<TransientBuffer> tb_ib_;
 		std::vector<SubAlloc> tb_vb_sub_allocs_;
 		std::vector<SubAlloc> tb_ib_sub_allocs_;
+		std::vector<FontVert> vertices_;
+		std::vector<uint16_t> indices_;
 
 		TexturePtr		dist_texture_;
 		std::vector<uint8_t> a_char_data_;
@@ -773,6 +1023,13 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			size_t seed = HashRange(font_desc_.res_name.begin(), font_desc_.res_name.end());
+			HashCombine(seed, font_desc_.flag);
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -904,6 +1161,27 @@ namespace KlayGE
 	}
 
 
+	uint32_t Font::CharCacheCapacity() const
+	{
+		return font_renderable_->CharCacheCapacity();
+	}
+
+	std::wstring Font::CachedChars() const
+	{
+		return font_renderable_->CachedChars();
+	}
+
+	uint32_t Font::NumCachedLayouts() const
+	{
+		return font_renderable_->NumCachedLayouts();
+	}
+
+	std::vector<Rect> Font::CharTexRects(std::wstring_view text, float font_size)
+	{
+		return font_renderable_->CharTexRects(text, font_size);
+	}
+
+
 	FontPtr SyncLoadFont(std::string_view font_name, uint32_t flags)
 	{
 		return ResLoader::Instance().SyncQueryT<Font>(MakeSharedPtr<FontLoadingDesc>(font_name, flags));
@@ -49,6 +49,12 @@ namespace KlayGE
 	{
 	}
 
+	SoftwareGraphicsBuffer::SoftwareGraphicsBuffer(uint32_t size_in_byte, std::shared_ptr<void const> const & data_holder)
+		: GraphicsBuffer(BU_Dynamic, EAH_CPU_Read | EAH_CPU_Write, size_in_byte, 0),
+			ref_only_(true), data_holder_(data_holder)
+	{
+	}
+
 	void SoftwareGraphicsBuffer::CopyToBuffer(GraphicsBuffer& target)
 	{
 		this->CopyToSubBuffer(target, 0, 0, size_in_byte_);
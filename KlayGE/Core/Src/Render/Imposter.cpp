@@ -124,6 +124,11 @@ namespace KlayGE
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			return HashRange(imposter_desc_.res_name.begin(), imposter_desc_.res_name.end());
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -0,0 +1,373 @@
+/**
+ * @file LightCluster.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/assert.hpp>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+	#include <xmmintrin.h>
+#endif
+
+#include <KlayGE/LightCluster.hpp>
+
+namespace
+{
+	// Below this many lights, binning on one thread is faster than waking up the pool
+	uint32_t const MIN_LIGHTS_PER_WORKER = 64;
+}
+
+namespace KlayGE
+{
+	LightClusterBuilder::LightClusterBuilder()
+		: LightClusterBuilder(16, 8, 24)
+	{
+	}
+
+	LightClusterBuilder::LightClusterBuilder(uint32_t tiles_x, uint32_t tiles_y, uint32_t slices)
+		: tiles_x_(tiles_x), tiles_y_(tiles_y), slices_(slices),
+			proj_(float4x4::Zero()), near_plane_(0), far_plane_(0)
+	{
+		BOOST_ASSERT((tiles_x > 0) && (tiles_y > 0) && (slices > 0));
+
+		cluster_bounds_.Resize(this->NumClusters());
+		cluster_offsets_.assign(this->NumClusters(), 0);
+		cluster_counts_.assign(this->NumClusters(), 0);
+	}
+
+	void LightClusterBuilder::Build(float4x4 const & view, float4x4 const & proj, float near_plane, float far_plane,
+		SphereSoA const & lights_ws)
+	{
+		BOOST_ASSERT((near_plane > 0) && (near_plane < far_plane));
+
+		if ((near_plane != near_plane_) || (far_plane != far_plane_) || !(proj == proj_))
+		{
+			this->UpdateClusterBounds(proj, near_plane, far_plane);
+		}
+
+		uint32_t const num_lights = static_cast<uint32_t>(lights_ws.Size());
+		centers_es_.resize(num_lights);
+		radii_.resize(num_lights);
+		for (uint32_t i = 0; i < num_lights; ++ i)
+		{
+			centers_es_[i] = float3(lights_ws.CenterX()[i], lights_ws.CenterY()[i], lights_ws.CenterZ()[i]);
+			radii_[i] = lights_ws.Radius()[i];
+		}
+		SIMDMathLib::TransformCoordVector3(centers_es_.data(), centers_es_.data(), num_lights, view);
+
+		light_ranges_.resize(num_lights);
+		light_valid_.resize(num_lights);
+		for (uint32_t i = 0; i < num_lights; ++ i)
+		{
+			light_valid_[i] = this->CalcLightRange(centers_es_[i], radii_[i], light_ranges_[i]);
+		}
+
+		uint32_t const num_workers = std::min(num_parallel_workers(num_lights, MIN_LIGHTS_PER_WORKER), slices_);
+		worker_hits_.resize(std::max(static_cast<uint32_t>(worker_hits_.size()), num_workers));
+
+		parallel_for_chunks(Context::Instance().ThreadPool(), slices_, num_workers,
+			[this](uint32_t worker, uint32_t first_slice, uint32_t last_slice)
+			{
+				this->BinSlices(first_slice, last_slice, worker_hits_[worker]);
+			});
+
+		// Compact the (cluster, light) pairs into per cluster lists. The lights of a cluster come from one worker in
+		// ascending order, so the lists end up sorted.
+		std::fill(cluster_counts_.begin(), cluster_counts_.end(), 0U);
+		for (uint32_t w = 0; w < num_workers; ++ w)
+		{
+			auto const & hits = worker_hits_[w];
+			for (size_t i = 0; i < hits.size(); i += 2)
+			{
+				++ cluster_counts_[hits[i]];
+			}
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t c = 0; c < this->NumClusters(); ++ c)
+		{
+			cluster_offsets_[c] = offset;
+			offset += cluster_counts_[c];
+			cluster_counts_[c] = 0;
+		}
+
+		light_indices_.resize(offset);
+		num_light_clusters_.assign(num_lights, 0);
+		for (uint32_t w = 0; w < num_workers; ++ w)
+		{
+			auto const & hits = worker_hits_[w];
+			for (size_t i = 0; i < hits.size(); i += 2)
+			{
+				uint32_t const cluster = hits[i + 0];
+				uint32_t const light = hits[i + 1];
+				light_indices_[cluster_offsets_[cluster] + cluster_counts_[cluster]] = light;
+				++ cluster_counts_[cluster];
+				++ num_light_clusters_[light];
+			}
+		}
+	}
+
+	void LightClusterBuilder::RemapLights(std::vector<uint32_t> const & slots, std::vector<uint32_t>& offsets,
+		std::vector<uint32_t>& counts, std::vector<uint32_t>& indices) const
+	{
+		BOOST_ASSERT(slots.size() == num_light_clusters_.size());
+
+		offsets.resize(this->NumClusters());
+		counts.resize(this->NumClusters());
+		indices.clear();
+		for (uint32_t c = 0; c < this->NumClusters(); ++ c)
+		{
+			uint32_t const offset = static_cast<uint32_t>(indices.size());
+			for (uint32_t i = 0; i < cluster_counts_[c]; ++ i)
+			{
+				uint32_t const slot = slots[light_indices_[cluster_offsets_[c] + i]];
+				if (slot != INVALID_SLOT)
+				{
+					indices.push_back(slot);
+				}
+			}
+			std::sort(indices.begin() + offset, indices.end());
+
+			offsets[c] = offset;
+			counts[c] = static_cast<uint32_t>(indices.size()) - offset;
+		}
+	}
+
+	int32_t LightClusterBuilder::ClusterIndex(float3 const & pos_es) const
+	{
+		if ((pos_es.z() < near_plane_) || (pos_es.z() > far_plane_))
+		{
+			return -1;
+		}
+
+		float const ndc_x = pos_es.x() * proj_(0, 0) / pos_es.z() + proj_(2, 0);
+		float const ndc_y = pos_es.y() * proj_(1, 1) / pos_es.z() + proj_(2, 1);
+		if ((ndc_x < -1) || (ndc_x > 1) || (ndc_y < -1) || (ndc_y > 1))
+		{
+			return -1;
+		}
+
+		return this->ClusterIndex(this->TileXOf(ndc_x), this->TileYOf(ndc_y), this->SliceOf(pos_es.z()));
+	}
+
+	AABBox LightClusterBuilder::ClusterBound(uint32_t cluster) const
+	{
+		return cluster_bounds_.Get(cluster);
+	}
+
+	void LightClusterBuilder::UpdateClusterBounds(float4x4 const & proj, float near_plane, float far_plane)
+	{
+		proj_ = proj;
+		near_plane_ = near_plane;
+		far_plane_ = far_plane;
+
+		slice_depths_.resize(slices_ + 1);
+		for (uint32_t s = 0; s < slices_; ++ s)
+		{
+			slice_depths_[s] = near_plane * std::pow(far_plane / near_plane, static_cast<float>(s) / slices_);
+		}
+		slice_depths_[slices_] = far_plane;
+
+		// A point at ndc_x and depth z is at x = (ndc_x - proj(2, 0)) * z / proj(0, 0) in view space
+		for (uint32_t s = 0; s < slices_; ++ s)
+		{
+			float const z[] = { slice_depths_[s], slice_depths_[s + 1] };
+			for (uint32_t y = 0; y < tiles_y_; ++ y)
+			{
+				float const ndc_y[] = { 1 - 2.0f * y / tiles_y_, 1 - 2.0f * (y + 1) / tiles_y_ };
+				for (uint32_t x = 0; x < tiles_x_; ++ x)
+				{
+					float const ndc_x[] = { -1 + 2.0f * x / tiles_x_, -1 + 2.0f * (x + 1) / tiles_x_ };
+
+					float3 min_pt(+1e10f, +1e10f, z[0]);
+					float3 max_pt(-1e10f, -1e10f, z[1]);
+					for (int i = 0; i < 2; ++ i)
+					{
+						for (int j = 0; j < 2; ++ j)
+						{
+							float const vx = (ndc_x[j] - proj(2, 0)) * z[i] / proj(0, 0);
+							float const vy = (ndc_y[j] - proj(2, 1)) * z[i] / proj(1, 1);
+							min_pt.x() = std::min(min_pt.x(), vx);
+							min_pt.y() = std::min(min_pt.y(), vy);
+							max_pt.x() = std::max(max_pt.x(), vx);
+							max_pt.y() = std::max(max_pt.y(), vy);
+						}
+					}
+
+					cluster_bounds_.Set(this->ClusterIndex(x, y, s), AABBox(min_pt, max_pt));
+				}
+			}
+		}
+	}
+
+	uint32_t LightClusterBuilder::SliceOf(float z) const
+	{
+		// The same depths as the cluster bounds, so a point is never binned into a slice that doesn't contain it
+		auto const first = slice_depths_.begin() + 1;
+		auto const last = slice_depths_.begin() + slices_;
+		return static_cast<uint32_t>(std::upper_bound(first, last, z) - first);
+	}
+
+	uint32_t LightClusterBuilder::TileXOf(float ndc_x) const
+	{
+		int const x = static_cast<int>(std::floor((ndc_x + 1) * 0.5f * tiles_x_));
+		return static_cast<uint32_t>(MathLib::clamp(x, 0, static_cast<int>(tiles_x_) - 1));
+	}
+
+	uint32_t LightClusterBuilder::TileYOf(float ndc_y) const
+	{
+		int const y = static_cast<int>(std::floor((1 - ndc_y) * 0.5f * tiles_y_));
+		return static_cast<uint32_t>(MathLib::clamp(y, 0, static_cast<int>(tiles_y_) - 1));
+	}
+
+	bool LightClusterBuilder::CalcLightRange(float3 const & center_es, float radius, LightRange& range) const
+	{
+		float const z_min = std::max(center_es.z() - radius, near_plane_);
+		float const z_max = std::min(center_es.z() + radius, far_plane_);
+		if (z_min > z_max)
+		{
+			return false;
+		}
+
+		// x / z is monotonic in both x and z for z > 0, so the extremes of the projected view space box are at its corners
+		float ndc_min_x = +1e10f;
+		float ndc_max_x = -1e10f;
+		float ndc_min_y = +1e10f;
+		float ndc_max_y = -1e10f;
+		float const xs[] = { center_es.x() - radius, center_es.x() + radius };
+		float const ys[] = { center_es.y() - radius, center_es.y() + radius };
+		float const zs[] = { z_min, z_max };
+		for (int i = 0; i < 2; ++ i)
+		{
+			for (int j = 0; j < 2; ++ j)
+			{
+				float const ndc_x = xs[j] * proj_(0, 0) / zs[i] + proj_(2, 0);
+				float const ndc_y = ys[j] * proj_(1, 1) / zs[i] + proj_(2, 1);
+				ndc_min_x = std::min(ndc_min_x, ndc_x);
+				ndc_max_x = std::max(ndc_max_x, ndc_x);
+				ndc_min_y = std::min(ndc_min_y, ndc_y);
+				ndc_max_y = std::max(ndc_max_y, ndc_y);
+			}
+		}
+		if ((ndc_max_x < -1) || (ndc_min_x > 1) || (ndc_max_y < -1) || (ndc_min_y > 1))
+		{
+			return false;
+		}
+
+		range.x0 = this->TileXOf(ndc_min_x);
+		range.x1 = this->TileXOf(ndc_max_x);
+		range.y0 = this->TileYOf(ndc_max_y);
+		range.y1 = this->TileYOf(ndc_min_y);
+		range.slice0 = this->SliceOf(z_min);
+		range.slice1 = this->SliceOf(z_max);
+		return true;
+	}
+
+	void LightClusterBuilder::BinSlices(uint32_t first_slice, uint32_t last_slice, std::vector<uint32_t>& hits) const
+	{
+		hits.clear();
+
+		float const * min_x = cluster_bounds_.MinX();
+		float const * min_y = cluster_bounds_.MinY();
+		float const * min_z = cluster_bounds_.MinZ();
+		float const * max_x = cluster_bounds_.MaxX();
+		float const * max_y = cluster_bounds_.MaxY();
+		float const * max_z = cluster_bounds_.MaxZ();
+
+		uint32_t const num_lights = static_cast<uint32_t>(light_ranges_.size());
+		for (uint32_t s = first_slice; s < last_slice; ++ s)
+		{
+			for (uint32_t light = 0; light < num_lights; ++ light)
+			{
+				LightRange const & range = light_ranges_[light];
+				if (!light_valid_[light] || (s < range.slice0) || (s > range.slice1))
+				{
+					continue;
+				}
+
+				float3 const & center = centers_es_[light];
+				float const radius_sq = radii_[light] * radii_[light];
+
+				// Sphere vs cluster AABB on a row of clusters, several at a time
+				for (uint32_t y = range.y0; y <= range.y1; ++ y)
+				{
+					uint32_t const row = this->ClusterIndex(0, y, s);
+					uint32_t x = range.x0;
+#if defined(KLAYGE_SSE_SUPPORT)
+					__m128 const cx = _mm_set1_ps(center.x());
+					__m128 const cy = _mm_set1_ps(center.y());
+					__m128 const cz = _mm_set1_ps(center.z());
+					__m128 const r_sq = _mm_set1_ps(radius_sq);
+					__m128 const zero = _mm_setzero_ps();
+					for (; x + 4 <= range.x1 + 1; x += 4)
+					{
+						uint32_t const index = row + x;
+						__m128 const dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_x + index), cx),
+							_mm_sub_ps(cx, _mm_loadu_ps(max_x + index))), zero);
+						__m128 const dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_y + index), cy),
+							_mm_sub_ps(cy, _mm_loadu_ps(max_y + index))), zero);
+						__m128 const dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(min_z + index), cz),
+							_mm_sub_ps(cz, _mm_loadu_ps(max_z + index))), zero);
+						__m128 const dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+						int const mask = _mm_movemask_ps(_mm_cmple_ps(dist_sq, r_sq));
+						for (uint32_t k = 0; k < 4; ++ k)
+						{
+							if (mask & (1 << k))
+							{
+								hits.push_back(index + k);
+								hits.push_back(light);
+							}
+						}
+					}
+#endif
+					for (; x <= range.x1; ++ x)
+					{
+						uint32_t const index = row + x;
+						float const dx = std::max(std::max(min_x[index] - center.x(), center.x() - max_x[index]), 0.0f);
+						float const dy = std::max(std::max(min_y[index] - center.y(), center.y() - max_y[index]), 0.0f);
+						float const dz = std::max(std::max(min_z[index] - center.z(), center.z() - max_z[index]), 0.0f);
+						if (dx * dx + dy * dy + dz * dz <= radius_sq)
+						{
+							hits.push_back(index);
+							hits.push_back(light);
+						}
+					}
+				}
+			}
+		}
+	}
+}
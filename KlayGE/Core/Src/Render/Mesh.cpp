@@ -23,6 +23,7 @@
 #include <KFL/CXX17/filesystem.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
@@ -50,7 +51,34 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const MODEL_BIN_VERSION = 16;
+	uint32_t const MODEL_BIN_VERSION = 17;
+
+	// Vertex and index streams are aligned in the decoded model_bin, so they can be used in place
+	uint32_t const MODEL_BIN_STREAM_ALIGNMENT = 16;
+
+	// The decoded model_bin starts with this header, all in little endian. It's followed by the vertex elements, the
+	// offsets of vertex streams, and the variable length part with materials, meshes, nodes, joints, and animations.
+	// Then the vertex streams and the index stream, each aligned to MODEL_BIN_STREAM_ALIGNMENT.
+	struct ModelBinHeader
+	{
+		uint32_t num_mtls;
+		uint32_t num_meshes;
+		uint32_t num_nodes;
+		uint32_t num_joints;
+		uint32_t num_kfs;
+		uint32_t num_actions;
+		uint32_t num_merged_ves;
+		uint32_t all_num_vertices;
+		uint32_t all_num_indices;
+		uint32_t all_is_index_16_bit;
+
+		uint64_t ves_offset;
+		uint64_t vb_offsets_offset;
+		uint64_t meta_offset;
+		uint64_t meta_size;
+		uint64_t ib_offset;
+	};
+	static_assert(sizeof(ModelBinHeader) == 80, "sizeof(ModelBinHeader) must be 80.");
 
 	class RenderModelLoadingDesc : public ResLoadingDesc
 	{
@@ -133,6 +161,11 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			return HashRange(model_desc_.res_name.begin(), model_desc_.res_name.end());
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			KFL_UNUSED(rhs);
@@ -696,6 +729,7 @@ namespace KlayGE
 
 	SkinnedModel::SkinnedModel(SceneNodePtr const & root_node)
 		: RenderModel(root_node),
+			palette_reals_(nullptr), palette_duals_(nullptr), crowd_(nullptr),
 			last_frame_(-1),
 			num_frames_(0), frame_rate_(0)
 	{
@@ -708,36 +742,103 @@ namespace KlayGE
 
 	void SkinnedModel::BuildBones(float frame)
 	{
+		anim_sampler_.Sample(frame);
+		this->BuildBonesFromPose();
+		this->UpdateBinds();
+	}
+
+	void SkinnedModel::BuildBlendedBones()
+	{
+		this->SampleBlendedPose();
+		this->BuildBonesFromPose();
+		this->UpdateBinds();
+	}
+
+	void SkinnedModel::SampleBlendedPose()
+	{
+		BOOST_ASSERT(!last_layers_.empty());
+
+		layer_frames_.resize(last_layers_.size());
+		layer_weights_.resize(last_layers_.size());
+		for (size_t i = 0; i < last_layers_.size(); ++ i)
+		{
+			AnimationLayer const & layer = last_layers_[i];
+
+			std::string name;
+			uint32_t start_frame;
+			uint32_t end_frame;
+			this->GetAction(layer.action, name, start_frame, end_frame);
+
+			float frame = static_cast<float>(start_frame);
+			if (end_frame > start_frame)
+			{
+				float const length = static_cast<float>(end_frame - start_frame);
+				float local_frame = std::fmod(layer.frame, length);
+				if (local_frame < 0)
+				{
+					local_frame += length;
+				}
+				frame += local_frame;
+			}
+
+			layer_frames_[i] = frame;
+			layer_weights_[i] = layer.weight;
+		}
+
+		anim_sampler_.Sample(layer_frames_, layer_weights_);
+	}
+
+	void SkinnedModel::EvaluatePalette(float4* reals, float4* duals)
+	{
+		if (last_layers_.empty())
+		{
+			anim_sampler_.Sample(last_frame_);
+		}
+		else
+		{
+			this->SampleBlendedPose();
+		}
+		this->BuildBonesFromPose();
+		this->UpdateBinds(reals, duals);
+	}
+
+	void SkinnedModel::BuildBonesFromPose()
+	{
+		std::vector<Quaternion> const & key_reals = anim_sampler_.Reals();
+		std::vector<Quaternion> const & key_duals = anim_sampler_.Duals();
+		std::vector<float> const & key_scales = anim_sampler_.Scales();
+		BOOST_ASSERT(key_reals.size() == joints_.size());
+
 		for (size_t i = 0; i < joints_.size(); ++ i)
 		{
 			Joint& joint = joints_[i];
-			KeyFrameSet const & kf = (*key_frame_sets_)[i];
 
-			std::tuple<Quaternion, Quaternion, float> key_dq = kf.Frame(frame);
+			Quaternion key_real = key_reals[i];
+			Quaternion key_dual = key_duals[i];
+			float const key_scale = key_scales[i];
 
 			if (joint.parent != -1)
 			{
 				Joint const & parent(joints_[joint.parent]);
 
-				if (MathLib::dot(std::get<0>(key_dq), parent.bind_real) < 0)
+				if (MathLib::dot(key_real, parent.bind_real) < 0)
 				{
-					std::get<0>(key_dq) = -std::get<0>(key_dq);
-					std::get<1>(key_dq) = -std::get<1>(key_dq);
+					key_real = -key_real;
+					key_dual = -key_dual;
 				}
 
-				if ((MathLib::SignBit(std::get<2>(key_dq)) > 0) && (MathLib::SignBit(parent.bind_scale) > 0))
+				if ((MathLib::SignBit(key_scale) > 0) && (MathLib::SignBit(parent.bind_scale) > 0))
 				{
-					joint.bind_real = MathLib::mul_real(std::get<0>(key_dq), parent.bind_real);
-					joint.bind_dual = MathLib::mul_dual(std::get<0>(key_dq), std::get<1>(key_dq) * parent.bind_scale,
+					joint.bind_real = MathLib::mul_real(key_real, parent.bind_real);
+					joint.bind_dual = MathLib::mul_dual(key_real, key_dual * parent.bind_scale,
 						parent.bind_real, parent.bind_dual);
-					joint.bind_scale = std::get<2>(key_dq) * parent.bind_scale;
+					joint.bind_scale = key_scale * parent.bind_scale;
 				}
 				else
 				{
-					float const key_scale = std::get<2>(key_dq);
 					float4x4 tmp_mat = MathLib::scaling(MathLib::abs(key_scale), MathLib::abs(key_scale), key_scale)
-						* MathLib::to_matrix(std::get<0>(key_dq))
-						* MathLib::translation(MathLib::udq_to_trans(std::get<0>(key_dq), std::get<1>(key_dq)))
+						* MathLib::to_matrix(key_real)
+						* MathLib::translation(MathLib::udq_to_trans(key_real, key_dual))
 						* MathLib::scaling(MathLib::abs(parent.bind_scale), MathLib::abs(parent.bind_scale), parent.bind_scale)
 						* MathLib::to_matrix(parent.bind_real)
 						* MathLib::translation(MathLib::udq_to_trans(parent.bind_real, parent.bind_dual));
@@ -766,20 +867,45 @@ namespace KlayGE
 			}
 			else
 			{
-				joint.bind_real = std::get<0>(key_dq);
-				joint.bind_dual = std::get<1>(key_dq);
-				joint.bind_scale = std::get<2>(key_dq);
+				joint.bind_real = key_real;
+				joint.bind_dual = key_dual;
+				joint.bind_scale = key_scale;
 			}
 		}
-
-		this->UpdateBinds();
 	}
 
 	void SkinnedModel::UpdateBinds()
 	{
-		bind_reals_.resize(joints_.size());
-		bind_duals_.resize(joints_.size());
-		for (size_t i = 0; i < joints_.size(); ++ i)
+		size_t const num_joints = joints_.size();
+		bind_reals_.resize(num_joints);
+		bind_duals_.resize(num_joints);
+
+		this->UpdateBinds(bind_reals_.data(), bind_duals_.data());
+		palette_reals_ = bind_reals_.data();
+		palette_duals_ = bind_duals_.data();
+	}
+
+	void SkinnedModel::UpdateBinds(float4* reals, float4* duals)
+	{
+		size_t const num_joints = joints_.size();
+
+		// Multiply inverse_origin * bind of all joints in one batch. Joints with negative scale are redone below.
+		bind_dq_scratch_.resize(num_joints * 4);
+		Quaternion* origin_reals = bind_dq_scratch_.data();
+		Quaternion* origin_duals = origin_reals + num_joints;
+		Quaternion* joint_reals = origin_duals + num_joints;
+		Quaternion* joint_duals = joint_reals + num_joints;
+		for (size_t i = 0; i < num_joints; ++ i)
+		{
+			Joint const & joint = joints_[i];
+			origin_reals[i] = joint.inverse_origin_real;
+			origin_duals[i] = joint.inverse_origin_dual;
+			joint_reals[i] = joint.bind_real;
+			joint_duals[i] = joint.bind_dual;
+		}
+		SIMDMathLib::MultiplyDualQuat(origin_reals, origin_duals, origin_reals, origin_duals, joint_reals, joint_duals, num_joints);
+
+		for (size_t i = 0; i < num_joints; ++ i)
 		{
 			Joint const & joint = joints_[i];
 
@@ -787,9 +913,8 @@ namespace KlayGE
 			float bind_scale;
 			if ((MathLib::SignBit(joint.inverse_origin_scale) > 0) && (MathLib::SignBit(joint.bind_scale) > 0))
 			{
-				bind_real = MathLib::mul_real(joint.inverse_origin_real, joint.bind_real);
-				bind_dual = MathLib::mul_dual(joint.inverse_origin_real, joint.inverse_origin_dual,
-					joint.bind_real, joint.bind_dual);
+				bind_real = origin_reals[i];
+				bind_dual = origin_duals[i];
 				bind_scale = joint.inverse_origin_scale * joint.bind_scale;
 
 				if (MathLib::SignBit(bind_real.w()) < 0)
@@ -835,8 +960,8 @@ namespace KlayGE
 				}
 			}
 
-			bind_reals_[i] = float4(bind_real.x(), bind_real.y(), bind_real.z(), bind_real.w()) * bind_scale;
-			bind_duals_[i] = float4(bind_dual.x(), bind_dual.y(), bind_dual.z(), bind_dual.w());
+			reals[i] = float4(bind_real.x(), bind_real.y(), bind_real.z(), bind_real.w()) * bind_scale;
+			duals[i] = float4(bind_dual.x(), bind_dual.y(), bind_dual.z(), bind_dual.w());
 		}
 	}
 
@@ -847,17 +972,43 @@ namespace KlayGE
 
 	void SkinnedModel::SetFrame(float frame)
 	{
-		if (last_frame_ != frame)
+		if ((last_frame_ != frame) || !last_layers_.empty())
 		{
 			last_frame_ = frame;
+			last_layers_.clear();
 
-			this->BuildBones(frame);
+			if (!crowd_)
+			{
+				this->BuildBones(frame);
+			}
+		}
+	}
+
+	void SkinnedModel::BlendActions(ArrayRef<AnimationLayer> layers)
+	{
+		BOOST_ASSERT(!layers.empty());
+
+		if (layers.data() != last_layers_.data())
+		{
+			last_layers_.assign(layers.begin(), layers.end());
+		}
+
+		if (!crowd_)
+		{
+			this->BuildBlendedBones();
 		}
 	}
 
 	void SkinnedModel::RebindJoints()
 	{
-		this->BuildBones(last_frame_);
+		if (last_layers_.empty())
+		{
+			this->BuildBones(last_frame_);
+		}
+		else
+		{
+			this->BuildBlendedBones();
+		}
 	}
 
 	void SkinnedModel::UnbindJoints()
@@ -867,6 +1018,8 @@ namespace KlayGE
 			bind_reals_[i] = float4(0, 0, 0, 1);
 			bind_duals_[i] = float4(0, 0, 0, 0);
 		}
+		palette_reals_ = bind_reals_.data();
+		palette_duals_ = bind_duals_.data();
 	}
 
 	AABBox SkinnedModel::FramePosBound(uint32_t frame) const
@@ -880,6 +1033,18 @@ namespace KlayGE
 		return pos_aabb;
 	}
 
+	void SkinnedModel::AttachKeyFrameSets(std::shared_ptr<std::vector<KeyFrameSet>> const & kf, AnimationClipPtr const & clip)
+	{
+		key_frame_sets_ = kf;
+
+		AnimationClipPtr anim_clip = clip;
+		if (!anim_clip && kf && !kf->empty())
+		{
+			anim_clip = MakeSharedPtr<AnimationClip>(*kf);
+		}
+		anim_sampler_.Clip(anim_clip);
+	}
+
 	void SkinnedModel::AttachActions(std::shared_ptr<std::vector<AnimationAction>> const & actions)
 	{
 		actions_ = actions;
@@ -926,7 +1091,7 @@ namespace KlayGE
 				joints[i] = src_skinned_model.GetJoint(i);
 			}
 			skinned_model.AssignJoints(joints.begin(), joints.end());
-			skinned_model.AttachKeyFrameSets(src_skinned_model.GetKeyFrameSets());
+			skinned_model.AttachKeyFrameSets(src_skinned_model.GetKeyFrameSets(), src_skinned_model.GetAnimationClip());
 
 			skinned_model.NumFrames(src_skinned_model.NumFrames());
 			skinned_model.FrameRate(src_skinned_model.FrameRate());
@@ -1052,9 +1217,7 @@ namespace KlayGE
 
 		std::vector<RenderMaterialPtr> mtls;
 		std::vector<VertexElement> merged_ves;
-		char all_is_index_16_bit;
-		std::vector<std::vector<uint8_t>> merged_buff;
-		std::vector<uint8_t> merged_indices;
+		std::vector<uint64_t> vb_offsets;
 		std::vector<std::string> mesh_names;
 		std::vector<int32_t> mtl_ids;
 		std::vector<uint32_t> mesh_lods;
@@ -1084,37 +1247,66 @@ namespace KlayGE
 		ver = LE2Native(ver);
 		BOOST_ASSERT(MODEL_BIN_VERSION == ver);
 
-		std::shared_ptr<std::stringstream> ss = MakeSharedPtr<std::stringstream>();
-
 		uint64_t original_len, len;
 		runtime_file->read(&original_len, sizeof(original_len));
 		original_len = LE2Native(original_len);
 		runtime_file->read(&len, sizeof(len));
 		len = LE2Native(len);
 
+		// Decode the whole payload into a single buffer. The vertex and index streams are used in place from it.
+		auto decoded_data = MakeSharedPtr<std::vector<uint8_t>>();
 		LZMACodec lzma;
-		lzma.Decode(*ss, runtime_file, len, original_len);
+		ArrayRef<uint8_t> const runtime_view = runtime_file->View();
+		int64_t const data_offset = runtime_file->tellg();
+		if (!runtime_view.empty() && (static_cast<uint64_t>(data_offset) + len <= runtime_view.size()))
+		{
+			decoded_data->resize(static_cast<size_t>(original_len));
+			lzma.Decode(decoded_data->data(), ArrayRef<uint8_t>(runtime_view.data() + data_offset, static_cast<size_t>(len)),
+				original_len);
+		}
+		else
+		{
+			lzma.Decode(*decoded_data, runtime_file, len, original_len);
+		}
+
+		ModelBinHeader header;
+		BOOST_ASSERT(decoded_data->size() >= sizeof(header));
+		std::memcpy(&header, decoded_data->data(), sizeof(header));
+
+		uint32_t const num_mtls = LE2Native(header.num_mtls);
+		uint32_t const num_meshes = LE2Native(header.num_meshes);
+		uint32_t const num_nodes = LE2Native(header.num_nodes);
+		uint32_t const num_joints = LE2Native(header.num_joints);
+		uint32_t const num_kfs = LE2Native(header.num_kfs);
+		uint32_t const num_actions = LE2Native(header.num_actions);
+		uint32_t const num_merged_ves = LE2Native(header.num_merged_ves);
+		uint32_t const all_num_vertices = LE2Native(header.all_num_vertices);
+		uint32_t const all_num_indices = LE2Native(header.all_num_indices);
+		bool const all_is_index_16_bit = LE2Native(header.all_is_index_16_bit) ? true : false;
+		uint64_t const ves_offset = LE2Native(header.ves_offset);
+		uint64_t const vb_offsets_offset = LE2Native(header.vb_offsets_offset);
+		uint64_t const meta_offset = LE2Native(header.meta_offset);
+		uint64_t const meta_size = LE2Native(header.meta_size);
+		uint64_t const ib_offset = LE2Native(header.ib_offset);
 
-		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(runtime_file->ResName(), runtime_file->Timestamp(), ss);
+		merged_ves.resize(num_merged_ves);
+		vb_offsets.resize(num_merged_ves);
+		if (num_merged_ves > 0)
+		{
+			std::memcpy(merged_ves.data(), decoded_data->data() + ves_offset, merged_ves.size() * sizeof(merged_ves[0]));
+			std::memcpy(vb_offsets.data(), decoded_data->data() + vb_offsets_offset, vb_offsets.size() * sizeof(vb_offsets[0]));
+		}
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			merged_ves[i].usage = LE2Native(merged_ves[i].usage);
+			merged_ves[i].format = LE2Native(merged_ves[i].format);
+			vb_offsets[i] = LE2Native(vb_offsets[i]);
+		}
 
-		uint32_t num_mtls;
-		decoded->read(&num_mtls, sizeof(num_mtls));
-		num_mtls = LE2Native(num_mtls);
-		uint32_t num_meshes;
-		decoded->read(&num_meshes, sizeof(num_meshes));
-		num_meshes = LE2Native(num_meshes);
-		uint32_t num_nodes;
-		decoded->read(&num_nodes, sizeof(num_nodes));
-		num_nodes = LE2Native(num_nodes);
-		uint32_t num_joints;
-		decoded->read(&num_joints, sizeof(num_joints));
-		num_joints = LE2Native(num_joints);
-		uint32_t num_kfs;
-		decoded->read(&num_kfs, sizeof(num_kfs));
-		num_kfs = LE2Native(num_kfs);
-		uint32_t num_actions;
-		decoded->read(&num_actions, sizeof(num_actions));
-		num_actions = LE2Native(num_actions);
+		uint32_t const index_elem_size = all_is_index_16_bit ? 2 : 4;
+
+		ResIdentifierPtr decoded = MakeSharedPtr<ResIdentifier>(runtime_file->ResName(), runtime_file->Timestamp(),
+			ArrayRef<uint8_t>(decoded_data->data() + meta_offset, static_cast<size_t>(meta_size)), decoded_data);
 
 		mtls.resize(num_mtls);
 		for (uint32_t mtl_index = 0; mtl_index < num_mtls; ++ mtl_index)
@@ -1192,37 +1384,6 @@ namespace KlayGE
 			}
 		}
 
-		uint32_t num_merged_ves;
-		decoded->read(&num_merged_ves, sizeof(num_merged_ves));
-		num_merged_ves = LE2Native(num_merged_ves);
-		merged_ves.resize(num_merged_ves);
-		for (size_t i = 0; i < merged_ves.size(); ++ i)
-		{
-			decoded->read(&merged_ves[i], sizeof(merged_ves[i]));
-
-			merged_ves[i].usage = LE2Native(merged_ves[i].usage);
-			merged_ves[i].format = LE2Native(merged_ves[i].format);
-		}
-
-		uint32_t all_num_vertices;
-		uint32_t all_num_indices;
-		decoded->read(&all_num_vertices, sizeof(all_num_vertices));
-		all_num_vertices = LE2Native(all_num_vertices);
-		decoded->read(&all_num_indices, sizeof(all_num_indices));
-		all_num_indices = LE2Native(all_num_indices);
-		decoded->read(&all_is_index_16_bit, sizeof(all_is_index_16_bit));
-
-		int const index_elem_size = all_is_index_16_bit ? 2 : 4;
-
-		merged_buff.resize(merged_ves.size());
-		for (size_t i = 0; i < merged_buff.size(); ++ i)
-		{
-			merged_buff[i].resize(all_num_vertices * merged_ves[i].element_size());
-			decoded->read(&merged_buff[i][0], merged_buff[i].size() * sizeof(merged_buff[i][0]));
-		}
-		merged_indices.resize(all_num_indices * index_elem_size);
-		decoded->read(&merged_indices[0], merged_indices.size() * sizeof(merged_indices[0]));
-
 		mesh_names.resize(num_meshes);
 		mtl_ids.resize(num_meshes);
 		mesh_lods.resize(num_meshes);
@@ -1491,16 +1652,16 @@ namespace KlayGE
 			model->GetMaterial(mtl_index) = mtls[mtl_index];
 		}
 
-		std::vector<GraphicsBufferPtr> merged_vbs(merged_buff.size());
-		for (size_t i = 0; i < merged_buff.size(); ++ i)
+		std::vector<GraphicsBufferPtr> merged_vbs(merged_ves.size());
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
 		{
-			auto vb = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_buff[i].size()), false);
-			vb->CreateHWResource(merged_buff[i].data());
+			auto vb = MakeSharedPtr<SoftwareGraphicsBuffer>(all_num_vertices * merged_ves[i].element_size(), decoded_data);
+			vb->CreateHWResource(decoded_data->data() + vb_offsets[i]);
 
 			merged_vbs[i] = vb;
 		}
-		auto merged_ib = MakeSharedPtr<SoftwareGraphicsBuffer>(static_cast<uint32_t>(merged_indices.size()), false);
-		merged_ib->CreateHWResource(merged_indices.data());
+		auto merged_ib = MakeSharedPtr<SoftwareGraphicsBuffer>(all_num_indices * index_elem_size, decoded_data);
+		merged_ib->CreateHWResource(decoded_data->data() + ib_offset);
 
 		uint32_t mesh_lod_index = 0;
 		std::vector<StaticMeshPtr> meshes(num_meshes);
@@ -1527,7 +1688,7 @@ namespace KlayGE
 			mesh->NumLods(lods);
 			for (uint32_t lod = 0; lod < lods; ++ lod, ++ mesh_lod_index)
 			{
-				for (uint32_t ve_index = 0; ve_index < merged_buff.size(); ++ ve_index)
+				for (uint32_t ve_index = 0; ve_index < merged_ves.size(); ++ ve_index)
 				{
 					mesh->AddVertexStream(lod, merged_vbs[ve_index], merged_ves[ve_index]);
 				}
@@ -1647,32 +1808,8 @@ namespace KlayGE
 		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
-		std::vector<VertexElement> const & merged_ves,
-		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
-		char is_index_16_bit, std::ostream& os)
+		std::ostream& os)
 	{
-		uint32_t num_merged_ves = Native2LE(static_cast<uint32_t>(merged_ves.size()));
-		os.write(reinterpret_cast<char*>(&num_merged_ves), sizeof(num_merged_ves));
-		for (size_t i = 0; i < merged_ves.size(); ++ i)
-		{
-			VertexElement ve = merged_ves[i];
-			ve.usage = Native2LE(ve.usage);
-			ve.format = Native2LE(ve.format);
-			os.write(reinterpret_cast<char*>(&ve), sizeof(ve));
-		}
-
-		uint32_t num_vertices = Native2LE(mesh_base_vertices.back());
-		os.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-		uint32_t num_indices = Native2LE(mesh_start_indices.back());
-		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
-		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
-
-		for (size_t i = 0; i < merged_vertices.size(); ++ i)
-		{
-			os.write(reinterpret_cast<char const *>(&merged_vertices[i][0]), merged_vertices[i].size() * sizeof(merged_vertices[i][0]));
-		}
-		os.write(reinterpret_cast<char const *>(&merged_indices[0]), merged_indices.size() * sizeof(merged_indices[0]));
-
 		uint32_t mesh_lod_index = 0;
 		for (uint32_t mesh_index = 0; mesh_index < mesh_names.size(); ++ mesh_index)
 		{
@@ -1890,26 +2027,6 @@ namespace KlayGE
 	{
 		std::ostringstream ss;
 
-		{
-			uint32_t num_mtls = Native2LE(static_cast<uint32_t>(mtls.size()));
-			ss.write(reinterpret_cast<char*>(&num_mtls), sizeof(num_mtls));
-
-			uint32_t num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
-			ss.write(reinterpret_cast<char*>(&num_meshes), sizeof(num_meshes));
-
-			uint32_t num_nodes = Native2LE(static_cast<uint32_t>(nodes.size()));
-			ss.write(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
-
-			uint32_t num_joints = Native2LE(static_cast<uint32_t>(joints.size()));
-			ss.write(reinterpret_cast<char*>(&num_joints), sizeof(num_joints));
-
-			uint32_t num_kfs = Native2LE(kfs ? static_cast<uint32_t>(kfs->size()) : 0);
-			ss.write(reinterpret_cast<char*>(&num_kfs), sizeof(num_kfs));
-
-			uint32_t num_actions = Native2LE(actions ? std::max(static_cast<uint32_t>(actions->size()), 1U) : 0);
-			ss.write(reinterpret_cast<char*>(&num_actions), sizeof(num_actions));
-		}
-
 		if (!mtls.empty())
 		{
 			WriteMaterialsChunk(mtls, ss);
@@ -1918,8 +2035,7 @@ namespace KlayGE
 		if (!mesh_names.empty())
 		{
 			WriteMeshesChunk(mesh_names, mtl_ids, mesh_lods, pos_bbs, tc_bbs,
-				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices,
-				merged_ves, merged_buffs, merged_indices, all_is_index_16_bit, ss);
+				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_base_indices, ss);
 		}
 
 		if (!nodes.empty())
@@ -1941,6 +2057,70 @@ namespace KlayGE
 			WriteActionsChunk(*actions, ss);
 		}
 
+		auto const & meta_str = ss.str();
+
+		auto align_stream = [](uint64_t offset)
+		{
+			return (offset + MODEL_BIN_STREAM_ALIGNMENT - 1) & ~static_cast<uint64_t>(MODEL_BIN_STREAM_ALIGNMENT - 1);
+		};
+
+		uint64_t const ves_offset = sizeof(ModelBinHeader);
+		uint64_t const vb_offsets_offset = ves_offset + merged_ves.size() * sizeof(VertexElement);
+		uint64_t const meta_offset = vb_offsets_offset + merged_buffs.size() * sizeof(uint64_t);
+		uint64_t offset = meta_offset + meta_str.size();
+		std::vector<uint64_t> vb_offsets(merged_buffs.size());
+		for (size_t i = 0; i < merged_buffs.size(); ++ i)
+		{
+			vb_offsets[i] = align_stream(offset);
+			offset = vb_offsets[i] + merged_buffs[i].size();
+		}
+		uint64_t const ib_offset = align_stream(offset);
+
+		std::vector<uint8_t> payload(static_cast<size_t>(ib_offset + merged_indices.size()), 0);
+
+		ModelBinHeader header;
+		header.num_mtls = Native2LE(static_cast<uint32_t>(mtls.size()));
+		header.num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
+		header.num_nodes = Native2LE(static_cast<uint32_t>(nodes.size()));
+		header.num_joints = Native2LE(static_cast<uint32_t>(joints.size()));
+		header.num_kfs = Native2LE(kfs ? static_cast<uint32_t>(kfs->size()) : 0);
+		header.num_actions = Native2LE(actions ? std::max(static_cast<uint32_t>(actions->size()), 1U) : 0);
+		header.num_merged_ves = Native2LE(static_cast<uint32_t>(merged_ves.size()));
+		header.all_num_vertices = Native2LE(mesh_base_vertices.empty() ? 0 : mesh_base_vertices.back());
+		header.all_num_indices = Native2LE(mesh_base_indices.empty() ? 0 : mesh_base_indices.back());
+		header.all_is_index_16_bit = Native2LE(all_is_index_16_bit ? 1U : 0U);
+		header.ves_offset = Native2LE(ves_offset);
+		header.vb_offsets_offset = Native2LE(vb_offsets_offset);
+		header.meta_offset = Native2LE(meta_offset);
+		header.meta_size = Native2LE(static_cast<uint64_t>(meta_str.size()));
+		header.ib_offset = Native2LE(ib_offset);
+		std::memcpy(&payload[0], &header, sizeof(header));
+
+		for (size_t i = 0; i < merged_ves.size(); ++ i)
+		{
+			VertexElement ve = merged_ves[i];
+			ve.usage = Native2LE(ve.usage);
+			ve.format = Native2LE(ve.format);
+			std::memcpy(&payload[static_cast<size_t>(ves_offset + i * sizeof(ve))], &ve, sizeof(ve));
+		}
+		for (size_t i = 0; i < merged_buffs.size(); ++ i)
+		{
+			uint64_t const vb_offset = Native2LE(vb_offsets[i]);
+			std::memcpy(&payload[static_cast<size_t>(vb_offsets_offset + i * sizeof(vb_offset))], &vb_offset, sizeof(vb_offset));
+			if (!merged_buffs[i].empty())
+			{
+				std::memcpy(&payload[static_cast<size_t>(vb_offsets[i])], merged_buffs[i].data(), merged_buffs[i].size());
+			}
+		}
+		if (!meta_str.empty())
+		{
+			std::memcpy(&payload[static_cast<size_t>(meta_offset)], meta_str.data(), meta_str.size());
+		}
+		if (!merged_indices.empty())
+		{
+			std::memcpy(&payload[static_cast<size_t>(ib_offset)], merged_indices.data(), merged_indices.size());
+		}
+
 		std::ofstream ofs(jit_name.c_str(), std::ios_base::binary);
 		BOOST_ASSERT(ofs);
 		uint32_t fourcc = Native2LE(MakeFourCC<'K', 'L', 'M', ' '>::value);
@@ -1949,8 +2129,7 @@ namespace KlayGE
 		uint32_t ver = Native2LE(MODEL_BIN_VERSION);
 		ofs.write(reinterpret_cast<char*>(&ver), sizeof(ver));
 
-		auto const & ss_str = ss.str();
-		uint64_t original_len = Native2LE(static_cast<uint64_t>(ss_str.size()));
+		uint64_t original_len = Native2LE(static_cast<uint64_t>(payload.size()));
 		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
 
 		std::ofstream::pos_type p = ofs.tellp();
@@ -1958,7 +2137,7 @@ namespace KlayGE
 		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
 
 		LZMACodec lzma;
-		len = lzma.Encode(ofs, MakeArrayRef(reinterpret_cast<uint8_t const *>(ss_str.c_str()), ss_str.size()));
+		len = lzma.Encode(ofs, payload);
 
 		ofs.seekp(p, std::ios_base::beg);
 		len = Native2LE(len);
@@ -30,6 +30,7 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ErrorHandling.hpp>
+#include <KFL/SIMDMath.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEngine.hpp>
@@ -41,13 +42,20 @@
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KFL/Thread.hpp>
 
+#include <cstring>
 #include <fstream>
 #include <string>
 
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+	#include <xmmintrin.h>
+#endif
+
 #include <KlayGE/ParticleSystem.hpp>
 
 namespace
@@ -56,6 +64,148 @@ namespace
 
 	uint32_t const NUM_PARTICLES = 4096;
 
+	// Systems with more particles than this emit, update and compute bounds on the thread pool
+	uint32_t const PARALLEL_PARTICLES_THRESHOLD = 100000;
+	uint32_t const MIN_PARTICLES_PER_WORKER = 32768;
+
+	uint32_t NumParticleWorkers(uint32_t num_particles)
+	{
+		if (num_particles <= PARALLEL_PARTICLES_THRESHOLD)
+		{
+			return 1;
+		}
+		return num_parallel_workers(num_particles, MIN_PARTICLES_PER_WORKER);
+	}
+
+	// First particle of a worker's chunk in parallel_for_chunks
+	uint32_t ChunkBegin(uint32_t num, uint32_t num_workers, uint32_t worker)
+	{
+		return static_cast<uint32_t>(static_cast<uint64_t>(num) * worker / num_workers);
+	}
+
+	uint32_t const REMOVED_PARTICLE = 0xFFFFFFFFU;
+
+	// Insertion sort that gives up after max_moves moves. It's linear on orders that are nearly sorted already, like
+	// last frame's order of slowly moving particles. Whatever it leaves is still a permutation of the input.
+	bool CoherentInsertionSort(uint16_t* keys, uint32_t* values, uint32_t num, uint64_t max_moves)
+	{
+		uint64_t moves = 0;
+		for (uint32_t i = 1; i < num; ++ i)
+		{
+			uint16_t const key = keys[i];
+			if (keys[i - 1] <= key)
+			{
+				continue;
+			}
+
+			uint32_t const value = values[i];
+			uint32_t j = i;
+			while ((j > 0) && (keys[j - 1] > key))
+			{
+				keys[j] = keys[j - 1];
+				values[j] = values[j - 1];
+				-- j;
+				++ moves;
+			}
+			keys[j] = key;
+			values[j] = value;
+
+			if (moves > max_moves)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Piecewise linear curve over the control points. The segment is the first one whose end has x >= t,
+	// t beyond the last point takes its y.
+	float EvalPolyline(std::vector<float2> const & ctrl_pts, float t)
+	{
+		for (size_t i = 1; i < ctrl_pts.size(); ++ i)
+		{
+			if (ctrl_pts[i].x() >= t)
+			{
+				float2 const & prev = ctrl_pts[i - 1];
+				float const s = (t - prev.x()) / (ctrl_pts[i].x() - prev.x());
+				return MathLib::lerp(prev.y(), ctrl_pts[i].y(), s);
+			}
+		}
+		return ctrl_pts.back().y();
+	}
+
+#if defined(KLAYGE_SSE_SUPPORT)
+	__m128 EvalPolyline(std::vector<float2> const & ctrl_pts, __m128 t)
+	{
+		__m128 ret = _mm_set1_ps(ctrl_pts.back().y());
+		__m128 done = _mm_setzero_ps();
+		for (size_t i = 1; i < ctrl_pts.size(); ++ i)
+		{
+			__m128 const prev_x = _mm_set1_ps(ctrl_pts[i - 1].x());
+			__m128 const prev_y = _mm_set1_ps(ctrl_pts[i - 1].y());
+			__m128 const s = _mm_div_ps(_mm_sub_ps(t, prev_x), _mm_set1_ps(ctrl_pts[i].x() - ctrl_pts[i - 1].x()));
+			__m128 const val = _mm_add_ps(prev_y, _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(ctrl_pts[i].y()), prev_y), s));
+
+			__m128 const hit = _mm_andnot_ps(done, _mm_cmpge_ps(_mm_set1_ps(ctrl_pts[i].x()), t));
+			ret = _mm_or_ps(_mm_and_ps(hit, val), _mm_andnot_ps(hit, ret));
+			done = _mm_or_ps(done, hit);
+			if (_mm_movemask_ps(done) == 0xF)
+			{
+				break;
+			}
+		}
+		return ret;
+	}
+#endif
+
+	void CalcBounds(ParticleSpan const & particles, float3& min_bb, float3& max_bb)
+	{
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+		if (particles.num >= 4)
+		{
+			__m128 min_x = _mm_loadu_ps(particles.pos_x);
+			__m128 min_y = _mm_loadu_ps(particles.pos_y);
+			__m128 min_z = _mm_loadu_ps(particles.pos_z);
+			__m128 max_x = min_x;
+			__m128 max_y = min_y;
+			__m128 max_z = min_z;
+			for (i = 4; i + 4 <= particles.num; i += 4)
+			{
+				__m128 const x = _mm_loadu_ps(particles.pos_x + i);
+				__m128 const y = _mm_loadu_ps(particles.pos_y + i);
+				__m128 const z = _mm_loadu_ps(particles.pos_z + i);
+				min_x = _mm_min_ps(min_x, x);
+				min_y = _mm_min_ps(min_y, y);
+				min_z = _mm_min_ps(min_z, z);
+				max_x = _mm_max_ps(max_x, x);
+				max_y = _mm_max_ps(max_y, y);
+				max_z = _mm_max_ps(max_z, z);
+			}
+
+			float mins[3][4];
+			float maxs[3][4];
+			_mm_storeu_ps(mins[0], min_x);
+			_mm_storeu_ps(mins[1], min_y);
+			_mm_storeu_ps(mins[2], min_z);
+			_mm_storeu_ps(maxs[0], max_x);
+			_mm_storeu_ps(maxs[1], max_y);
+			_mm_storeu_ps(maxs[2], max_z);
+			for (uint32_t j = 0; j < 4; ++ j)
+			{
+				min_bb = MathLib::minimize(min_bb, float3(mins[0][j], mins[1][j], mins[2][j]));
+				max_bb = MathLib::maximize(max_bb, float3(maxs[0][j], maxs[1][j], maxs[2][j]));
+			}
+		}
+#endif
+		for (; i < particles.num; ++ i)
+		{
+			float3 const pos(particles.pos_x[i], particles.pos_y[i], particles.pos_z[i]);
+			min_bb = MathLib::minimize(min_bb, pos);
+			max_bb = MathLib::maximize(max_bb, pos);
+		}
+	}
+
 	class ParticleSystemLoadingDesc : public ResLoadingDesc
 	{
 	private:
@@ -344,6 +494,11 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			return HashRange(ps_desc_.res_name.begin(), ps_desc_.res_name.end());
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -551,6 +706,145 @@ namespace
 
 namespace KlayGE
 {
+	Particle ParticleSpan::Get(uint32_t i) const
+	{
+		BOOST_ASSERT(i < num);
+
+		Particle par;
+		par.pos = float3(pos_x[i], pos_y[i], pos_z[i]);
+		par.vel = float3(vel_x[i], vel_y[i], vel_z[i]);
+		par.life = life[i];
+		par.spin = spin[i];
+		par.size = size[i];
+		par.alpha = alpha[i];
+		par.init_life = init_life[i];
+		return par;
+	}
+
+	void ParticleSpan::Set(uint32_t i, Particle const & par) const
+	{
+		BOOST_ASSERT(i < num);
+
+		pos_x[i] = par.pos.x();
+		pos_y[i] = par.pos.y();
+		pos_z[i] = par.pos.z();
+		vel_x[i] = par.vel.x();
+		vel_y[i] = par.vel.y();
+		vel_z[i] = par.vel.z();
+		life[i] = par.life;
+		spin[i] = par.spin;
+		size[i] = par.size;
+		alpha[i] = par.alpha;
+		init_life[i] = par.init_life;
+	}
+
+	ParticleSpan ParticleSpan::SubSpan(uint32_t first, uint32_t count) const
+	{
+		BOOST_ASSERT(first + count <= num);
+
+		ParticleSpan ret;
+		ret.pos_x = pos_x + first;
+		ret.pos_y = pos_y + first;
+		ret.pos_z = pos_z + first;
+		ret.vel_x = vel_x + first;
+		ret.vel_y = vel_y + first;
+		ret.vel_z = vel_z + first;
+		ret.life = life + first;
+		ret.spin = spin + first;
+		ret.size = size + first;
+		ret.alpha = alpha + first;
+		ret.init_life = init_life + first;
+		ret.num = count;
+		return ret;
+	}
+
+
+	ParticlePool::ParticlePool(uint32_t capacity)
+		: capacity_(capacity), num_alive_(0)
+	{
+		for (auto& attrib : attribs_)
+		{
+			attrib.assign(capacity, 0.0f);
+		}
+	}
+
+	ParticleSpan ParticlePool::Span(uint32_t first, uint32_t num)
+	{
+		BOOST_ASSERT(first + num <= capacity_);
+
+		ParticleSpan ret;
+		ret.pos_x = attribs_[PA_PosX].data() + first;
+		ret.pos_y = attribs_[PA_PosY].data() + first;
+		ret.pos_z = attribs_[PA_PosZ].data() + first;
+		ret.vel_x = attribs_[PA_VelX].data() + first;
+		ret.vel_y = attribs_[PA_VelY].data() + first;
+		ret.vel_z = attribs_[PA_VelZ].data() + first;
+		ret.life = attribs_[PA_Life].data() + first;
+		ret.spin = attribs_[PA_Spin].data() + first;
+		ret.size = attribs_[PA_Size].data() + first;
+		ret.alpha = attribs_[PA_Alpha].data() + first;
+		ret.init_life = attribs_[PA_InitLife].data() + first;
+		ret.num = num;
+		return ret;
+	}
+
+	Particle ParticlePool::Get(uint32_t i) const
+	{
+		BOOST_ASSERT(i < capacity_);
+
+		Particle par;
+		par.pos = float3(attribs_[PA_PosX][i], attribs_[PA_PosY][i], attribs_[PA_PosZ][i]);
+		par.vel = float3(attribs_[PA_VelX][i], attribs_[PA_VelY][i], attribs_[PA_VelZ][i]);
+		par.life = attribs_[PA_Life][i];
+		par.spin = attribs_[PA_Spin][i];
+		par.size = attribs_[PA_Size][i];
+		par.alpha = attribs_[PA_Alpha][i];
+		par.init_life = attribs_[PA_InitLife][i];
+		return par;
+	}
+
+	void ParticlePool::Set(uint32_t i, Particle const & par)
+	{
+		this->Span(i, 1).Set(0, par);
+	}
+
+	uint32_t ParticlePool::Compact(uint32_t first, uint32_t num)
+	{
+		BOOST_ASSERT(first + num <= capacity_);
+
+		float const * life = attribs_[PA_Life].data();
+		uint32_t dst = first;
+		for (uint32_t src = first; src < first + num; ++ src)
+		{
+			if (life[src] > 0)
+			{
+				if (dst != src)
+				{
+					for (auto& attrib : attribs_)
+					{
+						attrib[dst] = attrib[src];
+					}
+				}
+				++ dst;
+			}
+		}
+		return dst - first;
+	}
+
+	void ParticlePool::Move(uint32_t dst, uint32_t src, uint32_t num)
+	{
+		BOOST_ASSERT((dst + num <= capacity_) && (src + num <= capacity_));
+
+		if ((dst != src) && (num > 0))
+		{
+			for (auto& attrib : attribs_)
+			{
+				std::memmove(&attrib[dst], &attrib[src], num * sizeof(float));
+			}
+		}
+	}
+
+
 	ParticleEmitter::ParticleEmitter(SceneNodePtr const & ps)
 			: ps_(checked_pointer_cast<ParticleSystem>(ps)),
 				model_mat_(float4x4::Identity()),
@@ -724,118 +1018,233 @@ namespace KlayGE
 	uint32_t ParticleSystem::NumActiveParticles() const
 	{
 		std::lock_guard<std::mutex> lock(actived_particles_mutex_);
-		return static_cast<uint32_t>(actived_particles_.size());
+		return particles_.NumAlive();
 	}
 
 	uint32_t ParticleSystem::GetActiveParticleIndex(uint32_t i) const
 	{
 		std::lock_guard<std::mutex> lock(actived_particles_mutex_);
-		return actived_particles_[i].first;
+		BOOST_ASSERT(i < particles_.NumAlive());
+		return sort_particles_ ? actived_particles_[i] : i;
 	}
 
 	void ParticleSystem::ClearParticles()
 	{
-		for (auto& particle : particles_)
-		{
-			particle.life = 0;
-		}
+		particles_.NumAlive(0);
+		actived_particles_.clear();
 	}
 
 	void ParticleSystem::UpdateParticlesNoLock(float elapsed_time)
 	{
-		auto emitter_iter = emitters_.begin();
-		uint32_t new_particle = (*emitter_iter)->Update(elapsed_time);
-
-		float4x4 const & view_mat = Context::Instance().AppInstance().ActiveCamera().ViewMatrix();
-
-		actived_particles_.clear();
-
-		float3 min_bb(+1e10f, +1e10f, +1e10f);
-		float3 max_bb(-1e10f, -1e10f, -1e10f);
-
 		for (auto const & updater : updaters_)
 		{
 			updater->SnapParams();
 		}
 
-		for (uint32_t i = 0; i < particles_.size(); ++ i)
+		// Update the particles alive chunk by chunk and pack each chunk, then close the gaps between chunks
+		uint32_t const num_prev_alive = particles_.NumAlive();
+		uint32_t num_alive = 0;
 		{
-			Particle& particle = particles_[i];
-
-			if (particle.life > 0)
+			uint32_t const num_workers = NumParticleWorkers(num_prev_alive);
+			if (sort_particles_)
 			{
-				for (auto const & updater : updaters_)
-				{
-					updater->Update(particle, elapsed_time);
-				}
+				particle_remap_.resize(num_prev_alive);
 			}
-			else
-			{
-				if (new_particle > 0)
+
+			std::vector<uint32_t> chunk_alive(num_workers);
+			parallel_for_chunks(Context::Instance().ThreadPool(), num_prev_alive, num_workers,
+				[this, elapsed_time, &chunk_alive](uint32_t worker, uint32_t first, uint32_t last)
 				{
-					(*emitter_iter)->Emit(particle);
+					ParticleSpan const particles = particles_.Span(first, last - first);
 					for (auto const & updater : updaters_)
 					{
-						updater->Update(particle, 0);
+						updater->Update(particles, elapsed_time);
 					}
-					-- new_particle;
-				}
-				else
-				{
-					if (emitter_iter != emitters_.end())
+
+					if (sort_particles_)
 					{
-						++ emitter_iter;
-						if (emitter_iter != emitters_.end())
+						// Chunk local for now, the chunk base is added below
+						uint32_t num_chunk_alive = 0;
+						for (uint32_t i = 0; i < particles.num; ++ i)
 						{
-							new_particle = (*emitter_iter)->Update(elapsed_time);
+							particle_remap_[first + i] = (particles.life[i] > 0) ? num_chunk_alive ++ : REMOVED_PARTICLE;
 						}
 					}
-				}
+
+					chunk_alive[worker] = particles_.Compact(first, last - first);
+				});
+
+			std::vector<uint32_t> chunk_bases(num_workers);
+			for (uint32_t i = 0; i < num_workers; ++ i)
+			{
+				particles_.Move(num_alive, ChunkBegin(num_prev_alive, num_workers, i), chunk_alive[i]);
+				chunk_bases[i] = num_alive;
+				num_alive += chunk_alive[i];
 			}
 
-			if (particle.life > 0)
+			if (sort_particles_ && (num_workers > 1))
 			{
-				float3 const & pos = particle.pos;
+				parallel_for_chunks(Context::Instance().ThreadPool(), num_prev_alive, num_workers,
+					[this, &chunk_bases](uint32_t worker, uint32_t first, uint32_t last)
+					{
+						for (uint32_t i = first; i < last; ++ i)
+						{
+							if (particle_remap_[i] != REMOVED_PARTICLE)
+							{
+								particle_remap_[i] += chunk_bases[worker];
+							}
+						}
+					});
+			}
+		}
+		uint32_t const num_survived = num_alive;
 
-				float depth_es;
-				if (sort_particles_)
+		for (auto const & emitter : emitters_)
+		{
+			uint32_t const num_new = std::min(emitter->Update(elapsed_time), particles_.Capacity() - num_alive);
+			if (num_new > 0)
+			{
+				ParticleSpan const particles = particles_.Span(num_alive, num_new);
+				emitter->Emit(particles);
+				for (auto const & updater : updaters_)
 				{
-					float4 const pos4(pos.x(), pos.y(), pos.z(), 1);
-					float4 const z_row = view_mat.Col(2);
-					float4 const w_row = view_mat.Col(3);
-
-					depth_es = MathLib::dot(pos4, z_row) / MathLib::dot(pos4, w_row);
+					updater->Update(particles, 0);
 				}
-				else
+				num_alive += particles_.Compact(num_alive, num_new);
+			}
+		}
+
+		particles_.NumAlive(num_alive);
+
+		if (num_alive > 0)
+		{
+			float4x4 const view_mat = sort_particles_ ? Context::Instance().AppInstance().ActiveCamera().ViewMatrix()
+				: float4x4::Identity();
+			if (sort_particles_)
+			{
+				particle_depths_.resize(num_alive);
+			}
+
+			uint32_t const num_workers = NumParticleWorkers(num_alive);
+			std::vector<float3> chunk_min_bb(num_workers, float3(+1e10f, +1e10f, +1e10f));
+			std::vector<float3> chunk_max_bb(num_workers, float3(-1e10f, -1e10f, -1e10f));
+			std::vector<float> chunk_min_depth(num_workers, +1e10f);
+			std::vector<float> chunk_max_depth(num_workers, -1e10f);
+			ParticleSpan const alive = particles_.AliveSpan();
+			parallel_for_chunks(Context::Instance().ThreadPool(), num_alive, num_workers,
+				[this, &view_mat, &alive, &chunk_min_bb, &chunk_max_bb, &chunk_min_depth, &chunk_max_depth](
+					uint32_t worker, uint32_t first, uint32_t last)
 				{
-					depth_es = 0;
-				}
+					CalcBounds(alive.SubSpan(first, last - first), chunk_min_bb[worker], chunk_max_bb[worker]);
+
+					if (sort_particles_)
+					{
+						float min_depth = chunk_min_depth[worker];
+						float max_depth = chunk_max_depth[worker];
+						for (uint32_t i = first; i < last; ++ i)
+						{
+							float const depth = alive.pos_x[i] * view_mat(0, 2) + alive.pos_y[i] * view_mat(1, 2)
+								+ alive.pos_z[i] * view_mat(2, 2) + view_mat(3, 2);
+							particle_depths_[i] = depth;
+							min_depth = std::min(min_depth, depth);
+							max_depth = std::max(max_depth, depth);
+						}
+						chunk_min_depth[worker] = min_depth;
+						chunk_max_depth[worker] = max_depth;
+					}
+				});
 
-				actived_particles_.emplace_back(i, depth_es);
+			float3 min_bb = chunk_min_bb[0];
+			float3 max_bb = chunk_max_bb[0];
+			float min_depth = chunk_min_depth[0];
+			float max_depth = chunk_max_depth[0];
+			for (uint32_t i = 1; i < num_workers; ++ i)
+			{
+				min_bb = MathLib::minimize(min_bb, chunk_min_bb[i]);
+				max_bb = MathLib::maximize(max_bb, chunk_max_bb[i]);
+				min_depth = std::min(min_depth, chunk_min_depth[i]);
+				max_depth = std::max(max_depth, chunk_max_depth[i]);
+			}
 
-				min_bb = MathLib::minimize(min_bb, pos);
-				max_bb = MathLib::maximize(min_bb, pos);
+			if (sort_particles_)
+			{
+				this->SortParticlesNoLock(num_prev_alive, num_survived, min_depth, max_depth);
 			}
+
+			// Flush reads the bound, so in SceneManager's sub thread pass it's published with the other results
+			auto& renderable = this->FirstComponentOfType<RenderableComponent>()->BoundRenderableOfType<RenderParticles>();
+			AABBox const bound(min_bb, max_bb);
+			SceneNode::DeferSubThreadWrite([&renderable, bound] { renderable.PosBound(bound); });
+		}
+		else
+		{
+			actived_particles_.clear();
 		}
+	}
+
+	void ParticleSystem::SortParticlesNoLock(uint32_t num_prev_alive, uint32_t num_survived, float min_depth, float max_depth)
+	{
+		uint32_t const num_alive = particles_.NumAlive();
 
-		if (!actived_particles_.empty())
+		// Start from last frame's order, with the particles died removed and the new ones at the end
+		uint32_t num_ordered = 0;
+		if (actived_particles_.size() == num_prev_alive)
 		{
-			if (sort_particles_)
+			for (uint32_t i = 0; i < num_prev_alive; ++ i)
 			{
-				std::sort(actived_particles_.begin(), actived_particles_.end(),
-					[](std::pair<uint32_t, float> const & lhs, std::pair<uint32_t, float> const & rhs)
-					{
-						return lhs.second > rhs.second;
-					});
+				uint32_t const index = particle_remap_[actived_particles_[i]];
+				if (index != REMOVED_PARTICLE)
+				{
+					actived_particles_[num_ordered] = index;
+					++ num_ordered;
+				}
+			}
+		}
+		else
+		{
+			actived_particles_.resize(num_survived);
+			for (uint32_t i = 0; i < num_survived; ++ i)
+			{
+				actived_particles_[i] = i;
 			}
+			num_ordered = num_survived;
+		}
+		BOOST_ASSERT(num_ordered == num_survived);
+
+		actived_particles_.resize(num_alive);
+		for (uint32_t i = num_ordered; i < num_alive; ++ i)
+		{
+			actived_particles_[i] = i;
+		}
+
+		// Back to front is ascending on the distance to the farthest particle, quantized to 16 bits
+		sort_keys_.resize(num_alive);
+		float const scale = (max_depth > min_depth) ? 65535 / (max_depth - min_depth) : 0.0f;
+		uint32_t const num_workers = NumParticleWorkers(num_alive);
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_alive, num_workers,
+			[this, max_depth, scale](uint32_t worker, uint32_t first, uint32_t last)
+			{
+				KFL_UNUSED(worker);
+
+				for (uint32_t i = first; i < last; ++ i)
+				{
+					float const dist = (max_depth - particle_depths_[actived_particles_[i]]) * scale;
+					sort_keys_[i] = static_cast<uint16_t>(std::min(dist + 0.5f, 65535.0f));
+				}
+			});
 
-			this->FirstComponentOfType<RenderableComponent>()->BoundRenderableOfType<RenderParticles>().PosBound(AABBox(min_bb, max_bb));
+		if (!CoherentInsertionSort(sort_keys_.data(), actived_particles_.data(), num_alive, num_alive))
+		{
+			sort_tmp_keys_.resize(num_alive);
+			sort_tmp_indices_.resize(num_alive);
+			ParallelRadixSort(Context::Instance().ThreadPool(), sort_keys_.data(), actived_particles_.data(),
+				sort_tmp_keys_.data(), sort_tmp_indices_.data(), num_alive, num_workers);
 		}
 	}
 
 	void ParticleSystem::UpdateParticleBufferNoLock()
 	{
-		if (!actived_particles_.empty())
+		if (particles_.NumAlive() > 0)
 		{
 			RenderLayout& rl = this->FirstComponentOfType<RenderableComponent>()->BoundRenderable().GetRenderLayout();
 
@@ -849,7 +1258,7 @@ namespace KlayGE
 				instance_gb = rl.InstanceStream();
 			}
 
-			uint32_t const num_active_particles = static_cast<uint32_t>(actived_particles_.size());
+			uint32_t const num_active_particles = particles_.NumAlive();
 			uint32_t const new_instance_size = num_active_particles * sizeof(ParticleInstance);
 			if (!instance_gb || (instance_gb->Size() < new_instance_size))
 			{
@@ -880,18 +1289,28 @@ namespace KlayGE
 			}
 
 			{
+				ParticleSpan const alive = particles_.AliveSpan();
+				uint32_t const * order = sort_particles_ ? actived_particles_.data() : nullptr;
 				GraphicsBuffer::Mapper mapper(*instance_gb, BA_Write_Only);
 				ParticleInstance* instance_data = mapper.Pointer<ParticleInstance>();
-				for (uint32_t i = 0; i < num_active_particles; ++ i, ++ instance_data)
-				{
-					Particle const & par = particles_[actived_particles_[i].first];
-					instance_data->pos = par.pos;
-					instance_data->life = par.life;
-					instance_data->spin = par.spin;
-					instance_data->size = par.size;
-					instance_data->life_factor = (par.init_life - par.life) / par.init_life;
-					instance_data->alpha = par.alpha;
-				}
+				parallel_for_chunks(Context::Instance().ThreadPool(), num_active_particles,
+					NumParticleWorkers(num_active_particles),
+					[&alive, order, instance_data](uint32_t worker, uint32_t first, uint32_t last)
+					{
+						KFL_UNUSED(worker);
+
+						ParticleInstance* dst = instance_data + first;
+						for (uint32_t i = first; i < last; ++ i, ++ dst)
+						{
+							uint32_t const index = order ? order[i] : i;
+							dst->pos = float3(alive.pos_x[index], alive.pos_y[index], alive.pos_z[index]);
+							dst->life = alive.life[index];
+							dst->spin = alive.spin[index];
+							dst->size = alive.size[index];
+							dst->life_factor = (alive.init_life[index] - alive.life[index]) / alive.init_life[index];
+							dst->alpha = alive.alpha[index];
+						}
+					});
 			}
 		}
 	}
@@ -1120,8 +1539,7 @@ namespace KlayGE
 
 
 	PointParticleEmitter::PointParticleEmitter(SceneNodePtr const & ps)
-		: ParticleEmitter(ps),
-			random_dis_(0, 10000)
+		: ParticleEmitter(ps)
 	{
 	}
 
@@ -1138,28 +1556,65 @@ namespace KlayGE
 		return ret;
 	}
 
-	void PointParticleEmitter::Emit(Particle& par)
+	void PointParticleEmitter::Emit(ParticleSpan const & particles)
 	{
-		par.pos.x() = MathLib::lerp(min_pos_.x(), max_pos_.x(), this->RandomGen());
-		par.pos.y() = MathLib::lerp(min_pos_.y(), max_pos_.y(), this->RandomGen());
-		par.pos.z() = MathLib::lerp(min_pos_.z(), max_pos_.z(), this->RandomGen());
-		par.pos = MathLib::transform_coord(par.pos, model_mat_);
-		float theta = (this->RandomGen() * 2 - 1) * PI;
-		float phi = this->RandomGen() * emit_angle_ / 2;
-		float velocity = MathLib::lerp(min_vel_, max_vel_, this->RandomGen());
-		float vx = cos(theta) * sin(phi);
-		float vz = sin(theta) * sin(phi);
-		float vy = cos(phi);
-		par.vel = MathLib::transform_normal(float3(vx, vy, vz) * velocity, model_mat_);
-		par.life = MathLib::lerp(min_life_, max_life_, this->RandomGen());
-		par.spin = MathLib::lerp(min_spin_, max_spin_, this->RandomGen());
-		par.size = MathLib::lerp(min_size_, max_size_, this->RandomGen());
-		par.init_life = par.life;
+		uint32_t const num_workers = NumParticleWorkers(particles.num);
+		if (num_workers <= 1)
+		{
+			this->Emit(particles, gen_);
+		}
+		else
+		{
+			std::vector<std::ranlux24_base> gens;
+			gens.reserve(num_workers);
+			for (uint32_t i = 0; i < num_workers; ++ i)
+			{
+				gens.emplace_back(gen_());
+			}
+
+			parallel_for_chunks(Context::Instance().ThreadPool(), particles.num, num_workers,
+				[this, &particles, &gens](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					this->Emit(particles.SubSpan(first, last - first), gens[worker]);
+				});
+		}
 	}
 
-	float PointParticleEmitter::RandomGen()
+	void PointParticleEmitter::Emit(ParticleSpan const & particles, std::ranlux24_base& gen) const
 	{
-		return MathLib::clamp(random_dis_(gen_) * 0.0001f, 0.0f, 1.0f);
+		std::uniform_int_distribution<> random_dis(0, 10000);
+		auto random_gen = [&random_dis, &gen]
+			{
+				return MathLib::clamp(random_dis(gen) * 0.0001f, 0.0f, 1.0f);
+			};
+
+		for (uint32_t i = 0; i < particles.num; ++ i)
+		{
+			float3 pos;
+			pos.x() = MathLib::lerp(min_pos_.x(), max_pos_.x(), random_gen());
+			pos.y() = MathLib::lerp(min_pos_.y(), max_pos_.y(), random_gen());
+			pos.z() = MathLib::lerp(min_pos_.z(), max_pos_.z(), random_gen());
+			pos = MathLib::transform_coord(pos, model_mat_);
+			float theta = (random_gen() * 2 - 1) * PI;
+			float phi = random_gen() * emit_angle_ / 2;
+			float velocity = MathLib::lerp(min_vel_, max_vel_, random_gen());
+			float vx = cos(theta) * sin(phi);
+			float vz = sin(theta) * sin(phi);
+			float vy = cos(phi);
+			float3 const vel = MathLib::transform_normal(float3(vx, vy, vz) * velocity, model_mat_);
+
+			particles.pos_x[i] = pos.x();
+			particles.pos_y[i] = pos.y();
+			particles.pos_z[i] = pos.z();
+			particles.vel_x[i] = vel.x();
+			particles.vel_y[i] = vel.y();
+			particles.vel_z[i] = vel.z();
+			particles.life[i] = MathLib::lerp(min_life_, max_life_, random_gen());
+			particles.spin[i] = MathLib::lerp(min_spin_, max_spin_, random_gen());
+			particles.size[i] = MathLib::lerp(min_size_, max_size_, random_gen());
+			particles.alpha[i] = 0;
+			particles.init_life[i] = particles.life[i];
+		}
 	}
 
 
@@ -1184,59 +1639,83 @@ namespace KlayGE
 		return ret;
 	}
 
-	void PolylineParticleUpdater::Update(Particle& par, float elapse_time)
+	void PolylineParticleUpdater::Update(ParticleSpan const & particles, float elapse_time)
 	{
 		BOOST_ASSERT(!this_frame_size_over_life_.empty());
 		BOOST_ASSERT(!this_frame_mass_over_life_.empty());
 		BOOST_ASSERT(!this_frame_opacity_over_life_.empty());
 
-		float pos = (par.init_life - par.life) / par.init_life;
-
-		float cur_size = this_frame_size_over_life_.back().y();
-		for (auto iter = std::next(this_frame_size_over_life_.begin()); iter != this_frame_size_over_life_.end(); ++ iter)
-		{
-			if (iter->x() >= pos)
-			{
-				float2 const & prev = *std::prev(iter);
-				float const s = (pos - prev.x()) / (iter->x() - prev.x());
-				cur_size = MathLib::lerp(prev.y(), iter->y(), s);
-				break;
-			}
-		}
-
-		float cur_mass = this_frame_mass_over_life_.back().y();
-		for (auto iter = std::next(this_frame_mass_over_life_.begin()); iter != this_frame_mass_over_life_.end(); ++ iter)
+		ParticleSystemPtr ps = ps_.lock();
+		float const gravity = ps->Gravity();
+		float const buoyancy_scale = 4.0f / 3 * PI * ps->MediaDensity() * gravity;
+		float3 const force = ps->Force();
+
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+		__m128 const v_dt = _mm_set1_ps(elapse_time);
+		__m128 const v_one = _mm_set1_ps(1.0f);
+		__m128 const v_gravity = _mm_set1_ps(gravity);
+		__m128 const v_buoyancy_scale = _mm_set1_ps(buoyancy_scale);
+		__m128 const v_force_x = _mm_set1_ps(force.x());
+		__m128 const v_force_y = _mm_set1_ps(force.y());
+		__m128 const v_force_z = _mm_set1_ps(force.z());
+		__m128 const v_spin_step = _mm_set1_ps(0.001f);
+		for (; i + 4 <= particles.num; i += 4)
 		{
-			if (iter->x() >= pos)
-			{
-				float2 const & prev = *std::prev(iter);
-				float const s = (pos - prev.x()) / (iter->x() - prev.x());
-				cur_mass = MathLib::lerp(prev.y(), iter->y(), s);
-				break;
-			}
+			__m128 const life = _mm_loadu_ps(particles.life + i);
+			__m128 const init_life = _mm_loadu_ps(particles.init_life + i);
+			__m128 const t = _mm_div_ps(_mm_sub_ps(init_life, life), init_life);
+
+			__m128 const cur_size = EvalPolyline(this_frame_size_over_life_, t);
+			__m128 const cur_mass = EvalPolyline(this_frame_mass_over_life_, t);
+			__m128 const cur_alpha = EvalPolyline(this_frame_opacity_over_life_, t);
+
+			__m128 const inv_mass = _mm_div_ps(v_one, cur_mass);
+			__m128 const buoyancy = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(cur_size, cur_size), cur_size), v_buoyancy_scale);
+			__m128 const accel_x = _mm_mul_ps(v_force_x, inv_mass);
+			__m128 const accel_y = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(v_force_y, buoyancy), inv_mass), v_gravity);
+			__m128 const accel_z = _mm_mul_ps(v_force_z, inv_mass);
+
+			__m128 const vel_x = _mm_add_ps(_mm_loadu_ps(particles.vel_x + i), _mm_mul_ps(accel_x, v_dt));
+			__m128 const vel_y = _mm_add_ps(_mm_loadu_ps(particles.vel_y + i), _mm_mul_ps(accel_y, v_dt));
+			__m128 const vel_z = _mm_add_ps(_mm_loadu_ps(particles.vel_z + i), _mm_mul_ps(accel_z, v_dt));
+			_mm_storeu_ps(particles.vel_x + i, vel_x);
+			_mm_storeu_ps(particles.vel_y + i, vel_y);
+			_mm_storeu_ps(particles.vel_z + i, vel_z);
+			_mm_storeu_ps(particles.pos_x + i, _mm_add_ps(_mm_loadu_ps(particles.pos_x + i), _mm_mul_ps(vel_x, v_dt)));
+			_mm_storeu_ps(particles.pos_y + i, _mm_add_ps(_mm_loadu_ps(particles.pos_y + i), _mm_mul_ps(vel_y, v_dt)));
+			_mm_storeu_ps(particles.pos_z + i, _mm_add_ps(_mm_loadu_ps(particles.pos_z + i), _mm_mul_ps(vel_z, v_dt)));
+
+			_mm_storeu_ps(particles.life + i, _mm_sub_ps(life, v_dt));
+			_mm_storeu_ps(particles.spin + i, _mm_add_ps(_mm_loadu_ps(particles.spin + i), v_spin_step));
+			_mm_storeu_ps(particles.size + i, cur_size);
+			_mm_storeu_ps(particles.alpha + i, cur_alpha);
 		}
+#endif
 
-		float cur_alpha = this_frame_opacity_over_life_.back().y();
-		for (auto iter = std::next(this_frame_opacity_over_life_.begin()); iter != this_frame_opacity_over_life_.end(); ++ iter)
+		for (; i < particles.num; ++ i)
 		{
-			if (iter->x() >= pos)
-			{
-				float2 const & prev = *std::prev(iter);
-				float const s = (pos - prev.x()) / (iter->x() - prev.x());
-				cur_alpha = MathLib::lerp(prev.y(), iter->y(), s);
-				break;
-			}
+			float const t = (particles.init_life[i] - particles.life[i]) / particles.init_life[i];
+
+			float const cur_size = EvalPolyline(this_frame_size_over_life_, t);
+			float const cur_mass = EvalPolyline(this_frame_mass_over_life_, t);
+			float const cur_alpha = EvalPolyline(this_frame_opacity_over_life_, t);
+
+			float const inv_mass = 1.0f / cur_mass;
+			float const buoyancy = MathLib::cube(cur_size) * buoyancy_scale;
+			float3 const accel = (force + float3(0, buoyancy, 0)) * inv_mass - float3(0, gravity, 0);
+
+			particles.vel_x[i] += accel.x() * elapse_time;
+			particles.vel_y[i] += accel.y() * elapse_time;
+			particles.vel_z[i] += accel.z() * elapse_time;
+			particles.pos_x[i] += particles.vel_x[i] * elapse_time;
+			particles.pos_y[i] += particles.vel_y[i] * elapse_time;
+			particles.pos_z[i] += particles.vel_z[i] * elapse_time;
+			particles.life[i] -= elapse_time;
+			particles.spin[i] += 0.001f;
+			particles.size[i] = cur_size;
+			particles.alpha[i] = cur_alpha;
 		}
-
-		ParticleSystemPtr ps = ps_.lock();
-		float buoyancy = 4.0f / 3 * PI * MathLib::cube(cur_size) * ps->MediaDensity() * ps->Gravity();
-		float3 accel = (ps->Force() + float3(0, buoyancy, 0)) / cur_mass - float3(0, ps->Gravity(), 0);
-		par.vel += accel * elapse_time;
-		par.pos += par.vel * elapse_time;
-		par.life -= elapse_time;
-		par.spin += 0.001f;
-		par.size = cur_size;
-		par.alpha = cur_alpha;
 	}
 
 	void PolylineParticleUpdater::SnapParams()
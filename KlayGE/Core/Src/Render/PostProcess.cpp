@@ -191,6 +191,13 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			size_t seed = HashRange(pp_desc_.res_name.begin(), pp_desc_.res_name.end());
+			HashRange(seed, pp_desc_.pp_name.begin(), pp_desc_.pp_name.end());
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
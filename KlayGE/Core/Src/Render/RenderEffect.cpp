@@ -2513,6 +2513,301 @@ namespace
 		}
 	}
 #endif
+
+	bool IsIdentifierChar(char ch)
+	{
+		return ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z')) || ((ch >= '0') && (ch <= '9')) || (ch == '_');
+	}
+
+	std::string_view TrimSpaces(std::string_view str)
+	{
+		size_t const first = str.find_first_not_of(" \t\r\n");
+		if (first == std::string_view::npos)
+		{
+			return std::string_view();
+		}
+		size_t const last = str.find_last_not_of(" \t\r\n");
+		return str.substr(first, last - first + 1);
+	}
+
+	// Drops comments and the lines of preprocessor directives. The code under all branches of the conditions is kept.
+	std::string StripDirectivesAndComments(std::string_view src)
+	{
+		std::string ret;
+		ret.reserve(src.size());
+
+		bool in_block_comment = false;
+		bool in_directive = false;
+		size_t line_begin = 0;
+		while (line_begin < src.size())
+		{
+			size_t line_end = src.find('\n', line_begin);
+			if (line_end == std::string_view::npos)
+			{
+				line_end = src.size();
+			}
+			std::string_view const line = src.substr(line_begin, line_end - line_begin);
+			std::string_view const trimmed = TrimSpaces(line);
+			line_begin = line_end + 1;
+
+			if (in_directive || (!in_block_comment && !trimmed.empty() && (trimmed[0] == '#')))
+			{
+				in_directive = !trimmed.empty() && (trimmed.back() == '\\');
+				ret += '\n';
+				continue;
+			}
+
+			for (size_t i = 0; i < line.size(); ++ i)
+			{
+				if (in_block_comment)
+				{
+					if ((line[i] == '*') && (i + 1 < line.size()) && (line[i + 1] == '/'))
+					{
+						in_block_comment = false;
+						++ i;
+					}
+				}
+				else if ((line[i] == '/') && (i + 1 < line.size()) && (line[i + 1] == '/'))
+				{
+					break;
+				}
+				else if ((line[i] == '/') && (i + 1 < line.size()) && (line[i + 1] == '*'))
+				{
+					in_block_comment = true;
+					ret += ' ';
+					++ i;
+				}
+				else
+				{
+					ret += line[i];
+				}
+			}
+			ret += '\n';
+		}
+
+		return ret;
+	}
+
+	bool VertexElementFromSemantic(std::string_view semantic, VertexElementUsage& usage, uint8_t& usage_index)
+	{
+		size_t name_len = semantic.size();
+		while ((name_len > 0) && (semantic[name_len - 1] >= '0') && (semantic[name_len - 1] <= '9'))
+		{
+			-- name_len;
+		}
+		usage_index = 0;
+		for (size_t i = name_len; i < semantic.size(); ++ i)
+		{
+			usage_index = static_cast<uint8_t>(usage_index * 10 + (semantic[i] - '0'));
+		}
+
+		std::string_view const name = semantic.substr(0, name_len);
+		size_t const name_hash = HashRange(name.begin(), name.end());
+		if ((CT_HASH("POSITION") == name_hash) || (CT_HASH("SV_Position") == name_hash))
+		{
+			usage = VEU_Position;
+		}
+		else if (CT_HASH("NORMAL") == name_hash)
+		{
+			usage = VEU_Normal;
+		}
+		else if (CT_HASH("COLOR") == name_hash)
+		{
+			if (0 == usage_index)
+			{
+				usage = VEU_Diffuse;
+			}
+			else
+			{
+				usage = VEU_Specular;
+			}
+		}
+		else if (CT_HASH("BLENDWEIGHT") == name_hash)
+		{
+			usage = VEU_BlendWeight;
+		}
+		else if (CT_HASH("BLENDINDICES") == name_hash)
+		{
+			usage = VEU_BlendIndex;
+		}
+		else if (CT_HASH("TEXCOORD") == name_hash)
+		{
+			usage = VEU_TextureCoord;
+		}
+		else if (CT_HASH("TANGENT") == name_hash)
+		{
+			usage = VEU_Tangent;
+		}
+		else if (CT_HASH("BINORMAL") == name_hash)
+		{
+			usage = VEU_Binormal;
+		}
+		else
+		{
+			// System values, like SV_VertexID
+			return false;
+		}
+
+		return true;
+	}
+
+	// Splits the text between an opening bracket and its closing one at the separators that aren't nested
+	std::vector<std::string_view> SplitBracketed(std::string_view src, size_t open, char close, char separator)
+	{
+		std::vector<std::string_view> ret;
+
+		char const open_ch = src[open];
+		int depth = 0;
+		size_t item_begin = open + 1;
+		for (size_t i = open + 1; i < src.size(); ++ i)
+		{
+			char const ch = src[i];
+			if (ch == open_ch)
+			{
+				++ depth;
+			}
+			else if ((ch == close) && (0 == depth--))
+			{
+				ret.push_back(src.substr(item_begin, i - item_begin));
+				break;
+			}
+			else if ((ch == separator) && (0 == depth))
+			{
+				ret.push_back(src.substr(item_begin, i - item_begin));
+				item_begin = i + 1;
+			}
+		}
+
+		return ret;
+	}
+
+	// Finds an identifier that is followed by one of the characters, and preceded by another identifier
+	size_t FindDeclaration(std::string_view src, std::string_view name, std::string_view prefix, char following)
+	{
+		for (size_t pos = src.find(name); pos != std::string_view::npos; pos = src.find(name, pos + 1))
+		{
+			size_t const end = pos + name.size();
+			if (((pos > 0) && IsIdentifierChar(src[pos - 1])) || ((end < src.size()) && IsIdentifierChar(src[end])))
+			{
+				continue;
+			}
+
+			size_t const next = src.find_first_not_of(" \t\r\n", end);
+			size_t const prev_end = (pos > 0) ? src.find_last_not_of(" \t\r\n", pos - 1) : std::string_view::npos;
+			if ((next == std::string_view::npos) || (src[next] != following)
+				|| (prev_end == std::string_view::npos) || !IsIdentifierChar(src[prev_end]))
+			{
+				continue;
+			}
+			if (!prefix.empty())
+			{
+				size_t prev_begin = prev_end;
+				while ((prev_begin > 0) && IsIdentifierChar(src[prev_begin - 1]))
+				{
+					-- prev_begin;
+				}
+				if (src.substr(prev_begin, prev_end - prev_begin + 1) != prefix)
+				{
+					continue;
+				}
+			}
+
+			return next;
+		}
+
+		return std::string_view::npos;
+	}
+
+	// Collects the vertex elements read by a vertex shader entry function, from the semantics of its parameters that aren't
+	// outputs, and of the members of its struct typed ones
+	std::vector<std::pair<VertexElementUsage, uint8_t>> ParseVertexShaderInputs(std::string_view src, std::string_view func_name)
+	{
+		std::vector<std::pair<VertexElementUsage, uint8_t>> ret;
+
+		auto add_semantic = [&ret](std::string_view decl)
+		{
+			size_t const colon = decl.rfind(':');
+			if (colon != std::string_view::npos)
+			{
+				VertexElementUsage usage;
+				uint8_t usage_index;
+				if (VertexElementFromSemantic(TrimSpaces(decl.substr(colon + 1)), usage, usage_index))
+				{
+					ret.emplace_back(usage, usage_index);
+				}
+			}
+		};
+
+		size_t const params_open = FindDeclaration(src, func_name, "", '(');
+		if (params_open == std::string_view::npos)
+		{
+			return ret;
+		}
+
+		for (auto const & param : SplitBracketed(src, params_open, ')', ','))
+		{
+			std::vector<std::string_view> tokens;
+			for (size_t pos = 0; pos < param.size();)
+			{
+				if (IsIdentifierChar(param[pos]))
+				{
+					size_t const token_begin = pos;
+					while ((pos < param.size()) && IsIdentifierChar(param[pos]))
+					{
+						++ pos;
+					}
+					tokens.push_back(param.substr(token_begin, pos - token_begin));
+				}
+				else if (param[pos] == ':')
+				{
+					break;
+				}
+				else
+				{
+					++ pos;
+				}
+			}
+
+			std::string_view type;
+			bool input = true;
+			for (auto const & token : tokens)
+			{
+				if ((token == "out") || (token == "uniform"))
+				{
+					input = false;
+				}
+				else if ((token != "in") && (token != "inout") && (token != "const") && (token != "precise")
+					&& (token != "linear") && (token != "centroid") && (token != "nointerpolation")
+					&& (token != "noperspective") && (token != "sample"))
+				{
+					type = token;
+					break;
+				}
+			}
+			if (!input || type.empty())
+			{
+				continue;
+			}
+
+			if (param.find(':') != std::string_view::npos)
+			{
+				add_semantic(param);
+			}
+			else
+			{
+				size_t const body_open = FindDeclaration(src, type, "struct", '{');
+				if (body_open != std::string_view::npos)
+				{
+					for (auto const & member : SplitBracketed(src, body_open, '}', ';'))
+					{
+						add_semantic(member);
+					}
+				}
+			}
+		}
+
+		return ret;
+	}
 }
 
 namespace KlayGE
@@ -2586,6 +2881,16 @@ namespace KlayGE
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			size_t seed = 0;
+			for (auto const & name : effect_desc_.res_name)
+			{
+				HashRange(seed, name.begin(), name.end());
+			}
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -4250,6 +4555,18 @@ namespace KlayGE
 		}
 	}
 
+	bool RenderTechnique::HasVertexInput(VertexElementUsage usage, uint8_t usage_index) const
+	{
+		for (auto const & pass : passes_)
+		{
+			if (!pass->HasVertexInput(usage, usage_index))
+			{
+				return false;
+			}
+		}
+		return !passes_.empty();
+	}
+
 	bool RenderTechnique::StreamIn(RenderEffect& effect, ResIdentifierPtr const & res, uint32_t tech_index)
 	{
 		name_ = ReadShortString(res);
@@ -4959,6 +5276,28 @@ namespace KlayGE
 		shader_obj->LinkShaders(effect);
 
 		is_validate_ = shader_obj->Validate();
+
+		vs_inputs_.clear();
+		ShaderDesc const & vs_desc = effect.GetShaderDesc(shader_desc_ids_[static_cast<uint32_t>(ShaderStage::Vertex)]);
+		if (!vs_desc.func_name.empty())
+		{
+			std::string src;
+			for (uint32_t i = 0; i < effect.NumShaderFragments(); ++ i)
+			{
+				RenderShaderFragment const & frag = effect.ShaderFragmentByIndex(i);
+				if ((frag.Stage() == ShaderStage::Vertex) || (frag.Stage() == ShaderStage::NumStages))
+				{
+					src += frag.str();
+					src += '\n';
+				}
+			}
+			vs_inputs_ = ParseVertexShaderInputs(StripDirectivesAndComments(src), vs_desc.func_name);
+		}
+	}
+
+	bool RenderPass::HasVertexInput(VertexElementUsage usage, uint8_t usage_index) const
+	{
+		return std::find(vs_inputs_.begin(), vs_inputs_.end(), std::make_pair(usage, usage_index)) != vs_inputs_.end();
 	}
 
 	bool RenderPass::StreamIn(RenderEffect& effect, ResIdentifierPtr const& res, uint32_t tech_index, uint32_t pass_index)
@@ -354,6 +354,11 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			return HashRange(mtl_desc_.res_name.begin(), mtl_desc_.res_name.end());
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -294,6 +294,42 @@ namespace KlayGE
 		instances_.resize(0);
 	}
 
+	void Renderable::AutoInstancing(bool auto_inst)
+	{
+		auto_instancing_ = auto_inst;
+	}
+
+	bool Renderable::AutoInstancing() const
+	{
+		return auto_instancing_;
+	}
+
+	std::vector<VertexElement> const & Renderable::AutoInstanceFormat()
+	{
+		// Rows of the world matrix
+		static std::vector<VertexElement> const format =
+		{
+			VertexElement(VEU_TextureCoord, 4, EF_ABGR32F),
+			VertexElement(VEU_TextureCoord, 5, EF_ABGR32F),
+			VertexElement(VEU_TextureCoord, 6, EF_ABGR32F),
+			VertexElement(VEU_TextureCoord, 7, EF_ABGR32F)
+		};
+		return format;
+	}
+
+	void Renderable::RenderInstances(RenderLayout const & rl)
+	{
+		if (!instances_.empty())
+		{
+			this->BindSceneNode(instances_[0]);
+		}
+
+		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
+		this->OnRenderBegin();
+		re.Render(*this->GetRenderEffect(), *this->GetRenderTechnique(), rl);
+		this->OnRenderEnd();
+	}
+
 	void Renderable::UpdateInstanceStream()
 	{
 		if (!instances_.empty() && !instances_[0]->InstanceFormat().empty())
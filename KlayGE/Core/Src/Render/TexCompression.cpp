@@ -29,12 +29,16 @@
 */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Thread.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
 
-#include <vector>
+#include <algorithm>
 #include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
 
 #include <KlayGE/TexCompression.hpp>
 
@@ -275,6 +279,21 @@ namespace KlayGE
 	}
 
 
+	uint32_t TexCompression::NumWorkers(uint32_t num_block_rows, uint32_t num_blocks_per_row,
+		uint32_t min_blocks_per_worker) const
+	{
+		uint32_t num_workers = num_threads_;
+		if (0 == num_workers)
+		{
+			num_workers = std::max(std::thread::hardware_concurrency(), 1U);
+		}
+
+		uint64_t const num_blocks = static_cast<uint64_t>(num_block_rows) * num_blocks_per_row;
+		num_workers = static_cast<uint32_t>(std::min<uint64_t>(num_workers,
+			(num_blocks + min_blocks_per_worker - 1) / min_blocks_per_worker));
+		return std::max(std::min(num_workers, num_block_rows), 1U);
+	}
+
 	void TexCompression::EncodeMem(uint32_t width, uint32_t height,
 		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -290,35 +309,45 @@ namespace KlayGE
 
 		uint8_t const * src = static_cast<uint8_t const *>(input);
 
-		std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height)
+		auto encode_rows = [=](TexCompression& codec, uint32_t y_block_begin, uint32_t y_block_end)
 		{
-			uint8_t* dst = static_cast<uint8_t*>(output) + (y_base / block_height) * out_row_pitch;
-
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+			std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
+			for (uint32_t y_base = y_block_begin * block_height; y_base < std::min(y_block_end * block_height, height);
+				y_base += block_height)
 			{
-				for (uint32_t y = 0; y < block_height; ++ y)
+				uint8_t* dst = static_cast<uint8_t*>(output) + (y_base / block_height) * out_row_pitch;
+
+				for (uint32_t x_base = 0; x_base < width; x_base += block_width)
 				{
-					for (uint32_t x = 0; x < block_width; ++ x)
+					for (uint32_t y = 0; y < block_height; ++ y)
 					{
-						if ((x_base + x < width) && (y_base + y < height))
-						{
-							memcpy(&uncompressed[(y * block_width + x) * elem_size],
-								&src[(y_base + y) * in_row_pitch + (x_base + x) * elem_size],
-								elem_size);
-						}
-						else
+						for (uint32_t x = 0; x < block_width; ++ x)
 						{
-							memset(&uncompressed[(y * block_width + x) * elem_size],
-								0, elem_size);
+							if ((x_base + x < width) && (y_base + y < height))
+							{
+								memcpy(&uncompressed[(y * block_width + x) * elem_size],
+									&src[(y_base + y) * in_row_pitch + (x_base + x) * elem_size],
+									elem_size);
+							}
+							else
+							{
+								memset(&uncompressed[(y * block_width + x) * elem_size],
+									0, elem_size);
+							}
 						}
 					}
-				}
 
-				this->EncodeBlock(dst, &uncompressed[0], method);
-				dst += block_bytes;
+					codec.EncodeBlock(dst, &uncompressed[0], method);
+					dst += block_bytes;
+				}
 			}
-		}
+		};
+
+		// Encoding a block costs from microseconds (BC1) to milliseconds (BC7 quality), so even small batches pay off
+		uint32_t const num_block_rows = (height + block_height - 1) / block_height;
+		uint32_t const num_blocks_per_row = (width + block_width - 1) / block_width;
+		uint32_t const num_workers = this->NumWorkers(num_block_rows, num_blocks_per_row, 256);
+		this->RunWorkers(num_workers, num_block_rows, encode_rows);
 	}
 
 	void TexCompression::DecodeMem(uint32_t width, uint32_t height,
@@ -335,29 +364,61 @@ namespace KlayGE
 
 		uint8_t * dst = static_cast<uint8_t*>(output);
 
-		std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height)
+		auto decode_rows = [=](TexCompression& codec, uint32_t y_block_begin, uint32_t y_block_end)
 		{
-			uint8_t const * src = static_cast<uint8_t const *>(input) + in_row_pitch * (y_base / block_height);
-
-			uint32_t const block_h = std::min(block_height, height - y_base);
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width)
+			std::vector<uint8_t> uncompressed(block_width * block_height * elem_size);
+			for (uint32_t y_base = y_block_begin * block_height; y_base < std::min(y_block_end * block_height, height);
+				y_base += block_height)
 			{
-				uint32_t const block_w = std::min(block_width, width - x_base);
-
-				this->DecodeBlock(&uncompressed[0], src);
-				src += block_bytes;
+				uint8_t const * src = static_cast<uint8_t const *>(input) + in_row_pitch * (y_base / block_height);
 
-				for (uint32_t y = 0; y < block_h; ++ y)
+				uint32_t const block_h = std::min(block_height, height - y_base);
+				for (uint32_t x_base = 0; x_base < width; x_base += block_width)
 				{
-					for (uint32_t x = 0; x < block_w; ++ x)
+					uint32_t const block_w = std::min(block_width, width - x_base);
+
+					codec.DecodeBlock(&uncompressed[0], src);
+					src += block_bytes;
+
+					for (uint32_t y = 0; y < block_h; ++ y)
 					{
-						memcpy(&dst[(y_base + y) * out_row_pitch + (x_base + x) * elem_size],
-							&uncompressed[(y * block_width + x) * elem_size], elem_size);
+						for (uint32_t x = 0; x < block_w; ++ x)
+						{
+							memcpy(&dst[(y_base + y) * out_row_pitch + (x_base + x) * elem_size],
+								&uncompressed[(y * block_width + x) * elem_size], elem_size);
+						}
 					}
 				}
 			}
+		};
+
+		// Decoding is cheap, only split large images
+		uint32_t const num_block_rows = (height + block_height - 1) / block_height;
+		uint32_t const num_blocks_per_row = (width + block_width - 1) / block_width;
+		uint32_t const num_workers = this->NumWorkers(num_block_rows, num_blocks_per_row, 4096);
+		this->RunWorkers(num_workers, num_block_rows, decode_rows);
+	}
+
+	void TexCompression::RunWorkers(uint32_t num_workers, uint32_t num_block_rows,
+		std::function<void(TexCompression&, uint32_t, uint32_t)> const & process_rows)
+	{
+		// Every block row goes to exactly one worker and blocks are coded independently,
+		// so the output is identical to the serial path regardless of scheduling.
+		std::vector<TexCompressionPtr> codecs(num_workers);
+		for (uint32_t i = 1; i < num_workers; ++ i)
+		{
+			codecs[i] = this->Clone();
+			if (codecs[i])
+			{
+				codecs[i]->UseSIMD(this->UseSIMD());
+			}
 		}
+
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_block_rows, num_workers,
+			[this, &codecs, &process_rows](uint32_t worker, uint32_t y_block_begin, uint32_t y_block_end)
+			{
+				process_rows(codecs[worker] ? *codecs[worker] : *this, y_block_begin, y_block_end);
+			});
 	}
 
 	void TexCompression::EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method)
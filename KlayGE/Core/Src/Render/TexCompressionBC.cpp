@@ -30,20 +30,35 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/CXX17/iterator.hpp>
+#include <KFL/CpuInfo.hpp>
 #include <KFL/ErrorHandling.hpp>
+#include <KFL/Hash.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KFL/Color.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KFL/Half.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <limits>
 #include <random>
 #include <vector>
 #include <boost/assert.hpp>
 #ifdef KLAYGE_COMPILER_MSVC
 	#include <intrin.h>		// For _BitScanForward
 #endif
+#if defined(KLAYGE_CPU_X86) || defined(KLAYGE_CPU_X64)
+	// The kernels are picked at runtime, so they are compiled for SSE4.1 regardless of the target flags
+	#define KLAYGE_BC_SSE4_1_KERNELS
+	#include <smmintrin.h>
+	#if defined(KLAYGE_COMPILER_GCC) || defined(KLAYGE_COMPILER_CLANG)
+		#define KLAYGE_TARGET_SSE4_1 __attribute__((target("sse4.1")))
+	#else
+		#define KLAYGE_TARGET_SSE4_1
+	#endif
+#endif
 
 #include <KlayGE/TexCompressionBC.hpp>
 #include "../Base/TableGen/Tables.hpp"
@@ -332,6 +347,113 @@ namespace
 		}
 	}
 
+	int F162Int(half f16, bool signed_fmt)
+	{
+		uint16_t const bits = *(reinterpret_cast<uint16_t const *>(&f16));
+		int const magnitude = std::min(static_cast<int>(bits & 0x7FFF), 0x7BFF);
+		if (bits & 0x8000)
+		{
+			return signed_fmt ? -magnitude : 0;
+		}
+		else
+		{
+			return magnitude;
+		}
+	}
+
+	// Fits a line segment through the pixels of a region with PCA, in the integer half space the BC6 palette lives in.
+	// Returns the error of snapping the pixels onto num_indices evenly spaced points of that segment.
+	float FitBC6EndPoints(std::pair<float3, float3>& end_pts, int3 const * pixels,
+		uint32_t partitions, uint32_t shape, uint32_t region, uint32_t num_indices, bool signed_fmt)
+	{
+		float const min_value = signed_fmt ? -0x7BFF : 0;
+		float const max_value = 0x7BFF;
+
+		std::array<float3, 16> pts;
+		uint32_t num_pts = 0;
+		float3 mean(0, 0, 0);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (GetPartition(partitions, shape, i) == region)
+			{
+				pts[num_pts] = float3(static_cast<float>(pixels[i].x()), static_cast<float>(pixels[i].y()),
+					static_cast<float>(pixels[i].z()));
+				mean += pts[num_pts];
+				++ num_pts;
+			}
+		}
+		if (0 == num_pts)
+		{
+			end_pts.first = end_pts.second = float3(0, 0, 0);
+			return 0;
+		}
+		mean /= static_cast<float>(num_pts);
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (uint32_t i = 0; i < num_pts; ++ i)
+		{
+			float3 const d = pts[i] - mean;
+			cov[0] += d.x() * d.x();
+			cov[1] += d.x() * d.y();
+			cov[2] += d.x() * d.z();
+			cov[3] += d.y() * d.y();
+			cov[4] += d.y() * d.z();
+			cov[5] += d.z() * d.z();
+		}
+
+		// Power iteration for the principal axis
+		float3 axis(1, 1, 1);
+		for (int iter = 0; iter < 8; ++ iter)
+		{
+			float3 const next(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+				cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+				cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+			float const len = MathLib::length(next);
+			if (len < 1e-6f)
+			{
+				break;
+			}
+			axis = next / len;
+		}
+		float const axis_len_sq = MathLib::length_sq(axis);
+		if (axis_len_sq > 1e-6f)
+		{
+			axis /= sqrt(axis_len_sq);
+		}
+
+		float t_min = 0;
+		float t_max = 0;
+		for (uint32_t i = 0; i < num_pts; ++ i)
+		{
+			float const t = MathLib::dot(pts[i] - mean, axis);
+			t_min = std::min(t_min, t);
+			t_max = std::max(t_max, t);
+		}
+
+		end_pts.first = mean + axis * t_min;
+		end_pts.second = mean + axis * t_max;
+		for (uint32_t ch = 0; ch < 3; ++ ch)
+		{
+			end_pts.first[ch] = MathLib::clamp(end_pts.first[ch], min_value, max_value);
+			end_pts.second[ch] = MathLib::clamp(end_pts.second[ch], min_value, max_value);
+		}
+
+		float3 const dir = end_pts.second - end_pts.first;
+		float const dir_len_sq = MathLib::length_sq(dir);
+		float error = 0;
+		for (uint32_t i = 0; i < num_pts; ++ i)
+		{
+			float3 fitted = end_pts.first;
+			if (dir_len_sq > 1e-6f)
+			{
+				float const t = MathLib::clamp(MathLib::dot(pts[i] - end_pts.first, dir) / dir_len_sq, 0.0f, 1.0f);
+				fitted += dir * (MathLib::round(t * (num_indices - 1)) / (num_indices - 1));
+			}
+			error += MathLib::length_sq(pts[i] - fitted);
+		}
+		return error;
+	}
+
 	bool Bsf32(uint32_t& index, uint32_t v)
 	{
 #ifdef KLAYGE_COMPILER_MSVC
@@ -880,12 +1002,297 @@ namespace
 		}
 	}
 
-	int IntRand()
+	int IntRand(std::mt19937& gen)
 	{
-		static thread_local std::mt19937 gen;
 		std::uniform_int_distribution<int> random_dis(0, RAND_MAX);
 		return random_dis(gen);
 	}
+
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+	bool SSE41Supported()
+	{
+		static bool const supported = []
+			{
+				CPUInfo cpu;
+				return cpu.IsFeatureSupport(CPUInfo::CF_SSSE3) && cpu.IsFeatureSupport(CPUInfo::CF_SSE41);
+			}();
+		return supported;
+	}
+
+	bool UseSSE41Kernels(TexCompression const & codec)
+	{
+		return codec.UseSIMD() && SSE41Supported();
+	}
+
+	// The BC1-BC5 kernels below work on 4 pixels per register, one 32-bit lane per pixel, and are bit exact with
+	// the scalar code in the codecs.
+
+	KLAYGE_TARGET_SSE4_1 int HorizontalSumSSE41(__m128i v)
+	{
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtsi128_si32(v);
+	}
+
+	KLAYGE_TARGET_SSE4_1 __m128i ChannelSSE41(__m128i argb, int channel)
+	{
+		return _mm_and_si128(_mm_srli_epi32(argb, channel * 8), _mm_set1_epi32(0xFF));
+	}
+
+	KLAYGE_TARGET_SSE4_1 __m128i DotsSSE41(__m128i argb, __m128i dir_r, __m128i dir_g, __m128i dir_b)
+	{
+		__m128i const r = _mm_mullo_epi32(ChannelSSE41(argb, ARGBColor32::RChannel), dir_r);
+		__m128i const g = _mm_mullo_epi32(ChannelSSE41(argb, ARGBColor32::GChannel), dir_g);
+		__m128i const b = _mm_mullo_epi32(ChannelSSE41(argb, ARGBColor32::BChannel), dir_b);
+		return _mm_add_epi32(_mm_add_epi32(r, g), b);
+	}
+
+	// Spreads the 16 bits of lsb and msb into a 2-bit-per-pixel mask
+	uint32_t InterleaveMaskBits(uint32_t lsb, uint32_t msb)
+	{
+		uint32_t bits[] = { lsb, msb };
+		for (auto& x : bits)
+		{
+			x = (x | (x << 8)) & 0x00FF00FF;
+			x = (x | (x << 4)) & 0x0F0F0F0F;
+			x = (x | (x << 2)) & 0x33333333;
+			x = (x | (x << 1)) & 0x55555555;
+		}
+		return bits[0] | (bits[1] << 1);
+	}
+
+	KLAYGE_TARGET_SSE4_1 bool MaskTransparentSSE41(ARGBColor32* dst, ARGBColor32 const * src)
+	{
+		int opaque = 0;
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128i const argb = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&src[i]));
+			// Alpha >= 0x80 has the sign bit set
+			__m128i const opaque_mask = _mm_srai_epi32(argb, 31);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]), _mm_and_si128(argb, opaque_mask));
+			opaque |= _mm_movemask_ps(_mm_castsi128_ps(opaque_mask)) << i;
+		}
+		return opaque != 0xFFFF;
+	}
+
+	KLAYGE_TARGET_SSE4_1 void MinMaxARGBSSE41(uint32_t& min32, uint32_t& max32, ARGBColor32 const * argb)
+	{
+		__m128i min_v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[0]));
+		__m128i max_v = min_v;
+		for (int i = 4; i < 16; i += 4)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[i]));
+			min_v = _mm_min_epu32(min_v, v);
+			max_v = _mm_max_epu32(max_v, v);
+		}
+		min_v = _mm_min_epu32(min_v, _mm_shuffle_epi32(min_v, _MM_SHUFFLE(1, 0, 3, 2)));
+		min_v = _mm_min_epu32(min_v, _mm_shuffle_epi32(min_v, _MM_SHUFFLE(2, 3, 0, 1)));
+		max_v = _mm_max_epu32(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(1, 0, 3, 2)));
+		max_v = _mm_max_epu32(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(2, 3, 0, 1)));
+		min32 = static_cast<uint32_t>(_mm_cvtsi128_si32(min_v));
+		max32 = static_cast<uint32_t>(_mm_cvtsi128_si32(max_v));
+	}
+
+	KLAYGE_TARGET_SSE4_1 void ColorDotsSSE41(int* dots, ARGBColor32 const * argb, int dir_r, int dir_g, int dir_b)
+	{
+		__m128i const dir_r_v = _mm_set1_epi32(dir_r);
+		__m128i const dir_g_v = _mm_set1_epi32(dir_g);
+		__m128i const dir_b_v = _mm_set1_epi32(dir_b);
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[i]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&dots[i]), DotsSSE41(v, dir_r_v, dir_g_v, dir_b_v));
+		}
+	}
+
+	KLAYGE_TARGET_SSE4_1 uint32_t MatchColorsSSE41(ARGBColor32 const * argb, int dir_r, int dir_g, int dir_b,
+		int c0_point, int half_point, int c3_point, bool alpha)
+	{
+		__m128i const dir_r_v = _mm_set1_epi32(dir_r);
+		__m128i const dir_g_v = _mm_set1_epi32(dir_g);
+		__m128i const dir_b_v = _mm_set1_epi32(dir_b);
+		__m128i const c0_v = _mm_set1_epi32(c0_point);
+		__m128i const half_v = _mm_set1_epi32(half_point);
+		__m128i const c3_v = _mm_set1_epi32(c3_point);
+
+		uint32_t lsb = 0;
+		uint32_t msb = 0;
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[i]));
+			__m128i const dots = DotsSSE41(v, dir_r_v, dir_g_v, dir_b_v);
+			__m128i const lt_c0 = _mm_cmplt_epi32(dots, c0_v);
+			__m128i const lt_c3 = _mm_cmplt_epi32(dots, c3_v);
+
+			__m128i lsb_v;
+			__m128i msb_v;
+			if (alpha)
+			{
+				// Transparent -> 3, below c0 -> 0, below c3 -> 2, otherwise 1
+				__m128i const transparent = _mm_cmpeq_epi32(_mm_srli_epi32(v, 24), _mm_setzero_si128());
+				__m128i const ge_c0 = _mm_andnot_si128(lt_c0, _mm_set1_epi32(-1));
+				lsb_v = _mm_or_si128(transparent, _mm_andnot_si128(lt_c3, ge_c0));
+				msb_v = _mm_or_si128(transparent, _mm_and_si128(lt_c3, ge_c0));
+			}
+			else
+			{
+				// Below half: below c0 -> 1, otherwise 3. Above half: below c3 -> 2, otherwise 0
+				__m128i const lt_half = _mm_cmplt_epi32(dots, half_v);
+				lsb_v = lt_half;
+				msb_v = _mm_or_si128(_mm_andnot_si128(lt_c0, lt_half), _mm_andnot_si128(lt_half, lt_c3));
+			}
+
+			lsb |= _mm_movemask_ps(_mm_castsi128_ps(lsb_v)) << i;
+			msb |= _mm_movemask_ps(_mm_castsi128_ps(msb_v)) << i;
+		}
+
+		return InterleaveMaskBits(lsb, msb);
+	}
+
+	KLAYGE_TARGET_SSE4_1 void ColorStatsSSE41(int* mu, int* min, int* max, int* cov, ARGBColor32 const * argb)
+	{
+		__m128i argb_v[4];
+		for (int i = 0; i < 4; ++ i)
+		{
+			argb_v[i] = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[i * 4]));
+		}
+
+		__m128i centered[3][4];
+		for (int ch = 0; ch < 3; ++ ch)
+		{
+			__m128i sum_v = _mm_setzero_si128();
+			__m128i min_v = _mm_set1_epi32(255);
+			__m128i max_v = _mm_setzero_si128();
+			for (int i = 0; i < 4; ++ i)
+			{
+				centered[ch][i] = ChannelSSE41(argb_v[i], ch);
+				sum_v = _mm_add_epi32(sum_v, centered[ch][i]);
+				min_v = _mm_min_epi32(min_v, centered[ch][i]);
+				max_v = _mm_max_epi32(max_v, centered[ch][i]);
+			}
+			min_v = _mm_min_epi32(min_v, _mm_shuffle_epi32(min_v, _MM_SHUFFLE(1, 0, 3, 2)));
+			min_v = _mm_min_epi32(min_v, _mm_shuffle_epi32(min_v, _MM_SHUFFLE(2, 3, 0, 1)));
+			max_v = _mm_max_epi32(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(1, 0, 3, 2)));
+			max_v = _mm_max_epi32(max_v, _mm_shuffle_epi32(max_v, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			mu[ch] = (HorizontalSumSSE41(sum_v) + 8) >> 4;
+			min[ch] = _mm_cvtsi128_si32(min_v);
+			max[ch] = _mm_cvtsi128_si32(max_v);
+
+			__m128i const mu_v = _mm_set1_epi32(mu[ch]);
+			for (int i = 0; i < 4; ++ i)
+			{
+				centered[ch][i] = _mm_sub_epi32(centered[ch][i], mu_v);
+			}
+		}
+
+		int const R = ARGBColor32::RChannel;
+		int const G = ARGBColor32::GChannel;
+		int const B = ARGBColor32::BChannel;
+		int const pairs[6][2] = { { R, R }, { R, G }, { R, B }, { G, G }, { G, B }, { B, B } };
+		for (int j = 0; j < 6; ++ j)
+		{
+			__m128i sum_v = _mm_setzero_si128();
+			for (int i = 0; i < 4; ++ i)
+			{
+				sum_v = _mm_add_epi32(sum_v, _mm_mullo_epi32(centered[pairs[j][0]][i], centered[pairs[j][1]][i]));
+			}
+			cov[j] = HorizontalSumSSE41(sum_v);
+		}
+	}
+
+	KLAYGE_TARGET_SSE4_1 void RefineSumsSSE41(int* at1, int* at2, ARGBColor32 const * argb, int const * w1_tab, uint32_t mask)
+	{
+		__m128i at1_v[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+		__m128i at2_v[3] = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+		for (int i = 0; i < 16; i += 4, mask >>= 8)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&argb[i]));
+			__m128i const w1 = _mm_setr_epi32(w1_tab[(mask >> 0) & 3], w1_tab[(mask >> 2) & 3],
+				w1_tab[(mask >> 4) & 3], w1_tab[(mask >> 6) & 3]);
+			for (int ch = 0; ch < 3; ++ ch)
+			{
+				__m128i const c = ChannelSSE41(v, ch);
+				at1_v[ch] = _mm_add_epi32(at1_v[ch], _mm_mullo_epi32(w1, c));
+				at2_v[ch] = _mm_add_epi32(at2_v[ch], c);
+			}
+		}
+		for (int ch = 0; ch < 3; ++ ch)
+		{
+			at1[ch] = HorizontalSumSSE41(at1_v[ch]);
+			at2[ch] = HorizontalSumSSE41(at2_v[ch]);
+		}
+	}
+
+	KLAYGE_TARGET_SSE4_1 void LookupBC1SSE41(ARGBColor32* argb, ARGBColor32 const * clr, uint32_t mask)
+	{
+		__m128i const palette = _mm_loadu_si128(reinterpret_cast<__m128i const *>(clr));
+		__m128i const byte_offsets = _mm_set1_epi32(0x03020100);
+		__m128i const splat = _mm_set1_epi32(0x04040404);
+		for (int i = 0; i < 16; i += 4, mask >>= 8)
+		{
+			__m128i const index = _mm_setr_epi32((mask >> 0) & 3, (mask >> 2) & 3, (mask >> 4) & 3, (mask >> 6) & 3);
+			__m128i const control = _mm_add_epi32(_mm_mullo_epi32(index, splat), byte_offsets);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&argb[i]), _mm_shuffle_epi8(palette, control));
+		}
+	}
+
+	KLAYGE_TARGET_SSE4_1 void MinMaxU8SSE41(int& min, int& max, uint8_t const * r)
+	{
+		__m128i min_v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r));
+		__m128i max_v = min_v;
+		min_v = _mm_min_epu8(min_v, _mm_srli_si128(min_v, 8));
+		max_v = _mm_max_epu8(max_v, _mm_srli_si128(max_v, 8));
+		min_v = _mm_min_epu8(min_v, _mm_srli_si128(min_v, 4));
+		max_v = _mm_max_epu8(max_v, _mm_srli_si128(max_v, 4));
+		min_v = _mm_min_epu8(min_v, _mm_srli_si128(min_v, 2));
+		max_v = _mm_max_epu8(max_v, _mm_srli_si128(max_v, 2));
+		min_v = _mm_min_epu8(min_v, _mm_srli_si128(min_v, 1));
+		max_v = _mm_max_epu8(max_v, _mm_srli_si128(max_v, 1));
+		min = _mm_cvtsi128_si32(min_v) & 0xFF;
+		max = _mm_cvtsi128_si32(max_v) & 0xFF;
+	}
+
+	KLAYGE_TARGET_SSE4_1 void BC4IndicesSSE41(uint8_t* indices, uint8_t const * r, int bias, int dist)
+	{
+		__m128i const src = _mm_loadu_si128(reinterpret_cast<__m128i const *>(r));
+		__m128i const bias_v = _mm_set1_epi16(static_cast<int16_t>(bias));
+		__m128i const dist_v = _mm_set1_epi16(static_cast<int16_t>(dist));
+		__m128i const dist2_v = _mm_set1_epi16(static_cast<int16_t>(dist * 2));
+		__m128i const dist4_v = _mm_set1_epi16(static_cast<int16_t>(dist * 4));
+		__m128i const seven = _mm_set1_epi16(7);
+		__m128i const two = _mm_set1_epi16(2);
+		__m128i const one = _mm_set1_epi16(1);
+
+		__m128i ind[2];
+		for (int half = 0; half < 2; ++ half)
+		{
+			__m128i const c = half ? _mm_unpackhi_epi8(src, _mm_setzero_si128()) : _mm_cvtepu8_epi16(src);
+			__m128i a = _mm_sub_epi16(_mm_mullo_epi16(c, seven), bias_v);
+
+			__m128i t = _mm_cmpgt_epi16(a, dist4_v);
+			__m128i i = _mm_and_si128(t, _mm_set1_epi16(4));
+			a = _mm_sub_epi16(a, _mm_and_si128(dist4_v, t));
+			t = _mm_cmpgt_epi16(a, dist2_v);
+			i = _mm_add_epi16(i, _mm_and_si128(t, two));
+			a = _mm_sub_epi16(a, _mm_and_si128(dist2_v, t));
+			t = _mm_cmpgt_epi16(a, dist_v);
+			i = _mm_add_epi16(i, _mm_and_si128(t, one));
+
+			// ind = -ind & 7; ind ^= (2 > ind)
+			i = _mm_and_si128(_mm_sub_epi16(_mm_setzero_si128(), i), seven);
+			ind[half] = _mm_xor_si128(i, _mm_and_si128(_mm_cmpgt_epi16(two, i), one));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_packus_epi16(ind[0], ind[1]));
+	}
+
+	KLAYGE_TARGET_SSE4_1 void LookupBC4SSE41(uint8_t* output, uint8_t const * alpha, uint8_t const * indices)
+	{
+		__m128i const palette = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(alpha));
+		__m128i const control = _mm_loadu_si128(reinterpret_cast<__m128i const *>(indices));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(palette, control));
+	}
+#endif
 }
 
 namespace KlayGE
@@ -907,22 +1314,37 @@ namespace KlayGE
 
 		std::array<ARGBColor32, 16> tmp_argb;
 		bool alpha = false;
-		for (size_t i = 0; i < tmp_argb.size(); ++ i)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
 		{
-			if (argb[i].a() < 0x80)
-			{
-				tmp_argb[i] = ARGBColor32(0, 0, 0, 0);
-				alpha = true;
-			}
-			else
+			alpha = MaskTransparentSSE41(&tmp_argb[0], argb);
+		}
+		else
+#endif
+		{
+			for (size_t i = 0; i < tmp_argb.size(); ++ i)
 			{
-				tmp_argb[i] = argb[i];
+				if (argb[i].a() < 0x80)
+				{
+					tmp_argb[i] = ARGBColor32(0, 0, 0, 0);
+					alpha = true;
+				}
+				else
+				{
+					tmp_argb[i] = argb[i];
+				}
 			}
 		}
 
 		this->EncodeBC1Internal(bc1, &tmp_argb[0], alpha, method);
 	}
 
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC1::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
 	void TexCompressionBC1::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -957,11 +1379,20 @@ namespace KlayGE
 			clr[3] = ARGBColor32(0, 0, 0, 0);
 		}
 
-		for (int i = 0; i < 2; ++ i)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
 		{
-			for (int j = 0; j < 8; ++ j)
+			LookupBC1SSE41(argb, &clr[0], bc1.bitmap[0] | (static_cast<uint32_t>(bc1.bitmap[1]) << 16));
+		}
+		else
+#endif
+		{
+			for (int i = 0; i < 2; ++ i)
 			{
-				argb[i * 8 + j] = clr[(bc1.bitmap[i] >> (j * 2)) & 0x3];
+				for (int j = 0; j < 8; ++ j)
+				{
+					argb[i * 8 + j] = clr[(bc1.bitmap[i] >> (j * 2)) & 0x3];
+				}
 			}
 		}
 	}
@@ -996,17 +1427,13 @@ namespace KlayGE
 			color[3].a() = 255;
 		}
 
-		uint32_t mask = 0;
 		int dirr = color[0].r() - color[1].r();
 		int dirg = color[0].g() - color[1].g();
 		int dirb = color[0].b() - color[1].b();
 
-		int dots[16];
-		for (int i = 0; i < 16; ++ i)
-		{
-			dots[i] = argb[i].r() * dirr + argb[i].g() * dirg + argb[i].b() * dirb;
-		}
-
+		int c0_point;
+		int half_point;
+		int c3_point;
 		if (alpha)
 		{
 			std::array<int, 2> stops;
@@ -1015,9 +1442,39 @@ namespace KlayGE
 				stops[i] = color[i].r() * dirr + color[i].g() * dirg + color[i].b() * dirb;
 			}
 
-			int c0_point = (stops[0] + stops[1] * 2) / 3;
-			int c3_point = (stops[0] * 2 + stops[1]) / 3;
+			c0_point = (stops[0] + stops[1] * 2) / 3;
+			half_point = 0;
+			c3_point = (stops[0] * 2 + stops[1]) / 3;
+		}
+		else
+		{
+			std::array<int, 4> stops;
+			for (int i = 0; i < 4; ++ i)
+			{
+				stops[i] = color[i].r() * dirr + color[i].g() * dirg + color[i].b() * dirb;
+			}
+
+			c0_point = (stops[1] + stops[3]) >> 1;
+			half_point = (stops[3] + stops[2]) >> 1;
+			c3_point = (stops[2] + stops[0]) >> 1;
+		}
+
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
+		{
+			return MatchColorsSSE41(argb, dirr, dirg, dirb, c0_point, half_point, c3_point, alpha);
+		}
+#endif
+
+		int dots[16];
+		for (int i = 0; i < 16; ++ i)
+		{
+			dots[i] = argb[i].r() * dirr + argb[i].g() * dirg + argb[i].b() * dirb;
+		}
 
+		uint32_t mask = 0;
+		if (alpha)
+		{
 			for (int i = 15; i >= 0; -- i)
 			{
 				mask <<= 2;
@@ -1037,16 +1494,6 @@ namespace KlayGE
 		}
 		else
 		{
-			std::array<int, 4> stops;
-			for (int i = 0; i < 4; ++ i)
-			{
-				stops[i] = color[i].r() * dirr + color[i].g() * dirg + color[i].b() * dirb;
-			}
-
-			int c0_point = (stops[1] + stops[3]) >> 1;
-			int half_point = (stops[3] + stops[2]) >> 1;
-			int c3_point = (stops[2] + stops[0]) >> 1;
-
 			for (int i = 15; i >= 0; -- i)
 			{
 				mask <<= 2;
@@ -1098,43 +1545,52 @@ namespace KlayGE
 
 			// determine color distribution
 			int mu[3], min[3], max[3];
+			int cov[6];
 
-			for (int ch = 0; ch < 3; ++ ch)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+			if (UseSSE41Kernels(*this))
 			{
-				int muv, minv, maxv;
-
-				muv = minv = maxv = argb[0][ch];
-				for (int i = 1; i < 16; ++ i)
+				ColorStatsSSE41(mu, min, max, cov, argb);
+			}
+			else
+#endif
+			{
+				for (int ch = 0; ch < 3; ++ ch)
 				{
-					muv += argb[i][ch];
-					minv = std::min<int>(minv, argb[i][ch]);
-					maxv = std::max<int>(maxv, argb[i][ch]);
-				}
+					int muv, minv, maxv;
 
-				mu[ch] = (muv + 8) >> 4;
-				min[ch] = minv;
-				max[ch] = maxv;
-			}
+					muv = minv = maxv = argb[0][ch];
+					for (int i = 1; i < 16; ++ i)
+					{
+						muv += argb[i][ch];
+						minv = std::min<int>(minv, argb[i][ch]);
+						maxv = std::max<int>(maxv, argb[i][ch]);
+					}
 
-			// determine covariance matrix
-			int cov[6];
-			for (int i = 0; i < 6; ++ i)
-			{
-				cov[i] = 0;
-			}
+					mu[ch] = (muv + 8) >> 4;
+					min[ch] = minv;
+					max[ch] = maxv;
+				}
 
-			for (int i = 0; i < 16; ++ i)
-			{
-				int r = argb[i].r() - mu[ARGBColor32::RChannel];
-				int g = argb[i].g() - mu[ARGBColor32::GChannel];
-				int b = argb[i].b() - mu[ARGBColor32::BChannel];
+				// determine covariance matrix
+				for (int i = 0; i < 6; ++ i)
+				{
+					cov[i] = 0;
+				}
 
-				cov[0] += r * r;
-				cov[1] += r * g;
-				cov[2] += r * b;
-				cov[3] += g * g;
-				cov[4] += g * b;
-				cov[5] += b * b;
+				for (int i = 0; i < 16; ++ i)
+				{
+					int r = argb[i].r() - mu[ARGBColor32::RChannel];
+					int g = argb[i].g() - mu[ARGBColor32::GChannel];
+					int b = argb[i].b() - mu[ARGBColor32::BChannel];
+
+					cov[0] += r * r;
+					cov[1] += r * g;
+					cov[2] += r * b;
+					cov[3] += g * g;
+					cov[4] += g * b;
+					cov[5] += b * b;
+				}
 			}
 
 			// convert covariance matrix to float, find principal axis via power iter
@@ -1177,11 +1633,26 @@ namespace KlayGE
 			}
 
 			// Pick colors at extreme points
+			int dots[16];
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+			if (UseSSE41Kernels(*this))
+			{
+				ColorDotsSSE41(dots, argb, v_r, v_g, v_b);
+			}
+			else
+#endif
+			{
+				for (int i = 0; i < 16; ++ i)
+				{
+					dots[i] = argb[i].r() * v_r + argb[i].g() * v_g + argb[i].b() * v_b;
+				}
+			}
+
 			int min_d = 0x7FFFFFFF, max_d = -min_d;
 			min_clr = max_clr = ARGBColor32(0, 0, 0, 0);
 			for (int i = 0; i < 16; ++ i)
 			{
-				int dot = argb[i].r() * v_r + argb[i].g() * v_g + argb[i].b() * v_b;
+				int dot = dots[i];
 				if (dot < min_d)
 				{
 					min_d = dot;
@@ -1212,21 +1683,42 @@ namespace KlayGE
 
 		At1_r = At1_g = At1_b = 0;
 		At2_r = At2_g = At2_b = 0;
-		for (int i = 0; i < 16; ++ i, mask >>= 2)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
+		{
+			int at1[3], at2[3];
+			RefineSumsSSE41(at1, at2, argb, w1Tab, mask);
+			At1_r = at1[ARGBColor32::RChannel];
+			At1_g = at1[ARGBColor32::GChannel];
+			At1_b = at1[ARGBColor32::BChannel];
+			At2_r = at2[ARGBColor32::RChannel];
+			At2_g = at2[ARGBColor32::GChannel];
+			At2_b = at2[ARGBColor32::BChannel];
+
+			for (int i = 0; i < 16; ++ i, mask >>= 2)
+			{
+				akku += prods[mask & 3];
+			}
+		}
+		else
+#endif
 		{
-			int step = mask & 3;
-			int w1 = w1Tab[step];
-			int r = argb[i].r();
-			int g = argb[i].g();
-			int b = argb[i].b();
-
-			akku += prods[step];
-			At1_r += w1 * r;
-			At1_g += w1 * g;
-			At1_b += w1 * b;
-			At2_r += r;
-			At2_g += g;
-			At2_b += b;
+			for (int i = 0; i < 16; ++ i, mask >>= 2)
+			{
+				int step = mask & 3;
+				int w1 = w1Tab[step];
+				int r = argb[i].r();
+				int g = argb[i].g();
+				int b = argb[i].b();
+
+				akku += prods[step];
+				At1_r += w1 * r;
+				At1_g += w1 * g;
+				At1_b += w1 * b;
+				At2_r += r;
+				At2_g += g;
+				At2_b += b;
+			}
 		}
 
 		At2_r = 3 * At2_r - At1_r;
@@ -1282,11 +1774,20 @@ namespace KlayGE
 
 		// check if block is constant
 		uint32_t min32, max32;
-		min32 = max32 = argb[0].ARGB();
-		for (int i = 1; i < 16; ++ i)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
+		{
+			MinMaxARGBSSE41(min32, max32, argb);
+		}
+		else
+#endif
 		{
-			min32 = std::min(min32, argb[i].ARGB());
-			max32 = std::max(max32, argb[i].ARGB());
+			min32 = max32 = argb[0].ARGB();
+			for (int i = 1; i < 16; ++ i)
+			{
+				min32 = std::min(min32, argb[i].ARGB());
+				max32 = std::max(max32, argb[i].ARGB());
+			}
 		}
 
 		uint32_t mask;
@@ -1410,6 +1911,12 @@ namespace KlayGE
 		}
 	}
 
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC2::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
 	void TexCompressionBC2::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1429,6 +1936,12 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC2::UseSIMD(bool use)
+	{
+		TexCompression::UseSIMD(use);
+		bc1_codec_.UseSIMD(use);
+	}
+
 
 	TexCompressionBC3::TexCompressionBC3()
 	{
@@ -1456,6 +1969,12 @@ namespace KlayGE
 		bc4_codec_.EncodeBlock(&bc3.alpha, &alpha[0], method);
 	}
 
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC3::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
 	void TexCompressionBC3::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1475,6 +1994,13 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC3::UseSIMD(bool use)
+	{
+		TexCompression::UseSIMD(use);
+		bc1_codec_.UseSIMD(use);
+		bc4_codec_.UseSIMD(use);
+	}
+
 
 	TexCompressionBC4::TexCompressionBC4()
 	{
@@ -1494,12 +2020,22 @@ namespace KlayGE
 
 		// find min/max color
 		int min, max;
-		min = max = r[0];
-
-		for (int i = 1; i < 16; ++ i)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		bool const simd = UseSSE41Kernels(*this);
+		if (simd)
 		{
-			min = std::min<int>(min, r[i]);
-			max = std::max<int>(max, r[i]);
+			MinMaxU8SSE41(min, max, r);
+		}
+		else
+#endif
+		{
+			min = max = r[0];
+
+			for (int i = 1; i < 16; ++ i)
+			{
+				min = std::min<int>(min, r[i]);
+				max = std::max<int>(max, r[i]);
+			}
 		}
 
 		// encode them
@@ -1509,26 +2045,40 @@ namespace KlayGE
 		// determine bias and emit color indices
 		int dist = max - min;
 		int bias = min * 7 - (dist >> 1);
-		int dist4 = dist * 4;
-		int dist2 = dist * 2;
-		int bits = 0, mask = 0;
-
-		int dest = 0;
-		for (int i = 0; i < 16; ++ i)
+		std::array<uint8_t, 16> indices;
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (simd)
 		{
-			int a = r[i] * 7 - bias;
-			int ind, t;
+			BC4IndicesSSE41(&indices[0], r, bias, dist);
+		}
+		else
+#endif
+		{
+			int dist4 = dist * 4;
+			int dist2 = dist * 2;
+			for (int i = 0; i < 16; ++ i)
+			{
+				int a = r[i] * 7 - bias;
+				int ind, t;
+
+				// select index (hooray for bit magic)
+				t = (dist4 - a) >> 31;  ind = t & 4; a -= dist4 & t;
+				t = (dist2 - a) >> 31;  ind += t & 2; a -= dist2 & t;
+				t = (dist - a) >> 31;   ind += t & 1;
 
-			// select index (hooray for bit magic)
-			t = (dist4 - a) >> 31;  ind = t & 4; a -= dist4 & t;
-			t = (dist2 - a) >> 31;  ind += t & 2; a -= dist2 & t;
-			t = (dist - a) >> 31;   ind += t & 1;
+				ind = -ind & 7;
+				ind ^= (2 > ind);
 
-			ind = -ind & 7;
-			ind ^= (2 > ind);
+				indices[i] = static_cast<uint8_t>(ind);
+			}
+		}
 
+		int bits = 0, mask = 0;
+		int dest = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
 			// write index
-			mask |= ind << bits;
+			mask |= indices[i] << bits;
 			if ((bits += 3) >= 8)
 			{
 				bc4.bitmap[dest] = static_cast<uint8_t>(mask);
@@ -1539,6 +2089,12 @@ namespace KlayGE
 		}
 	}
 
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC4::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
 	void TexCompressionBC4::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1571,12 +2127,30 @@ namespace KlayGE
 			alpha[7] = 255;
 		}
 
-		for (int i = 0; i < 2; ++ i)
+#ifdef KLAYGE_BC_SSE4_1_KERNELS
+		if (UseSSE41Kernels(*this))
 		{
-			uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
-			for (int j = 0; j < 8; ++ j)
+			std::array<uint8_t, 16> indices;
+			for (int i = 0; i < 2; ++ i)
 			{
-				alpha_block[i * 8 + j] = alpha[(alpha32 >> (j * 3)) & 0x7];
+				uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
+				for (int j = 0; j < 8; ++ j)
+				{
+					indices[i * 8 + j] = (alpha32 >> (j * 3)) & 0x7;
+				}
+			}
+			LookupBC4SSE41(alpha_block, &alpha[0], &indices[0]);
+		}
+		else
+#endif
+		{
+			for (int i = 0; i < 2; ++ i)
+			{
+				uint32_t alpha32 = (bc4.bitmap[i * 3 + 2] << 16) | (bc4.bitmap[i * 3 + 1] << 8) | (bc4.bitmap[i * 3 + 0] << 0);
+				for (int j = 0; j < 8; ++ j)
+				{
+					alpha_block[i * 8 + j] = alpha[(alpha32 >> (j * 3)) & 0x7];
+				}
 			}
 		}
 	}
@@ -1607,6 +2181,12 @@ namespace KlayGE
 		bc4_codec_.EncodeBlock(&bc5.green, &g[0], method);
 	}
 
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC5::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
 	void TexCompressionBC5::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1626,6 +2206,12 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC5::UseSIMD(bool use)
+	{
+		TexCompression::UseSIMD(use);
+		bc4_codec_.UseSIMD(use);
+	}
+
 
 	// BC6H Compression
 	TexCompressionBC6U::ModeDescriptor const TexCompressionBC6U::mode_desc_[14][82] =
@@ -1889,11 +2475,13 @@ namespace KlayGE
 
 	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		this->EncodeBC6Internal(output, input, method, false);
+	}
 
-		// TODO
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC6U::Clone() const
+	{
+		return TexCompressionPtr();
 	}
 
 	void TexCompressionBC6U::DecodeBlock(void* output, void const * input)
@@ -1901,6 +2489,441 @@ namespace KlayGE
 		this->DecodeBC6Internal(output, input, false);
 	}
 
+	void TexCompressionBC6U::EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		Vector_T<half, 4> const * abgr = static_cast<Vector_T<half, 4> const *>(input);
+
+		std::array<int3, 16> pixels;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			pixels[i] = int3(F162Int(abgr[i].x(), signed_fmt), F162Int(abgr[i].y(), signed_fmt),
+				F162Int(abgr[i].z(), signed_fmt));
+		}
+
+		// Number of two-region shapes tried with every mode, and number of least square refinements per trial
+		uint32_t num_shapes;
+		uint32_t num_refinements;
+		switch (method)
+		{
+		case TCM_Speed:
+			num_shapes = 1;
+			num_refinements = 0;
+			break;
+
+		case TCM_Balanced:
+			num_shapes = 4;
+			num_refinements = 1;
+			break;
+
+		case TCM_Quality:
+		default:
+			num_shapes = 8;
+			num_refinements = 2;
+			break;
+		}
+
+		// End points are fitted in the unquantized space, so the fit of a shape is shared by all modes.
+		std::array<std::pair<float3, float3>, BC6_MAX_REGIONS> one_region_end_pts;
+		FitBC6EndPoints(one_region_end_pts[0], pixels.data(), 1, 0, 0, 16, signed_fmt);
+
+		std::array<std::array<std::pair<float3, float3>, BC6_MAX_REGIONS>, BC6_MAX_SHAPES> two_region_end_pts;
+		std::array<std::pair<float, uint32_t>, BC6_MAX_SHAPES> shape_errors;
+		for (uint32_t shape = 0; shape < BC6_MAX_SHAPES; ++ shape)
+		{
+			float error = 0;
+			for (uint32_t p = 0; p < 2; ++ p)
+			{
+				error += FitBC6EndPoints(two_region_end_pts[shape][p], pixels.data(), 2, shape, p, 8, signed_fmt);
+			}
+			shape_errors[shape] = std::make_pair(error, shape);
+		}
+		std::partial_sort(shape_errors.begin(), shape_errors.begin() + num_shapes, shape_errors.end());
+
+		float best_error = std::numeric_limits<float>::max();
+		std::array<uint8_t, 16> best_block;
+		for (uint32_t mode_index = 0; (mode_index < std::size(mode_info_)) && (best_error > 0); ++ mode_index)
+		{
+			ModeInfo const & info = mode_info_[mode_index];
+			uint32_t const num_trials = (info.partitions > 1) ? num_shapes : 1;
+			for (uint32_t trial = 0; trial < num_trials; ++ trial)
+			{
+				uint32_t const shape = (info.partitions > 1) ? shape_errors[trial].second : 0;
+				auto const & end_pts = (info.partitions > 1) ? two_region_end_pts[shape] : one_region_end_pts;
+
+				std::array<uint8_t, 16> block;
+				float const error = this->EncodeBC6Mode(block.data(), mode_index, shape, end_pts.data(), pixels.data(),
+					num_refinements, signed_fmt);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_block = block;
+				}
+			}
+		}
+
+		// Mode 11 (one region, 10-bit absolute end points) always fits, so a block has been found
+		BOOST_ASSERT(best_error < std::numeric_limits<float>::max());
+		memcpy(output, best_block.data(), best_block.size());
+	}
+
+	float TexCompressionBC6U::EncodeBC6Mode(void* output, uint32_t mode_index, uint32_t shape,
+		std::pair<float3, float3> const * end_pts, int3 const * pixels, uint32_t num_refinements, bool signed_fmt)
+	{
+		ModeInfo const & info = mode_info_[mode_index];
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+		int const * weights = BC67_PREC_WEIGHTS[1 + (1 == info.partitions)];
+		int const min_value = signed_fmt ? -0x7BFF : 0;
+		int const max_value = 0x7BFF;
+
+		std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> q_end_pts;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			q_end_pts[p].first = this->QuantizeEndPoint(end_pts[p].first, prec, signed_fmt);
+			q_end_pts[p].second = this->QuantizeEndPoint(end_pts[p].second, prec, signed_fmt);
+		}
+
+		float best_error = std::numeric_limits<float>::max();
+		std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> best_end_pts;
+		std::array<uint8_t, BC6_MAX_INDICES> best_indices;
+		for (uint32_t iter = 0; iter <= num_refinements; ++ iter)
+		{
+			std::array<uint8_t, BC6_MAX_INDICES> indices;
+			float const error = this->AssignBC6Indices(indices.data(), q_end_pts.data(), info, shape, pixels, signed_fmt);
+			if (error < best_error)
+			{
+				auto stored_end_pts = q_end_pts;
+				auto stored_indices = indices;
+				this->FixAnchorIndices(stored_end_pts.data(), stored_indices.data(), info, shape);
+				if (this->TransformForward(stored_end_pts.data(), info))
+				{
+					best_error = error;
+					best_end_pts = stored_end_pts;
+					best_indices = stored_indices;
+				}
+			}
+
+			if ((iter == num_refinements) || (0 == error))
+			{
+				break;
+			}
+
+			// Least square fit of the end points to the current index assignment
+			bool changed = false;
+			for (uint32_t p = 0; p < info.partitions; ++ p)
+			{
+				float a11 = 0, a12 = 0, a22 = 0;
+				float3 b1(0, 0, 0), b2(0, 0, 0);
+				for (uint32_t i = 0; i < 16; ++ i)
+				{
+					if (GetPartition(info.partitions, shape, i) == p)
+					{
+						float const w = weights[indices[i]] / static_cast<float>(BC6_WEIGHT_MAX);
+						float3 const pt(static_cast<float>(pixels[i].x()), static_cast<float>(pixels[i].y()),
+							static_cast<float>(pixels[i].z()));
+						a11 += (1 - w) * (1 - w);
+						a12 += (1 - w) * w;
+						a22 += w * w;
+						b1 += pt * (1 - w);
+						b2 += pt * w;
+					}
+				}
+
+				float const det = a11 * a22 - a12 * a12;
+				if (std::abs(det) > 1e-6f)
+				{
+					float3 first = (b1 * a22 - b2 * a12) / det;
+					float3 second = (b2 * a11 - b1 * a12) / det;
+					for (uint32_t ch = 0; ch < 3; ++ ch)
+					{
+						first[ch] = MathLib::clamp(first[ch], static_cast<float>(min_value), static_cast<float>(max_value));
+						second[ch] = MathLib::clamp(second[ch], static_cast<float>(min_value), static_cast<float>(max_value));
+					}
+
+					int3 const q_first = this->QuantizeEndPoint(first, prec, signed_fmt);
+					int3 const q_second = this->QuantizeEndPoint(second, prec, signed_fmt);
+					if ((q_first != q_end_pts[p].first) || (q_second != q_end_pts[p].second))
+					{
+						q_end_pts[p].first = q_first;
+						q_end_pts[p].second = q_second;
+						changed = true;
+					}
+				}
+			}
+			if (!changed)
+			{
+				break;
+			}
+		}
+
+		if (best_error < std::numeric_limits<float>::max())
+		{
+			this->PackBC6Block(output, mode_index, shape, best_end_pts.data(), best_indices.data());
+		}
+		return best_error;
+	}
+
+	float TexCompressionBC6U::AssignBC6Indices(uint8_t* indices, std::pair<int3, int3> const * end_pts,
+		ModeInfo const & info, uint32_t shape, int3 const * pixels, bool signed_fmt)
+	{
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+		uint32_t const num_indices = 1U << info.index_prec;
+		int const * weights = BC67_PREC_WEIGHTS[1 + (1 == info.partitions)];
+
+		// Same arithmetic as DecodeBC6Internal, so the error is exactly what the decoder produces
+		std::array<std::array<int3, 16>, BC6_MAX_REGIONS> palettes;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			int const r1 = this->Unquantize(end_pts[p].first.x(), prec.r(), signed_fmt);
+			int const g1 = this->Unquantize(end_pts[p].first.y(), prec.g(), signed_fmt);
+			int const b1 = this->Unquantize(end_pts[p].first.z(), prec.b(), signed_fmt);
+			int const r2 = this->Unquantize(end_pts[p].second.x(), prec.r(), signed_fmt);
+			int const g2 = this->Unquantize(end_pts[p].second.y(), prec.g(), signed_fmt);
+			int const b2 = this->Unquantize(end_pts[p].second.z(), prec.b(), signed_fmt);
+			for (uint32_t k = 0; k < num_indices; ++ k)
+			{
+				int const w = weights[k];
+				palettes[p][k].x() = this->FinishUnquantize((r1 * (BC6_WEIGHT_MAX - w) + r2 * w + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT,
+					signed_fmt);
+				palettes[p][k].y() = this->FinishUnquantize((g1 * (BC6_WEIGHT_MAX - w) + g2 * w + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT,
+					signed_fmt);
+				palettes[p][k].z() = this->FinishUnquantize((b1 * (BC6_WEIGHT_MAX - w) + b2 * w + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT,
+					signed_fmt);
+			}
+		}
+
+		float total_error = 0;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			auto const & palette = palettes[GetPartition(info.partitions, shape, i)];
+
+			float best_error = std::numeric_limits<float>::max();
+			for (uint32_t k = 0; k < num_indices; ++ k)
+			{
+				float const dr = static_cast<float>(palette[k].x() - pixels[i].x());
+				float const dg = static_cast<float>(palette[k].y() - pixels[i].y());
+				float const db = static_cast<float>(palette[k].z() - pixels[i].z());
+				float const error = dr * dr + dg * dg + db * db;
+				if (error < best_error)
+				{
+					best_error = error;
+					indices[i] = static_cast<uint8_t>(k);
+				}
+			}
+			total_error += best_error;
+		}
+
+		return total_error;
+	}
+
+	void TexCompressionBC6U::FixAnchorIndices(std::pair<int3, int3>* end_pts, uint8_t* indices, ModeInfo const & info,
+		uint32_t shape)
+	{
+		// The MSB of each region's anchor index is implicitly 0. Swapping the end points of a region mirrors its
+		// indices without changing the decoded colors, since the weights are symmetric.
+		uint32_t const num_indices = 1U << info.index_prec;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			uint32_t anchor = 0;
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				if ((GetPartition(info.partitions, shape, i) == p) && IsFixUpOffset(info.partitions, shape, i))
+				{
+					anchor = i;
+					break;
+				}
+			}
+
+			if (indices[anchor] >= num_indices / 2)
+			{
+				std::swap(end_pts[p].first, end_pts[p].second);
+				for (uint32_t i = 0; i < 16; ++ i)
+				{
+					if (GetPartition(info.partitions, shape, i) == p)
+					{
+						indices[i] = static_cast<uint8_t>(num_indices - 1 - indices[i]);
+					}
+				}
+			}
+		}
+	}
+
+	bool TexCompressionBC6U::TransformForward(std::pair<int3, int3>* end_pts, ModeInfo const & info)
+	{
+		if (!info.transformed)
+		{
+			return true;
+		}
+
+		auto fits = [](int3 const & delta, ARGBColor32 const & prec)
+		{
+			for (uint32_t ch = 0; ch < 3; ++ ch)
+			{
+				uint8_t const bits = (0 == ch) ? prec.r() : ((1 == ch) ? prec.g() : prec.b());
+				int const min_delta = -(1 << (bits - 1));
+				int const max_delta = (1 << (bits - 1)) - 1;
+				if ((delta[ch] < min_delta) || (delta[ch] > max_delta))
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		int3 const base = end_pts[0].first;
+		end_pts[0].second -= base;
+		if (!fits(end_pts[0].second, info.rgba_prec[0][1]))
+		{
+			return false;
+		}
+		if (info.partitions > 1)
+		{
+			end_pts[1].first -= base;
+			end_pts[1].second -= base;
+			if (!fits(end_pts[1].first, info.rgba_prec[1][0]) || !fits(end_pts[1].second, info.rgba_prec[1][1]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void TexCompressionBC6U::PackBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+		std::pair<int3, int3> const * end_pts, uint8_t const * indices)
+	{
+		ModeInfo const & info = mode_info_[mode_index];
+		ModeDescriptor const * desc = mode_desc_[mode_index];
+
+		memset(output, 0, 16);
+
+		size_t start_bit = 0;
+		size_t const header_bits = info.partitions > 1 ? 82 : 65;
+		while (start_bit < header_bits)
+		{
+			int val;
+			switch (desc[start_bit].field)
+			{
+			case M:
+				val = info.mode;
+				break;
+			case D:
+				val = shape;
+				break;
+			case RW:
+				val = end_pts[0].first.x();
+				break;
+			case RX:
+				val = end_pts[0].second.x();
+				break;
+			case RY:
+				val = end_pts[1].first.x();
+				break;
+			case RZ:
+				val = end_pts[1].second.x();
+				break;
+			case GW:
+				val = end_pts[0].first.y();
+				break;
+			case GX:
+				val = end_pts[0].second.y();
+				break;
+			case GY:
+				val = end_pts[1].first.y();
+				break;
+			case GZ:
+				val = end_pts[1].second.y();
+				break;
+			case BW:
+				val = end_pts[0].first.z();
+				break;
+			case BX:
+				val = end_pts[0].second.z();
+				break;
+			case BY:
+				val = end_pts[1].first.z();
+				break;
+			case BZ:
+				val = end_pts[1].second.z();
+				break;
+
+			default:
+				val = 0;
+				break;
+			}
+
+			WriteBit(output, start_bit, static_cast<uint8_t>((val >> desc[start_bit].bit) & 1));
+		}
+
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			size_t const num_bits = IsFixUpOffset(info.partitions, shape, i) ? info.index_prec - 1 : info.index_prec;
+			WriteBits(output, start_bit, num_bits, indices[i]);
+		}
+		BOOST_ASSERT(128 == start_bit);
+	}
+
+	int TexCompressionBC6U::Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt)
+	{
+		// Inverse of Unquantize + FinishUnquantize. Start from the closed form estimate and pick the best neighbor.
+		bool const negative = signed_fmt && (comp < 0);
+		int const magnitude = MathLib::clamp(negative ? -comp : comp, 0, 0x7BFF);
+
+		int estimate;
+		int max_q;
+		if (signed_fmt)
+		{
+			int const unq = (magnitude * 32 + 15) / 31;
+			if (bits_per_comp >= 16)
+			{
+				estimate = unq;
+				max_q = 0x7FFF;
+			}
+			else
+			{
+				estimate = (unq << (bits_per_comp - 1)) >> 15;
+				max_q = (1 << (bits_per_comp - 1)) - 1;
+			}
+		}
+		else
+		{
+			int const unq = (magnitude * 64 + 30) / 31;
+			if (bits_per_comp >= 15)
+			{
+				estimate = unq;
+				max_q = 0xFFFF;
+			}
+			else
+			{
+				estimate = (unq << bits_per_comp) >> 16;
+				max_q = (1 << bits_per_comp) - 1;
+			}
+		}
+
+		int best_q = 0;
+		int best_diff = std::numeric_limits<int>::max();
+		for (int q = std::max(estimate - 1, 0); q <= std::min(estimate + 1, max_q); ++ q)
+		{
+			int const diff = std::abs(this->FinishUnquantize(this->Unquantize(q, bits_per_comp, signed_fmt), signed_fmt) - magnitude);
+			if (diff < best_diff)
+			{
+				best_diff = diff;
+				best_q = q;
+			}
+		}
+
+		return negative ? -best_q : best_q;
+	}
+
+	int3 TexCompressionBC6U::QuantizeEndPoint(float3 const & pt, ARGBColor32 const & prec, bool signed_fmt)
+	{
+		return int3(this->Quantize(static_cast<int>(MathLib::round(pt.x())), prec.r(), signed_fmt),
+			this->Quantize(static_cast<int>(MathLib::round(pt.y())), prec.g(), signed_fmt),
+			this->Quantize(static_cast<int>(MathLib::round(pt.z())), prec.b(), signed_fmt));
+	}
+
 	void TexCompressionBC6U::DecodeBC6Internal(void* output, void const * input, bool signed_fmt)
 	{
 		BOOST_ASSERT(output);
@@ -2140,11 +3163,13 @@ namespace KlayGE
 
 	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		bc6u_codec_.EncodeBC6Internal(output, input, method, true);
+	}
 
-		// TODO
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionBC6S::Clone() const
+	{
+		return TexCompressionPtr();
 	}
 
 	void TexCompressionBC6S::DecodeBlock(void* output, void const * input)
@@ -2204,6 +3229,11 @@ namespace KlayGE
 			return;
 		}
 
+		{
+			uint8_t const * pixel_bytes = static_cast<uint8_t const *>(input);
+			sa_gen_.seed(static_cast<uint32_t>(HashRange(pixel_bytes, pixel_bytes + 16 * sizeof(ARGBColor32))));
+		}
+
 		TexCompressionErrorMetric metric = TCEM_Uniform;
 		int sa_steps;
 		switch (method)
@@ -2278,6 +3308,11 @@ namespace KlayGE
 		this->PackBC7Block(best_mode, best_params, output);
 	}
 
+	TexCompressionPtr TexCompressionBC7::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionBC7>();
+	}
+
 	void TexCompressionBC7::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -2888,7 +3923,7 @@ namespace KlayGE
 		{
 			float4 const & p = pt ? p1 : p2;
 			float4& np = pt ? np1 : np2;
-			uint32_t const rdir = IntRand() & 0xF;
+			uint32_t const rdir = IntRand(sa_gen_) & 0xF;
 
 			np = p;
 			if (has_pbits)
@@ -2921,7 +3956,7 @@ namespace KlayGE
 		}
 
 		size_t const p = static_cast<size_t>(exp(0.1f * static_cast<int64_t>(old_err - new_err) / temp) * RAND_MAX);
-		size_t const r = IntRand();
+		size_t const r = IntRand(sa_gen_);
 
 		return r < p;
 	}
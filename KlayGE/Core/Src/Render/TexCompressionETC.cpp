@@ -35,6 +35,9 @@
 #include <KFL/Color.hpp>
 #include <KlayGE/Texture.hpp>
 
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <vector>
 #include <cstring>
 #include <boost/assert.hpp>
@@ -501,6 +504,333 @@ namespace
 
 		return cur_ind;
 	}
+
+	int const etc2_distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+	uint32_t const ETC2_MAX_TH_CANDIDATES = 8;
+
+	int const eac_modifier_table[16][8] =
+	{
+		{ -3, -6, -9, -15, 2, 5, 8, 14 },
+		{ -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 },
+		{ -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 },
+		{ -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 },
+		{ -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },
+		{ -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },
+		{ -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },
+		{ -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },
+		{ -3, -5, -7, -9, 2, 4, 6, 8 }
+	};
+
+	// Channel-separated copy of a 4x4 block, so the inner loops of the ETC2 mode searches run over plain arrays.
+	struct ETC2BlockPixels
+	{
+		int r[16];
+		int g[16];
+		int b[16];
+		bool opaque[16];
+		uint32_t num_opaque;
+	};
+
+	void LoadETC2BlockPixels(ETC2BlockPixels& pixels, ARGBColor32 const * argb, bool alpha)
+	{
+		pixels.num_opaque = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
+			pixels.r[i] = argb[i].r();
+			pixels.g[i] = argb[i].g();
+			pixels.b[i] = argb[i].b();
+			pixels.opaque[i] = !alpha || (argb[i].a() >= 128);
+			if (pixels.opaque[i])
+			{
+				++ pixels.num_opaque;
+			}
+		}
+	}
+
+	void ETC2SearchParams(TexCompressionMethod method, uint32_t& num_candidates, uint32_t& num_refinements)
+	{
+		switch (method)
+		{
+		case TCM_Speed:
+			num_candidates = 1;
+			num_refinements = 0;
+			break;
+
+		case TCM_Balanced:
+			num_candidates = 4;
+			num_refinements = 1;
+			break;
+
+		default:
+			num_candidates = ETC2_MAX_TH_CANDIDATES;
+			num_refinements = 2;
+			break;
+		}
+	}
+
+	// Chooses the closest palette entry for the pixels in pixel_mask. Under punch-through alpha, entry 2 is transparent.
+	uint64_t ETC2PaletteIndices(uint8_t* indices, ETC2BlockPixels const & pixels, int const (&palette)[4][3],
+		bool alpha, uint32_t pixel_mask = 0xFFFF)
+	{
+		uint64_t error = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
+			if (pixel_mask & (1UL << i))
+			{
+				if (!pixels.opaque[i])
+				{
+					indices[i] = 2;
+				}
+				else
+				{
+					uint32_t best_pixel_error = std::numeric_limits<uint32_t>::max();
+					for (int j = 0; j < 4; ++ j)
+					{
+						if (!alpha || (j != 2))
+						{
+							int const dr = palette[j][0] - pixels.r[i];
+							int const dg = palette[j][1] - pixels.g[i];
+							int const db = palette[j][2] - pixels.b[i];
+							uint32_t const pixel_error = dr * dr + dg * dg + db * db;
+							if (pixel_error < best_pixel_error)
+							{
+								best_pixel_error = pixel_error;
+								indices[i] = static_cast<uint8_t>(j);
+							}
+						}
+					}
+					error += best_pixel_error;
+				}
+			}
+		}
+		return error;
+	}
+
+	void PackETC2Indices(uint16_t& msb, uint16_t& lsb, uint8_t const * indices)
+	{
+		msb = 0;
+		lsb = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
+			int const bit_index = ((i & 3) * 4 + (i >> 2)) ^ 0x8;
+			msb |= static_cast<uint16_t>((indices[i] >> 1) << bit_index);
+			lsb |= static_cast<uint16_t>((indices[i] & 1) << bit_index);
+		}
+	}
+
+	void ETC2OffsetColor(int (&clr)[3], int const * base, int offset)
+	{
+		for (int c = 0; c < 3; ++ c)
+		{
+			clr[c] = MathLib::clamp(base[c] + offset, 0, 255);
+		}
+	}
+
+	int QuantizeETC2Color4(float c)
+	{
+		return MathLib::clamp(static_cast<int>(c * 15 / 255 + 0.5f), 0, 15);
+	}
+
+	uint32_t PackedETC2Color4(int const * clr)
+	{
+		return (clr[0] << 8) | (clr[1] << 4) | clr[2];
+	}
+
+	// Splits the opaque pixels in two along their principal axis. The splits with the least variance become
+	// the candidate 4-bit color pairs of T and H modes.
+	uint32_t ETC2THPartitions(int (*colors)[2][3], uint32_t max_candidates, ETC2BlockPixels const & pixels)
+	{
+		uint32_t const n = pixels.num_opaque;
+		if (n == 0)
+		{
+			memset(colors[0], 0, sizeof(colors[0]));
+			return 1;
+		}
+
+		uint32_t order[16];
+		float3 mean(0, 0, 0);
+		for (uint32_t i = 0, j = 0; i < 16; ++ i)
+		{
+			if (pixels.opaque[i])
+			{
+				order[j] = i;
+				++ j;
+				mean += float3(static_cast<float>(pixels.r[i]), static_cast<float>(pixels.g[i]), static_cast<float>(pixels.b[i]));
+			}
+		}
+		mean /= static_cast<float>(n);
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (uint32_t j = 0; j < n; ++ j)
+		{
+			uint32_t const i = order[j];
+			float const r = pixels.r[i] - mean.x();
+			float const g = pixels.g[i] - mean.y();
+			float const b = pixels.b[i] - mean.z();
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		float3 axis(1, 1, 1);
+		for (int iter = 0; iter < 4; ++ iter)
+		{
+			float3 const t(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+				cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+				cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+			float const len = MathLib::length(t);
+			if (len < 1e-6f)
+			{
+				break;
+			}
+			axis = t / len;
+		}
+
+		float proj[16];
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			proj[i] = pixels.r[i] * axis.x() + pixels.g[i] * axis.y() + pixels.b[i] * axis.z();
+		}
+		std::sort(order, order + n,
+			[&proj](uint32_t lhs, uint32_t rhs)
+			{
+				return proj[lhs] < proj[rhs];
+			});
+
+		if (n == 1)
+		{
+			uint32_t const i = order[0];
+			colors[0][0][0] = colors[0][1][0] = QuantizeETC2Color4(static_cast<float>(pixels.r[i]));
+			colors[0][0][1] = colors[0][1][1] = QuantizeETC2Color4(static_cast<float>(pixels.g[i]));
+			colors[0][0][2] = colors[0][1][2] = QuantizeETC2Color4(static_cast<float>(pixels.b[i]));
+			return 1;
+		}
+
+		// Prefix sums along the sorted order give the squared error of every split in O(1).
+		int sum[17][3];
+		uint32_t sum_sq = 0;
+		sum[0][0] = sum[0][1] = sum[0][2] = 0;
+		for (uint32_t j = 0; j < n; ++ j)
+		{
+			uint32_t const i = order[j];
+			sum[j + 1][0] = sum[j][0] + pixels.r[i];
+			sum[j + 1][1] = sum[j][1] + pixels.g[i];
+			sum[j + 1][2] = sum[j][2] + pixels.b[i];
+			sum_sq += pixels.r[i] * pixels.r[i] + pixels.g[i] * pixels.g[i] + pixels.b[i] * pixels.b[i];
+		}
+
+		float split_error[16];
+		uint32_t splits[16];
+		uint32_t const num_splits = n - 1;
+		for (uint32_t k = 1; k < n; ++ k)
+		{
+			float e = static_cast<float>(sum_sq);
+			for (int c = 0; c < 3; ++ c)
+			{
+				float const s0 = static_cast<float>(sum[k][c]);
+				float const s1 = static_cast<float>(sum[n][c] - sum[k][c]);
+				e -= s0 * s0 / k + s1 * s1 / (n - k);
+			}
+			split_error[k] = e;
+			splits[k - 1] = k;
+		}
+		uint32_t const num_candidates = std::min(max_candidates, num_splits);
+		std::partial_sort(splits, splits + num_candidates, splits + num_splits,
+			[&split_error](uint32_t lhs, uint32_t rhs)
+			{
+				return split_error[lhs] < split_error[rhs];
+			});
+
+		for (uint32_t j = 0; j < num_candidates; ++ j)
+		{
+			uint32_t const k = splits[j];
+			for (int c = 0; c < 3; ++ c)
+			{
+				colors[j][0][c] = QuantizeETC2Color4(static_cast<float>(sum[k][c]) / k);
+				colors[j][1][c] = QuantizeETC2Color4(static_cast<float>(sum[n][c] - sum[k][c]) / (n - k));
+			}
+		}
+		return num_candidates;
+	}
+
+	// Re-centers a 4-bit color on the pixels using the given palette entries, after removing each entry's offset.
+	bool RefineETC2Color4(int (&clr)[3], ETC2BlockPixels const & pixels, uint8_t const * indices,
+		uint32_t index_mask, int const * offsets)
+	{
+		int sum[3] = { 0, 0, 0 };
+		int count = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
+			if (pixels.opaque[i] && (index_mask & (1UL << indices[i])))
+			{
+				sum[0] += pixels.r[i] - offsets[indices[i]];
+				sum[1] += pixels.g[i] - offsets[indices[i]];
+				sum[2] += pixels.b[i] - offsets[indices[i]];
+				++ count;
+			}
+		}
+		if (count == 0)
+		{
+			return false;
+		}
+
+		bool changed = false;
+		for (int c = 0; c < 3; ++ c)
+		{
+			int const q = QuantizeETC2Color4(static_cast<float>(sum[c]) / count);
+			changed |= (q != clr[c]);
+			clr[c] = q;
+		}
+		return changed;
+	}
+
+	// T, H and planar modes hide in an invalid differential mode: the free bits 7..5 and 2 of the byte are set
+	// so that base + delta overflows 5 bits.
+	uint8_t ForceETC2Overflow(uint8_t v)
+	{
+		int const a = (v >> 3) & 0x3;
+		int const b = v & 0x3;
+		return static_cast<uint8_t>((a + b >= 4) ? (v | 0xE0) : (v | 0x04));
+	}
+
+	// The opposite. The free bit 7 of the byte is set if needed to keep base + delta in 5 bits.
+	uint8_t AvoidETC2Overflow(uint8_t v)
+	{
+		int const base = v >> 3;
+		int const delta = v & 0x7;
+		return static_cast<uint8_t>((base - (delta & 0x4) + (delta & 0x3) < 0) ? (v | 0x80) : v);
+	}
+
+	uint64_t ETC2DecodedError(ARGBColor32 const * decoded, ARGBColor32 const * argb, bool alpha)
+	{
+		uint64_t error = 0;
+		for (int i = 0; i < 16; ++ i)
+		{
+			bool const opaque = !alpha || (argb[i].a() >= 128);
+			if (opaque != (decoded[i].a() != 0))
+			{
+				error += 4 * 255 * 255;
+			}
+			else if (opaque)
+			{
+				int const dr = decoded[i].r() - argb[i].r();
+				int const dg = decoded[i].g() - argb[i].g();
+				int const db = decoded[i].b() - argb[i].b();
+				error += dr * dr + dg * dg + db * db;
+			}
+		}
+		return error;
+	}
 }
 
 namespace KlayGE
@@ -938,6 +1268,11 @@ namespace KlayGE
 		return best_err;
 	}
 
+	TexCompressionPtr TexCompressionETC1::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC1>();
+	}
+
 	void TexCompressionETC1::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1030,7 +1365,8 @@ namespace KlayGE
 				int modifier;
 				if (alpha)
 				{
-					modifier = (mod & 0x1) ? GetModifier(cw, mod) : 0;
+					// Punch-through alpha drops the small modifiers, pixel index 2 becomes transparent
+					modifier = ((1 == mod) || (2 == mod)) ? 0 : GetModifier(cw, mod);
 				}
 				else
 				{
@@ -1824,11 +2160,315 @@ namespace KlayGE
 
 	void TexCompressionETC2RGB8::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		ETC2Block& etc2 = *static_cast<ETC2Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+
+		ARGBColor32 decoded[16];
+
+		etc1_codec_->EncodeETC1BlockInternal(etc2.etc1, argb, method);
+		this->DecodeBlock(decoded, &etc2);
+		uint64_t best_error = ETC2DecodedError(decoded, argb, false);
+		if (best_error > 0)
+		{
+			ETC2Block candidates[3];
+			this->EncodeETCTModeInternal(candidates[0].etc2_t_mode, argb, false, method);
+			this->EncodeETCHModeInternal(candidates[1].etc2_h_mode, argb, false, method);
+			this->EncodeETCPlanarModeInternal(candidates[2].etc2_planar_mode, argb, method);
+
+			// Errors are measured on the decoded candidates, so the choice can't be fooled by a mode's own estimate.
+			for (auto const & candidate : candidates)
+			{
+				this->DecodeBlock(decoded, &candidate);
+				uint64_t const error = ETC2DecodedError(decoded, argb, false);
+				if (error < best_error)
+				{
+					best_error = error;
+					etc2 = candidate;
+				}
+			}
+		}
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCTModeInternal(ETC2TModeBlock& etc2, ARGBColor32 const * argb, bool alpha,
+		TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(argb);
+
+		ETC2BlockPixels pixels;
+		LoadETC2BlockPixels(pixels, argb, alpha);
+
+		uint32_t max_candidates;
+		uint32_t num_refinements;
+		ETC2SearchParams(method, max_candidates, num_refinements);
+
+		int candidates[ETC2_MAX_TH_CANDIDATES][2][3];
+		uint32_t const num_candidates = ETC2THPartitions(candidates, max_candidates, pixels);
+
+		uint64_t best_error = std::numeric_limits<uint64_t>::max();
+		int best_clr[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		int best_d = 0;
+		uint8_t best_indices[16] = { 0 };
+		for (uint32_t cand = 0; cand < num_candidates; ++ cand)
+		{
+			// Either cluster can be the lone color c1, the other one gets the c2 +/- d "paint" colors.
+			for (int swap = 0; swap < 2; ++ swap)
+			{
+				int clr[2][3];
+				memcpy(clr[0], candidates[cand][swap], sizeof(clr[0]));
+				memcpy(clr[1], candidates[cand][!swap], sizeof(clr[1]));
+
+				for (uint32_t iter = 0; iter <= num_refinements; ++ iter)
+				{
+					int const base1[] = { Extend4To8Bits(clr[0][0]), Extend4To8Bits(clr[0][1]), Extend4To8Bits(clr[0][2]) };
+					int const base2[] = { Extend4To8Bits(clr[1][0]), Extend4To8Bits(clr[1][1]), Extend4To8Bits(clr[1][2]) };
+
+					uint64_t iter_error = std::numeric_limits<uint64_t>::max();
+					int iter_d = 0;
+					uint8_t iter_indices[16] = { 0 };
+					for (int d = 0; d < 8; ++ d)
+					{
+						int const distance = etc2_distance_table[d];
+						int palette[4][3];
+						ETC2OffsetColor(palette[0], base1, 0);
+						ETC2OffsetColor(palette[1], base2, distance);
+						ETC2OffsetColor(palette[2], base2, 0);
+						ETC2OffsetColor(palette[3], base2, -distance);
+
+						uint8_t indices[16];
+						uint64_t const error = ETC2PaletteIndices(indices, pixels, palette, alpha);
+						if (error < iter_error)
+						{
+							iter_error = error;
+							iter_d = d;
+							memcpy(iter_indices, indices, sizeof(indices));
+						}
+					}
+
+					if (iter_error < best_error)
+					{
+						best_error = iter_error;
+						memcpy(best_clr, clr, sizeof(clr));
+						best_d = iter_d;
+						memcpy(best_indices, iter_indices, sizeof(iter_indices));
+					}
+
+					if (iter < num_refinements)
+					{
+						int const distance = etc2_distance_table[iter_d];
+						int const offsets[] = { 0, distance, 0, -distance };
+						bool changed = RefineETC2Color4(clr[0], pixels, iter_indices, 1UL << 0, offsets);
+						changed |= RefineETC2Color4(clr[1], pixels, iter_indices, (1UL << 1) | (1UL << 2) | (1UL << 3), offsets);
+						if (!changed)
+						{
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		int const r1 = best_clr[0][0];
+		etc2.r1 = ForceETC2Overflow(static_cast<uint8_t>(((r1 >> 2) << 3) | (r1 & 0x3)));
+		etc2.g1_b1 = static_cast<uint8_t>((best_clr[0][1] << 4) | best_clr[0][2]);
+		etc2.r2_g2 = static_cast<uint8_t>((best_clr[1][0] << 4) | best_clr[1][1]);
+		etc2.b2_d = static_cast<uint8_t>((best_clr[1][2] << 4) | ((best_d >> 1) << 2) | (alpha ? 0 : 0x2) | (best_d & 0x1));
+		PackETC2Indices(etc2.msb, etc2.lsb, best_indices);
+
+		return best_error;
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCHModeInternal(ETC2HModeBlock& etc2, ARGBColor32 const * argb, bool alpha,
+		TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(argb);
+
+		ETC2BlockPixels pixels;
+		LoadETC2BlockPixels(pixels, argb, alpha);
+
+		uint32_t max_candidates;
+		uint32_t num_refinements;
+		ETC2SearchParams(method, max_candidates, num_refinements);
+
+		int candidates[ETC2_MAX_TH_CANDIDATES][2][3];
+		uint32_t const num_candidates = ETC2THPartitions(candidates, max_candidates, pixels);
+
+		uint64_t best_error = std::numeric_limits<uint64_t>::max();
+		int best_clr[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		int best_d = 1;
+		uint8_t best_indices[16] = { 0 };
+		for (uint32_t cand = 0; cand < num_candidates; ++ cand)
+		{
+			int clr[2][3];
+			memcpy(clr, candidates[cand], sizeof(clr));
+
+			for (uint32_t iter = 0; iter <= num_refinements; ++ iter)
+			{
+				uint64_t iter_error = std::numeric_limits<uint64_t>::max();
+				int iter_clr[2][3];
+				int iter_d = 1;
+				uint8_t iter_indices[16] = { 0 };
+				for (int d = 0; d < 8; ++ d)
+				{
+					// The LSB of the distance index is the ordering of the two base colors, not stored.
+					uint32_t const packed0 = PackedETC2Color4(clr[0]);
+					uint32_t const packed1 = PackedETC2Color4(clr[1]);
+					if ((packed0 == packed1) && !(d & 1))
+					{
+						continue;
+					}
+					int const first = ((packed0 >= packed1) == static_cast<bool>(d & 1)) ? 0 : 1;
+					int const * c1 = clr[first];
+					int const * c2 = clr[!first];
+
+					int const base1[] = { Extend4To8Bits(c1[0]), Extend4To8Bits(c1[1]), Extend4To8Bits(c1[2]) };
+					int const base2[] = { Extend4To8Bits(c2[0]), Extend4To8Bits(c2[1]), Extend4To8Bits(c2[2]) };
+
+					int const distance = etc2_distance_table[d];
+					int palette[4][3];
+					ETC2OffsetColor(palette[0], base1, distance);
+					ETC2OffsetColor(palette[1], base1, -distance);
+					ETC2OffsetColor(palette[2], base2, distance);
+					ETC2OffsetColor(palette[3], base2, -distance);
+
+					uint8_t indices[16];
+					uint64_t const error = ETC2PaletteIndices(indices, pixels, palette, alpha);
+					if (error < iter_error)
+					{
+						iter_error = error;
+						memcpy(iter_clr[0], c1, sizeof(iter_clr[0]));
+						memcpy(iter_clr[1], c2, sizeof(iter_clr[1]));
+						iter_d = d;
+						memcpy(iter_indices, indices, sizeof(indices));
+					}
+				}
+
+				if (iter_error < best_error)
+				{
+					best_error = iter_error;
+					memcpy(best_clr, iter_clr, sizeof(iter_clr));
+					best_d = iter_d;
+					memcpy(best_indices, iter_indices, sizeof(iter_indices));
+				}
+
+				if (iter < num_refinements)
+				{
+					memcpy(clr, iter_clr, sizeof(clr));
+
+					int const distance = etc2_distance_table[iter_d];
+					int const offsets[] = { distance, -distance, distance, -distance };
+					bool changed = RefineETC2Color4(clr[0], pixels, iter_indices, (1UL << 0) | (1UL << 1), offsets);
+					changed |= RefineETC2Color4(clr[1], pixels, iter_indices, (1UL << 2) | (1UL << 3), offsets);
+					if (!changed)
+					{
+						break;
+					}
+				}
+			}
+		}
+
+		int const r1 = best_clr[0][0];
+		int const g1 = best_clr[0][1];
+		int const b1 = best_clr[0][2];
+		int const r2 = best_clr[1][0];
+		int const g2 = best_clr[1][1];
+		int const b2 = best_clr[1][2];
+		etc2.r1_g1 = AvoidETC2Overflow(static_cast<uint8_t>((r1 << 3) | (g1 >> 1)));
+		etc2.g1_b1 = ForceETC2Overflow(static_cast<uint8_t>(((g1 & 0x1) << 4) | (b1 & 0x8) | ((b1 >> 1) & 0x3)));
+		etc2.b1_r2_g2 = static_cast<uint8_t>(((b1 & 0x1) << 7) | (r2 << 3) | (g2 >> 1));
+		etc2.g2_b2_d = static_cast<uint8_t>(((g2 & 0x1) << 7) | (b2 << 3) | (best_d & 0x4) | (alpha ? 0 : 0x2) | ((best_d >> 1) & 0x1));
+		PackETC2Indices(etc2.msb, etc2.lsb, best_indices);
+
+		return best_error;
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCPlanarModeInternal(ETC2PlanarModeBlock& etc2, ARGBColor32 const * argb,
+		TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(argb);
+
+		ETC2BlockPixels pixels;
+		LoadETC2BlockPixels(pixels, argb, false);
+
+		int const radius = (TCM_Speed == method) ? 0 : 1;
+
+		uint64_t error = 0;
+		int o[3];
+		int h[3];
+		int v[3];
+		for (int c = 0; c < 3; ++ c)
+		{
+			int const * channel = (0 == c) ? pixels.r : ((1 == c) ? pixels.g : pixels.b);
+
+			// Least squares fit of channel = a + b * x + c * y, then O = a, H = a + 4 * b, V = a + 4 * c.
+			float sum = 0;
+			float sum_x = 0;
+			float sum_y = 0;
+			for (int i = 0; i < 16; ++ i)
+			{
+				sum += channel[i];
+				sum_x += ((i & 3) - 1.5f) * channel[i];
+				sum_y += ((i >> 2) - 1.5f) * channel[i];
+			}
+			float const slope_x = sum_x / 20;
+			float const slope_y = sum_y / 20;
+			float const fo = sum / 16 - 1.5f * (slope_x + slope_y);
+
+			int const bits = (1 == c) ? 7 : 6;
+			int const max_q = (1 << bits) - 1;
+			int const qo = static_cast<int>(MathLib::clamp(fo, 0.0f, 255.0f) * max_q / 255 + 0.5f);
+			int const qh = static_cast<int>(MathLib::clamp(fo + 4 * slope_x, 0.0f, 255.0f) * max_q / 255 + 0.5f);
+			int const qv = static_cast<int>(MathLib::clamp(fo + 4 * slope_y, 0.0f, 255.0f) * max_q / 255 + 0.5f);
+
+			uint32_t best_error = std::numeric_limits<uint32_t>::max();
+			for (int to = std::max(qo - radius, 0); to <= std::min(qo + radius, max_q); ++ to)
+			{
+				int const eo = (7 == bits) ? Extend7To8Bits(to) : Extend6To8Bits(to);
+				for (int th = std::max(qh - radius, 0); th <= std::min(qh + radius, max_q); ++ th)
+				{
+					int const eh = (7 == bits) ? Extend7To8Bits(th) : Extend6To8Bits(th);
+					for (int tv = std::max(qv - radius, 0); tv <= std::min(qv + radius, max_q); ++ tv)
+					{
+						int const ev = (7 == bits) ? Extend7To8Bits(tv) : Extend6To8Bits(tv);
+
+						uint32_t channel_error = 0;
+						for (int i = 0; i < 16; ++ i)
+						{
+							int const x = i & 3;
+							int const y = i >> 2;
+							int const decoded = MathLib::clamp((x * (eh - eo) + y * (ev - eo) + 4 * eo + 2) >> 2, 0, 255);
+							channel_error += (decoded - channel[i]) * (decoded - channel[i]);
+						}
+						if (channel_error < best_error)
+						{
+							best_error = channel_error;
+							o[c] = to;
+							h[c] = th;
+							v[c] = tv;
+						}
+					}
+				}
+			}
+			error += best_error;
+		}
+
+		etc2.ro_go = AvoidETC2Overflow(static_cast<uint8_t>((o[0] << 1) | (o[1] >> 6)));
+		etc2.go_bo = AvoidETC2Overflow(static_cast<uint8_t>(((o[1] & 0x3F) << 1) | (o[2] >> 5)));
+		etc2.bo = ForceETC2Overflow(static_cast<uint8_t>((o[2] & 0x18) | ((o[2] >> 1) & 0x3)));
+		etc2.bo_rh = static_cast<uint8_t>(((o[2] & 0x1) << 7) | ((h[0] >> 1) << 2) | 0x2 | (h[0] & 0x1));
+		etc2.gh_bh = static_cast<uint8_t>((h[1] << 1) | (h[2] >> 5));
+		etc2.bh_rv = static_cast<uint8_t>(((h[2] & 0x1F) << 3) | (v[0] >> 3));
+		etc2.rv_gv = static_cast<uint8_t>(((v[0] & 0x7) << 5) | (v[1] >> 2));
+		etc2.gv_bv = static_cast<uint8_t>(((v[1] & 0x3) << 6) | v[2]);
 
-		// TODO
+		return error;
+	}
+
+	TexCompressionPtr TexCompressionETC2RGB8::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC2RGB8>();
 	}
 
 	void TexCompressionETC2RGB8::DecodeBlock(void* output, void const * input)
@@ -2045,11 +2685,174 @@ namespace KlayGE
 
 	void TexCompressionETC2RGB8A1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
 
-		// TODO
+		ETC2Block& etc2 = *static_cast<ETC2Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+
+		bool alpha = false;
+		for (int i = 0; i < 16; ++ i)
+		{
+			if (argb[i].a() < 128)
+			{
+				alpha = true;
+				break;
+			}
+		}
+
+		// The differential bit is the opaque flag here, so individual mode is out of reach and planar mode can't
+		// have transparent pixels.
+		ETC2Block candidates[5];
+		uint32_t num_candidates = 0;
+		if (!alpha)
+		{
+			etc1_codec_->EncodeETC1BlockInternal(candidates[num_candidates].etc1, argb, method);
+			if (candidates[num_candidates].etc1.cw_diff_flip & 0x2)
+			{
+				++ num_candidates;
+			}
+
+			etc2_rgb8_codec_->EncodeETCPlanarModeInternal(candidates[num_candidates].etc2_planar_mode, argb, method);
+			++ num_candidates;
+		}
+		this->EncodeETCDifferentialModeInternal(candidates[num_candidates].etc1, argb, alpha, method);
+		++ num_candidates;
+		etc2_rgb8_codec_->EncodeETCTModeInternal(candidates[num_candidates].etc2_t_mode, argb, alpha, method);
+		++ num_candidates;
+		etc2_rgb8_codec_->EncodeETCHModeInternal(candidates[num_candidates].etc2_h_mode, argb, alpha, method);
+		++ num_candidates;
+
+		uint64_t best_error = std::numeric_limits<uint64_t>::max();
+		for (uint32_t i = 0; i < num_candidates; ++ i)
+		{
+			ARGBColor32 decoded[16];
+			this->DecodeBlock(decoded, &candidates[i]);
+			uint64_t const error = ETC2DecodedError(decoded, argb, true);
+			if (error < best_error)
+			{
+				best_error = error;
+				etc2 = candidates[i];
+			}
+		}
+	}
+
+	uint64_t TexCompressionETC2RGB8A1::EncodeETCDifferentialModeInternal(ETC1Block& etc1, ARGBColor32 const * argb, bool alpha,
+		TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(argb);
+
+		ETC2BlockPixels pixels;
+		LoadETC2BlockPixels(pixels, argb, alpha);
+
+		uint64_t best_error = std::numeric_limits<uint64_t>::max();
+		for (int flip = 0; flip < 2; ++ flip)
+		{
+			uint32_t sub_masks[2] = { 0, 0 };
+			for (int i = 0; i < 16; ++ i)
+			{
+				int const sub = ((flip ? (i >> 2) : (i & 3)) >> 1);
+				sub_masks[sub] |= 1UL << i;
+			}
+
+			int avg_clr[2][3];
+			for (int sub = 0; sub < 2; ++ sub)
+			{
+				int sum[3] = { 0, 0, 0 };
+				int count = 0;
+				for (int i = 0; i < 16; ++ i)
+				{
+					if ((sub_masks[sub] & (1UL << i)) && pixels.opaque[i])
+					{
+						sum[0] += pixels.r[i];
+						sum[1] += pixels.g[i];
+						sum[2] += pixels.b[i];
+						++ count;
+					}
+				}
+				for (int c = 0; c < 3; ++ c)
+				{
+					avg_clr[sub][c] = count ? MathLib::clamp(static_cast<int>(sum[c] * 31.0f / 255 / count + 0.5f), 0, 31) : -1;
+				}
+			}
+			for (int sub = 0; sub < 2; ++ sub)
+			{
+				// A fully transparent sub-block follows the other one.
+				if (avg_clr[sub][0] < 0)
+				{
+					for (int c = 0; c < 3; ++ c)
+					{
+						avg_clr[sub][c] = std::max(avg_clr[!sub][c], 0);
+					}
+				}
+			}
+
+			// The second base color is stored as a 3-bit delta. Either end may give way when the delta doesn't fit.
+			int const num_bases = (TCM_Speed == method) ? 1 : 2;
+			for (int fixed = 0; fixed < num_bases; ++ fixed)
+			{
+				int clr[2][3];
+				for (int c = 0; c < 3; ++ c)
+				{
+					int const delta = MathLib::clamp(avg_clr[1][c] - avg_clr[0][c], -4, 3);
+					clr[fixed][c] = avg_clr[fixed][c];
+					clr[!fixed][c] = fixed ? clr[1][c] - delta : clr[0][c] + delta;
+				}
+
+				uint64_t error = 0;
+				int cw[2];
+				uint8_t indices[16] = { 0 };
+				for (int sub = 0; sub < 2; ++ sub)
+				{
+					int const base[] = { Extend5To8Bits(clr[sub][0]), Extend5To8Bits(clr[sub][1]), Extend5To8Bits(clr[sub][2]) };
+
+					uint64_t best_sub_error = std::numeric_limits<uint64_t>::max();
+					for (int table = 0; table < 8; ++ table)
+					{
+						int palette[4][3];
+						for (int mod = 0; mod < 4; ++ mod)
+						{
+							int const modifier = (alpha && ((1 == mod) || (2 == mod))) ? 0 : TexCompressionETC1::GetModifier(table, mod);
+							ETC2OffsetColor(palette[selector_index_to_etc1[mod]], base, modifier);
+						}
+
+						uint8_t sub_indices[16];
+						uint64_t const sub_error = ETC2PaletteIndices(sub_indices, pixels, palette, alpha, sub_masks[sub]);
+						if (sub_error < best_sub_error)
+						{
+							best_sub_error = sub_error;
+							cw[sub] = table;
+							for (int i = 0; i < 16; ++ i)
+							{
+								if (sub_masks[sub] & (1UL << i))
+								{
+									indices[i] = sub_indices[i];
+								}
+							}
+						}
+					}
+					error += best_sub_error;
+				}
+
+				if (error < best_error)
+				{
+					best_error = error;
+
+					etc1.r = static_cast<uint8_t>((clr[0][0] << 3) | ((clr[1][0] - clr[0][0]) & 0x7));
+					etc1.g = static_cast<uint8_t>((clr[0][1] << 3) | ((clr[1][1] - clr[0][1]) & 0x7));
+					etc1.b = static_cast<uint8_t>((clr[0][2] << 3) | ((clr[1][2] - clr[0][2]) & 0x7));
+					etc1.cw_diff_flip = static_cast<uint8_t>((cw[0] << 5) | (cw[1] << 2) | (alpha ? 0 : 0x2) | flip);
+					PackETC2Indices(etc1.msb, etc1.lsb, indices);
+				}
+			}
+		}
+
+		return best_error;
+	}
+
+	TexCompressionPtr TexCompressionETC2RGB8A1::Clone() const
+	{
+		return MakeSharedPtr<TexCompressionETC2RGB8A1>();
 	}
 
 	void TexCompressionETC2RGB8A1::DecodeBlock(void* output, void const * input)
@@ -2085,4 +2888,287 @@ namespace KlayGE
 			etc1_codec_->DecodeETCDifferentialModeInternal(argb, etc2.etc1, !op);
 		}
 	}
+
+
+	TexCompressionETC2R11::TexCompressionETC2R11(bool signed_fmt)
+		: signed_(signed_fmt)
+	{
+		compression_format_ = signed_fmt ? EF_SIGNED_ETC2_R11 : EF_ETC2_R11;
+	}
+
+	void TexCompressionETC2R11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		// Values are encoded in the 11-bit domain of the format
+		int values[16];
+		if (signed_)
+		{
+			int8_t const * r = static_cast<int8_t const *>(input);
+			for (int i = 0; i < 16; ++ i)
+			{
+				int const s = std::max<int>(r[i], -127);
+				values[i] = (s * 1023 + ((s < 0) ? -63 : 63)) / 127;
+			}
+		}
+		else
+		{
+			uint8_t const * r = static_cast<uint8_t const *>(input);
+			for (int i = 0; i < 16; ++ i)
+			{
+				values[i] = (r[i] << 3) | (r[i] >> 5);
+			}
+		}
+
+		this->EncodeEACBlockInternal(*static_cast<EACBlock*>(output), values, method);
+	}
+
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionETC2R11::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
+	void TexCompressionETC2R11::DecodeBlock(void* output, void const * input)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		int values[16];
+		this->DecodeEACBlockInternal(values, *static_cast<EACBlock const *>(input));
+
+		if (signed_)
+		{
+			int8_t* r = static_cast<int8_t*>(output);
+			for (int i = 0; i < 16; ++ i)
+			{
+				r[i] = static_cast<int8_t>((values[i] * 127 + ((values[i] < 0) ? -511 : 511)) / 1023);
+			}
+		}
+		else
+		{
+			uint8_t* r = static_cast<uint8_t*>(output);
+			for (int i = 0; i < 16; ++ i)
+			{
+				r[i] = static_cast<uint8_t>((values[i] * 255 + 1023) / 2047);
+			}
+		}
+	}
+
+	void TexCompressionETC2R11::EncodeEACBlockInternal(EACBlock& eac, int const * values, TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(values);
+
+		int mul_radius;
+		int base_radius;
+		switch (method)
+		{
+		case TCM_Speed:
+			mul_radius = 0;
+			base_radius = 0;
+			break;
+
+		case TCM_Balanced:
+			mul_radius = 1;
+			base_radius = 1;
+			break;
+
+		default:
+			mul_radius = 2;
+			base_radius = 3;
+			break;
+		}
+
+		int const min_base = signed_ ? -127 : 0;
+		int const max_base = signed_ ? 127 : 255;
+		int const min_value = signed_ ? -1023 : 0;
+		int const max_value = signed_ ? 1023 : 2047;
+		int const base_bias = signed_ ? 0 : 4;
+
+		int min_v = values[0];
+		int max_v = values[0];
+		for (int i = 1; i < 16; ++ i)
+		{
+			min_v = std::min(min_v, values[i]);
+			max_v = std::max(max_v, values[i]);
+		}
+
+		uint64_t best_error = std::numeric_limits<uint64_t>::max();
+		int best_base = 0;
+		int best_mul = 0;
+		int best_table = 0;
+		for (int table = 0; (table < 16) && (best_error > 0); ++ table)
+		{
+			int const mod_min = eac_modifier_table[table][3];
+			int const mod_max = eac_modifier_table[table][7];
+			int const mod_range = (mod_max - mod_min) * 8;
+			int const ideal_mul = (max_v - min_v + mod_range / 2) / mod_range;
+			for (int mul = std::max(ideal_mul - mul_radius, 0); mul <= std::min(ideal_mul + mul_radius, 15); ++ mul)
+			{
+				// A multiplier of 0 means the modifiers are applied unscaled
+				int const scale = mul ? mul * 8 : 1;
+				int const center = (min_v + max_v) / 2 - (mod_min + mod_max) * scale / 2 - base_bias;
+				int const ideal_base = MathLib::clamp((center + 4) >> 3, min_base, max_base);
+				for (int base = std::max(ideal_base - base_radius, min_base); base <= std::min(ideal_base + base_radius, max_base); ++ base)
+				{
+					int palette[8];
+					for (int k = 0; k < 8; ++ k)
+					{
+						palette[k] = MathLib::clamp(base * 8 + base_bias + eac_modifier_table[table][k] * scale, min_value, max_value);
+					}
+
+					uint64_t error = 0;
+					for (int i = 0; (i < 16) && (error < best_error); ++ i)
+					{
+						int best_pixel_error = std::numeric_limits<int>::max();
+						for (int k = 0; k < 8; ++ k)
+						{
+							int const diff = palette[k] - values[i];
+							best_pixel_error = std::min(best_pixel_error, diff * diff);
+						}
+						error += best_pixel_error;
+					}
+
+					if (error < best_error)
+					{
+						best_error = error;
+						best_base = base;
+						best_mul = mul;
+						best_table = table;
+					}
+				}
+			}
+		}
+
+		int const scale = best_mul ? best_mul * 8 : 1;
+		int palette[8];
+		for (int k = 0; k < 8; ++ k)
+		{
+			palette[k] = MathLib::clamp(best_base * 8 + base_bias + eac_modifier_table[best_table][k] * scale, min_value, max_value);
+		}
+
+		// 3-bit indices, big endian, in column major order
+		uint64_t bits = 0;
+		for (int x = 0; x < 4; ++ x)
+		{
+			for (int y = 0; y < 4; ++ y)
+			{
+				int const value = values[y * 4 + x];
+				int best_pixel_error = std::numeric_limits<int>::max();
+				uint64_t index = 0;
+				for (int k = 0; k < 8; ++ k)
+				{
+					int const diff = palette[k] - value;
+					if (diff * diff < best_pixel_error)
+					{
+						best_pixel_error = diff * diff;
+						index = k;
+					}
+				}
+				bits |= index << (45 - (x * 4 + y) * 3);
+			}
+		}
+
+		eac.base = static_cast<uint8_t>(best_base);
+		eac.mul_table = static_cast<uint8_t>((best_mul << 4) | best_table);
+		for (int i = 0; i < 6; ++ i)
+		{
+			eac.indices[i] = static_cast<uint8_t>(bits >> (40 - i * 8));
+		}
+	}
+
+	void TexCompressionETC2R11::DecodeEACBlockInternal(int* values, EACBlock const & eac) const
+	{
+		BOOST_ASSERT(values);
+
+		int base;
+		int min_value;
+		int max_value;
+		int base_bias;
+		if (signed_)
+		{
+			base = std::max<int>(static_cast<int8_t>(eac.base), -127);
+			min_value = -1023;
+			max_value = 1023;
+			base_bias = 0;
+		}
+		else
+		{
+			base = eac.base;
+			min_value = 0;
+			max_value = 2047;
+			base_bias = 4;
+		}
+		int const mul = eac.mul_table >> 4;
+		int const scale = mul ? mul * 8 : 1;
+		int const * modifiers = eac_modifier_table[eac.mul_table & 0xF];
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 6; ++ i)
+		{
+			bits = (bits << 8) | eac.indices[i];
+		}
+
+		for (int x = 0; x < 4; ++ x)
+		{
+			for (int y = 0; y < 4; ++ y)
+			{
+				int const index = (bits >> (45 - (x * 4 + y) * 3)) & 0x7;
+				values[y * 4 + x] = MathLib::clamp(base * 8 + base_bias + modifiers[index] * scale, min_value, max_value);
+			}
+		}
+	}
+
+
+	TexCompressionETC2RG11::TexCompressionETC2RG11(bool signed_fmt)
+		: r11_codec_(signed_fmt)
+	{
+		compression_format_ = signed_fmt ? EF_SIGNED_ETC2_GR11 : EF_ETC2_GR11;
+	}
+
+	void TexCompressionETC2RG11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		EACBlock* eac = static_cast<EACBlock*>(output);
+		uint16_t const * gr = static_cast<uint16_t const *>(input);
+
+		std::array<uint8_t, 16> r;
+		std::array<uint8_t, 16> g;
+		for (size_t i = 0; i < r.size(); ++ i)
+		{
+			r[i] = gr[i] & 0xFF;
+			g[i] = gr[i] >> 8;
+		}
+
+		r11_codec_.EncodeBlock(&eac[0], &r[0], method);
+		r11_codec_.EncodeBlock(&eac[1], &g[0], method);
+	}
+
+	// Stateless, all workers share this instance
+	TexCompressionPtr TexCompressionETC2RG11::Clone() const
+	{
+		return TexCompressionPtr();
+	}
+
+	void TexCompressionETC2RG11::DecodeBlock(void* output, void const * input)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint16_t* gr = static_cast<uint16_t*>(output);
+		EACBlock const * eac = static_cast<EACBlock const *>(input);
+
+		std::array<uint8_t, 16> r;
+		r11_codec_.DecodeBlock(&r[0], &eac[0]);
+		std::array<uint8_t, 16> g;
+		r11_codec_.DecodeBlock(&g[0], &eac[1]);
+
+		for (size_t i = 0; i < r.size(); ++ i)
+		{
+			gr[i] = static_cast<uint16_t>(r[i] | (g[i] << 8));
+		}
+	}
 }
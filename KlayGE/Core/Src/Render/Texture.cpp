@@ -887,15 +887,19 @@ namespace
 			break;
 
 		case EF_ETC2_R11:
+			codec = MakeUniquePtr<TexCompressionETC2R11>();
+			break;
+
 		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2R11>(true);
 			break;
 
 		case EF_ETC2_GR11:
+			codec = MakeUniquePtr<TexCompressionETC2RG11>();
+			break;
+
 		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2RG11>(true);
 			break;
 
 		default:
@@ -946,15 +950,16 @@ namespace
 		case EF_SIGNED_BC1:
 		case EF_SIGNED_BC2:
 		case EF_SIGNED_BC3:
-		case EF_SIGNED_ETC2_R11:
 			dst_format = EF_SIGNED_ABGR8;
 			break;
 
 		case EF_SIGNED_BC4:
+		case EF_SIGNED_ETC2_R11:
 			dst_format = EF_SIGNED_R8;
 			break;
 
 		case EF_SIGNED_BC5:
+		case EF_SIGNED_ETC2_GR11:
 			dst_format = EF_SIGNED_GR8;
 			break;
 
@@ -1046,15 +1051,19 @@ namespace
 			break;
 
 		case EF_ETC2_R11:
+			codec = MakeUniquePtr<TexCompressionETC2R11>();
+			break;
+
 		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2R11>(true);
 			break;
 
 		case EF_ETC2_GR11:
+			codec = MakeUniquePtr<TexCompressionETC2RG11>();
+			break;
+
 		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2RG11>(true);
 			break;
 
 		default:
@@ -1308,6 +1317,13 @@ namespace
 			return true;
 		}
 
+		uint64_t KeyHash() const override
+		{
+			size_t seed = HashRange(tex_desc_.res_name.begin(), tex_desc_.res_name.end());
+			HashCombine(seed, tex_desc_.access_hint);
+			return seed;
+		}
+
 		bool Match(ResLoadingDesc const & rhs) const override
 		{
 			if (this->Type() == rhs.Type())
@@ -2152,11 +2168,12 @@ namespace KlayGE
 		uint32_t array_size;
 		ElementFormat format;
 		std::vector<ElementInitData> init_data;
-		std::vector<uint8_t> data_block;
+		size_t data_size = 0;
 
 		uint32_t row_pitch, slice_pitch;
 		ReadDdsFileHeader(tex_res, type, width, height, depth, num_mipmaps, array_size, format,
 			row_pitch, slice_pitch);
+		int64_t const data_offset = tex_res->tellg();
 
 		uint32_t const fmt_size = NumFormatBytes(format);
 		bool padding = false;
@@ -2193,14 +2210,11 @@ namespace KlayGE
 							image_size = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 						}
 
-						base[index] = data_block.size();
-						data_block.resize(base[index] + image_size);
+						base[index] = data_size;
+						data_size += image_size;
 						init_data[index].row_pitch = image_size;
 						init_data[index].slice_pitch = image_size;
 
-						tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-						BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
-
 						the_width = std::max<uint32_t>(the_width / 2, 1);
 					}
 				}
@@ -2223,23 +2237,17 @@ namespace KlayGE
 							uint32_t const block_size = NumFormatBytes(format) * 4;
 							uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
 
-							base[index] = data_block.size();
-							data_block.resize(base[index] + image_size);
+							base[index] = data_size;
+							data_size += image_size;
 							init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 							init_data[index].slice_pitch = image_size;
-
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
 						}
 						else
 						{
 							init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 							init_data[index].slice_pitch = init_data[index].row_pitch * the_height;
-							base[index] = data_block.size();
-							data_block.resize(base[index] + init_data[index].slice_pitch);
-
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch));
+							base[index] = data_size;
+							data_size += init_data[index].slice_pitch;
 						}
 
 						the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2266,23 +2274,17 @@ namespace KlayGE
 							uint32_t const block_size = NumFormatBytes(format) * 4;
 							uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * the_depth * block_size;
 
-							base[index] = data_block.size();
-							data_block.resize(base[index] + image_size);
+							base[index] = data_size;
+							data_size += image_size;
 							init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 							init_data[index].slice_pitch = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
-
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
 						}
 						else
 						{
 							init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 							init_data[index].slice_pitch = init_data[index].row_pitch * the_height;
-							base[index] = data_block.size();
-							data_block.resize(base[index] + init_data[index].slice_pitch * the_depth);
-
-							tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch * the_depth));
-							BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch * the_depth));
+							base[index] = data_size;
+							data_size += init_data[index].slice_pitch * the_depth;
 						}
 
 						the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2311,23 +2313,17 @@ namespace KlayGE
 								uint32_t const block_size = NumFormatBytes(format) * 4;
 								uint32_t image_size = ((the_width + 3) / 4) * ((the_height + 3) / 4) * block_size;
 
-								base[index] = data_block.size();
-								data_block.resize(base[index] + image_size);
+								base[index] = data_size;
+								data_size += image_size;
 								init_data[index].row_pitch = (the_width + 3) / 4 * block_size;
 								init_data[index].slice_pitch = image_size;
-
-								tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(image_size));
-								BOOST_ASSERT(tex_res->gcount() == static_cast<int>(image_size));
 							}
 							else
 							{
 								init_data[index].row_pitch = (padding ? ((the_width + 3) & ~3) : the_width) * fmt_size;
 								init_data[index].slice_pitch = init_data[index].row_pitch * the_width;
-								base[index] = data_block.size();
-								data_block.resize(base[index] + init_data[index].slice_pitch);
-
-								tex_res->read(&data_block[base[index]], static_cast<std::streamsize>(init_data[index].slice_pitch));
-								BOOST_ASSERT(tex_res->gcount() == static_cast<int>(init_data[index].slice_pitch));
+								base[index] = data_size;
+								data_size += init_data[index].slice_pitch;
 							}
 
 							the_width = std::max<uint32_t>(the_width / 2, 1);
@@ -2339,9 +2335,26 @@ namespace KlayGE
 			break;
 		}
 
+		// All subresources are stored one after another, the same order as in the file. A memory mapped file is used in
+		// place, CreateHWResource copies it while tex_res is still alive.
+		std::vector<uint8_t> data_block;
+		uint8_t const * data;
+		ArrayRef<uint8_t> const tex_view = tex_res->View();
+		if (!tex_view.empty() && (static_cast<uint64_t>(data_offset) + data_size <= tex_view.size()))
+		{
+			data = tex_view.data() + data_offset;
+		}
+		else
+		{
+			data_block.resize(data_size);
+			tex_res->read(data_block.data(), data_block.size());
+			BOOST_ASSERT(tex_res->gcount() == static_cast<int64_t>(data_block.size()));
+			data = data_block.data();
+		}
+
 		for (size_t i = 0; i < base.size(); ++ i)
 		{
-			init_data[i].data = &data_block[base[i]];
+			init_data[i].data = data + base[i];
 		}
 
 		auto ret = MakeSharedPtr<SoftwareTexture>(type, width, height, depth,
@@ -3553,6 +3566,7 @@ namespace KlayGE
 				break;
 
 			case EF_SIGNED_BC5:
+			case EF_SIGNED_ETC2_GR11:
 				dst_cpu_format = EF_SIGNED_GR8;
 				break;
 
@@ -53,12 +53,91 @@
 #include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
 #include <map>
 #include <algorithm>
+#include <cstring>
 
 #include <KlayGE/SceneManager.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const NO_AUTO_INSTANCE_BATCH = 0xFFFFFFFFU;
+
+	size_t GeometryHash(RenderLayout const & rl)
+	{
+		size_t seed = 0;
+		HashCombine(seed, static_cast<uint32_t>(rl.TopologyType()));
+		for (uint32_t i = 0; i < rl.NumVertexStreams(); ++ i)
+		{
+			HashCombine(seed, rl.GetVertexStream(i).get());
+		}
+		if (rl.UseIndices())
+		{
+			HashCombine(seed, rl.GetIndexStream().get());
+		}
+		HashCombine(seed, rl.NumVertices());
+		HashCombine(seed, rl.NumIndices());
+		HashCombine(seed, rl.StartVertexLocation());
+		HashCombine(seed, rl.StartIndexLocation());
+		return seed;
+	}
+
+	// Only the geometry streams and ranges are compared, instance streams are ignored
+	bool SameGeometry(RenderLayout const & lhs, RenderLayout const & rhs)
+	{
+		if ((lhs.TopologyType() != rhs.TopologyType()) || (lhs.NumVertexStreams() != rhs.NumVertexStreams())
+			|| (lhs.UseIndices() != rhs.UseIndices()) || (lhs.NumVertices() != rhs.NumVertices())
+			|| (lhs.NumIndices() != rhs.NumIndices()) || (lhs.StartVertexLocation() != rhs.StartVertexLocation())
+			|| (lhs.StartIndexLocation() != rhs.StartIndexLocation()))
+		{
+			return false;
+		}
+		for (uint32_t i = 0; i < lhs.NumVertexStreams(); ++ i)
+		{
+			if ((lhs.GetVertexStream(i) != rhs.GetVertexStream(i)) || (lhs.VertexStreamFormat(i) != rhs.VertexStreamFormat(i)))
+			{
+				return false;
+			}
+		}
+		if (lhs.UseIndices())
+		{
+			if ((lhs.GetIndexStream() != rhs.GetIndexStream()) || (lhs.IndexStreamFormat() != rhs.IndexStreamFormat()))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Techniques that take the world matrix from the model parameters would draw all instances of a batch at one place
+	bool ReadsAutoInstanceStream(RenderTechnique const & tech)
+	{
+		for (auto const & ve : Renderable::AutoInstanceFormat())
+		{
+			if (!tech.HasVertexInput(ve.usage, ve.usage_index))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void CollectSubtree(SceneNodePtr const & node, std::vector<SceneNodePtr>& nodes)
+	{
+		nodes.push_back(node);
+		for (auto const & child : node->Children())
+		{
+			CollectSubtree(child, nodes);
+		}
+	}
+}
+
 namespace KlayGE
 {
 	// 캯
@@ -67,8 +146,12 @@ namespace KlayGE
 		: frustum_(nullptr),
 			scene_root_(L"SceenRoot", SceneNode::SOA_Cullable),
 			overlay_root_(L"OverlayRoot", SceneNode::SOA_Cullable | SceneNode::SOA_Overlay),
+			visible_marks_cache_capacity_(32),
+			num_visible_marks_cache_hits_(0), num_visible_marks_cache_misses_(0),
+			scene_version_(0), visible_nodes_hash_(0),
 			small_obj_threshold_(0),
 			update_elapse_(1.0f / 60),
+			flat_nodes_dirty_(true),
 			num_objects_rendered_(0), num_renderables_rendered_(0),
 			num_primitives_rendered_(0), num_vertices_rendered_(0),
 			num_draw_calls_(0), num_dispatch_calls_(0),
@@ -76,6 +159,12 @@ namespace KlayGE
 	{
 		scene_root_.VisibleMark(BO_Partial);
 		overlay_root_.VisibleMark(BO_Partial);
+
+#ifndef KLAYGE_SHIP
+		PerfProfiler& profiler = PerfProfiler::Instance();
+		render_queue_build_perf_ = profiler.CreatePerfRange(0, "Render queue build", false);
+		render_queue_sort_perf_ = profiler.CreatePerfRange(0, "Render queue sort", false);
+#endif
 	}
 
 	// 
@@ -106,6 +195,7 @@ namespace KlayGE
 	void SceneManager::SmallObjectThreshold(float area)
 	{
 		small_obj_threshold_ = area;
+		++ scene_version_;
 	}
 
 	void SceneManager::SceneUpdateElapse(float elapse)
@@ -294,20 +384,17 @@ namespace KlayGE
 			{
 				RenderTechnique const * obj_tech = obj->GetRenderTechnique();
 				BOOST_ASSERT(obj_tech);
-				bool found = false;
-				for (auto& items : render_queue_)
+				auto tech_iter = render_queue_tech_map_.emplace(obj_tech, static_cast<uint32_t>(render_queue_techs_.size())).first;
+				if (tech_iter->second == render_queue_techs_.size())
 				{
-					if (items.first == obj_tech)
-					{
-						items.second.push_back(obj);
-						found = true;
-						break;
-					}
-				}
-				if (!found)
-				{
-					render_queue_.emplace_back(obj_tech, std::vector<Renderable*>(1, obj));
+					render_queue_techs_.push_back(obj_tech);
 				}
+				auto mtl_iter = render_queue_mtl_map_.emplace(obj->GetMaterial().get(),
+					static_cast<uint32_t>(render_queue_mtl_map_.size())).first;
+
+				render_queue_.push_back(obj);
+				render_queue_tech_ids_.push_back(tech_iter->second);
+				render_queue_mtl_ids_.push_back(mtl_iter->second);
 			}
 		}
 	}
@@ -324,6 +411,23 @@ namespace KlayGE
 		}
 	}
 
+	void SceneManager::AABBsVisible(AABBoxSoA const & aabbs, uint32_t* visible_masks) const
+	{
+		size_t const num = aabbs.Size();
+		if (frustum_)
+		{
+			MathLib::intersect_aabb_frustum_mask(aabbs, 0, num, *frustum_, visible_masks);
+		}
+		else
+		{
+			std::fill(visible_masks, visible_masks + num / 32, 0xFFFFFFFFU);
+			if (num % 32 != 0)
+			{
+				visible_masks[num / 32] = (1U << (num % 32)) - 1;
+			}
+		}
+	}
+
 	BoundOverlap SceneManager::OBBVisible(OBBox const & obb) const
 	{
 		if (frustum_)
@@ -375,6 +479,7 @@ namespace KlayGE
 		std::lock_guard<std::mutex> lock(update_mutex_);
 		scene_root_.ClearChildren();
 		overlay_root_.ClearChildren();
+		auto_inst_layouts_.clear();
 	}
 
 	// ³
@@ -401,11 +506,18 @@ namespace KlayGE
 
 			scene_root_.Traverse([app_time, frame_time](SceneNode& node) {
 				node.MainThreadUpdate(app_time, frame_time);
-				node.UpdateTransforms();
-
 				return true;
 			});
-			scene_root_.UpdatePosBoundSubtree();
+
+			if (flat_nodes_dirty_)
+			{
+				this->FlattenSceneNodes();
+			}
+			this->UpdateSceneNodeTransforms();
+			if (this->UpdateSceneNodeBounds())
+			{
+				++ scene_version_;
+			}
 
 			overlay_root_.ClearChildren();
 			for (auto iter = lights_.begin(); iter != lights_.end();)
@@ -438,6 +550,19 @@ namespace KlayGE
 
 		this->FlushScene();
 
+		for (auto iter = auto_inst_layouts_.begin(); iter != auto_inst_layouts_.end();)
+		{
+			if (iter->second.used)
+			{
+				iter->second.used = false;
+				++ iter;
+			}
+			else
+			{
+				iter = auto_inst_layouts_.erase(iter);
+			}
+		}
+
 		FrameBuffer& fb = *re.ScreenFrameBuffer();
 		fb.SwapBuffers();
 
@@ -504,38 +629,73 @@ namespace KlayGE
 		{
 			frustum_ = &camera.ViewFrustum();
 
-			std::vector<uint32_t> visible_list((scene_nodes.size() + 31) / 32, 0);
-			for (size_t i = 0; i < scene_nodes.size(); ++ i)
+			float4x4 view_proj = camera.ViewProjMatrix();
+			auto drl = Context::Instance().DeferredRenderingLayerInstance();
+			if (drl)
 			{
-				if (scene_nodes[i]->Visible())
+				int32_t cas_index = drl->CurrCascadeIndex();
+				if (cas_index >= 0)
 				{
-					visible_list[i / 32] |= (1UL << (i & 31));
+					view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
 				}
 			}
-			size_t seed = 0;
-			HashRange(seed, visible_list.begin(), visible_list.end());
+
+			uint32_t view_proj_bits[16];
+			std::memcpy(view_proj_bits, view_proj.begin(), sizeof(view_proj_bits));
+
+			size_t seed = visible_nodes_hash_;
+			HashRange(seed, std::begin(view_proj_bits), std::end(view_proj_bits));
 			HashCombine(seed, camera.OmniDirectionalMode());
+			HashCombine(seed, (urt & App3DFramework::URV_Overlay) != 0);
 			HashCombine(seed, &camera);
 
 			auto vmiter = visible_marks_map_.find(seed);
-			if (vmiter == visible_marks_map_.end())
+			if ((vmiter != visible_marks_map_.end()) && (vmiter->second->scene_version == scene_version_)
+				&& (vmiter->second->marks.size() == scene_nodes.size())
+				&& std::equal(view_proj.begin(), view_proj.end(), vmiter->second->view_proj.begin()))
 			{
-				this->ClipScene();
+				visible_marks_lru_.splice(visible_marks_lru_.begin(), visible_marks_lru_, vmiter->second);
 
-				auto visible_marks = MakeUniquePtr<BoundOverlap[]>(scene_nodes.size());
+				auto const & marks = visible_marks_lru_.front().marks;
 				for (size_t i = 0; i < scene_nodes.size(); ++ i)
 				{
-					visible_marks[i] = scene_nodes[i]->VisibleMark();
+					scene_nodes[i]->VisibleMark(marks[i]);
 				}
 
-				visible_marks_map_.emplace(seed, std::move(visible_marks));
+				++ num_visible_marks_cache_hits_;
 			}
 			else
 			{
+				this->ClipScene();
+
+				if (vmiter != visible_marks_map_.end())
+				{
+					// A stale entry of the same key is refreshed in place
+					visible_marks_lru_.splice(visible_marks_lru_.begin(), visible_marks_lru_, vmiter->second);
+				}
+				else
+				{
+					visible_marks_lru_.emplace_front();
+					visible_marks_lru_.front().key = seed;
+					visible_marks_map_.emplace(seed, visible_marks_lru_.begin());
+				}
+
+				auto& entry = visible_marks_lru_.front();
+				entry.scene_version = scene_version_;
+				entry.view_proj = view_proj;
+				entry.marks.resize(scene_nodes.size());
 				for (size_t i = 0; i < scene_nodes.size(); ++ i)
 				{
-					scene_nodes[i]->VisibleMark(vmiter->second[i]);
+					entry.marks[i] = scene_nodes[i]->VisibleMark();
+				}
+
+				while (visible_marks_lru_.size() > visible_marks_cache_capacity_)
+				{
+					visible_marks_map_.erase(visible_marks_lru_.back().key);
+					visible_marks_lru_.pop_back();
 				}
+
+				++ num_visible_marks_cache_misses_;
 			}
 		}
 		if (urt & App3DFramework::URV_Overlay)
@@ -547,6 +707,10 @@ namespace KlayGE
 			}
 		}
 
+#ifndef KLAYGE_SHIP
+		render_queue_build_perf_->Begin();
+#endif
+
 		for (auto const & node : scene_nodes)
 		{
 			if (node->VisibleMark() != BO_No)
@@ -576,61 +740,116 @@ namespace KlayGE
 			}
 		}
 
-		std::sort(render_queue_.begin(), render_queue_.end(),
-			[](std::pair<RenderTechnique const *, std::vector<Renderable*>> const & lhs,
-				std::pair<RenderTechnique const *, std::vector<Renderable*>> const & rhs)
-			{
-				BOOST_ASSERT(lhs.first);
-				BOOST_ASSERT(rhs.first);
+		uint32_t const num_queued = static_cast<uint32_t>(render_queue_.size());
 
-				return lhs.first->Weight() < rhs.first->Weight();
+		// Techniques are ranked by weight. Ties keep the order they were queued in.
+		std::vector<uint32_t> techs_by_weight(render_queue_techs_.size());
+		for (uint32_t i = 0; i < techs_by_weight.size(); ++ i)
+		{
+			techs_by_weight[i] = i;
+		}
+		std::stable_sort(techs_by_weight.begin(), techs_by_weight.end(),
+			[this](uint32_t lhs, uint32_t rhs)
+			{
+				return render_queue_techs_[lhs]->Weight() < render_queue_techs_[rhs]->Weight();
 			});
+		render_queue_tech_ranks_.resize(render_queue_techs_.size());
+		for (uint32_t i = 0; i < techs_by_weight.size(); ++ i)
+		{
+			render_queue_tech_ranks_[techs_by_weight[i]] = i;
+		}
 
+		render_queue_keys_.resize(num_queued);
+		render_queue_order_.resize(num_queued);
 		float4 const & view_mat_z = camera.ViewMatrix().Col(2);
-		for (auto& items : render_queue_)
-		{
-			if (!items.first->Transparent() && !items.first->HasDiscard() && (items.second.size() > 1))
+		uint32_t const min_renderables_per_worker = 256;
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_queued,
+			num_parallel_workers(num_queued, min_renderables_per_worker),
+			[this, &view_mat_z](uint32_t worker, uint32_t first, uint32_t last)
 			{
-				std::vector<std::pair<float, uint32_t>> min_depths(items.second.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
+				KFL_UNUSED(worker);
+				for (uint32_t i = first; i < last; ++ i)
 				{
-					Renderable const * renderable = items.second[j];
-					AABBox const & box = renderable->PosBound();
-					uint32_t const num = renderable->NumInstances();
-					float md = 1e10f;
-					for (uint32_t i = 0; i < num; ++ i)
+					RenderTechnique const * tech = render_queue_techs_[render_queue_tech_ids_[i]];
+					uint64_t key = static_cast<uint64_t>(std::min(render_queue_tech_ranks_[render_queue_tech_ids_[i]], 0xFFFFU)) << 48;
+					if (!tech->Transparent() && !tech->HasDiscard())
 					{
-						float4x4 const & mat = renderable->GetInstance(i)->TransformToWorld();
-						float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
-							MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
-							MathLib::dot(mat.Row(3), view_mat_z));
-						for (int k = 0; k < 8; ++ k)
+						// Min view depth of the bound over all instances. For a box the min of a linear function is at
+						// center - extent * sign, so no corner needs to be transformed.
+						Renderable const * renderable = render_queue_[i];
+						AABBox const & box = renderable->PosBound();
+						float3 const center = box.Center();
+						float3 const extent = box.HalfSize();
+						uint32_t const num = renderable->NumInstances();
+						float md = 1e10f;
+						for (uint32_t j = 0; j < num; ++ j)
 						{
-							float3 const v = box.Corner(k);
-							md = std::min(md, v.x() * zvec.x() + v.y() * zvec.y() + v.z() * zvec.z() + zvec.w());
+							float4x4 const & mat = renderable->GetInstance(j)->TransformToWorld();
+							float4 const zvec(MathLib::dot(mat.Row(0), view_mat_z),
+								MathLib::dot(mat.Row(1), view_mat_z), MathLib::dot(mat.Row(2), view_mat_z),
+								MathLib::dot(mat.Row(3), view_mat_z));
+							md = std::min(md, center.x() * zvec.x() + center.y() * zvec.y() + center.z() * zvec.z() + zvec.w()
+								- (extent.x() * std::abs(zvec.x()) + extent.y() * std::abs(zvec.y()) + extent.z() * std::abs(zvec.z())));
 						}
+
+						key |= static_cast<uint64_t>(std::min(render_queue_mtl_ids_[i], 0xFFFFU)) << 32;
+						key |= RadixSortableFloat(md);
 					}
 
-					min_depths[j] = std::make_pair(md, static_cast<uint32_t>(j));
+					render_queue_keys_[i] = key;
+					render_queue_order_[i] = i;
 				}
+			});
 
-				std::sort(min_depths.begin(), min_depths.end());
+#ifndef KLAYGE_SHIP
+		render_queue_build_perf_->End();
+		render_queue_sort_perf_->Begin();
+#endif
 
-				std::vector<Renderable*> sorted_items(min_depths.size());
-				for (size_t j = 0; j < min_depths.size(); ++ j)
-				{
-					sorted_items[j] = items.second[min_depths[j].second];
-				}
-				items.second.swap(sorted_items);
-			}
+		render_queue_tmp_keys_.resize(num_queued);
+		render_queue_tmp_order_.resize(num_queued);
+		RadixSort(render_queue_keys_.data(), render_queue_order_.data(),
+			render_queue_tmp_keys_.data(), render_queue_tmp_order_.data(), num_queued);
 
-			for (auto const & item : items.second)
+#ifndef KLAYGE_SHIP
+		render_queue_sort_perf_->End();
+#endif
+
+		this->BuildAutoInstanceBatches();
+
+		for (uint32_t i = 0; i < num_queued; ++ i)
+		{
+			uint32_t const index = render_queue_order_[i];
+			Renderable* renderable = render_queue_[index];
+			uint32_t const batch_id = render_queue_batch_ids_[index];
+			if (batch_id == NO_AUTO_INSTANCE_BATCH)
 			{
-				item->Render();
+				renderable->Render();
+			}
+			else
+			{
+				auto const & batch = auto_inst_batches_[batch_id];
+				if (batch.num_instances == 1)
+				{
+					renderable->Render();
+				}
+				else if (batch.renderable == renderable)
+				{
+					RenderLayout& rl = this->AutoInstanceLayout(*batch.geometry);
+					rl.StartInstanceLocation(batch.first_instance);
+					rl.NumInstances(batch.num_instances);
+					renderable->RenderInstances(rl);
+				}
 			}
-			num_renderables_rendered_ += static_cast<uint32_t>(items.second.size());
 		}
-		render_queue_.resize(0);
+		num_renderables_rendered_ += num_queued;
+
+		render_queue_.clear();
+		render_queue_tech_ids_.clear();
+		render_queue_mtl_ids_.clear();
+		render_queue_techs_.clear();
+		render_queue_tech_map_.clear();
+		render_queue_mtl_map_.clear();
 
 		num_primitives_rendered_ += re.NumPrimitivesJustRendered();
 		num_vertices_rendered_ += re.NumVerticesJustRendered();
@@ -641,6 +860,137 @@ namespace KlayGE
 		urt_ = 0;
 	}
 
+	void SceneManager::BuildAutoInstanceBatches()
+	{
+		uint32_t const num_queued = static_cast<uint32_t>(render_queue_.size());
+
+		render_queue_batch_ids_.assign(num_queued, NO_AUTO_INSTANCE_BATCH);
+		auto_inst_batches_.clear();
+		auto_inst_batch_map_.clear();
+
+		// Batches are formed in sorted order, so the first renderable of a batch is the first one to draw
+		for (uint32_t i = 0; i < num_queued; ++ i)
+		{
+			uint32_t const index = render_queue_order_[i];
+			Renderable* renderable = render_queue_[index];
+			RenderTechnique const * tech = render_queue_techs_[render_queue_tech_ids_[index]];
+			if (!renderable->AutoInstancing() || renderable->SelectMode() || tech->Transparent()
+				|| (renderable->NumInstances() == 0) || !renderable->GetInstance(0)->InstanceFormat().empty()
+				|| (renderable->ActiveLod() < 0) || !ReadsAutoInstanceStream(*tech))
+			{
+				continue;
+			}
+
+			RenderLayout const & geometry = renderable->GetRenderLayout(renderable->ActiveLod());
+			if (geometry.InstanceStream() || geometry.GetIndirectArgs())
+			{
+				continue;
+			}
+
+			RenderMaterial const * mtl = renderable->GetMaterial().get();
+
+			size_t seed = GeometryHash(geometry);
+			HashCombine(seed, tech);
+			HashCombine(seed, mtl);
+
+			auto iter = auto_inst_batch_map_.emplace(seed, static_cast<uint32_t>(auto_inst_batches_.size())).first;
+			if (iter->second == auto_inst_batches_.size())
+			{
+				AutoInstanceBatch batch;
+				batch.renderable = renderable;
+				batch.tech = tech;
+				batch.mtl = mtl;
+				batch.geometry = &geometry;
+				batch.first_instance = 0;
+				batch.num_instances = 0;
+				batch.num_written = 0;
+				auto_inst_batches_.push_back(batch);
+			}
+
+			auto& batch = auto_inst_batches_[iter->second];
+			if ((batch.tech == tech) && (batch.mtl == mtl) && SameGeometry(*batch.geometry, geometry))
+			{
+				batch.num_instances += renderable->NumInstances();
+				render_queue_batch_ids_[index] = iter->second;
+			}
+		}
+
+		uint32_t num_instances = 0;
+		for (auto& batch : auto_inst_batches_)
+		{
+			batch.first_instance = num_instances;
+			num_instances += batch.num_instances;
+		}
+		if (num_instances == auto_inst_batches_.size())
+		{
+			// Every batch has a single instance, nothing to merge
+			return;
+		}
+
+		uint32_t const instance_size = sizeof(float4x4);
+		if (!auto_inst_buffer_ || (auto_inst_buffer_->Size() < num_instances * instance_size))
+		{
+			uint32_t capacity = 256;
+			while (capacity < num_instances)
+			{
+				capacity *= 2;
+			}
+
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			auto_inst_buffer_ = rf.MakeVertexBuffer(BU_Dynamic, EAH_CPU_Write | EAH_GPU_Read, capacity * instance_size, nullptr);
+		}
+
+		GraphicsBuffer::Mapper mapper(*auto_inst_buffer_, BA_Write_Only);
+		float4x4* instance_data = mapper.Pointer<float4x4>();
+		for (uint32_t index = 0; index < num_queued; ++ index)
+		{
+			uint32_t const batch_id = render_queue_batch_ids_[index];
+			if (batch_id != NO_AUTO_INSTANCE_BATCH)
+			{
+				auto& batch = auto_inst_batches_[batch_id];
+				Renderable const * renderable = render_queue_[index];
+				float4x4* dst = instance_data + batch.first_instance + batch.num_written;
+				for (uint32_t j = 0; j < renderable->NumInstances(); ++ j)
+				{
+					dst[j] = renderable->GetInstance(j)->TransformToWorld();
+				}
+				batch.num_written += renderable->NumInstances();
+			}
+		}
+	}
+
+	RenderLayout& SceneManager::AutoInstanceLayout(RenderLayout const & geometry)
+	{
+		auto& entry = auto_inst_layouts_[&geometry];
+		entry.used = true;
+
+		auto& rl = entry.rl;
+		if (!rl || !SameGeometry(*rl, geometry))
+		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			rl = rf.MakeRenderLayout();
+			rl->TopologyType(geometry.TopologyType());
+			for (uint32_t i = 0; i < geometry.NumVertexStreams(); ++ i)
+			{
+				rl->BindVertexStream(geometry.GetVertexStream(i), geometry.VertexStreamFormat(i));
+			}
+			if (geometry.UseIndices())
+			{
+				rl->BindIndexStream(geometry.GetIndexStream(), geometry.IndexStreamFormat());
+				rl->NumIndices(geometry.NumIndices());
+			}
+			rl->NumVertices(geometry.NumVertices());
+			rl->StartVertexLocation(geometry.StartVertexLocation());
+			rl->StartIndexLocation(geometry.StartIndexLocation());
+			rl->BindVertexStream(auto_inst_buffer_, Renderable::AutoInstanceFormat(), RenderLayout::ST_Instance, 1);
+		}
+		if (rl->InstanceStream() != auto_inst_buffer_)
+		{
+			rl->InstanceStream(auto_inst_buffer_);
+		}
+		return *rl;
+	}
+
 	// ȡȾ
 	/////////////////////////////////////////////////////////////////////////////////
 	uint32_t SceneManager::NumObjectsRendered() const
@@ -679,11 +1029,66 @@ namespace KlayGE
 		return num_dispatch_calls_;
 	}
 
+	void SceneManager::VisibleMarksCacheCapacity(uint32_t capacity)
+	{
+		visible_marks_cache_capacity_ = capacity;
+		while (visible_marks_lru_.size() > visible_marks_cache_capacity_)
+		{
+			visible_marks_map_.erase(visible_marks_lru_.back().key);
+			visible_marks_lru_.pop_back();
+		}
+	}
+
+	uint32_t SceneManager::VisibleMarksCacheCapacity() const
+	{
+		return visible_marks_cache_capacity_;
+	}
+
+	uint32_t SceneManager::NumVisibleMarksCacheHits() const
+	{
+		return num_visible_marks_cache_hits_;
+	}
+
+	uint32_t SceneManager::NumVisibleMarksCacheMisses() const
+	{
+		return num_visible_marks_cache_misses_;
+	}
+
+	size_t SceneManager::VisibleMarksCacheMemory() const
+	{
+		size_t mem = visible_marks_map_.size() * (sizeof(size_t) + sizeof(std::list<VisibleMarksEntry>::iterator));
+		for (auto const & entry : visible_marks_lru_)
+		{
+			mem += sizeof(entry) + entry.marks.capacity() * sizeof(BoundOverlap);
+		}
+		return mem;
+	}
+
+	void SceneManager::OnSceneChanged()
+	{
+		++ scene_version_;
+		flat_nodes_dirty_ = true;
+	}
+
+	// Each node contributes a fixed pseudo random value. Flipping a node twice cancels out, so a set of visible nodes
+	// that comes back, like shadow passes hiding the same nodes every frame, hashes to the same key.
+	void SceneManager::OnSceneNodeVisibleChanged(SceneNode const & node)
+	{
+		uint64_t x = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&node));
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDULL;
+		x ^= x >> 33;
+		x *= 0xC4CEB9FE1A85EC53ULL;
+		x ^= x >> 33;
+		visible_nodes_hash_ ^= static_cast<size_t>(x);
+	}
+
 	void SceneManager::FlushScene()
 	{
 		RenderEngine& re = Context::Instance().RenderFactoryInstance().RenderEngineInstance();
 
-		visible_marks_map_.clear();
+		num_visible_marks_cache_hits_ = 0;
+		num_visible_marks_cache_misses_ = 0;
 
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
@@ -736,14 +1141,7 @@ namespace KlayGE
 				WindowPtr const & win = Context::Instance().AppInstance().MainWnd();
 				if (win && win->Active())
 				{
-					std::lock_guard<std::mutex> lock(update_mutex_);
-
-					auto updater = [app_time, frame_time](SceneNode& node) {
-						node.SubThreadUpdate(app_time, frame_time);
-						return true;
-					};
-					scene_root_.Traverse(updater);
-					overlay_root_.Traverse(updater);
+					this->RunSubThreadUpdates(app_time, frame_time);
 				}
 
 				if (frame_time < update_elapse_)
@@ -754,6 +1152,157 @@ namespace KlayGE
 		}
 	}
 
+	// Top level subtrees are independent, so their sub thread updates run in parallel on the thread pool, each worker
+	// taking whole subtrees in scene order. The lock is only held to take the snapshot of the nodes, and to apply the
+	// writes the callbacks recorded. Flush therefore never waits for the callbacks, and sees either none or all of the
+	// results of a pass.
+	void SceneManager::RunSubThreadUpdates(float app_time, float elapsed_time)
+	{
+		{
+			std::lock_guard<std::mutex> lock(update_mutex_);
+
+			scene_root_.SubThreadUpdate(app_time, elapsed_time);
+			overlay_root_.SubThreadUpdate(app_time, elapsed_time);
+
+			sub_thread_nodes_.clear();
+			sub_thread_subtree_offsets_.clear();
+			for (auto const * root : { &scene_root_, &overlay_root_ })
+			{
+				for (auto const & child : root->Children())
+				{
+					sub_thread_subtree_offsets_.push_back(static_cast<uint32_t>(sub_thread_nodes_.size()));
+					CollectSubtree(child, sub_thread_nodes_);
+				}
+			}
+			sub_thread_subtree_offsets_.push_back(static_cast<uint32_t>(sub_thread_nodes_.size()));
+		}
+
+		uint32_t const min_nodes_per_worker = 64;
+		uint32_t const num_subtrees = static_cast<uint32_t>(sub_thread_subtree_offsets_.size() - 1);
+		uint32_t const num_nodes = static_cast<uint32_t>(sub_thread_nodes_.size());
+		uint32_t const num_workers = std::min(num_parallel_workers(num_nodes, min_nodes_per_worker), std::max(num_subtrees, 1U));
+		sub_thread_writes_.resize(num_workers);
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_nodes, num_workers,
+			[this, app_time, elapsed_time](uint32_t worker, uint32_t first, uint32_t last)
+			{
+				// A subtree goes to the worker its first node falls into
+				auto const offsets_end = sub_thread_subtree_offsets_.end() - 1;
+				uint32_t const node_first = *std::lower_bound(sub_thread_subtree_offsets_.begin(), offsets_end, first);
+				uint32_t const node_last = *std::lower_bound(sub_thread_subtree_offsets_.begin(), offsets_end, last);
+
+				SceneNode::BeginSubThreadWrites(sub_thread_writes_[worker]);
+				for (uint32_t i = node_first; i < node_last; ++ i)
+				{
+					sub_thread_nodes_[i]->SubThreadUpdate(app_time, elapsed_time);
+				}
+				SceneNode::EndSubThreadWrites();
+			});
+
+		std::lock_guard<std::mutex> lock(update_mutex_);
+
+		for (auto& writes : sub_thread_writes_)
+		{
+			for (auto const & write : writes)
+			{
+				write();
+			}
+			writes.clear();
+		}
+		sub_thread_nodes_.clear();
+	}
+
+	void SceneManager::FlattenSceneNodes()
+	{
+		flat_nodes_.assign(1, &scene_root_);
+		flat_parents_.assign(1, -1);
+		flat_first_children_.clear();
+		flat_num_children_.clear();
+		flat_level_offsets_.assign(1, 0);
+
+		uint32_t level_begin = 0;
+		while (level_begin < flat_nodes_.size())
+		{
+			uint32_t const level_end = static_cast<uint32_t>(flat_nodes_.size());
+			for (uint32_t i = level_begin; i < level_end; ++ i)
+			{
+				auto const & children = flat_nodes_[i]->Children();
+				flat_first_children_.push_back(static_cast<uint32_t>(flat_nodes_.size()));
+				flat_num_children_.push_back(static_cast<uint32_t>(children.size()));
+				for (auto const & child : children)
+				{
+					flat_nodes_.push_back(child.get());
+					flat_parents_.push_back(static_cast<int32_t>(i));
+				}
+			}
+
+			flat_level_offsets_.push_back(level_end);
+			level_begin = level_end;
+		}
+
+		flat_world_changed_.resize(flat_nodes_.size());
+		flat_bound_changed_.resize(flat_nodes_.size());
+
+		flat_nodes_dirty_ = false;
+	}
+
+	// Top down, one depth level at a time. Only nodes whose own transform or an ancestor's changed are recomputed.
+	void SceneManager::UpdateSceneNodeTransforms()
+	{
+		uint32_t const min_nodes_per_worker = 1024;
+		for (size_t level = 0; level + 1 < flat_level_offsets_.size(); ++ level)
+		{
+			uint32_t const level_begin = flat_level_offsets_[level];
+			uint32_t const num_level_nodes = flat_level_offsets_[level + 1] - level_begin;
+			parallel_for_chunks(Context::Instance().ThreadPool(), num_level_nodes,
+				num_parallel_workers(num_level_nodes, min_nodes_per_worker),
+				[this, level_begin](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					KFL_UNUSED(worker);
+					for (uint32_t i = level_begin + first; i < level_begin + last; ++ i)
+					{
+						auto& node = *flat_nodes_[i];
+						int32_t const parent = flat_parents_[i];
+						bool const dirty = node.TransformsDirty() || ((parent >= 0) && flat_world_changed_[parent]);
+						if (dirty)
+						{
+							node.UpdateTransforms();
+						}
+						flat_world_changed_[i] = dirty;
+					}
+				});
+		}
+	}
+
+	// Bottom up, one depth level at a time. Renderables can change their bounds without telling the node, so nodes with
+	// components are always refreshed. Others only when they are dirty or a child's bound changed.
+	bool SceneManager::UpdateSceneNodeBounds()
+	{
+		uint32_t const min_nodes_per_worker = 1024;
+		for (size_t level = flat_level_offsets_.size() - 1; level > 0; -- level)
+		{
+			uint32_t const level_begin = flat_level_offsets_[level - 1];
+			uint32_t const num_level_nodes = flat_level_offsets_[level] - level_begin;
+			parallel_for_chunks(Context::Instance().ThreadPool(), num_level_nodes,
+				num_parallel_workers(num_level_nodes, min_nodes_per_worker),
+				[this, level_begin](uint32_t worker, uint32_t first, uint32_t last)
+				{
+					KFL_UNUSED(worker);
+					for (uint32_t i = level_begin + first; i < level_begin + last; ++ i)
+					{
+						auto& node = *flat_nodes_[i];
+						bool need_update = node.PosBoundDirty() || (node.NumComponents() > 0);
+						for (uint32_t c = 0; (c < flat_num_children_[i]) && !need_update; ++ c)
+						{
+							need_update = (flat_bound_changed_[flat_first_children_[i] + c] != 0);
+						}
+						flat_bound_changed_[i] = need_update && node.UpdatePosBound();
+					}
+				});
+		}
+
+		return std::any_of(flat_bound_changed_.begin(), flat_bound_changed_.end(), [](uint8_t changed) { return changed != 0; });
+	}
+
 	BoundOverlap SceneManager::VisibleTestFromParent(SceneNode const & node, float3 const & view_dir, float3 const & eye_pos,
 		float4x4 const & view_proj)
 	{
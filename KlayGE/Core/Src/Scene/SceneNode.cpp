@@ -33,11 +33,17 @@
 #include <KlayGE/SceneManager.hpp>
 #include <KlayGE/Context.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
 
 #include <boost/assert.hpp>
 
 #include <KlayGE/SceneNode.hpp>
 
+namespace
+{
+	thread_local std::vector<std::function<void()>>* sub_thread_writes = nullptr;
+}
+
 namespace KlayGE
 {
 	SceneNode::SceneNode(uint32_t attrib)
@@ -159,6 +165,7 @@ namespace KlayGE
 		parent_ = so;
 
 		pos_aabb_dirty_ = true;
+		xform_dirty_ = true;
 		updated_ = false;
 	}
 
@@ -175,6 +182,8 @@ namespace KlayGE
 			pos_aabb_dirty_ = true;
 			node->Parent(this);
 			children_.push_back(node);
+
+			this->EmitSceneChanged();
 		}
 	}
 
@@ -296,13 +305,26 @@ namespace KlayGE
 
 	void SceneNode::TransformToParent(float4x4 const& mat)
 	{
+		if (sub_thread_writes != nullptr)
+		{
+			sub_thread_writes->emplace_back([this, mat] { this->TransformToParent(mat); });
+			return;
+		}
+
 		xform_to_parent_ = mat;
 		inv_xform_to_parent_ = MathLib::inverse(mat);
 		pos_aabb_dirty_ = true;
+		xform_dirty_ = true;
 	}
 
 	void SceneNode::TransformToWorld(float4x4 const& mat)
 	{
+		if (sub_thread_writes != nullptr)
+		{
+			sub_thread_writes->emplace_back([this, mat] { this->TransformToWorld(mat); });
+			return;
+		}
+
 		if (parent_)
 		{
 			xform_to_parent_ = mat * parent_->InverseTransformToWorld();
@@ -314,6 +336,30 @@ namespace KlayGE
 		inv_xform_to_parent_ = MathLib::inverse(mat);
 
 		pos_aabb_dirty_ = true;
+		xform_dirty_ = true;
+	}
+
+	void SceneNode::BeginSubThreadWrites(std::vector<std::function<void()>>& writes)
+	{
+		BOOST_ASSERT(nullptr == sub_thread_writes);
+		sub_thread_writes = &writes;
+	}
+
+	void SceneNode::EndSubThreadWrites()
+	{
+		sub_thread_writes = nullptr;
+	}
+
+	void SceneNode::DeferSubThreadWrite(std::function<void()> const & write)
+	{
+		if (sub_thread_writes != nullptr)
+		{
+			sub_thread_writes->push_back(write);
+		}
+		else
+		{
+			write();
+		}
 	}
 
 	float4x4 const& SceneNode::TransformToParent() const
@@ -328,8 +374,9 @@ namespace KlayGE
 
 	float4x4 const& SceneNode::TransformToWorld() const
 	{
+		// Workers of the sub thread pass run beside the main thread, they get the result of the last update
 		auto& scene_mgr = Context::Instance().SceneManagerInstance();
-		if (!scene_mgr.NodesUpdated())
+		if (!scene_mgr.NodesUpdated() && (nullptr == sub_thread_writes))
 		{
 			auto* parent = this->Parent();
 			xform_to_world_ = xform_to_parent_;
@@ -345,7 +392,7 @@ namespace KlayGE
 	float4x4 const& SceneNode::InverseTransformToWorld() const
 	{
 		auto& scene_mgr = Context::Instance().SceneManagerInstance();
-		if (!scene_mgr.NodesUpdated())
+		if (!scene_mgr.NodesUpdated() && (nullptr == sub_thread_writes))
 		{
 			inv_xform_to_world_ = MathLib::inverse(this->TransformToWorld());
 		}
@@ -362,11 +409,13 @@ namespace KlayGE
 		return *pos_aabb_ws_;
 	}
 
+	// Called in parallel per depth level, after the parent's level is done. The parent's world matrix is read directly,
+	// because TransformToWorld() would refill the parent's cache from every child's thread.
 	void SceneNode::UpdateTransforms()
 	{
 		if (parent_)
 		{
-			xform_to_world_ = xform_to_parent_ * parent_->TransformToWorld();
+			xform_to_world_ = xform_to_parent_ * parent_->xform_to_world_;
 		}
 		else
 		{
@@ -375,6 +424,17 @@ namespace KlayGE
 		inv_xform_to_world_ = MathLib::inverse(xform_to_world_);
 
 		pos_aabb_dirty_ = true;
+		xform_dirty_ = false;
+	}
+
+	bool SceneNode::TransformsDirty() const
+	{
+		return xform_dirty_;
+	}
+
+	bool SceneNode::PosBoundDirty() const
+	{
+		return pos_aabb_dirty_;
 	}
 
 	bool SceneNode::Updated() const
@@ -431,6 +491,15 @@ namespace KlayGE
 
 	void SceneNode::Visible(bool vis)
 	{
+		if (vis != this->Visible())
+		{
+			auto& context = Context::Instance();
+			if (context.SceneManagerValid())
+			{
+				context.SceneManagerInstance().OnSceneNodeVisibleChanged(*this);
+			}
+		}
+
 		if (vis)
 		{
 			attrib_ &= ~SOA_Invisible;
@@ -570,47 +639,62 @@ namespace KlayGE
 		}
 	}
 
-	void SceneNode::UpdatePosBoundSubtree()
+	bool SceneNode::UpdatePosBoundSubtree()
 	{
+		bool changed = false;
 		for (auto const & child : children_)
 		{
-			child->UpdatePosBoundSubtree();
+			changed |= child->UpdatePosBoundSubtree();
 		}
 
 		if (pos_aabb_dirty_)
 		{
-			if (pos_aabb_os_)
-			{
-				pos_aabb_os_->Min() = float3(+1e10f, +1e10f, +1e10f);
-				pos_aabb_os_->Max() = float3(-1e10f, -1e10f, -1e10f);
+			changed |= this->UpdatePosBound();
+		}
+
+		return changed;
+	}
+
+	bool SceneNode::UpdatePosBound()
+	{
+		bool changed = false;
+		if (pos_aabb_os_)
+		{
+			AABBox const old_aabb_ws = *pos_aabb_ws_;
 
-				for (auto const& component : components_)
+			pos_aabb_os_->Min() = float3(+1e10f, +1e10f, +1e10f);
+			pos_aabb_os_->Max() = float3(-1e10f, -1e10f, -1e10f);
+
+			for (auto const& component : components_)
+			{
+				auto const* renderable_comp = boost::typeindex::runtime_cast<RenderableComponent*>(component.get());
+				if (renderable_comp != nullptr)
 				{
-					auto const* renderable_comp = boost::typeindex::runtime_cast<RenderableComponent*>(component.get());
-					if (renderable_comp != nullptr)
-					{
-						*pos_aabb_os_ |= renderable_comp->BoundRenderable().PosBound();
-					}
+					*pos_aabb_os_ |= renderable_comp->BoundRenderable().PosBound();
 				}
+			}
 
-				for (auto const & child : children_)
+			for (auto const & child : children_)
+			{
+				if (child->pos_aabb_os_)
 				{
-					if (child->pos_aabb_os_)
+					if ((child->pos_aabb_os_->Min().x() < child->pos_aabb_os_->Max().x())
+						&& (child->pos_aabb_os_->Min().y() < child->pos_aabb_os_->Max().y())
+						&& (child->pos_aabb_os_->Min().z() < child->pos_aabb_os_->Max().z()))
 					{
-						if ((child->pos_aabb_os_->Min().x() < child->pos_aabb_os_->Max().x())
-							&& (child->pos_aabb_os_->Min().y() < child->pos_aabb_os_->Max().y())
-							&& (child->pos_aabb_os_->Min().z() < child->pos_aabb_os_->Max().z()))
-						{
-							*pos_aabb_os_ |= MathLib::transform_aabb(*child->pos_aabb_os_, child->TransformToParent());
-						}
+						AABBox child_aabb;
+						SIMDMathLib::TransformAABBox(&child_aabb, child->pos_aabb_os_.get(), 1, child->TransformToParent());
+						*pos_aabb_os_ |= child_aabb;
 					}
 				}
-
-				*pos_aabb_ws_ = MathLib::transform_aabb(*pos_aabb_os_, xform_to_world_);
 			}
 
-			pos_aabb_dirty_ = false;
+			SIMDMathLib::TransformAABBox(pos_aabb_ws_.get(), pos_aabb_os_.get(), 1, xform_to_world_);
+			changed = !(*pos_aabb_ws_ == old_aabb_ws);
 		}
+
+		pos_aabb_dirty_ = false;
+		return changed;
 	}
 
 	void SceneNode::EmitSceneChanged()
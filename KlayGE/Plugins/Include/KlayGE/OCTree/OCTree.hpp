@@ -29,6 +29,7 @@
 #include <KlayGE/SceneManager.hpp>
 #include <KFL/AABBox.hpp>
 
+#include <unordered_map>
 #include <vector>
 
 namespace KlayGE
@@ -46,6 +47,7 @@ namespace KlayGE
 		virtual BoundOverlap AABBVisible(AABBox const & aabb) const override;
 		virtual BoundOverlap OBBVisible(OBBox const & obb) const override;
 		virtual BoundOverlap SphereVisible(Sphere const & sphere) const override;
+		virtual void AABBsVisible(AABBoxSoA const & aabbs, uint32_t* visible_masks) const override;
 
 		virtual void ClearObject() override;
 
@@ -55,9 +57,21 @@ namespace KlayGE
 		void DoSuspend() override;
 		void DoResume() override;
 
-		void DivideNode(size_t index, uint32_t curr_depth);
+		void SyncObjects();
+		void RebuildTree();
+		bool InsertObj(SceneNode* node, AABBox const & aabb);
+		void RemoveObj(uint32_t node_index, uint32_t obj_index);
+		bool RefitObj(SceneNode* node, AABBox const & aabb);
+		void AllocateChildren(size_t index);
+		void ReleaseChildren(size_t index);
+		BoundOverlap TrackedObjVisible(SceneNode* node) const;
+
 		void NodeVisible(size_t index);
-		void MarkNodeObjs(size_t index, bool force);
+		void CollectVisibleNodes(size_t index, bool force);
+		void TestNodeObjs(float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj);
+		void TestNodeObjRange(uint32_t first, uint32_t last,
+			float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj);
+		void MarkNodeObjs(float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj);
 
 		BoundOverlap BoundVisible(size_t index, AABBox const & aabb) const;
 		BoundOverlap BoundVisible(size_t index, OBBox const & obb) const;
@@ -69,20 +83,48 @@ namespace KlayGE
 		OCTree& operator=(OCTree const & rhs);
 
 	private:
+		// A loose octree. Every object lives in exactly one node, the deepest one whose loose bound, the cell grown by half
+		// of its size on each side, still contains the object. Children are allocated 8 at a time when an object needs them.
 		struct octree_node_t
 		{
 			AABBox bb;
+			AABBox loose_bb;
 			int first_child_index;
+			int parent_index;
+			uint32_t depth;
+			uint32_t num_subtree_objs;
 			BoundOverlap visible;
+			uint32_t collected_pass;
+
+			std::vector<SceneNode*> objs;
+			AABBoxSoA obj_bbs;
+
+			// Per-pass results of the parallel pass, indexed like objs
+			std::vector<BoundOverlap> obj_frustum_visible;
+			std::vector<uint8_t> obj_large_enough;
+		};
 
-			std::vector<SceneNode*> node_ptrs;
+		struct obj_location_t
+		{
+			uint32_t node_index;
+			uint32_t obj_index;
+			uint32_t sync_stamp;
 		};
 
 		std::vector<octree_node_t> octree_;
+		std::vector<uint32_t> free_child_blocks_;
+		std::unordered_map<SceneNode*, obj_location_t> obj_locations_;
+
+		std::vector<uint32_t> visible_nodes_;
+		std::vector<uint32_t> visible_node_obj_offsets_;
 
 		uint32_t max_tree_depth_;
 
+		uint32_t sync_stamp_;
+		uint32_t last_sync_frame_;
+		uint32_t clip_pass_;
 		bool rebuild_tree_;
+		bool scene_changed_;
 
 #ifdef KLAYGE_DRAW_NODES
 		RenderablePtr node_renderable_;
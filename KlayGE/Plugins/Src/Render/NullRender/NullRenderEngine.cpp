@@ -31,6 +31,7 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/ErrorHandling.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/RenderEffect.hpp>
 
 #include <KlayGE/NullRender/NullRenderEngine.hpp>
 
@@ -161,8 +162,9 @@ namespace KlayGE
 	void NullRenderEngine::DoRender(RenderEffect const & effect, RenderTechnique const & tech, RenderLayout const & rl)
 	{
 		KFL_UNUSED(effect);
-		KFL_UNUSED(tech);
 		KFL_UNUSED(rl);
+
+		num_draws_just_called_ += tech.NumPasses();
 	}
 
 	void NullRenderEngine::DoDispatch(RenderEffect const & effect, RenderTechnique const & tech, uint32_t tgx, uint32_t tgy, uint32_t tgz)
@@ -28,6 +28,8 @@
 #include <KFL/Vector.hpp>
 #include <KFL/Matrix.hpp>
 #include <KFL/Plane.hpp>
+#include <KFL/Thread.hpp>
+#include <KlayGE/Context.hpp>
 #include <KlayGE/SceneNode.hpp>
 #include <KlayGE/Camera.hpp>
 #include <KlayGE/App3D.hpp>
@@ -37,7 +39,6 @@
 #include <boost/assert.hpp>
 
 #ifdef KLAYGE_DRAW_NODES
-#include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #endif
@@ -94,16 +95,46 @@ namespace
 }
 #endif
 
+namespace
+{
+	using namespace KlayGE;
+
+	AABBox ChildCell(AABBox const & parent_bb, uint32_t j)
+	{
+		float3 const parent_center = parent_bb.Center();
+		return AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
+				(j & 2) ? parent_center.y() : parent_bb.Min().y(),
+				(j & 4) ? parent_center.z() : parent_bb.Min().z()),
+			float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
+				(j & 2) ? parent_bb.Max().y() : parent_center.y(),
+				(j & 4) ? parent_bb.Max().z() : parent_center.z()));
+	}
+
+	AABBox LooseBound(AABBox const & bb)
+	{
+		float3 const half_size = bb.HalfSize();
+		return AABBox(bb.Min() - half_size, bb.Max() + half_size);
+	}
+
+	bool InBound(AABBox const & outer, AABBox const & inner)
+	{
+		return outer.VecInBound(inner.Min()) && outer.VecInBound(inner.Max());
+	}
+}
+
 namespace KlayGE
 {
 	OCTree::OCTree()
-		: max_tree_depth_(4), rebuild_tree_(false)
+		: max_tree_depth_(4),
+			sync_stamp_(0), last_sync_frame_(0xFFFFFFFF), clip_pass_(0),
+			rebuild_tree_(true), scene_changed_(false)
 	{
 	}
 
 	void OCTree::MaxTreeDepth(uint32_t max_tree_depth)
 	{
 		max_tree_depth_ = std::min<uint32_t>(max_tree_depth, 16UL);
+		rebuild_tree_ = true;
 	}
 
 	uint32_t OCTree::MaxTreeDepth() const
@@ -113,32 +144,8 @@ namespace KlayGE
 
 	void OCTree::ClipScene()
 	{
-		if (rebuild_tree_)
-		{
-			octree_.resize(1);
-			AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
-			octree_[0].first_child_index = -1;
-			octree_[0].visible = BO_No;
-			for (auto* sn : all_scene_nodes_)
-			{
-				auto const & node = *sn;
-				uint32_t const attr = node.Attrib();
-				if (node.Updated() && (attr & SceneNode::SOA_Cullable) && !(attr & SceneNode::SOA_Moveable))
-				{
-					bb_root |= node.PosBoundWS();
-					octree_[0].node_ptrs.push_back(sn);
-				}
-			}
-			float3 const & center = bb_root.Center();
-			float3 const & extent = bb_root.HalfSize();
-			float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
-			float3 new_extent(longest_dim, longest_dim, longest_dim);
-			octree_[0].bb = AABBox(center - new_extent, center + new_extent);
-
-			this->DivideNode(0, 1);
-
-			rebuild_tree_ = false;
-		}
+		this->SyncObjects();
+		++ clip_pass_;
 
 #ifdef KLAYGE_DRAW_NODES
 		if (!node_renderable_)
@@ -207,7 +214,10 @@ namespace KlayGE
 		{
 			if (!octree_.empty())
 			{
-				this->MarkNodeObjs(0, false);
+				visible_nodes_.clear();
+				this->CollectVisibleNodes(0, false);
+				this->TestNodeObjs(camera.ForwardVec(), camera.EyePos(), view_proj);
+				this->MarkNodeObjs(camera.ForwardVec(), camera.EyePos(), view_proj);
 			}
 
 			for (auto* sn : all_scene_nodes_)
@@ -224,7 +234,7 @@ namespace KlayGE
 						{
 							if (attr & SceneNode::SOA_Moveable)
 							{
-								visible = this->AABBVisible(node.PosBoundWS());
+								visible = this->TrackedObjVisible(sn);
 							}
 						}
 						else
@@ -248,12 +258,15 @@ namespace KlayGE
 		SceneManager::ClearObject();
 
 		octree_.clear();
+		free_child_blocks_.clear();
+		obj_locations_.clear();
 		rebuild_tree_ = true;
 	}
 
 	void OCTree::OnSceneChanged()
 	{
-		rebuild_tree_ = true;
+		SceneManager::OnSceneChanged();
+		scene_changed_ = true;
 	}
 
 	void OCTree::DoSuspend()
@@ -266,60 +279,302 @@ namespace KlayGE
 		// TODO
 	}
 
-	void OCTree::DivideNode(size_t index, uint32_t curr_depth)
+	// Brings the tree up to date with the scene once per frame. New objects are inserted, objects whose bound changed
+	// are refitted in place or moved to another node, and removed objects are dropped when the scene reported a change.
+	// The whole tree is only rebuilt if an object falls outside the root.
+	void OCTree::SyncObjects()
 	{
-		if (octree_[index].node_ptrs.size() > 1)
+		uint32_t const frame = Context::Instance().AppInstance().TotalNumFrames();
+		if ((frame == last_sync_frame_) && !rebuild_tree_ && !scene_changed_)
 		{
-			size_t const this_size = octree_.size();
-			AABBox const parent_bb = octree_[index].bb;
-			float3 const parent_center = parent_bb.Center();
-			octree_[index].first_child_index = static_cast<int>(this_size);
-			octree_[index].visible = BO_No;
+			return;
+		}
+		last_sync_frame_ = frame;
 
-			octree_.resize(this_size + 8);
-			for (auto* node : octree_[index].node_ptrs)
+		if (!rebuild_tree_)
+		{
+			++ sync_stamp_;
+			for (auto* sn : all_scene_nodes_)
 			{
-				AABBox const & aabb = node->PosBoundWS();
-				int mark[6];
-				mark[0] = aabb.Min().x() >= parent_center.x() ? 1 : 0;
-				mark[1] = aabb.Min().y() >= parent_center.y() ? 2 : 0;
-				mark[2] = aabb.Min().z() >= parent_center.z() ? 4 : 0;
-				mark[3] = aabb.Max().x() >= parent_center.x() ? 1 : 0;
-				mark[4] = aabb.Max().y() >= parent_center.y() ? 2 : 0;
-				mark[5] = aabb.Max().z() >= parent_center.z() ? 4 : 0;
-				for (int j = 0; j < 8; ++ j)
+				auto const & node = *sn;
+				uint32_t const attr = node.Attrib();
+				if (node.Updated() && (attr & SceneNode::SOA_Cullable))
 				{
-					if (j == ((j & 1) ? mark[3] : mark[0])
-						+ ((j & 2) ? mark[4] : mark[1])
-						+ ((j & 4) ? mark[5] : mark[2]))
+					AABBox const & aabb = node.PosBoundWS();
+					auto iter = obj_locations_.find(sn);
+					if (iter == obj_locations_.end())
+					{
+						rebuild_tree_ = !this->InsertObj(sn, aabb);
+					}
+					else
+					{
+						auto& loc = iter->second;
+						loc.sync_stamp = sync_stamp_;
+						if (!(octree_[loc.node_index].obj_bbs.Get(loc.obj_index) == aabb))
+						{
+							rebuild_tree_ = !this->RefitObj(sn, aabb);
+						}
+					}
+
+					if (rebuild_tree_)
 					{
-						octree_[this_size + j].node_ptrs.push_back(node);
+						break;
 					}
 				}
 			}
+		}
 
-			for (size_t j = 0; j < 8; ++ j)
+		if (!rebuild_tree_ && scene_changed_)
+		{
+			for (auto iter = obj_locations_.begin(); iter != obj_locations_.end();)
 			{
-				octree_node_t& new_node = octree_[this_size + j];
-				new_node.first_child_index = -1;
-				new_node.bb = AABBox(float3((j & 1) ? parent_center.x() : parent_bb.Min().x(),
-						(j & 2) ? parent_center.y() : parent_bb.Min().y(),
-						(j & 4) ? parent_center.z() : parent_bb.Min().z()),
-					float3((j & 1) ? parent_bb.Max().x() : parent_center.x(),
-						(j & 2) ? parent_bb.Max().y() : parent_center.y(),
-						(j & 4) ? parent_bb.Max().z() : parent_center.z()));
-
-				if (curr_depth < max_tree_depth_)
+				if (iter->second.sync_stamp != sync_stamp_)
 				{
-					this->DivideNode(this_size + j, curr_depth + 1);
+					this->RemoveObj(iter->second.node_index, iter->second.obj_index);
+					iter = obj_locations_.erase(iter);
 				}
+				else
+				{
+					++ iter;
+				}
+			}
+		}
+
+		if (rebuild_tree_)
+		{
+			this->RebuildTree();
+		}
+
+		scene_changed_ = false;
+	}
+
+	void OCTree::RebuildTree()
+	{
+		octree_.clear();
+		free_child_blocks_.clear();
+		obj_locations_.clear();
+
+		AABBox bb_root(float3(0, 0, 0), float3(0, 0, 0));
+		for (auto* sn : all_scene_nodes_)
+		{
+			auto const & node = *sn;
+			uint32_t const attr = node.Attrib();
+			if (node.Updated() && (attr & SceneNode::SOA_Cullable))
+			{
+				bb_root |= node.PosBoundWS();
+			}
+		}
+		float3 const & center = bb_root.Center();
+		float3 const & extent = bb_root.HalfSize();
+		float longest_dim = std::max(std::max(extent.x(), extent.y()), extent.z());
+		float3 new_extent(longest_dim, longest_dim, longest_dim);
+
+		octree_.resize(1);
+		auto& root = octree_[0];
+		root.bb = AABBox(center - new_extent, center + new_extent);
+		root.loose_bb = LooseBound(root.bb);
+		root.first_child_index = -1;
+		root.parent_index = -1;
+		root.depth = 1;
+		root.num_subtree_objs = 0;
+		root.visible = BO_No;
+		root.collected_pass = 0;
+
+		++ sync_stamp_;
+		for (auto* sn : all_scene_nodes_)
+		{
+			auto const & node = *sn;
+			uint32_t const attr = node.Attrib();
+			if (node.Updated() && (attr & SceneNode::SOA_Cullable))
+			{
+				bool const inserted = this->InsertObj(sn, node.PosBoundWS());
+				BOOST_ASSERT(inserted);
+				KFL_UNUSED(inserted);
 			}
+		}
+
+		rebuild_tree_ = false;
+	}
 
-			octree_[index].node_ptrs.clear();
-			octree_[index].node_ptrs.shrink_to_fit();
+	// Walks down from the root while a child's loose bound still holds the object. Returns false if the object is
+	// outside of the root's loose bound, in which case the tree has to grow.
+	bool OCTree::InsertObj(SceneNode* node, AABBox const & aabb)
+	{
+		BOOST_ASSERT(!octree_.empty());
+
+		if (!InBound(octree_[0].loose_bb, aabb))
+		{
+			return false;
+		}
+
+		float3 const center = aabb.Center();
+		float3 const half_size = aabb.HalfSize();
+		float const obj_extent = std::max(std::max(half_size.x(), half_size.y()), half_size.z());
+
+		uint32_t index = 0;
+		while (octree_[index].depth < max_tree_depth_)
+		{
+			AABBox const node_bb = octree_[index].bb;
+			if (obj_extent > node_bb.HalfSize().x() / 2)
+			{
+				break;
+			}
+
+			float3 const node_center = node_bb.Center();
+			uint32_t const j = (center.x() >= node_center.x() ? 1 : 0)
+				+ (center.y() >= node_center.y() ? 2 : 0)
+				+ (center.z() >= node_center.z() ? 4 : 0);
+			if (!InBound(LooseBound(ChildCell(node_bb, j)), aabb))
+			{
+				break;
+			}
+
+			if (-1 == octree_[index].first_child_index)
+			{
+				this->AllocateChildren(index);
+			}
+			index = octree_[index].first_child_index + j;
+		}
+
+		auto& octree_node = octree_[index];
+		obj_location_t loc;
+		loc.node_index = index;
+		loc.obj_index = static_cast<uint32_t>(octree_node.objs.size());
+		loc.sync_stamp = sync_stamp_;
+		obj_locations_[node] = loc;
+
+		octree_node.objs.push_back(node);
+		octree_node.obj_bbs.PushBack(aabb);
+		octree_node.obj_frustum_visible.push_back(BO_No);
+		octree_node.obj_large_enough.push_back(0);
+
+		for (int i = index; i != -1; i = octree_[i].parent_index)
+		{
+			++ octree_[i].num_subtree_objs;
+		}
+
+		return true;
+	}
+
+	void OCTree::RemoveObj(uint32_t node_index, uint32_t obj_index)
+	{
+		auto& octree_node = octree_[node_index];
+		uint32_t const last = static_cast<uint32_t>(octree_node.objs.size() - 1);
+		if (obj_index != last)
+		{
+			auto* moved = octree_node.objs[last];
+			octree_node.objs[obj_index] = moved;
+			octree_node.obj_bbs.Set(obj_index, octree_node.obj_bbs.Get(last));
+
+			auto iter = obj_locations_.find(moved);
+			BOOST_ASSERT(iter != obj_locations_.end());
+			iter->second.obj_index = obj_index;
+		}
+		octree_node.objs.pop_back();
+		octree_node.obj_bbs.Resize(last);
+		octree_node.obj_frustum_visible.pop_back();
+		octree_node.obj_large_enough.pop_back();
+
+		int empty_index = -1;
+		for (int i = node_index; i != -1; i = octree_[i].parent_index)
+		{
+			-- octree_[i].num_subtree_objs;
+			if (0 == octree_[i].num_subtree_objs)
+			{
+				empty_index = i;
+			}
+		}
+		if (empty_index != -1)
+		{
+			this->ReleaseChildren(empty_index);
 		}
 	}
 
+	// Most moves stay inside the loose bound of the object's node, which only needs its bound updated.
+	bool OCTree::RefitObj(SceneNode* node, AABBox const & aabb)
+	{
+		auto iter = obj_locations_.find(node);
+		BOOST_ASSERT(iter != obj_locations_.end());
+
+		auto& octree_node = octree_[iter->second.node_index];
+		if (InBound(octree_node.loose_bb, aabb))
+		{
+			octree_node.obj_bbs.Set(iter->second.obj_index, aabb);
+			return true;
+		}
+
+		this->RemoveObj(iter->second.node_index, iter->second.obj_index);
+		obj_locations_.erase(iter);
+		return this->InsertObj(node, aabb);
+	}
+
+	void OCTree::AllocateChildren(size_t index)
+	{
+		uint32_t first_child;
+		if (free_child_blocks_.empty())
+		{
+			first_child = static_cast<uint32_t>(octree_.size());
+			octree_.resize(first_child + 8);
+		}
+		else
+		{
+			first_child = free_child_blocks_.back();
+			free_child_blocks_.pop_back();
+		}
+
+		auto& parent = octree_[index];
+		parent.first_child_index = static_cast<int>(first_child);
+		for (uint32_t j = 0; j < 8; ++ j)
+		{
+			auto& child = octree_[first_child + j];
+			BOOST_ASSERT(child.objs.empty());
+
+			child.bb = ChildCell(parent.bb, j);
+			child.loose_bb = LooseBound(child.bb);
+			child.first_child_index = -1;
+			child.parent_index = static_cast<int>(index);
+			child.depth = parent.depth + 1;
+			child.num_subtree_objs = 0;
+			child.visible = BO_No;
+			child.collected_pass = 0;
+		}
+	}
+
+	void OCTree::ReleaseChildren(size_t index)
+	{
+		auto& octree_node = octree_[index];
+		if (octree_node.first_child_index != -1)
+		{
+			int const first_child = octree_node.first_child_index;
+			octree_node.first_child_index = -1;
+			for (int j = 0; j < 8; ++ j)
+			{
+				this->ReleaseChildren(first_child + j);
+			}
+			free_child_blocks_.push_back(first_child);
+		}
+	}
+
+	// Moveable objects are marked in the scene graph order, after their parents. Their frustum and size tests already
+	// ran in the parallel pass if their node was visible.
+	BoundOverlap OCTree::TrackedObjVisible(SceneNode* node) const
+	{
+		auto iter = obj_locations_.find(node);
+		if (iter == obj_locations_.end())
+		{
+			return this->AABBVisible(node->PosBoundWS());
+		}
+
+		auto const & loc = iter->second;
+		auto const & octree_node = octree_[loc.node_index];
+		if ((octree_node.collected_pass != clip_pass_)
+			|| ((small_obj_threshold_ > 0) && !octree_node.obj_large_enough[loc.obj_index]))
+		{
+			return BO_No;
+		}
+		return octree_node.obj_frustum_visible[loc.obj_index];
+	}
+
 	void OCTree::NodeVisible(size_t index)
 	{
 		BOOST_ASSERT(index < octree_.size());
@@ -340,10 +595,10 @@ namespace KlayGE
 
 		auto& octree_node = octree_[index];
 		if ((small_obj_threshold_ <= 0)
-			|| ((MathLib::ortho_area(camera.ForwardVec(), octree_node.bb) > small_obj_threshold_)
-				&& (MathLib::perspective_area(camera.EyePos(), view_proj, octree_node.bb) > small_obj_threshold_)))
+			|| ((MathLib::ortho_area(camera.ForwardVec(), octree_node.loose_bb) > small_obj_threshold_)
+				&& (MathLib::perspective_area(camera.EyePos(), view_proj, octree_node.loose_bb) > small_obj_threshold_)))
 		{
-			BoundOverlap const vis = frustum_->Intersect(octree_node.bb);
+			BoundOverlap const vis = frustum_->Intersect(octree_node.loose_bb);
 			octree_node.visible = vis;
 			if (BO_Partial == vis)
 			{
@@ -369,40 +624,113 @@ namespace KlayGE
 #endif
 	}
 
-	void OCTree::MarkNodeObjs(size_t index, bool force)
+	void OCTree::CollectVisibleNodes(size_t index, bool force)
 	{
 		BOOST_ASSERT(index < octree_.size());
 
-		App3DFramework& app = Context::Instance().AppInstance();
-		Camera& camera = app.ActiveCamera();
+		auto& octree_node = octree_[index];
+		if ((octree_node.num_subtree_objs > 0) && ((octree_node.visible != BO_No) || force))
+		{
+			if (!octree_node.objs.empty())
+			{
+				octree_node.collected_pass = clip_pass_;
+				visible_nodes_.push_back(static_cast<uint32_t>(index));
+			}
 
-		float4x4 view_proj = camera.ViewProjMatrix();
-		auto drl = Context::Instance().DeferredRenderingLayerInstance();
-		if (drl)
+			if (octree_node.first_child_index != -1)
+			{
+				for (int i = 0; i < 8; ++ i)
+				{
+					this->CollectVisibleNodes(octree_node.first_child_index + i, (BO_Yes == octree_node.visible) || force);
+				}
+			}
+		}
+	}
+
+	// The frustum and size tests of an object don't depend on other objects, so they run in parallel chunks over the
+	// objects of all visible nodes. Applying the parent's visibility has to follow the tree order, in MarkNodeObjs.
+	void OCTree::TestNodeObjs(float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj)
+	{
+		visible_node_obj_offsets_.resize(visible_nodes_.size() + 1);
+		uint32_t num_objs = 0;
+		for (size_t i = 0; i < visible_nodes_.size(); ++ i)
 		{
-			int32_t cas_index = drl->CurrCascadeIndex();
-			if (cas_index >= 0)
+			visible_node_obj_offsets_[i] = num_objs;
+			num_objs += static_cast<uint32_t>(octree_[visible_nodes_[i]].objs.size());
+		}
+		visible_node_obj_offsets_.back() = num_objs;
+
+		uint32_t const min_objs_per_worker = 4096;
+		parallel_for_chunks(Context::Instance().ThreadPool(), num_objs, num_parallel_workers(num_objs, min_objs_per_worker),
+			[this, &view_dir, &eye_pos, &view_proj](uint32_t worker, uint32_t first, uint32_t last)
 			{
-				view_proj *= drl->GetCascadedShadowLayer()->CascadeCropMatrix(cas_index);
+				KFL_UNUSED(worker);
+				this->TestNodeObjRange(first, last, view_dir, eye_pos, view_proj);
+			});
+	}
+
+	void OCTree::TestNodeObjRange(uint32_t first, uint32_t last,
+		float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj)
+	{
+		if (first >= last)
+		{
+			return;
+		}
+
+		size_t visible_node = std::upper_bound(visible_node_obj_offsets_.begin(), visible_node_obj_offsets_.end(), first)
+			- visible_node_obj_offsets_.begin() - 1;
+		for (uint32_t pos = first; pos < last; ++ visible_node)
+		{
+			auto& octree_node = octree_[visible_nodes_[visible_node]];
+			uint32_t const begin = pos - visible_node_obj_offsets_[visible_node];
+			uint32_t const count = std::min(static_cast<uint32_t>(octree_node.objs.size()) - begin, last - pos);
+
+			MathLib::intersect_aabb_frustum(octree_node.obj_bbs, begin, count, *frustum_,
+				&octree_node.obj_frustum_visible[begin]);
+			if (small_obj_threshold_ > 0)
+			{
+				for (uint32_t i = begin; i < begin + count; ++ i)
+				{
+					AABBox const aabb_ws = octree_node.obj_bbs.Get(i);
+					octree_node.obj_large_enough[i] = (MathLib::ortho_area(view_dir, aabb_ws) > small_obj_threshold_)
+						&& (MathLib::perspective_area(eye_pos, view_proj, aabb_ws) > small_obj_threshold_);
+				}
 			}
+
+			pos += count;
 		}
+	}
 
-		auto const & octree_node = octree_[index];
-		if ((octree_node.visible != BO_No) || force)
+	void OCTree::MarkNodeObjs(float3 const & view_dir, float3 const & eye_pos, float4x4 const & view_proj)
+	{
+		for (auto const index : visible_nodes_)
 		{
-			for (auto* node : octree_node.node_ptrs)
+			auto const & octree_node = octree_[index];
+			for (uint32_t i = 0; i < octree_node.objs.size(); ++ i)
 			{
-				if ((BO_No == node->VisibleMark()) && node->Visible())
+				auto* node = octree_node.objs[i];
+				if ((BO_No == node->VisibleMark()) && node->Visible() && !(node->Attrib() & SceneNode::SOA_Moveable))
 				{
-					auto visible = this->VisibleTestFromParent(*node, camera.ForwardVec(), camera.EyePos(), view_proj);
-					if (BO_Partial == visible)
+					BoundOverlap visible;
+					if (node->Parent())
+					{
+						BoundOverlap const parent_bo = node->Parent()->VisibleMark();
+						if ((BO_No == parent_bo) || ((small_obj_threshold_ > 0) && !octree_node.obj_large_enough[i]))
+						{
+							visible = BO_No;
+						}
+						else
+						{
+							visible = (BO_Partial == parent_bo) ? octree_node.obj_frustum_visible[i] : parent_bo;
+						}
+					}
+					else
 					{
-						AABBox const & aabb_ws = node->PosBoundWS();
-						if (node->Parent() || (small_obj_threshold_ <= 0)
-							|| ((MathLib::ortho_area(camera.ForwardVec(), octree_node.bb) > small_obj_threshold_)
-								&& (MathLib::perspective_area(camera.EyePos(), view_proj, aabb_ws) > small_obj_threshold_)))
+						if ((small_obj_threshold_ <= 0)
+							|| ((MathLib::ortho_area(view_dir, octree_node.bb) > small_obj_threshold_)
+								&& (MathLib::perspective_area(eye_pos, view_proj, node->PosBoundWS()) > small_obj_threshold_)))
 						{
-							visible = frustum_->Intersect(aabb_ws);
+							visible = octree_node.obj_frustum_visible[i];
 						}
 						else
 						{
@@ -422,14 +750,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			if (octree_node.first_child_index != -1)
-			{
-				for (int i = 0; i < 8; ++ i)
-				{
-					this->MarkNodeObjs(octree_node.first_child_index + i, (BO_Yes == octree_node.visible) || force);
-				}
-			}
 		}
 	}
 
@@ -439,7 +759,7 @@ namespace KlayGE
 		BoundOverlap visible = BO_Yes;
 		if (!octree_.empty())
 		{
-			if (MathLib::intersect_aabb_aabb(octree_[0].bb, aabb))
+			if (MathLib::intersect_aabb_aabb(octree_[0].loose_bb, aabb))
 			{
 				visible = this->BoundVisible(0, aabb);
 			}
@@ -464,13 +784,36 @@ namespace KlayGE
 		return visible;
 	}
 
+	void OCTree::AABBsVisible(AABBoxSoA const & aabbs, uint32_t* visible_masks) const
+	{
+		// Same result as AABBVisible, but the frustum test goes first in one batch, so only the survivors walk the tree
+		SceneManager::AABBsVisible(aabbs, visible_masks);
+
+		if (!octree_.empty())
+		{
+			size_t const num = aabbs.Size();
+			for (size_t i = 0; i < num; ++ i)
+			{
+				uint32_t const bit = 1U << (i % 32);
+				if (visible_masks[i / 32] & bit)
+				{
+					AABBox const aabb = aabbs.Get(i);
+					if (MathLib::intersect_aabb_aabb(octree_[0].loose_bb, aabb) && (BO_No == this->BoundVisible(0, aabb)))
+					{
+						visible_masks[i / 32] &= ~bit;
+					}
+				}
+			}
+		}
+	}
+
 	BoundOverlap OCTree::OBBVisible(OBBox const & obb) const
 	{
 		// Frustum VS node
 		BoundOverlap visible = BO_Yes;
 		if (!octree_.empty())
 		{
-			if (MathLib::intersect_aabb_obb(octree_[0].bb, obb))
+			if (MathLib::intersect_aabb_obb(octree_[0].loose_bb, obb))
 			{
 				visible = this->BoundVisible(0, obb);
 			}
@@ -501,7 +844,7 @@ namespace KlayGE
 		BoundOverlap visible = BO_Yes;
 		if (!octree_.empty())
 		{
-			if (MathLib::intersect_aabb_sphere(octree_[0].bb, sphere))
+			if (MathLib::intersect_aabb_sphere(octree_[0].loose_bb, sphere))
 			{
 				visible = this->BoundVisible(0, sphere);
 			}
@@ -531,7 +874,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < octree_.size());
 
 		octree_node_t const & node = octree_[index];
-		if ((node.visible != BO_No) && MathLib::intersect_aabb_aabb(node.bb, aabb))
+		if ((node.visible != BO_No) && MathLib::intersect_aabb_aabb(node.loose_bb, aabb))
 		{
 			if (BO_Yes == node.visible)
 			{
@@ -543,25 +886,13 @@ namespace KlayGE
 
 				if (node.first_child_index != -1)
 				{
-					float3 const center = node.bb.Center();
-					int mark[6];
-					mark[0] = aabb.Min().x() >= center.x() ? 1 : 0;
-					mark[1] = aabb.Min().y() >= center.y() ? 2 : 0;
-					mark[2] = aabb.Min().z() >= center.z() ? 4 : 0;
-					mark[3] = aabb.Max().x() >= center.x() ? 1 : 0;
-					mark[4] = aabb.Max().y() >= center.y() ? 2 : 0;
-					mark[5] = aabb.Max().z() >= center.z() ? 4 : 0;
-					for (int j = 0; j < 8; ++ j)
+					// Loose children overlap each other, so any of them could hold the bound
+					for (int i = 0; i < 8; ++ i)
 					{
-						if (j == ((j & 1) ? mark[3] : mark[0])
-							+ ((j & 2) ? mark[4] : mark[1])
-							+ ((j & 4) ? mark[5] : mark[2]))
+						BoundOverlap const bo = this->BoundVisible(node.first_child_index + i, aabb);
+						if (bo != BO_No)
 						{
-							BoundOverlap const bo = this->BoundVisible(node.first_child_index + j, aabb);
-							if (bo != BO_No)
-							{
-								return bo;
-							}
+							return bo;
 						}
 					}
 
@@ -584,7 +915,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < octree_.size());
 
 		octree_node_t const & node = octree_[index];
-		if ((node.visible != BO_No) && MathLib::intersect_aabb_obb(node.bb, obb))
+		if ((node.visible != BO_No) && MathLib::intersect_aabb_obb(node.loose_bb, obb))
 		{
 			if (BO_Yes == node.visible)
 			{
@@ -624,7 +955,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < octree_.size());
 
 		octree_node_t const & node = octree_[index];
-		if ((node.visible != BO_No) && MathLib::intersect_aabb_sphere(node.bb, sphere))
+		if ((node.visible != BO_No) && MathLib::intersect_aabb_sphere(node.loose_bb, sphere))
 		{
 			if (BO_Yes == node.visible)
 			{
@@ -664,7 +995,7 @@ namespace KlayGE
 		BOOST_ASSERT(index < octree_.size());
 
 		octree_node_t const & node = octree_[index];
-		if ((node.visible != BO_No) && MathLib::intersect_aabb_frustum(node.bb, frustum))
+		if ((node.visible != BO_No) && MathLib::intersect_aabb_frustum(node.loose_bb, frustum))
 		{
 			if (BO_Yes == node.visible)
 			{
@@ -217,10 +217,13 @@ uint32_t ProceduralTexApp::DoUpdate(uint32_t /*pass*/)
 					KFL_UNUSED(node);
 					KFL_UNUSED(elapsed_time);
 
-					for (uint32_t i = 0; i < polygon_model_->NumMeshes(); ++ i)
-					{
-						checked_pointer_cast<RenderPolygon>(polygon_model_->Mesh(i))->AppTime(app_time);
-					}
+					SceneNode::DeferSubThreadWrite([this, app_time]
+						{
+							for (uint32_t i = 0; i < polygon_model_->NumMeshes(); ++ i)
+							{
+								checked_pointer_cast<RenderPolygon>(polygon_model_->Mesh(i))->AppTime(app_time);
+							}
+						});
 				});
 
 			this->LookAt(float3(-0.18f, 0.24f, -0.18f), float3(0, 0.05f, 0));
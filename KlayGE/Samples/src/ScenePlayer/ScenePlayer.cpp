@@ -29,6 +29,7 @@
 #include <vector>
 #include <sstream>
 #include <fstream>
+#include <mutex>
 
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -60,6 +61,10 @@ namespace
 
 		std::any Run(float app_time, float elapsed_time)
 		{
+			// Scene object scripts run on several threads of the sub thread pass, the script engine isn't thread safe
+			static std::mutex script_mutex;
+			std::lock_guard<std::mutex> lock(script_mutex);
+
 			module_->RunString(*script_);
 
 			return module_->Call("update", { app_time, elapsed_time });
@@ -0,0 +1,241 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Animation.hpp>
+#include <KlayGE/Mesh.hpp>
+
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Joint 0 rotates and moves, joint 1 only rotates, joint 2 doesn't move
+	std::vector<KeyFrameSet> MakeKeyFrameSets()
+	{
+		std::vector<KeyFrameSet> kfs(3);
+		for (uint32_t f = 0; f <= 60; f += 4)
+		{
+			float const t = f / 60.0f;
+
+			Quaternion const rot0 = MathLib::rotation_axis(float3(0, 1, 0), t * PI);
+			kfs[0].frame_id.push_back(f);
+			kfs[0].bind_real.push_back(rot0);
+			kfs[0].bind_dual.push_back(MathLib::quat_trans_to_udq(rot0, float3(t * 2, 1 - t, 0.5f)));
+			kfs[0].bind_scale.push_back(1 + t);
+
+			Quaternion const rot1 = MathLib::rotation_axis(MathLib::normalize(float3(1, 1, 0)), -t * PI / 2);
+			kfs[1].frame_id.push_back(f);
+			kfs[1].bind_real.push_back(rot1);
+			kfs[1].bind_dual.push_back(MathLib::quat_trans_to_udq(rot1, float3(0, 0.3f, 0)));
+			kfs[1].bind_scale.push_back(1);
+
+			kfs[2].frame_id.push_back(f);
+			kfs[2].bind_real.push_back(Quaternion::Identity());
+			kfs[2].bind_dual.push_back(MathLib::quat_trans_to_udq(Quaternion::Identity(), float3(1, 2, 3)));
+			kfs[2].bind_scale.push_back(1);
+		}
+		return kfs;
+	}
+
+	void ExpectSamePose(Quaternion const & real0, Quaternion const & dual0, float scale0,
+		Quaternion const & real1, Quaternion const & dual1, float scale1, float tolerance)
+	{
+		EXPECT_GT(std::abs(MathLib::dot(real0, real1)), 1 - tolerance);
+
+		float3 const trans0 = MathLib::udq_to_trans(real0, dual0);
+		float3 const trans1 = MathLib::udq_to_trans(real1, dual1);
+		EXPECT_LT(MathLib::length(trans0 - trans1), tolerance);
+
+		EXPECT_NEAR(scale0, scale1, tolerance);
+	}
+}
+
+TEST(AnimationTest, MatchesKeyFrameSet)
+{
+	std::vector<KeyFrameSet> const kfs = MakeKeyFrameSets();
+	AnimationClipPtr clip = MakeSharedPtr<AnimationClip>(kfs);
+	EXPECT_EQ(3U, clip->NumJoints());
+
+	AnimationSampler sampler;
+	sampler.Clip(clip);
+	for (float frame = 0; frame <= 60; frame += 0.75f)
+	{
+		sampler.Sample(frame);
+		for (uint32_t j = 0; j < kfs.size(); ++ j)
+		{
+			auto const expected = kfs[j].Frame(frame);
+			ExpectSamePose(std::get<0>(expected), std::get<1>(expected), std::get<2>(expected),
+				sampler.Reals()[j], sampler.Duals()[j], sampler.Scales()[j], 1e-3f);
+		}
+	}
+}
+
+TEST(AnimationTest, CachedLookupMatchesSeek)
+{
+	AnimationClipPtr clip = MakeSharedPtr<AnimationClip>(MakeKeyFrameSets());
+
+	AnimationSampler sequential;
+	sequential.Clip(clip);
+
+	std::mt19937 gen(0x3A1F);
+	std::uniform_real_distribution<float> dis(-30.0f, 150.0f);
+	for (int i = 0; i < 200; ++ i)
+	{
+		// Mostly playing forward, with a jump now and then
+		float const frame = (i % 17 == 0) ? dis(gen) : i * 0.6f;
+		sequential.Sample(frame);
+
+		AnimationSampler fresh;
+		fresh.Clip(clip);
+		fresh.Sample(frame);
+
+		for (uint32_t j = 0; j < clip->NumJoints(); ++ j)
+		{
+			EXPECT_EQ(fresh.Reals()[j], sequential.Reals()[j]);
+			EXPECT_EQ(fresh.Duals()[j], sequential.Duals()[j]);
+			EXPECT_EQ(fresh.Scales()[j], sequential.Scales()[j]);
+		}
+	}
+}
+
+TEST(AnimationTest, Blend)
+{
+	AnimationClipPtr clip = MakeSharedPtr<AnimationClip>(MakeKeyFrameSets());
+
+	AnimationSampler single;
+	single.Clip(clip);
+	AnimationSampler blended;
+	blended.Clip(clip);
+
+	{
+		single.Sample(10.0f);
+
+		float const frames[] = { 10.0f, 50.0f };
+		float const weights[] = { 2.0f, 0.0f };
+		blended.Sample(frames, weights);
+		for (uint32_t j = 0; j < clip->NumJoints(); ++ j)
+		{
+			ExpectSamePose(single.Reals()[j], single.Duals()[j], single.Scales()[j],
+				blended.Reals()[j], blended.Duals()[j], blended.Scales()[j], 1e-4f);
+		}
+	}
+	{
+		single.Sample(30.0f);
+
+		float const frames[] = { 20.0f, 40.0f };
+		float const weights[] = { 0.5f, 0.5f };
+		blended.Sample(frames, weights);
+
+		// The scale is linear in frames, and the joint 1 rotation is about a fixed axis
+		EXPECT_NEAR(single.Scales()[0], blended.Scales()[0], 1e-3f);
+		EXPECT_GT(std::abs(MathLib::dot(single.Reals()[1], blended.Reals()[1])), 1 - 1e-3f);
+		ExpectSamePose(single.Reals()[2], single.Duals()[2], single.Scales()[2],
+			blended.Reals()[2], blended.Duals()[2], blended.Scales()[2], 1e-4f);
+	}
+}
+
+namespace
+{
+	SkinnedModelPtr MakeCrowdModel(std::shared_ptr<std::vector<KeyFrameSet>> const & kfs, AnimationClipPtr const & clip)
+	{
+		std::vector<Joint> joints(kfs->size());
+		for (size_t i = 0; i < joints.size(); ++ i)
+		{
+			Joint& joint = joints[i];
+			joint.name = "joint" + std::to_string(i);
+			joint.bind_real = Quaternion::Identity();
+			joint.bind_dual = Quaternion(0, 0, 0, 0);
+			joint.bind_scale = 1;
+			joint.inverse_origin_real = Quaternion::Identity();
+			joint.inverse_origin_dual = Quaternion(0, 0, 0, 0);
+			joint.inverse_origin_scale = 1;
+			joint.parent = static_cast<int16_t>(i) - 1;
+		}
+
+		SkinnedModelPtr model = MakeSharedPtr<SkinnedModel>(L"Crowd", 0);
+		model->AssignJoints(joints.begin(), joints.end());
+		model->AttachKeyFrameSets(kfs, clip);
+		model->NumFrames(61);
+		return model;
+	}
+
+	void ExpectSamePalette(SkinnedModel const & expected, SkinnedModel const & model)
+	{
+		ASSERT_EQ(expected.NumJoints(), model.NumJoints());
+		for (uint32_t j = 0; j < expected.NumJoints(); ++ j)
+		{
+			EXPECT_LT(MathLib::length(expected.BindRealPalette()[j] - model.BindRealPalette()[j]), 1e-5f);
+			EXPECT_LT(MathLib::length(expected.BindDualPalette()[j] - model.BindDualPalette()[j]), 1e-5f);
+		}
+	}
+}
+
+TEST(AnimationTest, SkinningCrowd)
+{
+	auto kfs = MakeSharedPtr<std::vector<KeyFrameSet>>(MakeKeyFrameSets());
+	auto clip = MakeSharedPtr<AnimationClip>(*kfs);
+	SkinnedModelPtr reference = MakeCrowdModel(kfs, clip);
+
+	SkinningCrowd crowd;
+	std::vector<SkinnedModelPtr> members;
+	for (uint32_t i = 0; i < 40; ++ i)
+	{
+		SkinnedModelPtr model = MakeCrowdModel(kfs, clip);
+		crowd.Add(model);
+		model->SetFrame((i % 4) * 10.5f);
+		members.push_back(model);
+	}
+	EXPECT_EQ(40U, crowd.NumModels());
+
+	AnimationLayer const layers[] = { { 0, 5.0f, 1.0f }, { 0, 30.0f, 3.0f } };
+	members.back()->BlendActions(layers);
+
+	crowd.Update();
+	EXPECT_EQ(5U, crowd.NumPalettesEvaluated());
+
+	for (uint32_t i = 0; i + 1 < members.size(); ++ i)
+	{
+		reference->SetFrame((i % 4) * 10.5f);
+		ExpectSamePalette(*reference, *members[i]);
+	}
+	EXPECT_EQ(members[1]->BindRealPalette().data(), members[5]->BindRealPalette().data());
+	EXPECT_NE(members[1]->BindRealPalette().data(), members[2]->BindRealPalette().data());
+
+	reference->BlendActions(layers);
+	ExpectSamePalette(*reference, *members.back());
+
+	// Destroyed members leave the crowd, removed ones pose themselves again
+	members.pop_back();
+	crowd.Remove(members[0]);
+	members[0]->SetFrame(50.0f);
+	crowd.Update();
+	EXPECT_EQ(38U, crowd.NumModels());
+	EXPECT_EQ(4U, crowd.NumPalettesEvaluated());
+
+	reference->SetFrame(50.0f);
+	ExpectSamePalette(*reference, *members[0]);
+	EXPECT_EQ(nullptr, members[0]->Crowd());
+
+	// A model with its own clip gets its own palette
+	SkinnedModelPtr own_clip = MakeCrowdModel(kfs, MakeSharedPtr<AnimationClip>(*kfs));
+	crowd.Add(own_clip);
+	own_clip->SetFrame(members[1]->GetFrame());
+	crowd.Update();
+	EXPECT_EQ(5U, crowd.NumPalettesEvaluated());
+	EXPECT_NE(members[1]->BindRealPalette().data(), own_clip->BindRealPalette().data());
+	ExpectSamePalette(*members[1], *own_clip);
+
+	// Models without a clip can join and leave
+	SkinnedModelPtr no_clip = MakeCrowdModel(kfs, AnimationClipPtr());
+	no_clip->AttachKeyFrameSets(nullptr);
+	crowd.Add(no_clip);
+	crowd.Update();
+	EXPECT_EQ(5U, crowd.NumPalettesEvaluated());
+	crowd.Remove(no_clip);
+	EXPECT_EQ(nullptr, no_clip->Crowd());
+	EXPECT_EQ(no_clip->NumJoints(), no_clip->BindRealPalette().size());
+}
@@ -0,0 +1,181 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/GraphicsBuffer.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderLayout.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneNode.hpp>
+#include <KlayGE/Renderable.hpp>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Every node gets its own renderable. Boxes made from another one draw its layout, so only the streams are shared.
+	class SharedGeometryBox : public Renderable
+	{
+	public:
+		explicit SharedGeometryBox(std::string_view tech_name)
+			: Renderable(L"SharedGeometryBox")
+		{
+			auto& rf = Context::Instance().RenderFactoryInstance();
+
+			effect_ = SyncLoadRenderEffect("AutoInstancing/AutoInstancingTest.fxml");
+			technique_ = simple_forward_tech_ = effect_->TechniqueByName(tech_name);
+			view_proj_param_ = effect_->ParameterByName("view_proj");
+			mvp_param_ = effect_->ParameterByName("mvp");
+			*(effect_->ParameterByName("color")) = float4(1, 1, 1, 1);
+
+			float3 vertices[] =
+			{
+				float3(-1, +1, -1), float3(+1, +1, -1), float3(-1, -1, -1), float3(+1, -1, -1),
+				float3(-1, +1, +1), float3(+1, +1, +1), float3(-1, -1, +1), float3(+1, -1, +1)
+			};
+
+			uint16_t indices[] =
+			{
+				0, 2, 3, 3, 1, 0,
+				5, 7, 6, 6, 4, 5,
+				4, 0, 1, 1, 5, 4,
+				4, 6, 2, 2, 0, 4,
+				2, 6, 7, 7, 3, 2,
+				1, 3, 7, 7, 5, 1
+			};
+
+			rls_[0] = rf.MakeRenderLayout();
+			rls_[0]->TopologyType(RenderLayout::TT_TriangleList);
+
+			auto vb = rf.MakeVertexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable, sizeof(vertices), vertices);
+			rls_[0]->BindVertexStream(vb, VertexElement(VEU_Position, 0, EF_BGR32F));
+
+			auto ib = rf.MakeIndexBuffer(BU_Static, EAH_GPU_Read | EAH_Immutable, sizeof(indices), indices);
+			rls_[0]->BindIndexStream(ib, EF_R16UI);
+
+			pos_aabb_ = AABBox(float3(-1, -1, -1), float3(1, 1, 1));
+			tc_aabb_ = AABBox(float3(0, 0, 0), float3(0, 0, 0));
+
+			effect_attrs_ |= EA_SimpleForward;
+		}
+
+		SharedGeometryBox(SharedGeometryBox const & geometry_src, std::string_view tech_name)
+			: SharedGeometryBox(tech_name)
+		{
+			rls_[0] = geometry_src.rls_[0];
+		}
+
+		void OnRenderBegin() override
+		{
+			Camera const & camera = Context::Instance().AppInstance().ActiveCamera();
+			*view_proj_param_ = camera.ViewProjMatrix();
+			*mvp_param_ = model_mat_ * camera.ViewProjMatrix();
+		}
+
+	private:
+		RenderEffectParameter* view_proj_param_;
+	};
+}
+
+class AutoInstancingTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		// Draw calls are only counted when Flush renders the scene
+		TestsAppUpdateRetValue(App3DFramework::URV_NeedFlush | App3DFramework::URV_Finished);
+	}
+
+	void TearDown() override
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		{
+			std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+			for (auto const & node : nodes_)
+			{
+				scene_mgr.SceneRootNode().RemoveChild(node);
+			}
+		}
+		nodes_.clear();
+		props_.clear();
+
+		TestsAppUpdateRetValue(App3DFramework::URV_Finished);
+	}
+
+	void AddProps(uint32_t num_props, uint32_t num_geometries, std::string_view tech_name)
+	{
+		props_.resize(num_props);
+		for (uint32_t i = 0; i < num_props; ++ i)
+		{
+			if (i < num_geometries)
+			{
+				props_[i] = MakeSharedPtr<SharedGeometryBox>(tech_name);
+			}
+			else
+			{
+				props_[i] = MakeSharedPtr<SharedGeometryBox>(*props_[i % num_geometries], tech_name);
+			}
+		}
+
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		nodes_.resize(num_props);
+		for (uint32_t i = 0; i < num_props; ++ i)
+		{
+			nodes_[i] = MakeSharedPtr<SceneNode>(L"Prop", 0);
+			nodes_[i]->TransformToParent(MathLib::translation(static_cast<float>(i % 50) * 3, 0.0f,
+				static_cast<float>(i / 50) * 3 + 5));
+			nodes_[i]->AddComponent(MakeSharedPtr<RenderableComponent>(props_[i]));
+			scene_mgr.SceneRootNode().AddChild(nodes_[i]);
+		}
+	}
+
+	uint32_t DrawCalls(bool auto_inst)
+	{
+		for (auto const & prop : props_)
+		{
+			prop->AutoInstancing(auto_inst);
+		}
+
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		scene_mgr.Update();
+		return scene_mgr.NumDrawCalls();
+	}
+
+	std::vector<std::shared_ptr<SharedGeometryBox>> props_;
+	std::vector<SceneNodePtr> nodes_;
+};
+
+TEST_F(AutoInstancingTest, DrawCallReduction)
+{
+	uint32_t const num_props = 2000;
+	uint32_t const num_geometries = 2;
+
+	this->AddProps(num_props, num_geometries, "InstancedBoxTech");
+
+	uint32_t const separate_draws = this->DrawCalls(false);
+	uint32_t const instanced_draws = this->DrawCalls(true);
+
+	// One instanced draw per shared geometry
+	EXPECT_GE(separate_draws, num_props);
+	EXPECT_LE(instanced_draws + (num_props - num_geometries), separate_draws);
+}
+
+TEST_F(AutoInstancingTest, WorldFromModelParameters)
+{
+	uint32_t const num_props = 200;
+
+	// The vertex shader doesn't read the instance stream, merging would draw all boxes at the same place
+	this->AddProps(num_props, 1, "BoxTech");
+
+	uint32_t const separate_draws = this->DrawCalls(false);
+	uint32_t const instanced_draws = this->DrawCalls(true);
+
+	EXPECT_GE(separate_draws, num_props);
+	EXPECT_EQ(separate_draws, instanced_draws);
+}
@@ -0,0 +1,756 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/LightCluster.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneNode.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace KlayGE;
+
+namespace
+{
+	void GenerateCullingScene(std::vector<AABBox>& aabbs, AABBoxSoA& aabbs_soa, Frustum& frustum, uint32_t num_objs)
+	{
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> pos_dis(-500, 500);
+		std::uniform_real_distribution<float> extent_dis(0.1f, 20);
+
+		aabbs.clear();
+		aabbs_soa.Clear();
+		for (uint32_t i = 0; i < num_objs; ++ i)
+		{
+			float3 const center(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+			float3 const extent(extent_dis(gen), extent_dis(gen), extent_dis(gen));
+			aabbs.emplace_back(center - extent, center + extent);
+			aabbs_soa.PushBack(aabbs.back());
+		}
+
+		float4x4 const view_proj = MathLib::look_at_lh(float3(0, 0, -300), float3(100, 50, 0))
+			* MathLib::perspective_fov_lh(PI / 4, 1.5f, 1.0f, 600.0f);
+		frustum.ClipMatrix(view_proj, MathLib::inverse(view_proj));
+	}
+
+	// Only gives its node a bound. Without a technique it's never queued, so big scenes cost nothing to draw.
+	class BoundRenderable : public Renderable
+	{
+	public:
+		explicit BoundRenderable(AABBox const & aabb)
+		{
+			pos_aabb_ = aabb;
+		}
+	};
+}
+
+// Culls through the scene manager of the tests app, which KlayGE.cfg sets to OCTree
+class OCTreeCullingTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		// ClipScene only runs when Flush draws the scene
+		TestsAppUpdateRetValue(App3DFramework::URV_NeedFlush | App3DFramework::URV_Finished);
+
+		// The same camera as GenerateCullingScene
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		old_eye_pos_ = camera.EyePos();
+		old_look_at_ = camera.LookAt();
+		old_up_vec_ = camera.UpVec();
+		old_fov_ = camera.FOV();
+		old_aspect_ = camera.Aspect();
+		old_near_plane_ = camera.NearPlane();
+		old_far_plane_ = camera.FarPlane();
+		camera.ViewParams(float3(0, 0, -300), float3(100, 50, 0));
+		camera.ProjParams(PI / 4, 1.5f, 1.0f, 600.0f);
+	}
+
+	void TearDown() override
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		{
+			std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+			for (auto const & group : groups_)
+			{
+				scene_mgr.SceneRootNode().RemoveChild(group);
+			}
+			for (auto const & node : nodes_)
+			{
+				if (node->Parent() == &scene_mgr.SceneRootNode())
+				{
+					scene_mgr.SceneRootNode().RemoveChild(node);
+				}
+			}
+		}
+		groups_.clear();
+		nodes_.clear();
+
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		camera.ViewParams(old_eye_pos_, old_look_at_, old_up_vec_);
+		camera.ProjParams(old_fov_, old_aspect_, old_near_plane_, old_far_plane_);
+
+		TestsAppUpdateRetValue(App3DFramework::URV_Finished);
+	}
+
+	// Adding a child is linear in the number of siblings, so static objects go in groups. A group has no bound, so it
+	// would mark moveable children visible without testing them. Those are added to the root instead.
+	SceneNodePtr const & AddObject(float3 const & center, float3 const & extent, uint32_t attrib)
+	{
+		uint32_t const max_group_size = 1024;
+
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+
+		nodes_.push_back(MakeSharedPtr<SceneNode>(
+			MakeSharedPtr<RenderableComponent>(MakeSharedPtr<BoundRenderable>(AABBox(-extent, extent))), L"Object", attrib));
+		nodes_.back()->TransformToParent(MathLib::translation(center));
+		if (attrib & SceneNode::SOA_Moveable)
+		{
+			scene_mgr.SceneRootNode().AddChild(nodes_.back());
+		}
+		else
+		{
+			if (groups_.empty() || (groups_.back()->Children().size() >= max_group_size))
+			{
+				groups_.push_back(MakeSharedPtr<SceneNode>(L"Group", 0));
+				scene_mgr.SceneRootNode().AddChild(groups_.back());
+			}
+			groups_.back()->AddChild(nodes_.back());
+		}
+		return nodes_.back();
+	}
+
+	// In the volume of GenerateCullingScene. One in 16 is moveable, which takes its result from the parallel pass in
+	// OCTree::TrackedObjVisible instead of OCTree::MarkNodeObjs.
+	void AddRandomObjects(uint32_t num)
+	{
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> pos_dis(-500, 500);
+		std::uniform_real_distribution<float> extent_dis(0.1f, 20);
+
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			float3 const center(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+			float3 const extent(extent_dis(gen), extent_dis(gen), extent_dis(gen));
+			this->AddObject(center, extent, (i % 16 == 0) ? (SceneNode::SOA_Cullable | SceneNode::SOA_Moveable) : SceneNode::SOA_Cullable);
+		}
+	}
+
+	void MoveObject(SceneNode& node, float3 const & center)
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		node.TransformToParent(MathLib::translation(center));
+	}
+
+	// Runs a frame, and checks the visible marks of all objects against a brute force frustum test
+	void CheckVisibleMarks()
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		scene_mgr.Update();
+
+		// Every check follows a change, so the marks can't come from the cache
+		EXPECT_EQ(1U, scene_mgr.NumVisibleMarksCacheMisses());
+
+		Frustum const & frustum = Context::Instance().AppInstance().ActiveCamera().ViewFrustum();
+		uint32_t num_visible = 0;
+		uint32_t num_mismatches = 0;
+		for (auto const & node : nodes_)
+		{
+			if (node->Parent() != nullptr)
+			{
+				bool const visible = node->Visible() && (MathLib::intersect_aabb_frustum(node->PosBoundWS(), frustum) != BO_No);
+				if (visible != (node->VisibleMark() != BO_No))
+				{
+					++ num_mismatches;
+				}
+				if (visible)
+				{
+					++ num_visible;
+				}
+			}
+		}
+		EXPECT_EQ(0U, num_mismatches);
+		EXPECT_GT(num_visible, 0U);
+	}
+
+	std::vector<SceneNodePtr> groups_;
+	std::vector<SceneNodePtr> nodes_;
+
+private:
+	float3 old_eye_pos_;
+	float3 old_look_at_;
+	float3 old_up_vec_;
+	float old_fov_;
+	float old_aspect_;
+	float old_near_plane_;
+	float old_far_plane_;
+};
+
+// The visible marks cache in SceneManager::Flush, on the same scenes
+class VisibleMarksCacheTest : public OCTreeCullingTest
+{
+protected:
+	void SetUp() override
+	{
+		OCTreeCullingTest::SetUp();
+		old_capacity_ = Context::Instance().SceneManagerInstance().VisibleMarksCacheCapacity();
+	}
+
+	void TearDown() override
+	{
+		Context::Instance().SceneManagerInstance().VisibleMarksCacheCapacity(old_capacity_);
+		OCTreeCullingTest::TearDown();
+	}
+
+	// Runs a frame, and returns whether its visible marks came from the cache
+	bool UpdateHits()
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		scene_mgr.Update();
+
+		// Counted over the frame, which flushes the scene once
+		uint32_t const hits = scene_mgr.NumVisibleMarksCacheHits();
+		EXPECT_EQ(1U, hits + scene_mgr.NumVisibleMarksCacheMisses());
+		return hits > 0;
+	}
+
+	std::vector<BoundOverlap> VisibleMarks() const
+	{
+		std::vector<BoundOverlap> marks;
+		for (auto const & node : nodes_)
+		{
+			marks.push_back(node->VisibleMark());
+		}
+		return marks;
+	}
+
+	void SetVisible(SceneNode& node, bool visible)
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		node.Visible(visible);
+	}
+
+private:
+	uint32_t old_capacity_;
+};
+
+TEST(CullingTest, AABBFrustumBatch)
+{
+	std::vector<AABBox> aabbs;
+	AABBoxSoA aabbs_soa;
+	Frustum frustum;
+	GenerateCullingScene(aabbs, aabbs_soa, frustum, 10007);
+
+	// Odd offsets and counts go through both the SIMD and the remainder paths
+	for (uint32_t first : { 0U, 1U, 3U, 4093U })
+	{
+		uint32_t const count = static_cast<uint32_t>(aabbs.size()) - first;
+		std::vector<BoundOverlap> results(count);
+		MathLib::intersect_aabb_frustum(aabbs_soa, first, count, frustum, &results[0]);
+		for (uint32_t i = 0; i < count; ++ i)
+		{
+			EXPECT_EQ(MathLib::intersect_aabb_frustum(aabbs[first + i], frustum), results[i]);
+		}
+	}
+}
+
+TEST(CullingTest, SphereFrustumBatch)
+{
+	std::vector<AABBox> aabbs;
+	AABBoxSoA aabbs_soa;
+	Frustum frustum;
+	GenerateCullingScene(aabbs, aabbs_soa, frustum, 10007);
+
+	std::vector<Sphere> spheres;
+	SphereSoA spheres_soa;
+	for (auto const & aabb : aabbs)
+	{
+		spheres.emplace_back(aabb.Center(), MathLib::length(aabb.HalfSize()));
+		spheres_soa.PushBack(spheres.back());
+	}
+
+	for (uint32_t first : { 0U, 1U, 3U, 4093U })
+	{
+		uint32_t const count = static_cast<uint32_t>(spheres.size()) - first;
+		std::vector<BoundOverlap> results(count);
+		MathLib::intersect_sphere_frustum(spheres_soa, first, count, frustum, &results[0]);
+		for (uint32_t i = 0; i < count; ++ i)
+		{
+			EXPECT_EQ(MathLib::intersect_sphere_frustum(spheres[first + i], frustum), results[i]);
+		}
+	}
+}
+
+TEST(CullingTest, FrustumVisibleMasks)
+{
+	std::vector<AABBox> aabbs;
+	AABBoxSoA aabbs_soa;
+	Frustum frustum;
+	GenerateCullingScene(aabbs, aabbs_soa, frustum, 10007);
+
+	SphereSoA spheres_soa;
+	for (auto const & aabb : aabbs)
+	{
+		spheres_soa.PushBack(Sphere(aabb.Center(), MathLib::length(aabb.HalfSize())));
+	}
+
+	for (uint32_t first : { 0U, 1U, 3U, 4093U })
+	{
+		uint32_t const count = static_cast<uint32_t>(aabbs.size()) - first;
+		uint32_t const num_words = (count + 31) / 32;
+
+		// Stale bits must be cleared by the batch functions
+		std::vector<uint32_t> aabb_masks(num_words, 0xFFFFFFFFU);
+		std::vector<uint32_t> sphere_masks(num_words, 0xFFFFFFFFU);
+		MathLib::intersect_aabb_frustum_mask(aabbs_soa, first, count, frustum, &aabb_masks[0]);
+		MathLib::intersect_sphere_frustum_mask(spheres_soa, first, count, frustum, &sphere_masks[0]);
+		for (uint32_t i = 0; i < num_words * 32; ++ i)
+		{
+			bool aabb_visible = false;
+			bool sphere_visible = false;
+			if (i < count)
+			{
+				aabb_visible = (MathLib::intersect_aabb_frustum(aabbs[first + i], frustum) != BO_No);
+				sphere_visible = (MathLib::intersect_sphere_frustum(spheres_soa.Get(first + i), frustum) != BO_No);
+			}
+			EXPECT_EQ(aabb_visible, (aabb_masks[i / 32] & (1U << (i % 32))) != 0);
+			EXPECT_EQ(sphere_visible, (sphere_masks[i / 32] & (1U << (i % 32))) != 0);
+		}
+	}
+}
+
+TEST(CullingTest, LightClusters)
+{
+	float4x4 const view = MathLib::look_at_lh(float3(0, 0, -300), float3(0, 0, 0));
+	float4x4 const proj = MathLib::perspective_fov_lh(PI / 4, 1.5f, 1.0f, 600.0f);
+
+	LightClusterBuilder builder(16, 8, 24);
+
+	{
+		SphereSoA lights;
+		lights.PushBack(Sphere(float3(0.1f, 0.1f, 0), 0.01f));	// Inside one cluster
+		lights.PushBack(Sphere(float3(0, 0, -400), 50));		// Behind the camera
+		lights.PushBack(Sphere(float3(0, 0, 1000), 50));		// Beyond the far plane
+		lights.PushBack(Sphere(float3(0, 0, -300), 0.5f));		// Inside the near plane
+		lights.PushBack(Sphere(float3(0, 0, 0), 10000));		// Covers everything
+		builder.Build(view, proj, 1.0f, 600.0f, lights);
+
+		EXPECT_EQ(1U, builder.NumLightClusters(0));
+		EXPECT_EQ(0U, builder.NumLightClusters(1));
+		EXPECT_EQ(0U, builder.NumLightClusters(2));
+		EXPECT_EQ(0U, builder.NumLightClusters(3));
+		EXPECT_EQ(builder.NumClusters(), builder.NumLightClusters(4));
+		EXPECT_EQ(builder.NumClusters() + 1, builder.LightIndices().size());
+
+		int32_t const cluster = builder.ClusterIndex(MathLib::transform_coord(float3(0.1f, 0.1f, 0), view));
+		ASSERT_GE(cluster, 0);
+		ASSERT_EQ(2U, builder.ClusterLightCount(cluster));
+		EXPECT_EQ(0U, builder.LightIndices()[builder.ClusterLightOffset(cluster) + 0]);
+		EXPECT_EQ(4U, builder.LightIndices()[builder.ClusterLightOffset(cluster) + 1]);
+	}
+
+	// Enough lights to bin on several threads
+	{
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> pos_dis(-300, 300);
+		std::uniform_real_distribution<float> radius_dis(1, 40);
+
+		SphereSoA lights;
+		for (uint32_t i = 0; i < 1000; ++ i)
+		{
+			lights.PushBack(Sphere(float3(pos_dis(gen), pos_dis(gen), pos_dis(gen)), radius_dis(gen)));
+		}
+		builder.Build(view, proj, 1.0f, 600.0f, lights);
+
+		// The lists are compact, sorted, and only have lights touching the cluster bounds
+		auto const & indices = builder.LightIndices();
+		uint32_t total = 0;
+		for (uint32_t c = 0; c < builder.NumClusters(); ++ c)
+		{
+			EXPECT_EQ(total, builder.ClusterLightOffset(c));
+			AABBox const bound = builder.ClusterBound(c);
+			for (uint32_t i = 0; i < builder.ClusterLightCount(c); ++ i)
+			{
+				uint32_t const light = indices[total + i];
+				if (i > 0)
+				{
+					EXPECT_LT(indices[total + i - 1], light);
+				}
+
+				Sphere const sphere = lights.Get(light);
+				float3 const center_es = MathLib::transform_coord(sphere.Center(), view);
+				float3 const closest = MathLib::maximize(bound.Min(), MathLib::minimize(center_es, bound.Max()));
+				EXPECT_LE(MathLib::length(closest - center_es), sphere.Radius() * 1.001f);
+			}
+			total += builder.ClusterLightCount(c);
+		}
+		EXPECT_EQ(total, indices.size());
+
+		// Every point of a light inside the view is in a cluster listing that light
+		uint32_t total_light_clusters = 0;
+		for (uint32_t light = 0; light < lights.Size(); ++ light)
+		{
+			total_light_clusters += builder.NumLightClusters(light);
+
+			Sphere const sphere = lights.Get(light);
+			float3 const center_es = MathLib::transform_coord(sphere.Center(), view);
+			float const r = sphere.Radius() * 0.5f;
+			float3 const samples[] = { center_es, center_es + float3(r, 0, 0), center_es - float3(r, 0, 0),
+				center_es + float3(0, r, 0), center_es - float3(0, r, 0), center_es + float3(0, 0, r), center_es - float3(0, 0, r) };
+			for (auto const & p : samples)
+			{
+				int32_t const cluster = builder.ClusterIndex(p);
+				if (cluster >= 0)
+				{
+					auto const first = indices.begin() + builder.ClusterLightOffset(cluster);
+					EXPECT_TRUE(std::binary_search(first, first + builder.ClusterLightCount(cluster), light));
+				}
+			}
+		}
+		EXPECT_EQ(total, total_light_clusters);
+	}
+}
+
+TEST(CullingTest, LightClusterRemap)
+{
+	float4x4 const view = MathLib::look_at_lh(float3(0, 0, -300), float3(0, 0, 0));
+	float4x4 const proj = MathLib::perspective_fov_lh(PI / 4, 1.5f, 1.0f, 600.0f);
+
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<float> pos_dis(-300, 300);
+	std::uniform_real_distribution<float> radius_dis(1, 40);
+
+	SphereSoA lights;
+	for (uint32_t i = 0; i < 200; ++ i)
+	{
+		lights.PushBack(Sphere(float3(pos_dis(gen), pos_dis(gen), pos_dis(gen)), radius_dis(gen)));
+	}
+
+	LightClusterBuilder builder(16, 8, 24);
+	builder.Build(view, proj, 1.0f, 600.0f, lights);
+
+	// Reversed order, every third light is dropped
+	std::vector<uint32_t> slots(lights.Size());
+	for (uint32_t light = 0; light < lights.Size(); ++ light)
+	{
+		slots[light] = (light % 3 == 0) ? LightClusterBuilder::INVALID_SLOT : static_cast<uint32_t>(lights.Size()) - light;
+	}
+
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> counts;
+	std::vector<uint32_t> indices;
+	builder.RemapLights(slots, offsets, counts, indices);
+	ASSERT_EQ(builder.NumClusters(), offsets.size());
+	ASSERT_EQ(builder.NumClusters(), counts.size());
+
+	uint32_t total = 0;
+	for (uint32_t c = 0; c < builder.NumClusters(); ++ c)
+	{
+		EXPECT_EQ(total, offsets[c]);
+
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < builder.ClusterLightCount(c); ++ i)
+		{
+			uint32_t const slot = slots[builder.LightIndices()[builder.ClusterLightOffset(c) + i]];
+			if (slot != LightClusterBuilder::INVALID_SLOT)
+			{
+				expected.push_back(slot);
+			}
+		}
+		std::sort(expected.begin(), expected.end());
+
+		ASSERT_EQ(expected.size(), counts[c]);
+		EXPECT_TRUE(std::equal(expected.begin(), expected.end(), indices.begin() + offsets[c]));
+		total += counts[c];
+	}
+	EXPECT_EQ(total, indices.size());
+	EXPECT_LT(total, builder.LightIndices().size());
+}
+
+// Enough objects in the visible nodes for OCTree::TestNodeObjs to split them across the thread pool
+TEST_F(OCTreeCullingTest, ParallelObjectTests)
+{
+	this->AddRandomObjects(64 * 1024);
+	this->CheckVisibleMarks();
+}
+
+TEST_F(OCTreeCullingTest, InsertObjects)
+{
+	this->AddRandomObjects(4096);
+	this->CheckVisibleMarks();
+
+	// Added to the existing tree, inside and outside of the view
+	this->AddObject(float3(100, 50, 0), float3(5, 5, 5), SceneNode::SOA_Cullable);
+	this->AddObject(float3(90, 40, 10), float3(1, 2, 3), SceneNode::SOA_Cullable | SceneNode::SOA_Moveable);
+	this->AddObject(float3(-400, 0, -400), float3(5, 5, 5), SceneNode::SOA_Cullable);
+	this->AddObject(float3(400, 400, 400), float3(10, 1, 10), SceneNode::SOA_Cullable | SceneNode::SOA_Moveable);
+	this->CheckVisibleMarks();
+	EXPECT_NE(BO_No, nodes_[nodes_.size() - 4]->VisibleMark());
+	EXPECT_NE(BO_No, nodes_[nodes_.size() - 3]->VisibleMark());
+}
+
+TEST_F(OCTreeCullingTest, RefitInsideLooseBound)
+{
+	this->AddRandomObjects(4096);
+	this->CheckVisibleMarks();
+
+	// Far less than the half cell a loose bound adds, so almost all of them stay in their nodes
+	for (uint32_t frame = 0; frame < 4; ++ frame)
+	{
+		for (size_t i = frame; i < nodes_.size(); i += 2)
+		{
+			this->MoveObject(*nodes_[i], nodes_[i]->PosBoundWS().Center() + float3(0.5f, -0.5f, 0.25f));
+		}
+		this->CheckVisibleMarks();
+	}
+}
+
+TEST_F(OCTreeCullingTest, MoveAcrossNodes)
+{
+	this->AddRandomObjects(4096);
+	this->CheckVisibleMarks();
+
+	// Mirrored through the center of the scene, which lands in another node but stays inside the root
+	for (size_t i = 0; i < nodes_.size(); i += 3)
+	{
+		this->MoveObject(*nodes_[i], -nodes_[i]->PosBoundWS().Center());
+	}
+	this->CheckVisibleMarks();
+
+	// And back
+	for (size_t i = 0; i < nodes_.size(); i += 3)
+	{
+		this->MoveObject(*nodes_[i], -nodes_[i]->PosBoundWS().Center());
+	}
+	this->CheckVisibleMarks();
+}
+
+TEST_F(OCTreeCullingTest, RemoveObjects)
+{
+	this->AddRandomObjects(4096);
+	this->CheckVisibleMarks();
+
+	// Removing a child reports a scene change, which drops the objects from the tree. Later objects of the same node are
+	// moved into the freed slots.
+	auto& scene_mgr = Context::Instance().SceneManagerInstance();
+	{
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		for (size_t i = 0; i < nodes_.size(); i += 3)
+		{
+			nodes_[i]->Parent()->RemoveChild(nodes_[i]);
+		}
+	}
+	this->CheckVisibleMarks();
+
+	// Objects that were moved into the freed slots are still tracked
+	for (size_t i = 1; i < nodes_.size(); i += 3)
+	{
+		this->MoveObject(*nodes_[i], -nodes_[i]->PosBoundWS().Center());
+	}
+	this->CheckVisibleMarks();
+
+	// Emptying the tree releases its subtrees, later inserts allocate them again
+	{
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		for (auto const & node : nodes_)
+		{
+			if (node->Parent() != nullptr)
+			{
+				node->Parent()->RemoveChild(node);
+			}
+		}
+	}
+	this->AddObject(float3(100, 50, 0), float3(5, 5, 5), SceneNode::SOA_Cullable);
+	this->AddObject(float3(-400, 0, -400), float3(5, 5, 5), SceneNode::SOA_Cullable | SceneNode::SOA_Moveable);
+	this->CheckVisibleMarks();
+	EXPECT_NE(BO_No, nodes_[nodes_.size() - 2]->VisibleMark());
+	EXPECT_EQ(BO_No, nodes_.back()->VisibleMark());
+}
+
+TEST_F(OCTreeCullingTest, GrowOutOfRoot)
+{
+	this->AddRandomObjects(4096);
+	this->CheckVisibleMarks();
+
+	// Beyond the loose bound of the root, so the tree is rebuilt around the new extent
+	this->MoveObject(*nodes_[0], float3(5000, 0, 0));
+	this->AddObject(float3(0, 0, -5000), float3(5, 5, 5), SceneNode::SOA_Cullable | SceneNode::SOA_Moveable);
+	this->CheckVisibleMarks();
+
+	// Later changes go to the rebuilt tree
+	for (size_t i = 1; i < nodes_.size(); i += 5)
+	{
+		this->MoveObject(*nodes_[i], -nodes_[i]->PosBoundWS().Center());
+	}
+	this->MoveObject(*nodes_[0], float3(100, 50, 0));
+	this->CheckVisibleMarks();
+	EXPECT_NE(BO_No, nodes_[0]->VisibleMark());
+}
+
+TEST_F(VisibleMarksCacheTest, StaticSceneHits)
+{
+	auto& scene_mgr = Context::Instance().SceneManagerInstance();
+
+	this->AddRandomObjects(1024);
+	EXPECT_FALSE(this->UpdateHits());
+	std::vector<BoundOverlap> const marks = this->VisibleMarks();
+
+	for (uint32_t frame = 0; frame < 3; ++ frame)
+	{
+		// Flush resets the marks before looking them up
+		EXPECT_TRUE(this->UpdateHits());
+		EXPECT_TRUE(this->VisibleMarks() == marks);
+	}
+
+	// A frame that doesn't draw the scene neither hits nor misses
+	TestsAppUpdateRetValue(App3DFramework::URV_Finished);
+	scene_mgr.Update();
+	EXPECT_EQ(0U, scene_mgr.NumVisibleMarksCacheHits());
+	EXPECT_EQ(0U, scene_mgr.NumVisibleMarksCacheMisses());
+}
+
+TEST_F(VisibleMarksCacheTest, MissAfterMove)
+{
+	this->AddRandomObjects(1024);
+	EXPECT_FALSE(this->UpdateHits());
+	EXPECT_TRUE(this->UpdateHits());
+
+	// Static and moveable objects, into the view
+	for (size_t i = 0; i < 2; ++ i)
+	{
+		this->MoveObject(*nodes_[i], float3(100, 50, 0));
+		EXPECT_FALSE(this->UpdateHits());
+		EXPECT_NE(BO_No, nodes_[i]->VisibleMark());
+		EXPECT_TRUE(this->UpdateHits());
+		EXPECT_NE(BO_No, nodes_[i]->VisibleMark());
+	}
+}
+
+TEST_F(VisibleMarksCacheTest, MissAfterVisibleFlip)
+{
+	this->AddRandomObjects(1024);
+	EXPECT_FALSE(this->UpdateHits());
+	EXPECT_TRUE(this->UpdateHits());
+	std::vector<BoundOverlap> const marks = this->VisibleMarks();
+
+	auto iter = std::find_if(nodes_.begin(), nodes_.end(), [](SceneNodePtr const & node) { return node->VisibleMark() != BO_No; });
+	ASSERT_TRUE(iter != nodes_.end());
+	SceneNode& node = **iter;
+
+	this->SetVisible(node, false);
+	EXPECT_FALSE(this->UpdateHits());
+	EXPECT_EQ(BO_No, node.VisibleMark());
+	EXPECT_TRUE(this->UpdateHits());
+	EXPECT_EQ(BO_No, node.VisibleMark());
+
+	// Flipping back restores the key of the first entry, which is still valid
+	this->SetVisible(node, true);
+	EXPECT_TRUE(this->UpdateHits());
+	EXPECT_TRUE(this->VisibleMarks() == marks);
+}
+
+TEST_F(VisibleMarksCacheTest, EvictLeastRecentlyUsed)
+{
+	auto& scene_mgr = Context::Instance().SceneManagerInstance();
+	scene_mgr.VisibleMarksCacheCapacity(2);
+
+	this->AddRandomObjects(1024);
+
+	// A frame per view, each view has its own entry
+	Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+	auto view = [&camera](float x)
+	{
+		camera.ViewParams(float3(x, 0, -300), float3(100, 50, 0));
+	};
+
+	view(0);
+	EXPECT_FALSE(this->UpdateHits());
+	view(10);
+	EXPECT_FALSE(this->UpdateHits());
+	size_t const full_memory = scene_mgr.VisibleMarksCacheMemory();
+
+	// Evicts the first view
+	view(-10);
+	EXPECT_FALSE(this->UpdateHits());
+	EXPECT_EQ(full_memory, scene_mgr.VisibleMarksCacheMemory());
+
+	view(10);
+	EXPECT_TRUE(this->UpdateHits());
+
+	// Evicts the third view, used before the second one
+	view(0);
+	EXPECT_FALSE(this->UpdateHits());
+	view(10);
+	EXPECT_TRUE(this->UpdateHits());
+	view(-10);
+	EXPECT_FALSE(this->UpdateHits());
+
+	// Shrinking evicts right away
+	scene_mgr.VisibleMarksCacheCapacity(1);
+	EXPECT_LT(scene_mgr.VisibleMarksCacheMemory(), full_memory);
+	view(10);
+	EXPECT_FALSE(this->UpdateHits());
+	view(10);
+	EXPECT_TRUE(this->UpdateHits());
+}
+
+// Culling cost of the object pass in OCTree::ClipScene, on the CPU only. Timings depend on the machine, so nothing is
+// asserted. Run with --gtest_also_run_disabled_tests.
+TEST(CullingTest, DISABLED_AABBFrustumBenchmark)
+{
+	uint32_t const NUM_OBJS = 128 * 1024;
+	uint32_t const ITERATIONS = 32;
+
+	std::vector<AABBox> aabbs;
+	AABBoxSoA aabbs_soa;
+	Frustum frustum;
+	GenerateCullingScene(aabbs, aabbs_soa, frustum, NUM_OBJS);
+
+	std::vector<BoundOverlap> scalar_results(NUM_OBJS);
+	Timer timer;
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		for (uint32_t i = 0; i < NUM_OBJS; ++ i)
+		{
+			scalar_results[i] = MathLib::intersect_aabb_frustum(aabbs[i], frustum);
+		}
+	}
+	double const scalar_time = timer.elapsed() / ITERATIONS;
+
+	std::vector<BoundOverlap> batch_results(NUM_OBJS);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		MathLib::intersect_aabb_frustum(aabbs_soa, 0, NUM_OBJS, frustum, &batch_results[0]);
+	}
+	double const batch_time = timer.elapsed() / ITERATIONS;
+
+	// Split like OCTree::TestNodeObjs
+	std::vector<BoundOverlap> parallel_results(NUM_OBJS);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		parallel_for_chunks(Context::Instance().ThreadPool(), NUM_OBJS, num_parallel_workers(NUM_OBJS, 4096),
+			[&aabbs_soa, &frustum, &parallel_results](uint32_t worker, uint32_t first, uint32_t last)
+			{
+				KFL_UNUSED(worker);
+				MathLib::intersect_aabb_frustum(aabbs_soa, first, last - first, frustum, &parallel_results[first]);
+			});
+	}
+	double const parallel_time = timer.elapsed() / ITERATIONS;
+
+	std::cout << "Culling " << NUM_OBJS << " AABBs: scalar " << scalar_time * 1000 << " ms, batch "
+		<< batch_time * 1000 << " ms, parallel batch " << parallel_time * 1000 << " ms" << std::endl;
+}
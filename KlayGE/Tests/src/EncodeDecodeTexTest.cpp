@@ -6,58 +6,77 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/Half.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <random>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <thread>
 
 #include "KlayGETests.hpp"
 
 using namespace std;
 using namespace KlayGE;
 
-void TestEncodeDecodeTex(std::string_view input_name, std::string_view tc_name,
-		ElementFormat bc_fmt, float threshold)
+std::unique_ptr<TexCompression> CreateTexCodec(ElementFormat bc_fmt)
 {
-	ResLoader::Instance().AddPath("../../Tests/media/EncodeDecodeTex");
-
-	std::vector<uint8_t> input_argb;
-	std::vector<uint8_t> bc_blocks;
-	uint32_t width, height;
-
-	std::unique_ptr<TexCompression> codec;
 	switch (bc_fmt)
 	{
 	case EF_BC1:
-		codec = MakeUniquePtr<TexCompressionBC1>();
-		break;
+		return MakeUniquePtr<TexCompressionBC1>();
 
 	case EF_BC2:
-		codec = MakeUniquePtr<TexCompressionBC2>();
-		break;
+		return MakeUniquePtr<TexCompressionBC2>();
 
 	case EF_BC3:
-		codec = MakeUniquePtr<TexCompressionBC3>();
-		break;
+		return MakeUniquePtr<TexCompressionBC3>();
 
 	case EF_BC6:
-		codec = MakeUniquePtr<TexCompressionBC6U>();
-		break;
+		return MakeUniquePtr<TexCompressionBC6U>();
 
 	case EF_SIGNED_BC6:
-		codec = MakeUniquePtr<TexCompressionBC6S>();
-		break;
+		return MakeUniquePtr<TexCompressionBC6S>();
 
 	case EF_BC7:
-		codec = MakeUniquePtr<TexCompressionBC7>();
-		break;
+		return MakeUniquePtr<TexCompressionBC7>();
 
 	case EF_ETC1:
-		codec = MakeUniquePtr<TexCompressionETC1>();
-		break;
+		return MakeUniquePtr<TexCompressionETC1>();
+
+	case EF_ETC2_BGR8:
+		return MakeUniquePtr<TexCompressionETC2RGB8>();
+
+	case EF_ETC2_A1BGR8:
+		return MakeUniquePtr<TexCompressionETC2RGB8A1>();
+
+	case EF_ETC2_R11:
+		return MakeUniquePtr<TexCompressionETC2R11>(false);
+
+	case EF_SIGNED_ETC2_R11:
+		return MakeUniquePtr<TexCompressionETC2R11>(true);
+
+	case EF_ETC2_GR11:
+		return MakeUniquePtr<TexCompressionETC2RG11>(false);
+
+	case EF_SIGNED_ETC2_GR11:
+		return MakeUniquePtr<TexCompressionETC2RG11>(true);
 
 	default:
 		KFL_UNREACHABLE("Unsupported compression format");
 	}
+}
+
+float EncodeDecodeTexError(std::string_view input_name, std::string_view tc_name, ElementFormat bc_fmt)
+{
+	ResLoader::Instance().AddPath("../../Tests/media/EncodeDecodeTex");
+
+	std::vector<uint8_t> input_argb;
+	std::vector<uint8_t> bc_blocks;
+	uint32_t width, height;
+
+	auto codec = CreateTexCodec(bc_fmt);
 
 	ElementFormat const decoded_fmt = DecodedFormat(bc_fmt);
 	uint32_t const pixel_size = NumFormatBytes(decoded_fmt);
@@ -80,7 +99,7 @@ void TestEncodeDecodeTex(std::string_view input_name, std::string_view tc_name,
 			for (uint32_t x = 0; x < width; ++ x)
 			{
 				memcpy(&pixel[0], &src[x * pixel_size], pixel_size);
-				if (EF_BC1 == bc_fmt)
+				if ((EF_BC1 == bc_fmt) || (EF_ETC2_A1BGR8 == bc_fmt))
 				{
 					if (pixel[3] < 128)
 					{
@@ -225,8 +244,13 @@ void TestEncodeDecodeTex(std::string_view input_name, std::string_view tc_name,
 		}
 	}
 
-	mse = sqrt(mse / (width * height) / 4);
-	EXPECT_LT(mse, threshold);
+	return sqrt(mse / (width * height) / 4);
+}
+
+void TestEncodeDecodeTex(std::string_view input_name, std::string_view tc_name,
+		ElementFormat bc_fmt, float threshold)
+{
+	EXPECT_LT(EncodeDecodeTexError(input_name, tc_name, bc_fmt), threshold);
 }
 
 TEST(EncodeDecodeTexTest, DecodeBC1)
@@ -293,3 +317,275 @@ TEST(EncodeDecodeTexTest, EncodeDecodeETC1)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC1, 4.8f);
 }
+
+TEST(EncodeDecodeTexTest, EncodeDecodeETC2RGB8)
+{
+	// ETC2 RGB8 starts from the ETC1 encoding and only switches to T, H or planar modes when they decode closer.
+	float const etc1_error = EncodeDecodeTexError("Lenna.dds", "", EF_ETC1);
+	float const etc2_error = EncodeDecodeTexError("Lenna.dds", "", EF_ETC2_BGR8);
+	EXPECT_LE(etc2_error, etc1_error);
+}
+
+// Deterministic stand-in for a real texture: smooth gradients, hard edges and some noise. A 4-channel image is opaque,
+// or with cut_out, transparent black outside a circle. Signed images are the same ramps shifted to int8.
+std::vector<uint8_t> GenerateTestImage(uint32_t width, uint32_t height, uint32_t num_channels, bool cut_out,
+	bool signed_channels)
+{
+	std::mt19937 gen(0xE7C2);
+	std::vector<uint8_t> image(width * height * num_channels);
+	for (uint32_t y = 0; y < height; ++ y)
+	{
+		for (uint32_t x = 0; x < width; ++ x)
+		{
+			uint8_t* pixel = &image[(y * width + x) * num_channels];
+			for (uint32_t c = 0; c < num_channels; ++ c)
+			{
+				float const smooth = 128 + 96 * std::sin((x * (c + 1) + y * 2) * 0.05f + c);
+				float const edge = (((x / 16 + y / 24 + c) & 1) != 0) ? 24.0f : -24.0f;
+				int const noise = static_cast<int>(gen() % 9) - 4;
+				pixel[c] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(smooth + edge) + noise, 0, 255));
+			}
+
+			if (num_channels == 4)
+			{
+				pixel[3] = 255;
+			}
+			if (cut_out)
+			{
+				int const dx = static_cast<int>(x) - static_cast<int>(width / 2);
+				int const dy = static_cast<int>(y) - static_cast<int>(height / 2);
+				if (dx * dx + dy * dy > static_cast<int>(width * height / 5))
+				{
+					std::fill(pixel, pixel + num_channels, static_cast<uint8_t>(0));
+				}
+			}
+
+			if (signed_channels)
+			{
+				for (uint32_t c = 0; c < num_channels; ++ c)
+				{
+					pixel[c] ^= 0x80;
+				}
+			}
+		}
+	}
+	return image;
+}
+
+// HDR stand-in for BC6: the ramps of GenerateTestImage mapped to half floats from 1/16 to 64, with an opaque alpha. Signed
+// images flip the sign of every other 8 pixel column stripe, shifted per channel.
+std::vector<uint8_t> GenerateHDRTestImage(uint32_t width, uint32_t height, bool signed_channels)
+{
+	std::vector<uint8_t> const ldr = GenerateTestImage(width, height, 4, false, false);
+	std::vector<uint8_t> image(width * height * 4 * sizeof(half));
+	half* dst = reinterpret_cast<half*>(&image[0]);
+	for (uint32_t i = 0; i < width * height; ++ i)
+	{
+		for (uint32_t c = 0; c < 3; ++ c)
+		{
+			float value = std::exp2(ldr[i * 4 + c] / 255.0f * 10 - 4);
+			if (signed_channels && ((((i % width) / 8 + c) & 1) != 0))
+			{
+				value = -value;
+			}
+			dst[i * 4 + c] = half(value);
+		}
+		dst[i * 4 + 3] = half(1.0f);
+	}
+	return image;
+}
+
+// RMS error per channel after EncodeMem and DecodeMem. Channels of signed formats are int8, of BC6 formats half.
+float EncodeDecodeMemError(ElementFormat bc_fmt, std::vector<uint8_t> const & input, uint32_t width, uint32_t height,
+	TexCompressionMethod method, bool signed_channels)
+{
+	auto codec = CreateTexCodec(bc_fmt);
+
+	uint32_t const block_width = BlockWidth(bc_fmt);
+	uint32_t const block_height = BlockHeight(bc_fmt);
+	uint32_t const block_bytes = BlockBytes(bc_fmt);
+	uint32_t const bc_row_pitch = (width + block_width - 1) / block_width * block_bytes;
+	uint32_t const bc_slice_pitch = (height + block_height - 1) / block_height * bc_row_pitch;
+	uint32_t const row_pitch = width * NumFormatBytes(DecodedFormat(bc_fmt));
+	uint32_t const slice_pitch = height * row_pitch;
+
+	std::vector<uint8_t> blocks(bc_slice_pitch);
+	codec->EncodeMem(width, height, &blocks[0], bc_row_pitch, bc_slice_pitch, &input[0], row_pitch, slice_pitch, method);
+	std::vector<uint8_t> restored(slice_pitch);
+	codec->DecodeMem(width, height, &restored[0], row_pitch, slice_pitch, &blocks[0], bc_row_pitch, bc_slice_pitch);
+
+	float mse = 0;
+	if (EF_ABGR16F == DecodedFormat(bc_fmt))
+	{
+		half const * input_half = reinterpret_cast<half const *>(&input[0]);
+		half const * restored_half = reinterpret_cast<half const *>(&restored[0]);
+		size_t const num_channels = input.size() / sizeof(half);
+		for (size_t i = 0; i < num_channels; ++ i)
+		{
+			float const diff = static_cast<float>(input_half[i]) - static_cast<float>(restored_half[i]);
+			mse += diff * diff;
+		}
+		return sqrt(mse / num_channels);
+	}
+
+	for (size_t i = 0; i < input.size(); ++ i)
+	{
+		float const diff = signed_channels
+			? static_cast<float>(static_cast<int8_t>(input[i]) - static_cast<int8_t>(restored[i]))
+			: static_cast<float>(input[i] - restored[i]);
+		mse += diff * diff;
+	}
+	return sqrt(mse / input.size());
+}
+
+// Thresholds are the errors measured with TCM_Balanced on 128x128 images, plus about 5%.
+TEST(EncodeDecodeTexTest, EncodeDecodeETC2RGB8Generated)
+{
+	auto const input = GenerateTestImage(128, 128, 4, false, false);
+	EXPECT_LT(EncodeDecodeMemError(EF_ETC2_BGR8, input, 128, 128, TCM_Balanced, false), 2.45f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeETC2RGB8A1Generated)
+{
+	auto const input = GenerateTestImage(128, 128, 4, true, false);
+	EXPECT_LT(EncodeDecodeMemError(EF_ETC2_A1BGR8, input, 128, 128, TCM_Balanced, false), 2.15f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeETC2R11)
+{
+	auto const input = GenerateTestImage(128, 128, 1, false, false);
+	EXPECT_LT(EncodeDecodeMemError(EF_ETC2_R11, input, 128, 128, TCM_Balanced, false), 1.25f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeSignedETC2R11)
+{
+	auto const input = GenerateTestImage(128, 128, 1, false, true);
+	EXPECT_LT(EncodeDecodeMemError(EF_SIGNED_ETC2_R11, input, 128, 128, TCM_Balanced, true), 1.25f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeETC2RG11)
+{
+	auto const input = GenerateTestImage(128, 128, 2, false, false);
+	EXPECT_LT(EncodeDecodeMemError(EF_ETC2_GR11, input, 128, 128, TCM_Balanced, false), 1.4f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeSignedETC2RG11)
+{
+	auto const input = GenerateTestImage(128, 128, 2, false, true);
+	EXPECT_LT(EncodeDecodeMemError(EF_SIGNED_ETC2_GR11, input, 128, 128, TCM_Balanced, true), 1.4f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6U)
+{
+	auto const input = GenerateHDRTestImage(128, 128, false);
+	EXPECT_LT(EncodeDecodeMemError(EF_BC6, input, 128, 128, TCM_Balanced, false), 0.91f);
+}
+
+TEST(EncodeDecodeTexTest, EncodeDecodeBC6S)
+{
+	auto const input = GenerateHDRTestImage(128, 128, true);
+	EXPECT_LT(EncodeDecodeMemError(EF_SIGNED_BC6, input, 128, 128, TCM_Balanced, false), 0.96f);
+}
+
+// Runs EncodeMem/DecodeMem on two codecs that only differ in how configure sets them up, and expects identical output.
+void TestEncodeDecodeTexMatch(std::string_view input_name, ElementFormat bc_fmt, TexCompressionMethod method,
+	std::function<void(TexCompression& reference, TexCompression& codec)> const & configure)
+{
+	ResLoader::Instance().AddPath("../../Tests/media/EncodeDecodeTex");
+
+	TexturePtr in_tex = LoadSoftwareTexture(input_name);
+	uint32_t const width = in_tex->Width(0);
+	uint32_t const height = in_tex->Height(0);
+	auto const & init_data = checked_cast<SoftwareTexture&>(*in_tex).SubresourceData();
+
+	uint32_t const block_width = BlockWidth(bc_fmt);
+	uint32_t const block_height = BlockHeight(bc_fmt);
+	uint32_t const block_bytes = BlockBytes(bc_fmt);
+	uint32_t const bc_row_pitch = (width + block_width - 1) / block_width * block_bytes;
+	uint32_t const bc_slice_pitch = (height + block_height - 1) / block_height * bc_row_pitch;
+	uint32_t const decoded_row_pitch = width * NumFormatBytes(DecodedFormat(bc_fmt));
+	uint32_t const decoded_slice_pitch = height * decoded_row_pitch;
+
+	auto ref_codec = CreateTexCodec(bc_fmt);
+	auto codec = CreateTexCodec(bc_fmt);
+	configure(*ref_codec, *codec);
+
+	std::vector<uint8_t> ref_blocks(bc_slice_pitch);
+	ref_codec->EncodeMem(width, height, &ref_blocks[0], bc_row_pitch, bc_slice_pitch,
+		init_data[0].data, init_data[0].row_pitch, init_data[0].slice_pitch, method);
+	std::vector<uint8_t> blocks(bc_slice_pitch);
+	codec->EncodeMem(width, height, &blocks[0], bc_row_pitch, bc_slice_pitch,
+		init_data[0].data, init_data[0].row_pitch, init_data[0].slice_pitch, method);
+	EXPECT_TRUE(ref_blocks == blocks);
+
+	std::vector<uint8_t> ref_decoded(decoded_slice_pitch);
+	ref_codec->DecodeMem(width, height, &ref_decoded[0], decoded_row_pitch, decoded_slice_pitch,
+		&ref_blocks[0], bc_row_pitch, bc_slice_pitch);
+	std::vector<uint8_t> decoded(decoded_slice_pitch);
+	codec->DecodeMem(width, height, &decoded[0], decoded_row_pitch, decoded_slice_pitch,
+		&ref_blocks[0], bc_row_pitch, bc_slice_pitch);
+	EXPECT_TRUE(ref_decoded == decoded);
+}
+
+void TestParallelEncodeDecodeTex(std::string_view input_name, ElementFormat bc_fmt, TexCompressionMethod method)
+{
+	TestEncodeDecodeTexMatch(input_name, bc_fmt, method, [](TexCompression& reference, TexCompression& codec)
+		{
+			reference.NumThreads(1);
+			codec.NumThreads(std::max(std::thread::hardware_concurrency(), 4U));
+		});
+}
+
+void TestSIMDEncodeDecodeTex(std::string_view input_name, ElementFormat bc_fmt, TexCompressionMethod method)
+{
+	TestEncodeDecodeTexMatch(input_name, bc_fmt, method, [](TexCompression& reference, TexCompression& codec)
+		{
+			KFL_UNUSED(codec);
+			reference.UseSIMD(false);
+		});
+}
+
+TEST(EncodeDecodeTexTest, ParallelEncodeDecodeBC1)
+{
+	TestParallelEncodeDecodeTex("Lenna.dds", EF_BC1, TCM_Quality);
+}
+
+TEST(EncodeDecodeTexTest, ParallelEncodeDecodeBC3)
+{
+	TestParallelEncodeDecodeTex("leaf_v3_green_tex.dds", EF_BC3, TCM_Quality);
+}
+
+TEST(EncodeDecodeTexTest, ParallelEncodeDecodeBC7)
+{
+	TestParallelEncodeDecodeTex("leaf_v3_green_tex.dds", EF_BC7, TCM_Balanced);
+}
+
+TEST(EncodeDecodeTexTest, ParallelEncodeDecodeETC1)
+{
+	TestParallelEncodeDecodeTex("Lenna.dds", EF_ETC1, TCM_Balanced);
+}
+
+TEST(EncodeDecodeTexTest, ParallelEncodeDecodeETC2RGB8)
+{
+	TestParallelEncodeDecodeTex("Lenna.dds", EF_ETC2_BGR8, TCM_Balanced);
+}
+
+TEST(EncodeDecodeTexTest, SIMDEncodeDecodeBC1Speed)
+{
+	TestSIMDEncodeDecodeTex("Lenna.dds", EF_BC1, TCM_Speed);
+}
+
+TEST(EncodeDecodeTexTest, SIMDEncodeDecodeBC1Quality)
+{
+	TestSIMDEncodeDecodeTex("Lenna.dds", EF_BC1, TCM_Quality);
+}
+
+TEST(EncodeDecodeTexTest, SIMDEncodeDecodeBC2)
+{
+	TestSIMDEncodeDecodeTex("leaf_v3_green_tex.dds", EF_BC2, TCM_Balanced);
+}
+
+TEST(EncodeDecodeTexTest, SIMDEncodeDecodeBC3)
+{
+	TestSIMDEncodeDecodeTex("leaf_v3_green_tex.dds", EF_BC3, TCM_Quality);
+}
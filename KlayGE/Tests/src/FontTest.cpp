@@ -0,0 +1,98 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Font.hpp>
+
+#include <string>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(FontTest, CharCache)
+{
+	FontPtr font = SyncLoadFont("gkai00mp.kfont");
+	uint32_t const capacity = font->CharCacheCapacity();
+	ASSERT_GT(capacity, 2U);
+
+	std::vector<Rect> const probe_rects = font->CharTexRects(L"A", 16);
+	ASSERT_EQ(1U, probe_rects.size());
+
+	// Fills the texture with other glyphs. Each new one evicts the least recently used, so "A" goes last.
+	std::wstring chars;
+	for (wchar_t ch = 0x4E00; (ch < 0x9FA6) && (chars.size() < capacity); ++ ch)
+	{
+		font->CalcSize(std::wstring(1, ch), 16);
+		if (font->CachedChars()[0] == ch)
+		{
+			chars.push_back(ch);
+		}
+	}
+	ASSERT_EQ(capacity, chars.size());
+	EXPECT_EQ(std::wstring(chars.rbegin(), chars.rend()), font->CachedChars());
+
+	// chars[0] is used again, so chars[1] makes room for "A"
+	font->CalcSize(chars.substr(0, 1), 16);
+	std::vector<Rect> const rects = font->CharTexRects(L"A", 16);
+
+	std::wstring expected = L"A";
+	expected.push_back(chars[0]);
+	expected.append(chars.rbegin(), chars.rend() - 2);
+	EXPECT_EQ(expected, font->CachedChars());
+
+	// The layout of "A" is cached, its old slot now holds another glyph
+	ASSERT_EQ(1U, rects.size());
+	EXPECT_FALSE(rects[0] == probe_rects[0]);
+	std::vector<Rect> const new_layout_rects = font->CharTexRects(L"A", 17);
+	ASSERT_EQ(1U, new_layout_rects.size());
+	EXPECT_TRUE(rects[0] == new_layout_rects[0]);
+}
+
+TEST(FontTest, PurgeLayouts)
+{
+	FontPtr font = SyncLoadFont("gkai00mp.kfont");
+
+	auto text = [](uint32_t i)
+	{
+		return L"Layout " + std::to_wstring(i);
+	};
+
+	// Adds new layouts until they're purged, twice
+	uint32_t max_cached = 0;
+	uint32_t num_texts = 0;
+	uint32_t first_kept = 0;
+	for (uint32_t purges = 0; purges < 2;)
+	{
+		uint32_t const num_before = font->NumCachedLayouts();
+		font->CharTexRects(text(num_texts), 16);
+		++ num_texts;
+		uint32_t const num_after = font->NumCachedLayouts();
+		if (num_after < num_before)
+		{
+			++ purges;
+			if (purges == 1)
+			{
+				// The most recently used half and the new one are kept
+				max_cached = num_after - 1;
+				EXPECT_EQ(max_cached * 2, num_before);
+				first_kept = num_texts - 1 - max_cached;
+
+				// The oldest one is used again
+				font->CharTexRects(text(first_kept), 16);
+				EXPECT_EQ(num_after, font->NumCachedLayouts());
+			}
+		}
+		else
+		{
+			EXPECT_EQ(num_before + 1, num_after);
+		}
+	}
+	EXPECT_EQ(max_cached + 1, font->NumCachedLayouts());
+
+	// It survived the second purge, unlike the ones added after it
+	uint32_t const num_cached = font->NumCachedLayouts();
+	font->CharTexRects(text(first_kept), 16);
+	EXPECT_EQ(num_cached, font->NumCachedLayouts());
+	font->CharTexRects(text(first_kept + 1), 16);
+	EXPECT_EQ(num_cached + 1, font->NumCachedLayouts());
+}
@@ -26,8 +26,26 @@ namespace KlayGE
 		virtual uint32_t DoUpdate(uint32_t pass) override
 		{
 			KFL_UNUSED(pass);
-			return URV_Finished;
+			if (update_callback_)
+			{
+				update_callback_();
+			}
+			return update_ret_val_;
+		}
+
+		void UpdateRetValue(uint32_t urv)
+		{
+			update_ret_val_ = urv;
+		}
+
+		void UpdateCallback(std::function<void()> const & callback)
+		{
+			update_callback_ = callback;
 		}
+
+	private:
+		uint32_t update_ret_val_ = URV_Finished;
+		std::function<void()> update_callback_;
 	};
 
 	class KlayGETestEnvironment : public testing::Environment
@@ -58,6 +76,16 @@ namespace KlayGE
 		std::shared_ptr<App3DFramework> app_;
 	};
 
+	void TestsAppUpdateRetValue(uint32_t urv)
+	{
+		checked_cast<KlayGETestsApp&>(Context::Instance().AppInstance()).UpdateRetValue(urv);
+	}
+
+	void TestsAppUpdateCallback(std::function<void()> const & callback)
+	{
+		checked_cast<KlayGETestsApp&>(Context::Instance().AppInstance()).UpdateCallback(callback);
+	}
+
 	bool CompareBuffer(GraphicsBuffer& buff0, uint32_t buff0_offset,
 		GraphicsBuffer& buff1, uint32_t buff1_offset,
 		uint32_t num_elems, float tolerance)
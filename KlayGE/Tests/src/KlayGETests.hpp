@@ -1,7 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <functional>
+
 namespace KlayGE
 {
+	// What the tests app returns from DoUpdate, URV_Finished by default. Tests that need Flush to draw the scene set
+	// URV_NeedFlush | URV_Finished, and restore the default when done.
+	void TestsAppUpdateRetValue(uint32_t urv);
+	// Called from the tests app's DoUpdate, where the scene manager's nodes are up to date for the frame. Tests that set
+	// one clear it with nullptr when done.
+	void TestsAppUpdateCallback(std::function<void()> const & callback);
+
 	bool CompareBuffer(GraphicsBuffer& buff0, uint32_t buff0_offset,
 		GraphicsBuffer& buff1, uint32_t buff1_offset,
 		uint32_t num_elems, float tolerance);
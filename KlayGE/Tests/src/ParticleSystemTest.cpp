@@ -0,0 +1,275 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Camera.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/ParticleSystem.hpp>
+
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	Particle MakeParticle(uint32_t id, float life)
+	{
+		Particle par;
+		par.pos = float3(static_cast<float>(id), 1.0f, 2.0f);
+		par.vel = float3(0.5f, static_cast<float>(id), -1.0f);
+		par.life = life;
+		par.spin = 0.25f;
+		par.size = 3.0f;
+		par.alpha = 0.75f;
+		par.init_life = 10.0f;
+		return par;
+	}
+
+	bool NearlyEqual(float lhs, float rhs)
+	{
+		return MathLib::abs(lhs - rhs) <= 1e-5f * std::max(1.0f, std::max(MathLib::abs(lhs), MathLib::abs(rhs)));
+	}
+
+	float EvalPolyline(std::vector<float2> const & ctrl_pts, float pos)
+	{
+		float ret = ctrl_pts.back().y();
+		for (auto iter = std::next(ctrl_pts.begin()); iter != ctrl_pts.end(); ++ iter)
+		{
+			if (iter->x() >= pos)
+			{
+				float2 const & prev = *std::prev(iter);
+				float const s = (pos - prev.x()) / (iter->x() - prev.x());
+				ret = MathLib::lerp(prev.y(), iter->y(), s);
+				break;
+			}
+		}
+		return ret;
+	}
+
+	// PolylineParticleUpdater::Update as it was before particles were stored as SoA, one particle at a time
+	void PerParticleUpdate(Particle& par, ParticleSystem const & ps, std::vector<float2> const & size_over_life,
+		std::vector<float2> const & mass_over_life, std::vector<float2> const & opacity_over_life, float elapse_time)
+	{
+		float const pos = (par.init_life - par.life) / par.init_life;
+		float const cur_size = EvalPolyline(size_over_life, pos);
+		float const cur_mass = EvalPolyline(mass_over_life, pos);
+		float const cur_alpha = EvalPolyline(opacity_over_life, pos);
+
+		float buoyancy = 4.0f / 3 * PI * MathLib::cube(cur_size) * ps.MediaDensity() * ps.Gravity();
+		float3 accel = (ps.Force() + float3(0, buoyancy, 0)) / cur_mass - float3(0, ps.Gravity(), 0);
+		par.vel += accel * elapse_time;
+		par.pos += par.vel * elapse_time;
+		par.life -= elapse_time;
+		par.spin += 0.001f;
+		par.size = cur_size;
+		par.alpha = cur_alpha;
+	}
+
+	class SortedParticleSystem : public ParticleSystem
+	{
+	public:
+		explicit SortedParticleSystem(uint32_t max_num_particles)
+			: ParticleSystem(max_num_particles, true)
+		{
+		}
+
+		ParticlePool& Pool()
+		{
+			return particles_;
+		}
+	};
+
+	// Each particle alive is drawn once, and view depth never increases along the order, up to the 16-bit quantization
+	bool DrawnBackToFront(ParticleSystem const & ps, float4x4 const & view)
+	{
+		uint32_t const num_alive = ps.NumActiveParticles();
+
+		std::vector<float> depths(num_alive);
+		for (uint32_t i = 0; i < num_alive; ++ i)
+		{
+			depths[i] = MathLib::transform_coord(ps.GetParticle(i).pos, view).z();
+		}
+		float const min_depth = *std::min_element(depths.begin(), depths.end());
+		float const max_depth = *std::max_element(depths.begin(), depths.end());
+		float const tolerance = (max_depth - min_depth) / 65535 * 1.01f + 1e-5f;
+
+		std::vector<bool> drawn(num_alive, false);
+		float prev_depth = max_depth;
+		for (uint32_t i = 0; i < num_alive; ++ i)
+		{
+			uint32_t const index = ps.GetActiveParticleIndex(i);
+			if ((index >= num_alive) || drawn[index] || (depths[index] > prev_depth + tolerance))
+			{
+				return false;
+			}
+			drawn[index] = true;
+			prev_depth = depths[index];
+		}
+		return true;
+	}
+
+	void TestSortParticles(uint32_t num)
+	{
+		Camera& camera = Context::Instance().AppInstance().ActiveCamera();
+		float3 const old_eye_pos = camera.EyePos();
+		float3 const old_look_at = camera.LookAt();
+		float3 const old_up_vec = camera.UpVec();
+
+		auto ps = MakeSharedPtr<SortedParticleSystem>(num);
+
+		std::mt19937 gen(num);
+		std::uniform_real_distribution<float> pos_dis(-50, 50);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			Particle par = MakeParticle(i, 5.0f);
+			par.pos = float3(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+			ps->Pool().Set(i, par);
+		}
+		ps->Pool().NumAlive(num);
+
+		// No previous order, sorted from the pool order
+		camera.ViewParams(float3(0, 0, -200), float3(0, 0, 0));
+		ps->SubThreadUpdateFunc(0);
+		EXPECT_EQ(num, ps->NumActiveParticles());
+		EXPECT_TRUE(DrawnBackToFront(*ps, camera.ViewMatrix()));
+
+		// Last frame's order, remapped past the particles that died, is nearly sorted for a small camera move
+		ParticleSpan const alive = ps->Pool().AliveSpan();
+		uint32_t num_died = 0;
+		for (uint32_t i = 0; i < alive.num; i += 3)
+		{
+			alive.life[i] = 0;
+			++ num_died;
+		}
+		camera.ViewParams(float3(10, 20, -200), float3(0, 0, 0));
+		ps->SubThreadUpdateFunc(0);
+		EXPECT_EQ(num - num_died, ps->NumActiveParticles());
+		EXPECT_TRUE(DrawnBackToFront(*ps, camera.ViewMatrix()));
+
+		// Viewed from the other side the old order is reversed, which takes the radix sort
+		camera.ViewParams(float3(0, 0, 200), float3(0, 0, 0));
+		ps->SubThreadUpdateFunc(0);
+		EXPECT_EQ(num - num_died, ps->NumActiveParticles());
+		EXPECT_TRUE(DrawnBackToFront(*ps, camera.ViewMatrix()));
+
+		camera.ViewParams(old_eye_pos, old_look_at, old_up_vec);
+	}
+}
+
+TEST(ParticleSystemTest, PoolGetSet)
+{
+	ParticlePool pool(16);
+	EXPECT_EQ(16U, pool.Capacity());
+	EXPECT_EQ(0U, pool.NumAlive());
+
+	pool.Set(5, MakeParticle(5, 4.0f));
+	Particle const par = pool.Get(5);
+	EXPECT_EQ(5.0f, par.pos.x());
+	EXPECT_EQ(5.0f, par.vel.y());
+	EXPECT_EQ(4.0f, par.life);
+	EXPECT_EQ(10.0f, par.init_life);
+
+	ParticleSpan const span = pool.Span(4, 4);
+	EXPECT_EQ(4U, span.num);
+	EXPECT_EQ(5.0f, span.pos_x[1]);
+	EXPECT_EQ(4.0f, span.SubSpan(1, 2).life[0]);
+}
+
+TEST(ParticleSystemTest, PoolCompactAndMove)
+{
+	uint32_t const num = 37;
+	ParticlePool pool(num);
+	for (uint32_t i = 0; i < num; ++ i)
+	{
+		// Every third particle is dead
+		pool.Set(i, MakeParticle(i, (i % 3 == 0) ? 0.0f : 1.0f));
+	}
+
+	uint32_t const first = 20;
+	uint32_t const num_alive = pool.Compact(first, num - first);
+	std::vector<uint32_t> expected;
+	for (uint32_t i = first; i < num; ++ i)
+	{
+		if (i % 3 != 0)
+		{
+			expected.push_back(i);
+		}
+	}
+	ASSERT_EQ(expected.size(), num_alive);
+	for (uint32_t i = 0; i < num_alive; ++ i)
+	{
+		Particle const par = pool.Get(first + i);
+		EXPECT_EQ(static_cast<float>(expected[i]), par.pos.x());
+		EXPECT_EQ(static_cast<float>(expected[i]), par.vel.y());
+	}
+
+	pool.Move(3, first, num_alive);
+	for (uint32_t i = 0; i < num_alive; ++ i)
+	{
+		EXPECT_EQ(static_cast<float>(expected[i]), pool.Get(3 + i).pos.x());
+	}
+
+	pool.NumAlive(3 + num_alive);
+	EXPECT_EQ(3 + num_alive, pool.AliveSpan().num);
+}
+
+TEST(ParticleSystemTest, PolylineUpdate)
+{
+	// 4 SIMD batches and a scalar tail of 3
+	uint32_t const num = 19;
+	float const elapse_time = 0.1f;
+
+	auto ps = MakeSharedPtr<ParticleSystem>(num);
+	ps->Gravity(0.5f);
+	ps->Force(float3(0.1f, 0.2f, -0.3f));
+	ps->MediaDensity(0.4f);
+
+	std::vector<float2> const size_over_life = { float2(0, 1), float2(0.3f, 2), float2(1, 0.5f) };
+	std::vector<float2> const mass_over_life = { float2(0, 2), float2(0.5f, 1), float2(0.8f, 1.5f), float2(1, 3) };
+	std::vector<float2> const opacity_over_life = { float2(0, 0), float2(0.1f, 1), float2(1, 0) };
+
+	auto updater = checked_pointer_cast<PolylineParticleUpdater>(ps->MakeUpdater("polyline"));
+	updater->SizeOverLife(size_over_life);
+	updater->MassOverLife(mass_over_life);
+	updater->OpacityOverLife(opacity_over_life);
+	updater->SnapParams();
+
+	ParticlePool pool(num);
+	std::vector<Particle> expected(num);
+	for (uint32_t i = 0; i < num; ++ i)
+	{
+		// Life from init_life down, so the curves are evaluated from t = 0 on and between every pair of control points
+		expected[i] = MakeParticle(i, 10.0f * (num - i) / num);
+		pool.Set(i, expected[i]);
+		PerParticleUpdate(expected[i], *ps, size_over_life, mass_over_life, opacity_over_life, elapse_time);
+	}
+	pool.NumAlive(num);
+
+	updater->Update(pool.AliveSpan(), elapse_time);
+
+	for (uint32_t i = 0; i < num; ++ i)
+	{
+		Particle const par = pool.Get(i);
+		EXPECT_TRUE(NearlyEqual(expected[i].pos.x(), par.pos.x()) && NearlyEqual(expected[i].pos.y(), par.pos.y())
+			&& NearlyEqual(expected[i].pos.z(), par.pos.z())) << "particle " << i;
+		EXPECT_TRUE(NearlyEqual(expected[i].vel.x(), par.vel.x()) && NearlyEqual(expected[i].vel.y(), par.vel.y())
+			&& NearlyEqual(expected[i].vel.z(), par.vel.z())) << "particle " << i;
+		EXPECT_TRUE(NearlyEqual(expected[i].life, par.life)) << "particle " << i;
+		EXPECT_TRUE(NearlyEqual(expected[i].spin, par.spin)) << "particle " << i;
+		EXPECT_TRUE(NearlyEqual(expected[i].size, par.size)) << "particle " << i;
+		EXPECT_TRUE(NearlyEqual(expected[i].alpha, par.alpha)) << "particle " << i;
+	}
+}
+
+TEST(ParticleSystemTest, SortBackToFront)
+{
+	TestSortParticles(1000);
+}
+
+// Large enough to sort on the thread pool
+TEST(ParticleSystemTest, ParallelSortBackToFront)
+{
+	TestSortParticles(150000);
+}
@@ -0,0 +1,111 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/RadixSort.hpp>
+#include <KlayGE/Context.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+TEST(RadixSortTest, MatchesStableSort)
+{
+	std::mt19937 gen(0x52AD);
+	std::uniform_int_distribution<uint64_t> dis_low(0, 31);
+	std::uniform_int_distribution<uint64_t> dis_full;
+
+	for (int round = 0; round < 2; ++ round)
+	{
+		uint32_t const num = 5000;
+		std::vector<uint64_t> keys(num);
+		std::vector<uint32_t> values(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			// Round 0 has many duplicates and constant high bytes, round 1 uses every byte
+			keys[i] = (round == 0) ? ((dis_low(gen) << 48) | dis_low(gen)) : dis_full(gen);
+			values[i] = i;
+		}
+
+		std::vector<std::pair<uint64_t, uint32_t>> expected(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			expected[i] = std::make_pair(keys[i], values[i]);
+		}
+		std::stable_sort(expected.begin(), expected.end(),
+			[](std::pair<uint64_t, uint32_t> const & lhs, std::pair<uint64_t, uint32_t> const & rhs)
+			{
+				return lhs.first < rhs.first;
+			});
+
+		std::vector<uint64_t> tmp_keys(num);
+		std::vector<uint32_t> tmp_values(num);
+		RadixSort(keys.data(), values.data(), tmp_keys.data(), tmp_values.data(), num);
+
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			EXPECT_EQ(expected[i].first, keys[i]);
+			EXPECT_EQ(expected[i].second, values[i]);
+		}
+	}
+}
+
+TEST(RadixSortTest, FloatKeys)
+{
+	float const depths[] = { 3.5f, -1.0f, 0.0f, 1e10f, -250.0f, 0.25f, -0.0f, 7.0f };
+	uint32_t const num = static_cast<uint32_t>(sizeof(depths) / sizeof(depths[0]));
+
+	std::vector<uint32_t> keys(num);
+	std::vector<uint32_t> values(num);
+	for (uint32_t i = 0; i < num; ++ i)
+	{
+		keys[i] = RadixSortableFloat(depths[i]);
+		values[i] = i;
+	}
+
+	std::vector<uint32_t> tmp_keys(num);
+	std::vector<uint32_t> tmp_values(num);
+	RadixSort(keys.data(), values.data(), tmp_keys.data(), tmp_values.data(), num);
+
+	for (uint32_t i = 1; i < num; ++ i)
+	{
+		EXPECT_LE(depths[values[i - 1]], depths[values[i]]);
+	}
+	EXPECT_EQ(4U, values[0]);
+	EXPECT_EQ(3U, values[num - 1]);
+}
+
+TEST(RadixSortTest, ParallelMatchesStableSort)
+{
+	std::mt19937 gen(0x9A4A);
+	std::uniform_int_distribution<uint32_t> dis(0, 999);
+
+	// 16-bit keys like the particle depths, and uneven chunks
+	uint32_t const num = 100003;
+	std::vector<uint16_t> keys(num);
+	std::vector<uint32_t> values(num);
+	for (uint32_t i = 0; i < num; ++ i)
+	{
+		keys[i] = static_cast<uint16_t>(dis(gen) * 61);
+		values[i] = i;
+	}
+
+	std::vector<uint16_t> expected_keys = keys;
+	std::vector<uint32_t> expected_values = values;
+	std::vector<uint16_t> tmp_keys(num);
+	std::vector<uint32_t> tmp_values(num);
+	RadixSort(expected_keys.data(), expected_values.data(), tmp_keys.data(), tmp_values.data(), num);
+
+	for (uint32_t num_workers = 2; num_workers <= 7; num_workers += 5)
+	{
+		std::vector<uint16_t> sorted_keys = keys;
+		std::vector<uint32_t> sorted_values = values;
+		ParallelRadixSort(Context::Instance().ThreadPool(), sorted_keys.data(), sorted_values.data(), tmp_keys.data(),
+			tmp_values.data(), num, num_workers);
+
+		EXPECT_TRUE(expected_keys == sorted_keys);
+		EXPECT_TRUE(expected_values == sorted_values);
+	}
+}
@@ -1,6 +1,17 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/Hash.hpp>
+#include <KlayGE/Package.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
 #include "KlayGETests.hpp"
 
 using namespace KlayGE;
@@ -31,6 +42,22 @@ TEST(ResLoaderTest, AddDelPath)
 	EXPECT_TRUE(ResLoader::Instance().Locate("Test.txt").empty());
 }
 
+TEST(ResLoaderTest, ResourceView)
+{
+	auto res = ResLoader::Instance().Open("../../Tests/media/ResLoader/Test.txt");
+	EXPECT_TRUE(res);
+
+	ArrayRef<uint8_t> const view = res->View();
+#if defined(KLAYGE_PLATFORM_LINUX)
+	EXPECT_FALSE(view.empty());
+#endif
+	if (!view.empty())
+	{
+		EXPECT_EQ(std::string(view.begin(), view.end()), sanity_string);
+	}
+	EXPECT_EQ(ReadWholeFile(res), sanity_string);
+}
+
 TEST(ResLoaderTest, MountUnmountPath)
 {
 	ResLoader::Instance().Mount("ResLoaderTestData", "../../Tests/media/ResLoader");
@@ -95,3 +122,555 @@ TEST(ResLoaderTest, MountUnmountInsideEncrypt7zPath)
 	ResLoader::Instance().Unmount("ResLoaderTestData", "../../Tests/media/ResLoader/TestPassword.7z|1234/ResLoader");
 	EXPECT_TRUE(ResLoader::Instance().Locate("ResLoaderTestData/Test.txt").empty());
 }
+
+TEST(ResLoaderTest, MountUnmountKPackagePath)
+{
+	std::string const pkg_name = ResLoader::Instance().LocalFolder() + "ResLoaderTest.kpk";
+	{
+		std::string repeated_string;
+		for (int i = 0; i < 256; ++ i)
+		{
+			repeated_string += sanity_string;
+		}
+
+		std::vector<std::tuple<std::string, ResIdentifierPtr, bool>> files;
+		files.emplace_back("ResLoader/Test.txt", ResLoader::Instance().Open("../../Tests/media/ResLoader/Test.txt"), false);
+		files.emplace_back("ResLoader/Repeated.txt", MakeSharedPtr<ResIdentifier>("Repeated.txt", 0,
+			MakeSharedPtr<std::stringstream>(repeated_string)), true);
+		SaveKPackage(pkg_name, files);
+
+		ResLoader::Instance().Mount("ResLoaderTestData", pkg_name + "/ResLoader");
+		EXPECT_FALSE(ResLoader::Instance().Locate("ResLoaderTestData/Test.txt").empty());
+		EXPECT_FALSE(ResLoader::Instance().Locate("ResLoaderTestData/repeated.TXT").empty());
+
+		auto res = ResLoader::Instance().Open("ResLoaderTestData/Test.txt");
+		EXPECT_TRUE(res);
+		EXPECT_EQ(ReadWholeFile(res), sanity_string);
+
+		res = ResLoader::Instance().Open("ResLoaderTestData/Repeated.txt");
+		EXPECT_TRUE(res);
+		EXPECT_EQ(ReadWholeFile(res), repeated_string);
+
+		ResLoader::Instance().Unmount("ResLoaderTestData", pkg_name + "/ResLoader");
+		EXPECT_TRUE(ResLoader::Instance().Locate("ResLoaderTestData/Test.txt").empty());
+	}
+	std::remove(pkg_name.c_str());
+}
+
+namespace
+{
+	uint32_t Crc32(void const * data, size_t size, uint32_t crc = 0)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++ i)
+		{
+			crc ^= static_cast<uint8_t const *>(data)[i];
+			for (int bit = 0; bit < 8; ++ bit)
+			{
+				crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1)));
+			}
+		}
+		return ~crc;
+	}
+
+	void Write7zNumber(std::string& os, uint64_t value)
+	{
+		uint8_t first_byte = 0;
+		uint8_t mask = 0x80;
+		int num_extra_bytes = 0;
+		for (; num_extra_bytes < 8; ++ num_extra_bytes)
+		{
+			if (value < (1ULL << (7 * (num_extra_bytes + 1))))
+			{
+				first_byte |= static_cast<uint8_t>(value >> (8 * num_extra_bytes));
+				break;
+			}
+			first_byte |= mask;
+			mask >>= 1;
+		}
+		os.push_back(static_cast<char>(first_byte));
+		for (; num_extra_bytes > 0; -- num_extra_bytes)
+		{
+			os.push_back(static_cast<char>(value & 0xFF));
+			value >>= 8;
+		}
+	}
+
+	// A 7z archive with the Copy coder. Every block is a solid block (a folder in 7z terms) with the given files.
+	void Save7zArchive(std::string const & name, std::vector<std::vector<std::pair<std::string, std::string>>> const & blocks)
+	{
+		std::string header;
+		header.push_back(0x01);		// kHeader
+		header.push_back(0x04);		// kMainStreamsInfo
+
+		header.push_back(0x06);		// kPackInfo
+		Write7zNumber(header, 0);
+		Write7zNumber(header, blocks.size());
+		header.push_back(0x09);		// kSize
+		std::vector<uint64_t> block_sizes;
+		for (auto const & block : blocks)
+		{
+			uint64_t size = 0;
+			for (auto const & file : block)
+			{
+				size += file.second.size();
+			}
+			block_sizes.push_back(size);
+			Write7zNumber(header, size);
+		}
+		header.push_back(0x00);		// kEnd
+
+		header.push_back(0x07);		// kUnPackInfo
+		header.push_back(0x0B);		// kFolder
+		Write7zNumber(header, blocks.size());
+		header.push_back(0x00);		// Not external
+		for (size_t i = 0; i < blocks.size(); ++ i)
+		{
+			Write7zNumber(header, 1);	// One coder, simple, 1 byte ID
+			header.push_back(0x01);
+			header.push_back(0x00);		// Copy
+		}
+		header.push_back(0x0C);		// kCodersUnPackSize
+		for (auto const size : block_sizes)
+		{
+			Write7zNumber(header, size);
+		}
+		header.push_back(0x00);		// kEnd
+
+		header.push_back(0x08);		// kSubStreamsInfo
+		header.push_back(0x0D);		// kNumUnPackStream
+		for (auto const & block : blocks)
+		{
+			Write7zNumber(header, block.size());
+		}
+		header.push_back(0x09);		// kSize, all but the last file of each block
+		for (auto const & block : blocks)
+		{
+			for (size_t i = 0; i + 1 < block.size(); ++ i)
+			{
+				Write7zNumber(header, block[i].second.size());
+			}
+		}
+		header.push_back(0x00);		// kEnd
+
+		header.push_back(0x00);		// kEnd of kMainStreamsInfo
+
+		std::string names;
+		uint64_t num_files = 0;
+		names.push_back(0x00);		// Not external
+		for (auto const & block : blocks)
+		{
+			for (auto const & file : block)
+			{
+				for (auto const ch : file.first)
+				{
+					names.push_back(ch);
+					names.push_back(0x00);
+				}
+				names.push_back(0x00);
+				names.push_back(0x00);
+				++ num_files;
+			}
+		}
+		header.push_back(0x05);		// kFilesInfo
+		Write7zNumber(header, num_files);
+		header.push_back(0x11);		// kName
+		Write7zNumber(header, names.size());
+		header += names;
+		header.push_back(0x00);		// kEnd
+
+		header.push_back(0x00);		// kEnd of kHeader
+
+		uint64_t packed_size = 0;
+		for (auto const size : block_sizes)
+		{
+			packed_size += size;
+		}
+
+		uint8_t start_header[20];
+		uint64_t const next_header_offset = Native2LE(packed_size);
+		uint64_t const next_header_size = Native2LE(static_cast<uint64_t>(header.size()));
+		uint32_t const next_header_crc = Native2LE(Crc32(header.data(), header.size()));
+		std::memcpy(&start_header[0], &next_header_offset, sizeof(next_header_offset));
+		std::memcpy(&start_header[8], &next_header_size, sizeof(next_header_size));
+		std::memcpy(&start_header[16], &next_header_crc, sizeof(next_header_crc));
+		uint32_t const start_header_crc = Native2LE(Crc32(start_header, sizeof(start_header)));
+
+		std::ofstream ofs(name.c_str(), std::ios_base::binary);
+		char const signature[] = { '7', 'z', '\xBC', '\xAF', '\x27', '\x1C', 0, 4 };
+		ofs.write(signature, sizeof(signature));
+		ofs.write(reinterpret_cast<char const *>(&start_header_crc), sizeof(start_header_crc));
+		ofs.write(reinterpret_cast<char const *>(start_header), sizeof(start_header));
+		for (auto const & block : blocks)
+		{
+			for (auto const & file : block)
+			{
+				ofs.write(file.second.data(), file.second.size());
+			}
+		}
+		ofs.write(header.data(), header.size());
+	}
+}
+
+TEST(ResLoaderTest, SevenZipSolidBlockCache)
+{
+	// 3 solid blocks of 4 files. Any 2 blocks fit in the cache, all 3 don't.
+	uint32_t const num_blocks = 3;
+	uint32_t const num_files_per_block = 4;
+	size_t const file_size = static_cast<size_t>(SevenZipPackage::MAX_DECODED_BLOCKS_SIZE * 3 / 8 / num_files_per_block);
+
+	auto file_path = [](uint32_t block, uint32_t file)
+	{
+		return "Block" + std::to_string(block) + "/File" + std::to_string(file) + ".bin";
+	};
+	auto file_content = [file_size](uint32_t block, uint32_t file)
+	{
+		std::string content(file_size, '\0');
+		for (size_t i = 0; i < content.size(); ++ i)
+		{
+			content[i] = static_cast<char>((i * 7 + block * 31 + file * 13 + (i >> 12)) & 0xFF);
+		}
+		return content;
+	};
+
+	std::string const pkg_name = ResLoader::Instance().LocalFolder() + "ResLoaderTest.7z";
+	{
+		std::vector<std::vector<std::pair<std::string, std::string>>> blocks(num_blocks);
+		for (uint32_t block = 0; block < num_blocks; ++ block)
+		{
+			for (uint32_t file = 0; file < num_files_per_block; ++ file)
+			{
+				blocks[block].emplace_back(file_path(block, file), file_content(block, file));
+			}
+		}
+		Save7zArchive(pkg_name, blocks);
+	}
+
+	{
+		PackagePtr package = OpenPackage(ResLoader::Instance().Open(pkg_name), "");
+		ASSERT_TRUE(package);
+		auto& sz_package = checked_cast<SevenZipPackage&>(*package);
+
+		// Paths are case insensitive, and '\\' is the same as '/'
+		EXPECT_TRUE(sz_package.Locate("Block1/File2.bin"));
+		EXPECT_TRUE(sz_package.Locate("block1\\FILE2.BIN"));
+		EXPECT_FALSE(sz_package.Locate("Block1/File4.bin"));
+		EXPECT_FALSE(sz_package.Locate("Block3/File0.bin"));
+		EXPECT_FALSE(sz_package.Extract("Block1/File4.bin", "File4.bin"));
+
+		// The first Extract decodes the whole block, the other files come from the cache
+		std::vector<ResIdentifierPtr> block0_res;
+		for (uint32_t file = 0; file < num_files_per_block; ++ file)
+		{
+			block0_res.push_back(sz_package.Extract(file_path(0, file), "File.bin"));
+			ASSERT_TRUE(block0_res.back());
+			EXPECT_EQ(1U, sz_package.NumDecodedBlocks());
+			EXPECT_EQ(ReadWholeFile(block0_res.back()), file_content(0, file));
+		}
+		EXPECT_EQ(num_files_per_block * file_size, sz_package.DecodedBlocksSize());
+
+		// A repeated Extract hits the cache, the data is shared
+		auto res = sz_package.Extract("BLOCK0/file1.bin", "File.bin");
+		ASSERT_TRUE(res);
+		EXPECT_EQ(block0_res[1]->View().data(), res->View().data());
+		EXPECT_EQ(ReadWholeFile(res), file_content(0, 1));
+
+		auto block1_res = sz_package.Extract(file_path(1, 3), "File.bin");
+		ASSERT_TRUE(block1_res);
+		EXPECT_EQ(ReadWholeFile(block1_res), file_content(1, 3));
+		EXPECT_EQ(2U, sz_package.NumDecodedBlocks());
+
+		// The third block pushes out the least recently used one, block 0
+		auto block2_res = sz_package.Extract(file_path(2, 0), "File.bin");
+		ASSERT_TRUE(block2_res);
+		EXPECT_EQ(ReadWholeFile(block2_res), file_content(2, 0));
+		EXPECT_EQ(2U, sz_package.NumDecodedBlocks());
+		EXPECT_LE(sz_package.DecodedBlocksSize(), SevenZipPackage::MAX_DECODED_BLOCKS_SIZE);
+
+		// Decoded again into new memory, with the same content. Block 1 goes this time.
+		res = sz_package.Extract(file_path(0, 2), "File.bin");
+		ASSERT_TRUE(res);
+		EXPECT_NE(block0_res[2]->View().data(), res->View().data());
+		EXPECT_EQ(ReadWholeFile(res), file_content(0, 2));
+		EXPECT_EQ(2U, sz_package.NumDecodedBlocks());
+		EXPECT_LE(sz_package.DecodedBlocksSize(), SevenZipPackage::MAX_DECODED_BLOCKS_SIZE);
+
+		EXPECT_EQ(block2_res->View().data(), sz_package.Extract(file_path(2, 0), "File.bin")->View().data());
+		res = sz_package.Extract(file_path(1, 3), "File.bin");
+		ASSERT_TRUE(res);
+		EXPECT_NE(block1_res->View().data(), res->View().data());
+		EXPECT_EQ(ReadWholeFile(res), file_content(1, 3));
+		EXPECT_LE(sz_package.DecodedBlocksSize(), SevenZipPackage::MAX_DECODED_BLOCKS_SIZE);
+	}
+	std::remove(pkg_name.c_str());
+}
+
+class SleepLoadingDesc : public ResLoadingDesc
+{
+public:
+	SleepLoadingDesc(uint32_t id, uint32_t sleep_ms, bool wait_for_gate = false)
+		: id_(id), sleep_ms_(sleep_ms), wait_for_gate_(wait_for_gate), loaded_(MakeSharedPtr<uint32_t>(0))
+	{
+	}
+
+	static void ResetCounters()
+	{
+		num_in_flight_ = 0;
+		max_in_flight_ = 0;
+		num_loads_ = 0;
+		num_matches_ = 0;
+		gate_open_ = false;
+		load_order_.clear();
+	}
+
+	static void OpenGate()
+	{
+		gate_open_ = true;
+	}
+
+	static uint32_t NumInFlight()
+	{
+		return num_in_flight_;
+	}
+
+	static uint32_t MaxInFlight()
+	{
+		return max_in_flight_;
+	}
+
+	static uint32_t NumLoads()
+	{
+		return num_loads_;
+	}
+
+	static uint32_t NumMatches()
+	{
+		return num_matches_;
+	}
+
+	static std::vector<uint32_t> const & LoadOrder()
+	{
+		return load_order_;
+	}
+
+	uint64_t Type() const override
+	{
+		static uint64_t const type = CT_HASH("SleepLoadingDesc");
+		return type;
+	}
+
+	bool StateLess() const override
+	{
+		return true;
+	}
+
+	std::shared_ptr<void> CreateResource() override
+	{
+		++ num_loads_;
+		return loaded_;
+	}
+
+	void SubThreadStage() override
+	{
+		uint32_t const in_flight = ++ num_in_flight_;
+		uint32_t max_in_flight = max_in_flight_;
+		while ((in_flight > max_in_flight) && !max_in_flight_.compare_exchange_weak(max_in_flight, in_flight))
+		{
+		}
+
+		if (wait_for_gate_)
+		{
+			while (!gate_open_)
+			{
+				Sleep(1);
+			}
+		}
+		Sleep(sleep_ms_);
+
+		{
+			std::lock_guard<std::mutex> lock(load_order_mutex_);
+			load_order_.push_back(id_);
+		}
+		-- num_in_flight_;
+	}
+
+	void MainThreadStage() override
+	{
+		*loaded_ = 1;
+	}
+
+	bool HasSubThreadStage() const override
+	{
+		return true;
+	}
+
+	uint64_t KeyHash() const override
+	{
+		return id_;
+	}
+
+	bool Match(ResLoadingDesc const & rhs) const override
+	{
+		++ num_matches_;
+		if (this->Type() == rhs.Type())
+		{
+			SleepLoadingDesc const & sld = static_cast<SleepLoadingDesc const &>(rhs);
+			return id_ == sld.id_;
+		}
+		return false;
+	}
+
+	void CopyDataFrom(ResLoadingDesc const & rhs) override
+	{
+		BOOST_ASSERT(this->Type() == rhs.Type());
+
+		SleepLoadingDesc const & sld = static_cast<SleepLoadingDesc const &>(rhs);
+		id_ = sld.id_;
+		sleep_ms_ = sld.sleep_ms_;
+		wait_for_gate_ = sld.wait_for_gate_;
+		loaded_ = sld.loaded_;
+	}
+
+	std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource) override
+	{
+		return resource;
+	}
+
+	std::shared_ptr<void> Resource() const override
+	{
+		return loaded_;
+	}
+
+private:
+	uint32_t id_;
+	uint32_t sleep_ms_;
+	bool wait_for_gate_;
+	std::shared_ptr<uint32_t> loaded_;
+
+	static std::atomic<uint32_t> num_in_flight_;
+	static std::atomic<uint32_t> max_in_flight_;
+	static std::atomic<uint32_t> num_loads_;
+	static std::atomic<uint32_t> num_matches_;
+	static std::atomic<bool> gate_open_;
+	static std::mutex load_order_mutex_;
+	static std::vector<uint32_t> load_order_;
+};
+
+std::atomic<uint32_t> SleepLoadingDesc::num_in_flight_(0);
+std::atomic<uint32_t> SleepLoadingDesc::max_in_flight_(0);
+std::atomic<uint32_t> SleepLoadingDesc::num_loads_(0);
+std::atomic<uint32_t> SleepLoadingDesc::num_matches_(0);
+std::atomic<bool> SleepLoadingDesc::gate_open_(false);
+std::mutex SleepLoadingDesc::load_order_mutex_;
+std::vector<uint32_t> SleepLoadingDesc::load_order_;
+
+void WaitForLoading(std::vector<std::shared_ptr<uint32_t>> const & resources)
+{
+	for (;;)
+	{
+		ResLoader::Instance().Update();
+
+		bool all_loaded = true;
+		for (auto const & res : resources)
+		{
+			if (!*res)
+			{
+				all_loaded = false;
+				break;
+			}
+		}
+		if (all_loaded)
+		{
+			break;
+		}
+	}
+}
+
+TEST(ResLoaderTest, ASyncLoadingPriority)
+{
+	uint32_t const orig_num_threads = ResLoader::Instance().NumLoadingThreads();
+
+	SleepLoadingDesc::ResetCounters();
+	ResLoader::Instance().NumLoadingThreads(1);
+
+	// The gated request holds the only worker, so all the others are in the queue when it's released
+	uint32_t const base_id = 0x1000;
+	std::vector<std::shared_ptr<uint32_t>> resources;
+	resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + 0, 0, true), 100));
+	resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + 1, 0), 0));
+	resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + 2, 0), 1));
+	resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + 3, 0), 0));
+	resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + 4, 0), 1));
+	SleepLoadingDesc::OpenGate();
+
+	WaitForLoading(resources);
+
+	std::vector<uint32_t> const expected_order = { base_id + 0, base_id + 2, base_id + 4, base_id + 1, base_id + 3 };
+	EXPECT_EQ(expected_order, SleepLoadingDesc::LoadOrder());
+	EXPECT_EQ(1U, SleepLoadingDesc::MaxInFlight());
+
+	ResLoader::Instance().NumLoadingThreads(orig_num_threads);
+}
+
+TEST(ResLoaderTest, ParallelASyncLoading)
+{
+	uint32_t const orig_num_threads = ResLoader::Instance().NumLoadingThreads();
+
+	SleepLoadingDesc::ResetCounters();
+	ResLoader::Instance().NumLoadingThreads(4);
+
+	// Each worker ends up in one of the gated requests, they are released when all 4 are in flight
+	uint32_t const base_id = 0x2000;
+	uint32_t const num_gated = 4;
+	uint32_t const num_res = 32;
+	std::vector<std::shared_ptr<uint32_t>> resources;
+	for (uint32_t i = 0; i < num_res; ++ i)
+	{
+		bool const gated = (i < num_gated);
+		resources.push_back(ResLoader::Instance().ASyncQueryT<uint32_t>(
+			MakeSharedPtr<SleepLoadingDesc>(base_id + i, 1, gated), gated ? 1 : 0));
+	}
+	while (SleepLoadingDesc::NumInFlight() < num_gated)
+	{
+		Sleep(1);
+	}
+	SleepLoadingDesc::OpenGate();
+
+	WaitForLoading(resources);
+
+	EXPECT_EQ(num_res, SleepLoadingDesc::LoadOrder().size());
+	EXPECT_EQ(num_gated, SleepLoadingDesc::MaxInFlight());
+	for (auto const & res : resources)
+	{
+		EXPECT_EQ(1U, *res);
+	}
+
+	ResLoader::Instance().NumLoadingThreads(orig_num_threads);
+}
+
+TEST(ResLoaderTest, LoadedResourceQuery)
+{
+	SleepLoadingDesc::ResetCounters();
+
+	uint32_t const base_id = 0x80000000U;
+	uint32_t const num_cached = 16 * 1024;
+
+	std::vector<std::shared_ptr<uint32_t>> resources;
+	for (uint32_t i = 0; i < num_cached; ++ i)
+	{
+		resources.push_back(ResLoader::Instance().SyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + i, 0)));
+	}
+	EXPECT_EQ(num_cached, SleepLoadingDesc::NumLoads());
+	EXPECT_EQ(0U, SleepLoadingDesc::NumMatches());
+
+	// Every query hits, and only compares with the one loaded desc of the same key hash
+	uint32_t const num_queries = 4096;
+	for (uint32_t i = 0; i < num_queries; ++ i)
+	{
+		uint32_t const index = i * 7 % num_cached;
+		auto res = ResLoader::Instance().SyncQueryT<uint32_t>(MakeSharedPtr<SleepLoadingDesc>(base_id + index, 0));
+		EXPECT_EQ(res, resources[index]);
+	}
+	EXPECT_EQ(num_cached, SleepLoadingDesc::NumLoads());
+	EXPECT_EQ(num_queries, SleepLoadingDesc::NumMatches());
+}
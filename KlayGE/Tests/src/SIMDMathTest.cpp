@@ -1,16 +1,66 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/SIMDMath.hpp>
+#include <KFL/Timer.hpp>
 
 #include "KlayGETests.hpp"
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <random>
 
 using namespace std;
 using namespace KlayGE;
 
+namespace
+{
+	float const BATCH_TOLERANCE = 1e-4f;
+
+	bool NearlyEqual(float lhs, float rhs)
+	{
+		return MathLib::abs(lhs - rhs) <= BATCH_TOLERANCE * std::max(1.0f, std::max(MathLib::abs(lhs), MathLib::abs(rhs)));
+	}
+
+	bool NearlyEqual(float3 const & lhs, float3 const & rhs)
+	{
+		return NearlyEqual(lhs.x(), rhs.x()) && NearlyEqual(lhs.y(), rhs.y()) && NearlyEqual(lhs.z(), rhs.z());
+	}
+
+	bool NearlyEqual(Quaternion const & lhs, Quaternion const & rhs)
+	{
+		return NearlyEqual(lhs.x(), rhs.x()) && NearlyEqual(lhs.y(), rhs.y()) && NearlyEqual(lhs.z(), rhs.z())
+			&& NearlyEqual(lhs.w(), rhs.w());
+	}
+
+	std::vector<float3> GeneratePoints(uint32_t num)
+	{
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> dis(-100, 100);
+
+		std::vector<float3> points(num);
+		for (auto& p : points)
+		{
+			p = float3(dis(gen), dis(gen), dis(gen));
+		}
+		return points;
+	}
+
+	void GenerateDualQuats(std::vector<Quaternion>& reals, std::vector<Quaternion>& duals, uint32_t num, uint32_t seed)
+	{
+		std::mt19937 gen(seed);
+		std::uniform_real_distribution<float> dis(-1, 1);
+
+		reals.resize(num);
+		duals.resize(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			reals[i] = MathLib::normalize(Quaternion(dis(gen), dis(gen), dis(gen), dis(gen)));
+			duals[i] = MathLib::quat_trans_to_udq(reals[i], float3(dis(gen), dis(gen), dis(gen)) * 10.0f);
+		}
+	}
+}
+
 TEST(SIMDMathTest, NormalizeVector2)
 {
 	SIMDVectorF4 v = SIMDMathLib::SetVector(1, 2, 0, 0);
@@ -31,3 +81,192 @@ TEST(SIMDMathTest, NormalizeVector4)
 	v = SIMDMathLib::NormalizeVector4(v);
 	EXPECT_LT(MathLib::abs(SIMDMathLib::GetX(SIMDMathLib::LengthVector4(v)) - 1.0f), 1e-3f);
 }
+
+// Odd counts go through both the SIMD and the remainder paths
+TEST(SIMDMathTest, TransformCoordVector3Batch)
+{
+	float4x4 const affine = MathLib::scaling(2.0f, 3.0f, 4.0f) * MathLib::rotation_y(0.7f) * MathLib::translation(5.0f, -6.0f, 7.0f);
+	float4x4 const perspective = MathLib::look_at_lh(float3(0, 0, -300), float3(10, 5, 0))
+		* MathLib::perspective_fov_lh(PI / 4, 1.5f, 1.0f, 600.0f);
+
+	for (float4x4 const & mat : { affine, perspective })
+	{
+		for (uint32_t num : { 1U, 3U, 8U, 33U })
+		{
+			std::vector<float3> const points = GeneratePoints(num);
+			std::vector<float3> results(num);
+			SIMDMathLib::TransformCoordVector3(&results[0], &points[0], num, mat);
+			for (uint32_t i = 0; i < num; ++ i)
+			{
+				EXPECT_TRUE(NearlyEqual(MathLib::transform_coord(points[i], mat), results[i]));
+			}
+		}
+	}
+}
+
+TEST(SIMDMathTest, TransformAABBoxBatch)
+{
+	float4x4 const mat = MathLib::scaling(2.0f, 3.0f, 4.0f) * MathLib::rotation_x(0.3f) * MathLib::translation(5.0f, -6.0f, 7.0f);
+
+	for (uint32_t num : { 1U, 3U, 8U, 33U })
+	{
+		std::vector<float3> const points = GeneratePoints(num * 2);
+		std::vector<AABBox> boxes(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			boxes[i] = AABBox(MathLib::minimize(points[i * 2 + 0], points[i * 2 + 1]),
+				MathLib::maximize(points[i * 2 + 0], points[i * 2 + 1]));
+		}
+
+		std::vector<AABBox> results(num);
+		SIMDMathLib::TransformAABBox(&results[0], &boxes[0], num, mat);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			AABBox const expected = MathLib::transform_aabb(boxes[i], mat);
+			EXPECT_TRUE(NearlyEqual(expected.Min(), results[i].Min()));
+			EXPECT_TRUE(NearlyEqual(expected.Max(), results[i].Max()));
+		}
+
+		// In place
+		SIMDMathLib::TransformAABBox(&boxes[0], &boxes[0], num, mat);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			EXPECT_TRUE(boxes[i] == results[i]);
+		}
+	}
+}
+
+TEST(SIMDMathTest, MultiplyDualQuatBatch)
+{
+	for (uint32_t num : { 1U, 3U, 8U, 33U })
+	{
+		std::vector<Quaternion> lhs_reals, lhs_duals, rhs_reals, rhs_duals;
+		GenerateDualQuats(lhs_reals, lhs_duals, num, 1);
+		GenerateDualQuats(rhs_reals, rhs_duals, num, 2);
+
+		std::vector<Quaternion> out_reals(num), out_duals(num);
+		SIMDMathLib::MultiplyDualQuat(&out_reals[0], &out_duals[0], &lhs_reals[0], &lhs_duals[0],
+			&rhs_reals[0], &rhs_duals[0], num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			EXPECT_TRUE(NearlyEqual(MathLib::mul_real(lhs_reals[i], rhs_reals[i]), out_reals[i]));
+			EXPECT_TRUE(NearlyEqual(MathLib::mul_dual(lhs_reals[i], lhs_duals[i], rhs_reals[i], rhs_duals[i]), out_duals[i]));
+		}
+	}
+}
+
+TEST(SIMDMathTest, BlendDualQuatBatch)
+{
+	for (uint32_t num : { 1U, 3U, 8U, 33U })
+	{
+		std::vector<Quaternion> reals0, duals0, reals1, duals1;
+		GenerateDualQuats(reals0, duals0, num, 1);
+		GenerateDualQuats(reals1, duals1, num, 2);
+
+		std::vector<float> factors(num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			factors[i] = (i + 0.5f) / num;
+		}
+
+		std::vector<Quaternion> out_reals(num), out_duals(num);
+		SIMDMathLib::BlendDualQuat(&out_reals[0], &out_duals[0], &reals0[0], &duals0[0],
+			&reals1[0], &duals1[0], &factors[0], num);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			// Linear blend along the shortest arc, then normalized by the length of the real part
+			float const w1 = (MathLib::dot(reals0[i], reals1[i]) < 0) ? -factors[i] : factors[i];
+			Quaternion const real = reals0[i] * (1 - factors[i]) + reals1[i] * w1;
+			Quaternion const dual = duals0[i] * (1 - factors[i]) + duals1[i] * w1;
+			float const inv_len = MathLib::recip_sqrt(MathLib::length_sq(real));
+			EXPECT_TRUE(NearlyEqual(real * inv_len, out_reals[i]));
+			EXPECT_TRUE(NearlyEqual(dual * inv_len, out_duals[i]));
+		}
+	}
+}
+
+// Scalar MathLib against the batch kernels. Timings depend on the machine, so nothing is asserted. Run with
+// --gtest_also_run_disabled_tests.
+TEST(SIMDMathTest, DISABLED_BatchBenchmark)
+{
+	uint32_t const NUM = 64 * 1024;
+	uint32_t const ITERATIONS = 32;
+
+	float4x4 const mat = MathLib::scaling(2.0f, 3.0f, 4.0f) * MathLib::rotation_y(0.7f) * MathLib::translation(5.0f, -6.0f, 7.0f);
+	std::vector<float3> const points = GeneratePoints(NUM);
+
+	std::vector<float3> scalar_points(NUM);
+	Timer timer;
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		for (uint32_t i = 0; i < NUM; ++ i)
+		{
+			scalar_points[i] = MathLib::transform_coord(points[i], mat);
+		}
+	}
+	double const scalar_point_time = timer.elapsed() / ITERATIONS;
+
+	std::vector<float3> batch_points(NUM);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		SIMDMathLib::TransformCoordVector3(&batch_points[0], &points[0], NUM, mat);
+	}
+	double const batch_point_time = timer.elapsed() / ITERATIONS;
+
+	std::vector<AABBox> boxes(NUM / 2);
+	for (uint32_t i = 0; i < NUM / 2; ++ i)
+	{
+		boxes[i] = AABBox(MathLib::minimize(points[i * 2 + 0], points[i * 2 + 1]),
+			MathLib::maximize(points[i * 2 + 0], points[i * 2 + 1]));
+	}
+
+	std::vector<AABBox> scalar_boxes(NUM / 2);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		for (uint32_t i = 0; i < NUM / 2; ++ i)
+		{
+			scalar_boxes[i] = MathLib::transform_aabb(boxes[i], mat);
+		}
+	}
+	double const scalar_box_time = timer.elapsed() / ITERATIONS;
+
+	std::vector<AABBox> batch_boxes(NUM / 2);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		SIMDMathLib::TransformAABBox(&batch_boxes[0], &boxes[0], NUM / 2, mat);
+	}
+	double const batch_box_time = timer.elapsed() / ITERATIONS;
+
+	std::vector<Quaternion> lhs_reals, lhs_duals, rhs_reals, rhs_duals;
+	GenerateDualQuats(lhs_reals, lhs_duals, NUM, 1);
+	GenerateDualQuats(rhs_reals, rhs_duals, NUM, 2);
+
+	std::vector<Quaternion> out_reals(NUM), out_duals(NUM);
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		for (uint32_t i = 0; i < NUM; ++ i)
+		{
+			out_reals[i] = MathLib::mul_real(lhs_reals[i], rhs_reals[i]);
+			out_duals[i] = MathLib::mul_dual(lhs_reals[i], lhs_duals[i], rhs_reals[i], rhs_duals[i]);
+		}
+	}
+	double const scalar_dq_time = timer.elapsed() / ITERATIONS;
+
+	timer.restart();
+	for (uint32_t iter = 0; iter < ITERATIONS; ++ iter)
+	{
+		SIMDMathLib::MultiplyDualQuat(&out_reals[0], &out_duals[0], &lhs_reals[0], &lhs_duals[0],
+			&rhs_reals[0], &rhs_duals[0], NUM);
+	}
+	double const batch_dq_time = timer.elapsed() / ITERATIONS;
+
+	std::cout << "SIMDMathLib batch (" << SIMDMathLib::BatchBackendName() << "):" << std::endl
+		<< "  " << NUM << " points: scalar " << scalar_point_time * 1000 << " ms, batch " << batch_point_time * 1000 << " ms" << std::endl
+		<< "  " << NUM / 2 << " AABBs: scalar " << scalar_box_time * 1000 << " ms, batch " << batch_box_time * 1000 << " ms" << std::endl
+		<< "  " << NUM << " dual quaternions: scalar " << scalar_dq_time * 1000 << " ms, batch " << batch_dq_time * 1000 << " ms"
+		<< std::endl;
+}
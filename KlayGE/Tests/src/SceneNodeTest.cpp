@@ -0,0 +1,249 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/App3D.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/Renderable.hpp>
+#include <KlayGE/SceneManager.hpp>
+#include <KlayGE/SceneNode.hpp>
+
+#include <functional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "KlayGETests.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	AABBox const OBJ_BOUND(float3(-1, -2, -3), float3(3, 2, 1));
+
+	class BoundRenderable : public Renderable
+	{
+	public:
+		BoundRenderable()
+		{
+			pos_aabb_ = OBJ_BOUND;
+		}
+	};
+
+	bool NearlyEqual(float4x4 const & lhs, float4x4 const & rhs)
+	{
+		for (size_t i = 0; i < 16; ++ i)
+		{
+			if (abs(lhs[i] - rhs[i]) > 1e-4f * (1 + abs(rhs[i])))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool NearlyEqual(AABBox const & lhs, AABBox const & rhs)
+	{
+		for (size_t i = 0; i < 3; ++ i)
+		{
+			if ((abs(lhs.Min()[i] - rhs.Min()[i]) > 1e-3f * (1 + abs(rhs.Min()[i])))
+				|| (abs(lhs.Max()[i] - rhs.Max()[i]) > 1e-3f * (1 + abs(rhs.Max()[i]))))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+// The per level passes of SceneManager::UpdateSceneNodeTransforms and UpdateSceneNodeBounds, on levels big enough to be
+// split across the thread pool
+class SceneNodeHierarchyTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		std::mt19937 gen(1);
+		std::uniform_real_distribution<float> pos_dis(-20, 20);
+		std::uniform_real_distribution<float> angle_dis(-PI, PI);
+		auto random_xform = [&gen, &pos_dis, &angle_dis]
+		{
+			return MathLib::rotation_y(angle_dis(gen)) * MathLib::translation(pos_dis(gen), pos_dis(gen), pos_dis(gen));
+		};
+
+		// 8 branches of 256 chains, each 3 nodes deep. The levels below the branches have 2048 nodes each.
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		for (uint32_t b = 0; b < 8; ++ b)
+		{
+			branches_.push_back(this->MakeNode(random_xform()));
+			for (uint32_t c = 0; c < 256; ++ c)
+			{
+				SceneNodePtr parent = branches_.back();
+				for (uint32_t d = 0; d < 3; ++ d)
+				{
+					auto node = this->MakeNode(random_xform());
+					parent->AddChild(node);
+					parent = node;
+				}
+			}
+			scene_mgr.SceneRootNode().AddChild(branches_.back());
+		}
+	}
+
+	void TearDown() override
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		{
+			std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+			for (auto const & branch : branches_)
+			{
+				scene_mgr.SceneRootNode().RemoveChild(branch);
+			}
+		}
+		branches_.clear();
+	}
+
+	SceneNodePtr MakeNode(float4x4 const & xform_to_parent)
+	{
+		auto node = MakeSharedPtr<SceneNode>(MakeSharedPtr<RenderableComponent>(MakeSharedPtr<BoundRenderable>()), L"Node",
+			SceneNode::SOA_Cullable);
+		node->TransformToParent(xform_to_parent);
+		return node;
+	}
+
+	// Runs a frame, and checks the world matrices it computed, and the bounds, against a recursive recompute
+	void CheckHierarchy()
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+
+		// Outside of a frame TransformToWorld walks up the parents, during one it returns what the update computed
+		std::unordered_map<SceneNode const *, float4x4> worlds;
+		TestsAppUpdateCallback([this, &worlds]
+			{
+				for (auto const & branch : branches_)
+				{
+					branch->Traverse([&worlds](SceneNode& node)
+						{
+							worlds.emplace(&node, node.TransformToWorld());
+							return true;
+						});
+				}
+			});
+		scene_mgr.Update();
+		TestsAppUpdateCallback(nullptr);
+
+		uint32_t num_nodes = 0;
+		uint32_t num_xform_mismatches = 0;
+		uint32_t num_bound_mismatches = 0;
+		std::function<AABBox(SceneNode const &, float4x4 const &)> recompute =
+			[&](SceneNode const & node, float4x4 const & parent_world)
+			{
+				float4x4 const world = node.TransformToParent() * parent_world;
+
+				AABBox bound_os = OBJ_BOUND;
+				for (auto const & child : node.Children())
+				{
+					bound_os |= MathLib::transform_aabb(recompute(*child, world), child->TransformToParent());
+				}
+
+				++ num_nodes;
+				auto const iter = worlds.find(&node);
+				if ((iter == worlds.end()) || !NearlyEqual(iter->second, world))
+				{
+					++ num_xform_mismatches;
+				}
+				if (!NearlyEqual(node.PosBoundOS(), bound_os) || !NearlyEqual(node.PosBoundWS(), MathLib::transform_aabb(bound_os, world)))
+				{
+					++ num_bound_mismatches;
+				}
+
+				return bound_os;
+			};
+		for (auto const & branch : branches_)
+		{
+			recompute(*branch, float4x4::Identity());
+		}
+
+		EXPECT_EQ(8U * (1 + 256 * 3), num_nodes);
+		EXPECT_EQ(0U, num_xform_mismatches);
+		EXPECT_EQ(0U, num_bound_mismatches);
+	}
+
+	std::vector<SceneNodePtr> branches_;
+};
+
+TEST_F(SceneNodeHierarchyTest, ParentOnlyMove)
+{
+	this->CheckHierarchy();
+
+	// Only the branch is dirty, its whole subtree has to follow
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		branches_[3]->TransformToParent(MathLib::rotation_y(1.0f) * MathLib::translation(100.0f, -50.0f, 25.0f));
+	}
+	this->CheckHierarchy();
+
+	// A node in the middle of the chains
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		auto const & mid = branches_[5]->Children()[17]->Children()[0];
+		mid->TransformToParent(mid->TransformToParent() * MathLib::translation(0.0f, 10.0f, 0.0f));
+	}
+	this->CheckHierarchy();
+}
+
+TEST_F(SceneNodeHierarchyTest, Reparent)
+{
+	this->CheckHierarchy();
+
+	// Chains move to another branch, with their local transforms. The scene graph is flattened again.
+	{
+		auto& scene_mgr = Context::Instance().SceneManagerInstance();
+		std::lock_guard<std::mutex> lock(scene_mgr.MutexForUpdate());
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			SceneNodePtr const chain = branches_[0]->Children().back();
+			branches_[0]->RemoveChild(chain);
+			branches_[1]->AddChild(chain);
+		}
+
+		// A chain's tail goes to the top of another chain, which changes the sizes of the two lowest levels
+		SceneNodePtr const tail = branches_[2]->Children()[0]->Children()[0]->Children()[0];
+		tail->Parent()->RemoveChild(tail);
+		branches_[2]->Children()[1]->AddChild(tail);
+	}
+	this->CheckHierarchy();
+}
+
+TEST(SceneNodeTest, SubThreadWrites)
+{
+	SceneNode node(L"Node", 0);
+	float4x4 const old_xform = MathLib::translation(1.0f, 2.0f, 3.0f);
+	float4x4 const new_xform = MathLib::translation(4.0f, 5.0f, 6.0f);
+	node.TransformToParent(old_xform);
+
+	// In a sub thread pass, writes are recorded in order and take effect when applied
+	std::vector<std::function<void()>> writes;
+	uint32_t value = 0;
+	SceneNode::BeginSubThreadWrites(writes);
+	node.TransformToParent(new_xform);
+	SceneNode::DeferSubThreadWrite([&value] { value = value * 10 + 1; });
+	SceneNode::DeferSubThreadWrite([&value] { value = value * 10 + 2; });
+	EXPECT_TRUE(NearlyEqual(node.TransformToParent(), old_xform));
+	SceneNode::EndSubThreadWrites();
+
+	ASSERT_EQ(3U, writes.size());
+	EXPECT_EQ(0U, value);
+	for (auto const & write : writes)
+	{
+		write();
+	}
+	EXPECT_TRUE(NearlyEqual(node.TransformToParent(), new_xform));
+	EXPECT_EQ(12U, value);
+
+	// Outside of a pass they happen right away
+	SceneNode::DeferSubThreadWrite([&value] { value = 3; });
+	EXPECT_EQ(3U, value);
+}
@@ -427,6 +427,83 @@ namespace
 		cout << "MSE: " << mse << endl;
 		cout << "PSNR: " << psnr << endl;
 	}
+
+	void CompressHDRBC6(std::string const & in_file, std::string const & out_file)
+	{
+		TexturePtr in_tex = LoadSoftwareTexture(in_file);
+		auto const in_format = in_tex->Format();
+		if ((in_format != EF_ABGR16F) && (in_format != EF_ABGR32F))
+		{
+			cout << "Unsupported texture format" << endl;
+			return;
+		}
+
+		auto const & in_data = checked_cast<SoftwareTexture&>(*in_tex).SubresourceData();
+		uint32_t const in_pixel_size = NumFormatBytes(in_format);
+
+		TexCompressionBC6U bc6_codec;
+		uint32_t const block_bytes = BlockBytes(EF_BC6);
+
+		std::vector<ElementInitData> bc6_data(in_data.size());
+		std::vector<std::vector<uint8_t>> bc6_data_block(in_data.size());
+		float mse = 0;
+		uint32_t n = 0;
+		for (size_t i = 0; i < in_data.size(); ++ i)
+		{
+			uint32_t const width = in_data[i].row_pitch / in_pixel_size;
+			uint32_t const height = in_data[i].slice_pitch / in_data[i].row_pitch;
+
+			std::vector<half> src(width * height * 4);
+			for (uint32_t y = 0; y < height; ++ y)
+			{
+				uint8_t const * src_row = static_cast<uint8_t const *>(in_data[i].data) + y * in_data[i].row_pitch;
+				for (uint32_t x = 0; x < width * 4; ++ x)
+				{
+					if (EF_ABGR16F == in_format)
+					{
+						src[y * width * 4 + x] = reinterpret_cast<half const *>(src_row)[x];
+					}
+					else
+					{
+						src[y * width * 4 + x] = half(reinterpret_cast<float const *>(src_row)[x]);
+					}
+				}
+			}
+
+			bc6_data[i].row_pitch = (width + 3) / 4 * block_bytes;
+			bc6_data[i].slice_pitch = (height + 3) / 4 * bc6_data[i].row_pitch;
+			bc6_data_block[i].resize(bc6_data[i].slice_pitch);
+			bc6_data[i].data = bc6_data_block[i].data();
+
+			bc6_codec.EncodeMem(width, height, bc6_data_block[i].data(), bc6_data[i].row_pitch, bc6_data[i].slice_pitch,
+				src.data(), width * sizeof(half) * 4, width * height * sizeof(half) * 4, TCM_Quality);
+
+			std::vector<half> restored(width * height * 4);
+			bc6_codec.DecodeMem(width, height, restored.data(), width * sizeof(half) * 4, width * height * sizeof(half) * 4,
+				bc6_data_block[i].data(), bc6_data[i].row_pitch, bc6_data[i].slice_pitch);
+
+			for (uint32_t j = 0; j < width * height; ++ j)
+			{
+				for (uint32_t ch = 0; ch < 3; ++ ch)
+				{
+					float const diff = static_cast<float>(src[j * 4 + ch]) - static_cast<float>(restored[j * 4 + ch]);
+					mse += diff * diff;
+				}
+			}
+			n += width * height;
+		}
+
+		TexturePtr out_tex = MakeSharedPtr<SoftwareTexture>(in_tex->Type(), in_tex->Width(0), in_tex->Height(0), in_tex->Depth(0),
+			in_tex->NumMipMaps(), in_tex->ArraySize(), EF_BC6, true);
+		out_tex->CreateHWResource(bc6_data, nullptr);
+		SaveTexture(out_tex, out_file);
+
+		mse /= n;
+		float psnr = 10 * log10(65504.0f * 65504.0f / std::max(mse, 1e-6f));
+
+		cout << "MSE: " << mse << endl;
+		cout << "PSNR: " << psnr << endl;
+	}
 }
 
 int main(int argc, char* argv[])
@@ -436,9 +513,24 @@ int main(int argc, char* argv[])
 	if (argc < 2)
 	{
 		cout << "Usage: HDRCompressor xxx.dds [R16 | R16F] [BC5 | BC3]" << endl;
+		cout << "       HDRCompressor xxx.dds BC6" << endl;
 		return 1;
 	}
 
+	if ((argc >= 3) && (std::string(argv[2]) == "BC6"))
+	{
+		filesystem::path output_path(argv[1]);
+		std::string bc6_file = output_path.stem().string() + "_bc6" + output_path.extension().string();
+
+		CompressHDRBC6(argv[1], bc6_file);
+
+		cout << "HDR texture is compressed into " << bc6_file << endl;
+
+		Context::Destroy();
+
+		return 0;
+	}
+
 	ElementFormat y_format = EF_R16;
 	if (argc >= 3)
 	{
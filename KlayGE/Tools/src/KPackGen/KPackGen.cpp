@@ -0,0 +1,275 @@
+﻿/**
+ * @file KPackGen.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/ErrorHandling.hpp>
+#include <KFL/Timer.hpp>
+#include <KlayGE/Package.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#ifndef KLAYGE_DEBUG
+#define CXXOPTS_NO_RTTI
+#endif
+#include <cxxopts.hpp>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	std::vector<std::string> SplitExtensions(std::string const & exts)
+	{
+		std::vector<std::string> ret;
+		std::istringstream iss(exts);
+		std::string ext;
+		while (std::getline(iss, ext, ','))
+		{
+			if (!ext.empty())
+			{
+				if (ext[0] != '.')
+				{
+					ext = '.' + ext;
+				}
+				std::transform(ext.begin(), ext.end(), ext.begin(),
+					[](char ch)
+					{
+						return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+					});
+				ret.push_back(ext);
+			}
+		}
+		return ret;
+	}
+
+	// Returns the number of bytes read
+	uint64_t ReadAll(std::string const & virtual_path, std::vector<std::string> const & files)
+	{
+		uint64_t total_size = 0;
+		std::vector<char> buff;
+		for (auto const & file : files)
+		{
+			auto res = ResLoader::Instance().Open(virtual_path + "/" + file);
+			if (res)
+			{
+				res->seekg(0, std::ios_base::end);
+				buff.resize(static_cast<size_t>(res->tellg()));
+				res->seekg(0, std::ios_base::beg);
+				res->read(buff.data(), buff.size());
+				total_size += buff.size();
+			}
+			else
+			{
+				cout << "Could NOT open " << file << " in " << virtual_path << '.' << endl;
+			}
+		}
+		return total_size;
+	}
+
+	void Benchmark(std::string const & seven_zip_name, std::string const & kpk_name, std::vector<std::string> const & files,
+		uint32_t iterations)
+	{
+		std::tuple<char const *, std::string, std::string> const packages[] =
+		{
+			{ "7z", "KPackGenBench7z", seven_zip_name },
+			{ "kpk", "KPackGenBenchKpk", kpk_name }
+		};
+		for (auto const & package : packages)
+		{
+			Timer timer;
+			uint64_t total_size = 0;
+			double mount_time = 0;
+			double total_time = 0;
+			for (uint32_t i = 0; i < iterations; ++ i)
+			{
+				// Mount every time, to exclude any cache inside the package
+				timer.restart();
+				ResLoader::Instance().Mount(std::get<1>(package), std::get<2>(package));
+				mount_time += timer.elapsed();
+				total_size += ReadAll(std::get<1>(package), files);
+				ResLoader::Instance().Unmount(std::get<1>(package), std::get<2>(package));
+				total_time += timer.elapsed();
+			}
+
+			cout << std::get<0>(package) << ": " << total_time / iterations * 1000 << " ms per pass ("
+				<< mount_time / iterations * 1000 << " ms mounting), "
+				<< total_size / iterations / 1024.0 / 1024.0 / (total_time / iterations) << " MB/s" << endl;
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string input_folder;
+	std::string output_name;
+	std::string stored_exts = ".dds,.jpg,.png,.ogg,.7z,.kpk";
+	std::string benchmark_name;
+	uint32_t iterations = 4;
+	bool quiet = false;
+
+	cxxopts::Options options("KPackGen", "KlayGE Package Generator");
+	options.add_options()
+		("H,help", "Produce help message.")
+		("I,input-folder", "Input folder.", cxxopts::value<std::string>())
+		("O,output-name", "Output package name. (default: input-folder.kpk)", cxxopts::value<std::string>())
+		("S,stored-exts", "Comma separated extensions of files stored without compression, usually because they are already "
+			"compressed. (default: .dds,.jpg,.png,.ogg,.7z,.kpk)", cxxopts::value<std::string>())
+		("B,benchmark", "Compare the load time of the package against a 7z of the same folder.", cxxopts::value<std::string>())
+		("N,iterations", "Iterations of the benchmark. (default: 4)", cxxopts::value<uint32_t>())
+		("q,quiet", "Quiet mode.", cxxopts::value<bool>()->implicit_value("true"))
+		("v,version", "Version.");
+
+	int const argc_backup = argc;
+	auto vm = options.parse(argc, argv);
+
+	if ((argc_backup <= 1) || (vm.count("help") > 0))
+	{
+		cout << options.help() << endl;
+		return 1;
+	}
+	if (vm.count("version") > 0)
+	{
+		cout << "KlayGE Package Generator, Version 1.0.0" << endl;
+		return 1;
+	}
+	if (vm.count("input-folder") > 0)
+	{
+		input_folder = vm["input-folder"].as<std::string>();
+	}
+	else
+	{
+		cout << "Need input folder." << endl;
+		cout << options.help() << endl;
+		return 1;
+	}
+	if (vm.count("output-name") > 0)
+	{
+		output_name = vm["output-name"].as<std::string>();
+	}
+	if (vm.count("stored-exts") > 0)
+	{
+		stored_exts = vm["stored-exts"].as<std::string>();
+	}
+	if (vm.count("benchmark") > 0)
+	{
+		benchmark_name = vm["benchmark"].as<std::string>();
+	}
+	if (vm.count("iterations") > 0)
+	{
+		iterations = std::max(vm["iterations"].as<uint32_t>(), 1U);
+	}
+	if (vm.count("quiet") > 0)
+	{
+		quiet = vm["quiet"].as<bool>();
+	}
+
+	filesystem::path input_path(input_folder);
+	while (!input_path.has_filename() && input_path.has_parent_path() && (input_path != input_path.parent_path()))
+	{
+		input_path = input_path.parent_path();
+	}
+	if (!filesystem::is_directory(input_path))
+	{
+		cout << "Could NOT find folder " << input_folder << '.' << endl;
+		Context::Destroy();
+		return 1;
+	}
+	if (output_name.empty())
+	{
+		output_name = input_path.string() + ".kpk";
+	}
+
+	std::vector<std::string> const stored_ext_list = SplitExtensions(stored_exts);
+
+	std::vector<std::string> file_names;
+	std::vector<std::tuple<std::string, std::function<ResIdentifierPtr()>, bool>> files;
+	for (auto const & entry : filesystem::recursive_directory_iterator(input_path))
+	{
+		if (!filesystem::is_regular_file(entry.path()))
+		{
+			continue;
+		}
+
+		std::string const full_name = entry.path().string();
+		std::string name = filesystem::path(full_name.substr(input_path.string().size() + 1)).generic_string();
+
+		std::string ext = entry.path().extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(),
+			[](char ch)
+			{
+				return static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+			});
+		bool const compress = (std::find(stored_ext_list.begin(), stored_ext_list.end(), ext) == stored_ext_list.end());
+
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+		uint64_t const timestamp = filesystem::last_write_time(entry.path()).time_since_epoch().count();
+#else
+		uint64_t const timestamp = filesystem::last_write_time(entry.path());
+#endif
+		// Files are only opened when they are packed, a big folder could run out of file handles otherwise
+		auto open_file = [full_name, timestamp]
+		{
+			// The static_cast is a workaround for a bug in clang/c2
+			return MakeSharedPtr<ResIdentifier>(full_name, timestamp,
+				MakeSharedPtr<std::ifstream>(full_name.c_str(), static_cast<std::ios_base::openmode>(std::ios_base::binary)));
+		};
+
+		file_names.push_back(name);
+		files.emplace_back(name, open_file, compress);
+	}
+
+	Timer timer;
+	SaveKPackage(output_name, files);
+	files.clear();
+
+	if (!quiet)
+	{
+		cout << file_names.size() << " files have been packed to " << output_name << " in " << timer.elapsed() << " s." << endl;
+	}
+
+	if (!benchmark_name.empty())
+	{
+		Benchmark(benchmark_name, output_name, file_names, iterations);
+	}
+
+	Context::Destroy();
+
+	return 0;
+}